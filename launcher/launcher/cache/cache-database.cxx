@@ -1,5 +1,7 @@
 #include <launcher/cache/cache-database.hxx>
 
+#include <algorithm>
+#include <cstdlib>
 #include <stdexcept>
 
 #include <odb/query.hxx>
@@ -11,14 +13,95 @@ using namespace std;
 
 namespace launcher
 {
+  namespace
+  {
+    // The performance ledger (see perf_record). It is not an ODB object so
+    // we create it ourselves, both in new databases and when migrating.
+    //
+    constexpr const char* ledger_ddl =
+      "CREATE TABLE IF NOT EXISTS \"perf_ledger\" ("
+      "\"id\" INTEGER PRIMARY KEY, "
+      "\"run\" INTEGER NOT NULL, "
+      "\"time\" INTEGER NOT NULL, "
+      "\"release\" TEXT NOT NULL, "
+      "\"phase\" TEXT NOT NULL, "
+      "\"host\" TEXT NOT NULL, "
+      "\"files\" INTEGER NOT NULL, "
+      "\"bytes\" INTEGER NOT NULL, "
+      "\"duration\" INTEGER NOT NULL, "
+      "\"errors\" INTEGER NOT NULL, "
+      "\"retries\" INTEGER NOT NULL);"
+      "CREATE INDEX IF NOT EXISTS \"perf_ledger_phase_i\" "
+      "ON \"perf_ledger\" (\"phase\", \"host\", \"id\")";
+
+    // Prepared ledger statement, finalized on destruction.
+    //
+    struct ledger_statement
+    {
+      sqlite3* h;
+      sqlite3_stmt* s = nullptr;
+
+      ledger_statement (odb::connection& c, const char* q)
+        : h (static_cast<odb::sqlite::connection&> (c).handle ())
+      {
+        if (sqlite3_prepare_v2 (h, q, -1, &s, nullptr) != SQLITE_OK)
+          fail ();
+      }
+
+      ~ledger_statement ()
+      {
+        sqlite3_finalize (s);
+      }
+
+      ledger_statement (const ledger_statement&) = delete;
+      ledger_statement& operator= (const ledger_statement&) = delete;
+
+      // Return true if there is a row.
+      //
+      bool
+      step ()
+      {
+        int r (sqlite3_step (s));
+
+        if (r != SQLITE_ROW && r != SQLITE_DONE)
+          fail ();
+
+        return r == SQLITE_ROW;
+      }
+
+      void
+      execute ()
+      {
+        if (step ())
+          fail ();
+      }
+
+      string
+      text (int i) const
+      {
+        const unsigned char* p (sqlite3_column_text (s, i));
+        return p != nullptr ? string (reinterpret_cast<const char*> (p))
+                            : string ();
+      }
+
+      [[noreturn]] void
+      fail () const
+      {
+        throw runtime_error (string ("performance ledger query failed: ") +
+                             sqlite3_errmsg (h));
+      }
+    };
+  }
+
   cache_database::
-  cache_database (const fs::path& d)
+  cache_database (const fs::path& d, lock_mode m)
+      : mode_ (m)
   {
     // Construct the cache database and initialize the schema and pragmas.
     //
     launcher::log::trace_l2 (categories::cache {},
                              "constructing cache_database");
-    init (d);
+    init (d, m);
   }
 
   cache_database::
@@ -67,7 +150,7 @@ namespace launcher
   }
 
   void cache_database::
-  init (const fs::path& d)
+  init (const fs::path& d, lock_mode m)
   {
     launcher::log::trace_l1 (categories::cache {},
                              "initializing cache database at root: {}",
@@ -77,6 +160,25 @@ namespace launcher
     //
     fs::path c (d / dir_name);
 
+    // In the read-only mode there is nothing to bootstrap: either someone
+    // has created the database or there is nothing to inspect.
+    //
+    if (m == lock_mode::read_only)
+    {
+      path_ = c / db_name;
+
+      if (!fs::exists (path_))
+        throw runtime_error ("cache database does not exist: " +
+                             path_.string ());
+
+      launcher::log::trace_l2 (categories::cache {},
+                               "opening sqlite database read-only");
+      db_ = make_unique<odb::sqlite::database> (path_.string (),
+                                                SQLITE_OPEN_READONLY);
+      pragmas ();
+      return;
+    }
+
     if (!fs::exists (c))
     {
       // The cache directory does not exist, so create it.
@@ -174,11 +276,94 @@ namespace launcher
 
       odb::transaction t (db_->begin ());
       odb::schema_catalog::create_schema (*db_);
+
+      sqlite3* h (
+        static_cast<odb::sqlite::connection&> (t.connection ()).handle ());
+
+      if (sqlite3_exec (h, ledger_ddl, nullptr, nullptr, nullptr) != SQLITE_OK)
+        throw runtime_error (string ("failed to create ledger table: ") +
+                             sqlite3_errmsg (h));
+
       t.commit ();
+
+      migrate (schema_ver);
     }
     else
+    {
       launcher::log::trace_l3 (categories::cache {},
                                "database schema already exists");
+      migrate ();
+    }
+  }
+
+  void cache_database::
+  migrate (optional<unsigned int> v)
+  {
+    // Statements that upgrade the schema from the previous version, indexed
+    // by the version they upgrade to minus 2. Databases created before we
+    // started recording the version have user_version 0 and are treated as
+    // version 1.
+    //
+    static const char* const ms[] = {
+      "ALTER TABLE \"cached_files\" "
+      "ADD COLUMN \"fingerprint\" TEXT NOT NULL DEFAULT ''",
+
+      "ALTER TABLE \"cached_files\" "
+      "ADD COLUMN \"verified\" INTEGER NOT NULL DEFAULT 0",
+
+      ledger_ddl};
+
+    static_assert (sizeof (ms) / sizeof (ms[0]) == schema_ver - 1);
+
+    odb::connection_ptr c (db_->connection ());
+    sqlite3* h (static_cast<odb::sqlite::connection&> (*c).handle ());
+
+    if (!v)
+    {
+      unsigned int cv (0);
+      sqlite3_stmt* s (nullptr);
+
+      if (sqlite3_prepare_v2 (h, "PRAGMA user_version", -1, &s, nullptr) ==
+          SQLITE_OK)
+      {
+        if (sqlite3_step (s) == SQLITE_ROW)
+          cv = static_cast<unsigned int> (sqlite3_column_int (s, 0));
+
+        sqlite3_finalize (s);
+      }
+
+      cv = max (cv, 1U);
+
+      if (cv == schema_ver)
+        return;
+
+      if (cv > schema_ver)
+      {
+        // Written by a newer launcher. The columns we know about are still
+        // there so leave it be.
+        //
+        launcher::log::warning (categories::cache {},
+                                "database schema version {} is newer than {}",
+                                cv,
+                                schema_ver);
+        return;
+      }
+
+      for (unsigned int i (cv); i != schema_ver; ++i)
+      {
+        launcher::log::info (categories::cache {},
+                             "migrating database schema to version {}",
+                             i + 1);
+
+        if (sqlite3_exec (h, ms[i - 1], nullptr, nullptr, nullptr) !=
+            SQLITE_OK)
+          throw runtime_error (string ("failed to migrate database schema: ") +
+                               sqlite3_errmsg (h));
+      }
+    }
+
+    string q ("PRAGMA user_version=" + to_string (schema_ver));
+    sqlite3_exec (h, q.c_str (), nullptr, nullptr, nullptr);
   }
 
   void cache_database::
@@ -192,8 +377,20 @@ namespace launcher
     odb::sqlite::connection& sc (static_cast<odb::sqlite::connection&> (*c));
     sqlite3* h (sc.handle ());
 
-    // Enable WAL mode. This allows better concurrency if we ever have
-    // multiple processes, though currently we lock the whole thing.
+    // Wait for a concurrent writer (or, in the exclusive mode, for whoever
+    // holds the database) instead of failing with SQLITE_BUSY right away.
+    //
+    sqlite3_busy_timeout (h, busy_timeout);
+
+    if (mode_ == lock_mode::read_only)
+    {
+      launcher::log::trace_l3 (categories::cache {}, "enabling query-only");
+      sqlite3_exec (h, "PRAGMA query_only=ON", nullptr, nullptr, nullptr);
+      return;
+    }
+
+    // Enable WAL mode. This allows readers to run concurrently with the
+    // writer (see lock_mode).
     //
     if (wal)
     {
@@ -204,15 +401,32 @@ namespace launcher
     // Prioritize performance. If something corrupts, we just rebuild the
     // cache rather than paying a continuous synchronization penalty.
     //
+    // Unless we were asked for durability, that is. Note that the data
+    // barrier itself is issued by whoever applies the files (see
+    // sync_files()); here we only make sure the database cannot end up
+    // ahead of it. In the WAL mode NORMAL only synchronizes on checkpoints
+    // so the batch mode is still cheap.
+    //
+    durability_mode dm (configured_durability ());
+    const char* sm (dm == durability_mode::none  ? "OFF"    :
+                    dm == durability_mode::batch ? "NORMAL" :
+                                                   "FULL");
+
     launcher::log::trace_l3 (
       categories::cache {},
-      "disabling synchronous mode and foreign keys, enabling exclusive locking "
-      "and memory temp_store");
-
-    sqlite3_exec (h, "PRAGMA synchronous=OFF", nullptr, nullptr, nullptr);
+      "setting synchronous mode to {}, disabling foreign keys, enabling {} "
+      "locking and memory temp_store",
+      sm,
+      mode_ == lock_mode::exclusive ? "exclusive" : "normal");
+
+    string q ("PRAGMA synchronous=");
+    q += sm;
+    sqlite3_exec (h, q.c_str (), nullptr, nullptr, nullptr);
     sqlite3_exec (h, "PRAGMA foreign_keys=OFF", nullptr, nullptr, nullptr);
     sqlite3_exec (h,
-                  "PRAGMA locking_mode=EXCLUSIVE",
+                  mode_ == lock_mode::exclusive
+                  ? "PRAGMA locking_mode=EXCLUSIVE"
+                  : "PRAGMA locking_mode=NORMAL",
                   nullptr,
                   nullptr,
                   nullptr);
@@ -278,6 +492,8 @@ namespace launcher
       e->set_version (f.version ());
       e->set_size (f.size ());
       e->set_hash (f.hash ());
+      e->set_fingerprint (f.fingerprint ());
+      e->set_verified (f.verified ());
       db_->update (*e);
     }
     else
@@ -316,6 +532,8 @@ namespace launcher
         e->set_version (f.version ());
         e->set_size (f.size ());
         e->set_hash (f.hash ());
+        e->set_fingerprint (f.fingerprint ());
+        e->set_verified (f.verified ());
         db_->update (*e);
       }
       else
@@ -569,6 +787,276 @@ namespace launcher
     return r;
   }
 
+  cache_status cache_database::
+  status () const
+  {
+    launcher::log::trace_l2 (categories::cache {}, "taking status snapshot");
+
+    cache_status r;
+
+    // Run everything in one read transaction so that the counts, versions,
+    // and sync result are consistent with each other even if the launcher is
+    // writing concurrently. We go straight to SQLite for the aggregates
+    // rather than loading every object.
+    //
+    odb::transaction t (db_->begin ());
+
+    sqlite3* h (
+      static_cast<odb::sqlite::connection&> (t.connection ()).handle ());
+
+    auto query ([h] (const char* q, const auto& f)
+    {
+      sqlite3_stmt* s (nullptr);
+
+      if (sqlite3_prepare_v2 (h, q, -1, &s, nullptr) != SQLITE_OK)
+        throw runtime_error (string ("failed to query cache status: ") +
+                             sqlite3_errmsg (h));
+
+      while (sqlite3_step (s) == SQLITE_ROW)
+        f (s);
+
+      sqlite3_finalize (s);
+    });
+
+    auto text ([] (sqlite3_stmt* s, int i)
+    {
+      const unsigned char* p (sqlite3_column_text (s, i));
+      return p != nullptr ? string (reinterpret_cast<const char*> (p))
+                          : string ();
+    });
+
+    auto comp ([&r] (int c) -> cache_status::component&
+    {
+      component_type ct (static_cast<component_type> (c));
+
+      for (auto& e : r.components)
+      {
+        if (e.type == ct)
+          return e;
+      }
+
+      r.components.push_back (cache_status::component {ct, nullopt, 0, 0});
+      return r.components.back ();
+    });
+
+    query ("SELECT \"component\", \"tag\" FROM \"component_versions\"",
+           [&] (sqlite3_stmt* s)
+    {
+      comp (sqlite3_column_int (s, 0)).version = text (s, 1);
+    });
+
+    query ("SELECT \"component\", COUNT(*), SUM(\"size\") "
+           "FROM \"cached_files\" GROUP BY \"component\"",
+           [&] (sqlite3_stmt* s)
+    {
+      auto& e (comp (sqlite3_column_int (s, 0)));
+      e.files = static_cast<size_t> (sqlite3_column_int64 (s, 1));
+      e.bytes = static_cast<uint64_t> (sqlite3_column_int64 (s, 2));
+    });
+
+    query ("SELECT \"key\", \"val\" FROM \"user_settings\" "
+           "WHERE \"key\" IN "
+           "('last_sync', 'last_sync_error', 'last_sync_time')",
+           [&] (sqlite3_stmt* s)
+    {
+      string k (text (s, 0));
+      string v (text (s, 1));
+
+      if (k == "last_sync")
+        r.last_sync = move (v);
+      else if (k == "last_sync_error")
+        r.last_sync_error = move (v);
+      else
+        r.last_sync_time = strtoll (v.c_str (), nullptr, 10);
+    });
+
+    t.commit ();
+
+    sort (r.components.begin (), r.components.end (),
+          [] (const auto& x, const auto& y) {return x.type < y.type;});
+
+    return r;
+  }
+
+  void cache_database::
+  record_sync (bool ok, const string& e)
+  {
+    transact ([this, ok, &e] ()
+    {
+      auto set ([this] (const string& k, const string& v)
+      {
+        shared_ptr<user_setting> s (db_->find<user_setting> (k));
+
+        if (s)
+        {
+          s->val (v);
+          db_->update (*s);
+        }
+        else
+        {
+          user_setting n (k, v);
+          db_->persist (n);
+        }
+      });
+
+      set ("last_sync", ok ? "ok" : "failed");
+      set ("last_sync_error", e);
+      set ("last_sync_time", to_string (current_timestamp ()));
+    });
+  }
+
+  void cache_database::
+  record (const vector<perf_record>& rs)
+  {
+    if (rs.empty ())
+      return;
+
+    launcher::log::trace_l2 (categories::cache {},
+                             "recording {} performance ledger record(s)",
+                             rs.size ());
+
+    odb::transaction t (db_->begin ());
+    {
+      ledger_statement s (
+        t.connection (),
+        "INSERT INTO \"perf_ledger\" (\"run\", \"time\", \"release\", "
+        "\"phase\", \"host\", \"files\", \"bytes\", \"duration\", "
+        "\"errors\", \"retries\") "
+        "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)");
+
+      for (const perf_record& r : rs)
+      {
+        sqlite3_bind_int64 (s.s, 1, r.run);
+        sqlite3_bind_int64 (s.s, 2, r.time);
+        sqlite3_bind_text (s.s, 3, r.release.c_str (), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text (s.s, 4, r.phase.c_str (), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text (s.s, 5, r.host.c_str (), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int64 (s.s, 6, static_cast<sqlite3_int64> (r.files));
+        sqlite3_bind_int64 (s.s, 7, static_cast<sqlite3_int64> (r.bytes));
+        sqlite3_bind_int64 (s.s, 8, r.duration);
+        sqlite3_bind_int64 (s.s, 9, static_cast<sqlite3_int64> (r.errors));
+        sqlite3_bind_int64 (s.s, 10, static_cast<sqlite3_int64> (r.retries));
+
+        s.execute ();
+        sqlite3_reset (s.s);
+      }
+    }
+    t.commit ();
+  }
+
+  vector<perf_record> cache_database::
+  history (int64_t since) const
+  {
+    launcher::log::trace_l3 (categories::cache {},
+                             "querying performance ledger since {}",
+                             since);
+
+    vector<perf_record> r;
+
+    odb::transaction t (db_->begin ());
+    {
+      ledger_statement s (
+        t.connection (),
+        "SELECT \"run\", \"time\", \"release\", \"phase\", \"host\", "
+        "\"files\", \"bytes\", \"duration\", \"errors\", \"retries\" "
+        "FROM \"perf_ledger\" WHERE \"time\" >= ?1 ORDER BY \"id\"");
+
+      sqlite3_bind_int64 (s.s, 1, since);
+
+      auto u ([&s] (int i)
+      {
+        return static_cast<uint64_t> (sqlite3_column_int64 (s.s, i));
+      });
+
+      while (s.step ())
+      {
+        perf_record e;
+        e.run = sqlite3_column_int64 (s.s, 0);
+        e.time = sqlite3_column_int64 (s.s, 1);
+        e.release = s.text (2);
+        e.phase = s.text (3);
+        e.host = s.text (4);
+        e.files = u (5);
+        e.bytes = u (6);
+        e.duration = sqlite3_column_int64 (s.s, 7);
+        e.errors = u (8);
+        e.retries = u (9);
+        r.push_back (move (e));
+      }
+    }
+    t.commit ();
+
+    return r;
+  }
+
+  optional<perf_prior> cache_database::
+  prior (const string& phase, const string& host, size_t n) const
+  {
+    optional<perf_prior> r;
+
+    odb::transaction t (db_->begin ());
+    {
+      ledger_statement s (
+        t.connection (),
+        "SELECT COUNT(*), SUM(\"bytes\"), SUM(\"duration\"), "
+        "SUM(\"files\"), SUM(\"errors\") FROM ("
+        "SELECT \"bytes\", \"duration\", \"files\", \"errors\" "
+        "FROM \"perf_ledger\" WHERE \"phase\" = ?1 AND \"host\" = ?2 "
+        "ORDER BY \"id\" DESC LIMIT ?3)");
+
+      sqlite3_bind_text (s.s, 1, phase.c_str (), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_text (s.s, 2, host.c_str (), -1, SQLITE_TRANSIENT);
+      sqlite3_bind_int64 (s.s, 3, static_cast<sqlite3_int64> (n));
+
+      if (s.step () && sqlite3_column_int64 (s.s, 0) != 0)
+      {
+        double b (sqlite3_column_double (s.s, 1));
+        double d (sqlite3_column_double (s.s, 2));
+        double f (sqlite3_column_double (s.s, 3));
+        double e (sqlite3_column_double (s.s, 4));
+
+        perf_prior p;
+        p.samples = static_cast<size_t> (sqlite3_column_int64 (s.s, 0));
+        p.throughput = d > 0 ? b * 1000 / d : 0;
+        p.error_rate = f + e > 0 ? e / (f + e) : 0;
+        r = p;
+      }
+    }
+    t.commit ();
+
+    return r;
+  }
+
+  void cache_database::
+  prune_ledger (int64_t before, size_t n)
+  {
+    launcher::log::trace_l2 (categories::cache {},
+                             "pruning performance ledger before {}, "
+                             "keeping at most {} record(s)",
+                             before,
+                             n);
+
+    odb::transaction t (db_->begin ());
+    {
+      ledger_statement s (t.connection (),
+                          "DELETE FROM \"perf_ledger\" WHERE \"time\" < ?1");
+
+      sqlite3_bind_int64 (s.s, 1, before);
+      s.execute ();
+    }
+    {
+      ledger_statement s (
+        t.connection (),
+        "DELETE FROM \"perf_ledger\" WHERE \"id\" <= ("
+        "SELECT \"id\" FROM \"perf_ledger\" ORDER BY \"id\" DESC "
+        "LIMIT 1 OFFSET ?1)");
+
+      sqlite3_bind_int64 (s.s, 1, static_cast<sqlite3_int64> (n));
+      s.execute ();
+    }
+    t.commit ();
+  }
+
   optional<user_setting> cache_database::
   setting (const string& k) const
   {
@@ -2,6 +2,7 @@
 
 #include <launcher/cache/cache-types.hxx>
 
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <memory>
@@ -20,6 +21,67 @@ namespace launcher
 {
   namespace fs = std::filesystem;
 
+  // Point-in-time summary of the cache for status tools. See
+  // cache_database::status().
+  //
+  struct cache_status
+  {
+    struct component
+    {
+      component_type type;
+      std::optional<std::string> version; // Installed tag, if any.
+      std::size_t files = 0;              // Tracked files.
+      std::uint64_t bytes = 0;            // Their total size.
+    };
+
+    std::vector<component> components;
+
+    // Outcome of the last synchronization: "ok", "failed", or empty if there
+    // hasn't been any. The time is in seconds since epoch.
+    //
+    std::string last_sync;
+    std::string last_sync_error;
+    std::int64_t last_sync_time = 0;
+  };
+
+  // Performance ledger record.
+  //
+  // Every run appends a record per phase (and, for downloads, per host) so
+  // that we can tell whether things got slower after a release and so that
+  // adaptive decisions have some history to start from. See
+  // cache_database::record().
+  //
+  struct perf_record
+  {
+    std::int64_t run = 0;      // Start of the run, milliseconds since epoch.
+    std::int64_t time = 0;     // Seconds since epoch.
+    std::string release;       // Launcher version.
+    std::string phase;         // sync, download, hash, etc.
+    std::string host;          // Download host, empty if not applicable.
+    std::uint64_t files = 0;
+    std::uint64_t bytes = 0;
+    std::int64_t duration = 0; // Milliseconds.
+    std::uint64_t errors = 0;
+    std::uint64_t retries = 0;
+
+    // Bytes per second or 0 if unknown.
+    //
+    double
+    throughput () const noexcept
+    {
+      return duration > 0 ? bytes * 1000.0 / duration : 0;
+    }
+  };
+
+  // Aggregate of the most recent records of a phase (and host).
+  //
+  struct perf_prior
+  {
+    std::size_t samples = 0; // Records it is based on.
+    double throughput = 0;   // Bytes per second, 0 if unknown.
+    double error_rate = 0;   // Errors per attempt (file plus error).
+  };
+
   // Main database handle.
   //
   // Note that ODB handles connection pooling internally so we just hold the
@@ -40,7 +102,14 @@ namespace launcher
     // migration, but since this is just a cache, we might also consider a
     // wipe-and-rebuild strategy on mismatch instead of complex migrations.
     //
-    static constexpr unsigned int schema_ver = 1;
+    // The version is kept in SQLite's user_version and, so far, the changes
+    // are additive and applied with plain SQL (see migrate()):
+    //
+    // 2: cached_files.fingerprint
+    // 3: cached_files.verified
+    // 4: perf_ledger
+    //
+    static constexpr unsigned int schema_ver = 4;
 
     // If the database file is missing, we want ODB to generate the schema for
     // us immediately.
@@ -53,8 +122,38 @@ namespace launcher
     //
     static constexpr bool wal = true;
 
+    // Locking mode.
+    //
+    // In the shared mode we only hold the database lock for the duration of
+    // a transaction so that WAL readers (status tools, monitoring, another
+    // launcher instance) can run concurrently with us, the single writer.
+    // Concurrent writers wait for each other for up to busy_timeout.
+    //
+    // In the exclusive mode we hold the lock for as long as the database is
+    // open. This saves the shared-memory index bookkeeping and works on
+    // filesystems without shared memory support but locks everyone else out.
+    //
+    // The read-only mode is for inspecting a database that may be in use by
+    // another process. It never creates, migrates, or writes anything and
+    // fails if the database does not exist.
+    //
+    enum class lock_mode
+    {
+      shared,
+      exclusive,
+      read_only
+    };
+
+    static constexpr lock_mode def_lock = lock_mode::shared;
+    static constexpr int busy_timeout = 5000; // Milliseconds.
+
+    // Upper bound on the performance ledger size regardless of the
+    // retention (see prune_ledger()).
+    //
+    static constexpr std::size_t ledger_max_records = 10000;
+
     explicit
-    cache_database (const fs::path& root);
+    cache_database (const fs::path& root, lock_mode m = def_lock);
 
     cache_database (const cache_database&) = delete;
     cache_database& operator= (const cache_database&) = delete;
@@ -162,6 +261,53 @@ namespace launcher
     std::vector<component_version>
     versions () const;
 
+    // Status.
+    //
+
+    // Take a consistent snapshot of the cache summary. This only runs a few
+    // aggregate queries in a single read transaction which, thanks to WAL,
+    // neither waits for nor blocks a concurrent writer.
+    //
+    cache_status
+    status () const;
+
+    // Record the outcome of a synchronization for status().
+    //
+    void
+    record_sync (bool ok, const std::string& error = std::string ());
+
+    // Performance ledger.
+    //
+    // The ledger is append-only (other than pruning) and lives in plain SQL
+    // rather than ODB since we only ever append to it and aggregate over it.
+    //
+
+    // Append the records in a single transaction.
+    //
+    void
+    record (const std::vector<perf_record>& rs);
+
+    // Return the records not older than the specified time (seconds since
+    // epoch), oldest first.
+    //
+    std::vector<perf_record>
+    history (std::int64_t since = 0) const;
+
+    // Aggregate the most recent records of the phase and host (see
+    // perf_prior). Return nullopt if there are none.
+    //
+    std::optional<perf_prior>
+    prior (const std::string& phase,
+           const std::string& host = std::string (),
+           std::size_t samples = 16) const;
+
+    // Drop records older than the specified time (seconds since epoch) as
+    // well as the oldest records in excess of the maximum count.
+    //
+    void
+    prune_ledger (std::int64_t before,
+                  std::size_t max_records = ledger_max_records);
+
     // User settings.
     //
 
@@ -233,7 +379,7 @@ namespace launcher
 
   private:
     void
-    init (const fs::path& root);
+    init (const fs::path& root, lock_mode m);
 
     // Check schema_catalog.
     //
@@ -243,12 +389,20 @@ namespace launcher
     void
     schema ();
 
+    // Bring an existing database up to schema_ver and record the version. If
+    // the current version is specified (for example, because the schema was
+    // just created), then only record it.
+    //
+    void
+    migrate (std::optional<unsigned int> current = std::nullopt);
+
     // Setup database pragmas (WAL, synchronous modes, etc).
     //
     void
     pragmas ();
 
     fs::path path_;
+    lock_mode mode_;
     std::unique_ptr<odb::sqlite::database> db_;
   };
 }
@@ -0,0 +1,413 @@
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#include <launcher/cache/cache-reconciler.hxx>
+#include <launcher/cache/cache-database.hxx>
+#include <launcher/manifest/manifest.hxx>
+
+#include <launcher/launcher-blake3.test.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace launcher;
+
+// Reconciler scaling benchmark.
+//
+// Usage: cache-reconciler.bench [<name>=<fraction>...] [<files>...]
+//
+// For each file count (1k to 500k by default) we synthesize an update
+// manifest (a quarter of the files are members of exploded archives, the
+// rest are standalone) together with an installation tree and cache
+// database in which the manifest files are split into stale (the database
+// entry doesn't match the file so it has to be hashed), missing, and valid
+// (the rest) ones, plus unknown files that are tracked but no longer in the
+// manifest. The fractions can be adjusted with the stale=, missing= and
+// unknown= arguments.
+//
+// We then time each reconciler phase and record its peak memory, first with
+// a cold and then with a warm page cache. A cold* cache means we couldn't
+// drop the dentry and inode caches (requires root) and only evicted the file
+// data.
+//
+// Note that most files are kept empty so that a 500k tree costs inodes
+// rather than blocks. Only the stale files have content since those are the
+// ones we hash.
+//
+
+struct fractions
+{
+  double stale   = 0.05;
+  double missing = 0.10;
+  double unknown = 0.05; // Relative to the manifest size.
+};
+
+// Resident set size accounting (Linux only, zero elsewhere).
+//
+// We reset the high water mark before each phase (see clear_refs in
+// proc(5)) so that we get the peak of that phase rather than of the whole
+// process.
+//
+struct memory
+{
+  static uint64_t
+  status (const string& k)
+  {
+#ifdef __linux__
+    ifstream is ("/proc/self/status");
+
+    for (string l; getline (is, l); )
+    {
+      if (l.compare (0, k.size (), k) == 0)
+        return stoull (l.substr (k.size ())) * 1024;
+    }
+#else
+    (void) k;
+#endif
+    return 0;
+  }
+
+  static void
+  reset ()
+  {
+#ifdef __linux__
+    ofstream ("/proc/self/clear_refs") << "5";
+#endif
+  }
+
+  static uint64_t
+  current ()
+  {
+    return status ("VmRSS:");
+  }
+
+  static uint64_t
+  peak ()
+  {
+    return status ("VmHWM:");
+  }
+};
+
+// Evict the tree (and the database) from the page cache.
+//
+// Dropping all the caches requires privileges so we fall back to advising
+// the kernel to drop each file's pages which covers the data but not the
+// dentry and inode caches. Return true if we managed the former.
+//
+static bool
+evict (const fs::path& root)
+{
+#ifdef __linux__
+  sync ();
+
+  {
+    ofstream os ("/proc/sys/vm/drop_caches");
+
+    if (os << "3" << flush)
+      return true;
+  }
+
+  for (const auto& e : fs::recursive_directory_iterator (root))
+  {
+    if (!e.is_regular_file ())
+      continue;
+
+    int fd (open (e.path ().c_str (), O_RDONLY));
+
+    if (fd != -1)
+    {
+      posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+      close (fd);
+    }
+  }
+#else
+  (void) root;
+#endif
+
+  return false;
+}
+
+class tree
+{
+public:
+  tree (const fs::path& r, size_t n, const fractions& f)
+    : root (r), db (r), rec (db, r)
+  {
+    const string v ("v1");
+
+    size_t nm (n * f.missing);
+    size_t ns (n * f.stale);
+    size_t nv (n - nm - ns);
+    size_t nu (n * f.unknown);
+
+    m = manifest (manifest_format::update, manifest_format::update);
+
+    // Archives of 64 members each covering a quarter of the files.
+    //
+    size_t na ((n / 4 + 63) / 64);
+
+    for (size_t i (0); i != na; ++i)
+      m.archives.emplace_back (launcher::hash (blake3_hex ("")),
+                               0,
+                               "pak_" + to_string (i) + ".zip");
+
+    // Distribute the states evenly rather than in blocks so that each of
+    // them is spread across archive members and standalone files.
+    //
+    mt19937 g (n);
+    vector<char> ss;
+    ss.insert (ss.end (), nv, 'v');
+    ss.insert (ss.end (), ns, 's');
+    ss.insert (ss.end (), nm, 'm');
+    shuffle (ss.begin (), ss.end (), g);
+
+    vector<fs::path> tracked;
+
+    for (size_t i (0); i != n; ++i)
+    {
+      bool member (i < n / 4);
+      string p ((member ? "zone/pak_" + to_string (i / 64) + "/f_"
+                        : "iw4x/d_" + to_string (i % 256) + "/f_") +
+                to_string (i) + ".dat");
+
+      // Stale files have content that matches the manifest half the time.
+      //
+      string c (ss[i] == 's' ? "content " + to_string (i) : string ());
+      string h (blake3_hex (i % 2 == 0 ? c : c + '~'));
+
+      manifest_file mf (launcher::hash (h), c.size (), p);
+
+      if (member)
+      {
+        mf.archive_name = m.archives[i / 64].name;
+        m.archives[i / 64].files.push_back (mf);
+      }
+
+      m.files.push_back (move (mf));
+
+      if (ss[i] == 'm')
+        continue;
+
+      fs::path fp (root / p);
+      write (fp, c);
+      tracked.push_back (fp);
+
+      if (ss[i] == 's')
+        stale.push_back (fp);
+    }
+
+    for (size_t i (0); i != nu; ++i)
+    {
+      fs::path fp (root / "iw4x" / "old" / ("u_" + to_string (i) + ".dat"));
+      write (fp, string ());
+      unknown.push_back (fp);
+    }
+
+    rec.track (tracked, component_type::client, v);
+    rec.stamp (component_type::client, v);
+  }
+
+  // Restore the states that the previous pass changed: stale files adopted
+  // into the database and unknown files pruned from it.
+  //
+  void
+  prepare ()
+  {
+    auto t (fs::file_time_type::clock::now () + chrono::seconds (++epoch));
+
+    for (const auto& p : stale)
+      fs::last_write_time (p, t);
+
+    rec.track (unknown, component_type::client, "v1");
+  }
+
+  fs::path root;
+  cache_database db;
+  reconciler rec;
+  manifest m;
+
+private:
+  static void
+  write (const fs::path& p, const string& c)
+  {
+    fs::create_directories (p.parent_path ());
+    ofstream (p, ios::binary | ios::trunc) << c;
+  }
+
+  vector<fs::path> stale;
+  vector<fs::path> unknown;
+  int epoch = 0;
+};
+
+static void
+measure (size_t n, const char* cache, const char* phase,
+         const function<size_t ()>& f)
+{
+  memory::reset ();
+  uint64_t m0 (memory::current ());
+  auto t0 (chrono::steady_clock::now ());
+
+  size_t r (f ());
+
+  chrono::duration<double, milli> d (chrono::steady_clock::now () - t0);
+  uint64_t pk (memory::peak ());
+
+  cout << setw (8)  << n
+       << setw (7)  << cache
+       << setw (15) << phase
+       << setw (12) << fixed << setprecision (1) << d.count ()
+       << setw (12) << fixed << setprecision (1) << pk / 1048576.0
+       << setw (12) << fixed << setprecision (1)
+                    << (pk > m0 ? pk - m0 : 0) / 1048576.0
+       << setw (9)  << r
+       << endl;
+}
+
+static void
+run (const fs::path& work, size_t n, const fractions& fr)
+{
+  fs::path root (work / to_string (n));
+  fs::remove_all (root);
+  fs::create_directories (root);
+
+  tree t (root, n, fr);
+
+  const component_type c (component_type::client);
+  const string v ("v1");
+
+  for (bool cold : {true, false})
+  {
+    const char* cs (cold ? "cold" : "warm");
+
+    // Phases individually.
+    //
+    t.prepare ();
+
+    if (cold && !evict (root))
+      cs = "cold*";
+
+    reconciler::cache_map cm;
+    vector<reconcile_item> is;
+
+    measure (n, cs, "load", [&] ()
+    {
+      for (auto& f : t.db.files (c))
+        cm.emplace (f.path (), move (f));
+
+      return cm.size ();
+    });
+
+    measure (n, cs, "plan_archives", [&] ()
+    {
+      auto r (t.rec.plan_archives (t.m.archives, c, v, cm));
+      is.insert (is.end (), r.begin (), r.end ());
+      return r.size ();
+    });
+
+    measure (n, cs, "plan_files", [&] ()
+    {
+      auto r (t.rec.plan_files (t.m.files, c, v, cm));
+      is.insert (is.end (), r.begin (), r.end ());
+      return r.size ();
+    });
+
+    measure (n, cs, "summarize", [&] ()
+    {
+      return t.rec.summarize (is).downloads_required;
+    });
+
+    // Then the whole thing as the launcher does it.
+    //
+    t.prepare ();
+
+    if (cold)
+      evict (root);
+
+    measure (n, cs, "plan", [&] ()
+    {
+      return t.rec.plan (t.m, c, v).size ();
+    });
+
+    measure (n, cs, "clean", [&] ()
+    {
+      return t.rec.clean (t.m, c).size ();
+    });
+  }
+
+  fs::remove_all (root);
+}
+
+int
+main (int argc, char* argv[])
+{
+  fractions fr;
+  vector<size_t> ns;
+
+  for (int i (1); i < argc; ++i)
+  {
+    string a (argv[i]);
+    size_t p (a.find ('='));
+
+    if (p == string::npos)
+    {
+      ns.push_back (stoull (a));
+      continue;
+    }
+
+    string k (a.substr (0, p));
+    double x (stod (a.substr (p + 1)));
+
+    if      (k == "stale")   fr.stale = x;
+    else if (k == "missing") fr.missing = x;
+    else if (k == "unknown") fr.unknown = x;
+    else
+    {
+      cerr << "error: unknown argument '" << a << "'" << endl;
+      return 1;
+    }
+  }
+
+  if (ns.empty ())
+    ns = {1000, 10000, 100000, 500000};
+
+  fs::path work (fs::temp_directory_path () / "iw4x-reconciler-bench");
+
+  cout << setw (8)  << "files"
+       << setw (7)  << "cache"
+       << setw (15) << "phase"
+       << setw (12) << "time (ms)"
+       << setw (12) << "peak (MiB)"
+       << setw (12) << "delta (MiB)"
+       << setw (9)  << "items"
+       << endl;
+
+  try
+  {
+    for (size_t n : ns)
+      run (work, n, fr);
+  }
+  catch (const exception& e)
+  {
+    cerr << "error: " << e.what () << endl;
+    return 1;
+  }
+
+  error_code ec;
+  fs::remove_all (work, ec);
+
+  return 0;
+}
@@ -2,10 +2,14 @@
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cctype>
 #include <exception>
+#include <iomanip>
 #include <latch>
 #include <mutex>
+#include <random>
+#include <sstream>
 #include <thread>
 #include <unordered_map>
 #include <vector>
@@ -14,6 +18,7 @@
 #include <boost/asio/thread_pool.hpp>
 
 #include <launcher/launcher-manifest.hxx>
+#include <launcher/launcher-resources.hxx>
 
 using namespace std;
 
@@ -43,6 +48,18 @@ namespace launcher
       auto s (fs::file_size (p, ec));
       return ec ? 0 : s;
     }
+
+    atomic<strategy> default_strat (reconciler::def_strat);
+
+    mutex budget_mutex;
+    verify_budget default_bud; // Protected by budget_mutex.
+
+    verify_budget
+    budget ()
+    {
+      lock_guard<mutex> l (budget_mutex);
+      return default_bud;
+    }
   }
 
   cache_database& reconciler::
@@ -76,7 +93,8 @@ namespace launcher
   reconciler (cache_database& db, const fs::path& r)
     : db_ (db),
       root_ (fs::weakly_canonical (r)),
-      strat_ (def_strat)
+      strat_ (default_strat.load ()),
+      budget_ (budget ())
   {
     launcher::log::trace_l2 (categories::cache {},
                              "initialized reconciler with root: {}",
@@ -98,6 +116,19 @@ namespace launcher
     return strat_;
   }
 
+  void reconciler::
+  default_mode (strategy s)
+  {
+    default_strat = s;
+  }
+
+  void reconciler::
+  default_budget (const verify_budget& b)
+  {
+    lock_guard<mutex> l (budget_mutex);
+    default_bud = b;
+  }
+
   void reconciler::
   progress (progress_cb cb)
   {
@@ -218,24 +249,26 @@ namespace launcher
     int64_t mt;
     uint64_t s;
     string err;
+    string f;
   };
 
   namespace
   {
+    // If the fingerprint key is not empty, then also record the fingerprints
+    // of the files that matched.
+    //
     void
     run_hashes (vector<hash_task>& ts,
+                const string& fk,
                 function<void (const string&, size_t, size_t)> cb)
     {
       if (ts.empty ())
         return;
 
-      // Determine a reasonable number of workers. Hardware concurrency is a
-      // good default, but it can return 0 on some platforms, so we provide
-      // a fallback.
+      // One worker per hardware thread unless configured otherwise (see
+      // configure_hashing()).
       //
-      unsigned int n (thread::hardware_concurrency ());
-      if (n == 0)
-        n = 4;
+      size_t n (hashing_workers ());
 
       launcher::log::trace_l2 (
         categories::cache {},
@@ -243,6 +276,7 @@ namespace launcher
         n,
         ts.size ());
 
+      worker_placement wp;
       asio::thread_pool pl (n);
       atomic<size_t> d (0);
       size_t tot (ts.size ());
@@ -250,8 +284,10 @@ namespace launcher
 
       for (auto& t : ts)
       {
-        asio::post (pl,[&t, &d, tot, &l, &cb] ()
+        asio::post (pl,[&t, &d, tot, &l, &fk, &cb, &wp] ()
         {
+          wp.place ();
+
           try
           {
             // We only bother hashing if the file actually exists and we have
@@ -269,6 +305,9 @@ namespace launcher
               {
                 t.mt = get_file_mtime (t.p);
                 t.s = size_quiet (t.p);
+
+                if (!fk.empty ())
+                  t.f = compute_fingerprint (t.p, fk, t.k);
               }
               else
               {
@@ -319,6 +358,47 @@ namespace launcher
       launcher::log::trace_l2 (categories::cache {},
                                "all hash tasks completed");
     }
+
+    // Hash the files in parallel. The hash of a file that could not be read
+    // is left empty.
+    //
+    vector<string>
+    hash_files (const vector<fs::path>& ps)
+    {
+      vector<string> r (ps.size ());
+
+      if (ps.empty ())
+        return r;
+
+      worker_placement wp;
+      asio::thread_pool pl (min (hashing_workers (), ps.size ()));
+
+      for (size_t i (0); i != ps.size (); ++i)
+      {
+        asio::post (pl, [&ps, &r, &wp, i] ()
+        {
+          wp.place ();
+
+          try
+          {
+            blake3_hash h (blake3_hash::of_file (ps[i]));
+
+            if (!h.empty ())
+              r[i] = h.string ();
+          }
+          catch (const exception& e)
+          {
+            launcher::log::warning (categories::cache {},
+                                    "unable to hash {}: {}",
+                                    ps[i].string (),
+                                    e.what ());
+          }
+        });
+      }
+
+      pl.join ();
+      return r;
+    }
   }
 
   vector<reconcile_item> reconciler::
@@ -346,6 +426,11 @@ namespace launcher
         cm.emplace (f.path (), move (f));
     }
 
+    // Scrub first so that whatever turns out to be corrupted is planned
+    // like any other untracked file.
+    //
+    scrub (c, cm);
+
     vector<reconcile_item> r;
 
     auto as (plan_archives (m.archives, c, v, cm));
@@ -506,18 +591,23 @@ namespace launcher
       vector<hash_task> ts;
       ts.reserve (ls.size () + fs.size ());
 
+      string fkey (strat_ == strategy::fingerprint
+                   ? fingerprint_key ()
+                   : string ());
+
       for (const auto& l : ls)
-        ts.push_back ({l.p, l.h, l.k, c, false, 0, 0, ""});
+        ts.push_back ({l.p, l.h, l.k, c, false, 0, 0, "", ""});
 
       for (const auto& f : fs)
-        ts.push_back ({f.p, f.h, f.k, c, false, 0, 0, ""});
+        ts.push_back ({f.p, f.h, f.k, c, false, 0, 0, "", ""});
 
-      run_hashes (ts, cb_);
+      run_hashes (ts, fkey, cb_);
 
       // Collect all adoptions so we can batch them in a single DB
       // transaction instead of one per file.
       //
       vector<cached_file> adoptions;
+      int64_t now (current_timestamp ());
       auto i (ts.begin ());
 
       for (const auto& l : ls)
@@ -529,7 +619,7 @@ namespace launcher
           launcher::log::trace_l3 (categories::cache {},
                                    "adopting existing file into db: {}",
                                    l.k);
-          adoptions.emplace_back (l.k, t.mt, v, c, t.s, l.h);
+          adoptions.emplace_back (l.k, t.mt, v, c, t.s, l.h, t.f, now);
         }
         else
         {
@@ -551,7 +641,7 @@ namespace launcher
           launcher::log::trace_l3 (categories::cache {},
                                    "adopting existing blob archive into db: {}",
                                    f.k);
-          adoptions.emplace_back (f.k, t.mt, v, c, t.s, f.h);
+          adoptions.emplace_back (f.k, t.mt, v, c, t.s, f.h, t.f, now);
           s.skip = true;
         }
         else
@@ -699,14 +789,19 @@ namespace launcher
       vector<hash_task> ts;
       ts.reserve (to_hash.size ());
 
+      string fkey (strat_ == strategy::fingerprint
+                   ? fingerprint_key ()
+                   : string ());
+
       for (const auto& e : to_hash)
-        ts.push_back ({e.p, e.h, e.k, c, false, 0, 0, ""});
+        ts.push_back ({e.p, e.h, e.k, c, false, 0, 0, "", ""});
 
-      run_hashes (ts, cb_);
+      run_hashes (ts, fkey, cb_);
 
       // Process results and collect adoptions for batch DB write.
       //
       vector<cached_file> adoptions;
+      int64_t now (current_timestamp ());
 
       for (size_t j (0); j < to_hash.size (); ++j)
       {
@@ -719,7 +814,7 @@ namespace launcher
             categories::cache {},
             "file {} matches expected hash, adopting to db",
             fs[e.mi].path);
-          adoptions.emplace_back (e.k, t.mt, v, c, t.s, e.h);
+          adoptions.emplace_back (e.k, t.mt, v, c, t.s, e.h, t.f, now);
         }
         else
         {
@@ -757,6 +852,164 @@ namespace launcher
     return r;
   }
 
+  size_t reconciler::
+  scrub (component_type c)
+  {
+    cache_map cm;
+    {
+      auto fs (db_.files (c));
+      cm.reserve (fs.size ());
+      for (auto& f : fs)
+        cm.emplace (f.path (), move (f));
+    }
+
+    return scrub (c, cm);
+  }
+
+  size_t reconciler::
+  scrub (component_type c, cache_map& cm)
+  {
+    if (budget_.bytes == 0 || budget_.time <= chrono::milliseconds::zero ())
+      return 0;
+
+    int64_t now (current_timestamp ());
+    int64_t due (now - budget_.interval.count ());
+
+    // Collect the tracked entries that are due, that is, have a recorded
+    // hash and were last verified long enough ago. Note that we verify
+    // against what we recorded rather than the manifest so this covers
+    // entries from any version, including leftovers from older releases.
+    //
+    struct entry
+    {
+      fs::path p;
+      string k;
+      string h;
+      int64_t t;
+      uint64_t s;
+    };
+
+    vector<entry> es;
+
+    for (const auto& [k, f] : cm)
+    {
+      if (f.hash ().empty () ||
+          f.verified () > due ||
+          k.ends_with ("update.json"))
+        continue;
+
+      es.push_back ({fs::path (f.path ()), k, f.hash (), f.verified (),
+                     f.size ()});
+    }
+
+    if (es.empty ())
+      return 0;
+
+    stable_sort (es.begin (), es.end (),
+                 [] (const entry& x, const entry& y) {return x.t < y.t;});
+
+    auto start (chrono::steady_clock::now ());
+    auto deadline (start + budget_.time);
+
+    string fkey (strat_ == strategy::fingerprint
+                 ? fingerprint_key ()
+                 : string ());
+
+    // Hash in batches of a few files per worker so that we don't overshoot
+    // the time budget by much.
+    //
+    size_t bn (hashing_workers () * 2);
+
+    vector<cached_file> ok;
+    vector<string> bad;
+    size_t n (0), i (0);
+    uint64_t bytes (0);
+    bool full (false);
+
+    while (!full && i != es.size () && chrono::steady_clock::now () < deadline)
+    {
+      vector<hash_task> ts;
+      uint64_t bb (0);
+
+      for (; i != es.size () && ts.size () != bn; ++i)
+      {
+        const entry& e (es[i]);
+
+        // Let the first file through even if it exceeds the whole budget,
+        // otherwise it would never be scrubbed and would block the rotation.
+        //
+        if (bytes + bb + e.s > budget_.bytes && bytes + bb != 0)
+        {
+          full = true;
+          break;
+        }
+
+        // Leave files that no longer look intact to the planners.
+        //
+        if (!exists_quiet (e.p) || !match (e.p, cm.at (e.k)))
+          continue;
+
+        ts.push_back ({e.p, e.h, e.k, c, false, 0, 0, "", ""});
+        bb += e.s;
+      }
+
+      run_hashes (ts, fkey, cb_);
+
+      for (const hash_task& t : ts)
+      {
+        auto j (cm.find (t.k));
+
+        if (t.m)
+        {
+          j->second.set_verified (now);
+
+          if (!t.f.empty ())
+            j->second.set_fingerprint (t.f);
+
+          ok.push_back (j->second);
+        }
+        else
+        {
+          launcher::log::warning (
+            categories::cache {},
+            "deep verification of {} failed, will be re-acquired",
+            t.p.string ());
+
+          bad.push_back (t.k);
+          cm.erase (j);
+        }
+      }
+
+      n += ts.size ();
+      bytes += bb;
+    }
+
+    if (!ok.empty ())
+      db_.store (ok);
+
+    if (!bad.empty ())
+      db_.erase (bad);
+
+    auto d (chrono::duration_cast<chrono::milliseconds> (
+              chrono::steady_clock::now () - start));
+
+    budget_.bytes -= min (bytes, budget_.bytes);
+    budget_.time -= min (d, budget_.time);
+
+    launcher::log::info (
+      categories::cache {},
+      "deep verified {} file(s) ({} bytes) of component {} in {}ms, {} "
+      "corrupted, {} more due",
+      n,
+      bytes,
+      static_cast<int> (c),
+      d.count (),
+      bad.size (),
+      es.size () - i);
+
+    return bad.size ();
+  }
+
   reconcile_summary reconciler::
   summarize (const vector<reconcile_item>& is) const
   {
@@ -809,8 +1062,14 @@ namespace launcher
       launcher::log::trace_l3 (categories::cache {},
                                "tracking file: {}",
                                p.string ());
-      db_.store (
-        cached_file (key (p), get_file_mtime (p), v, c, fs::file_size (p), h));
+      db_.store (cached_file (key (p),
+                              get_file_mtime (p),
+                              v,
+                              c,
+                              fs::file_size (p),
+                              h,
+                              fingerprint (p),
+                              h.empty () ? 0 : current_timestamp ()));
     }
     catch (const exception& e)
     {
@@ -836,8 +1095,19 @@ namespace launcher
     vector<cached_file> cfs;
     cfs.reserve (ps.size ());
 
-    for (const auto& p : ps)
+    // These are extracted from an archive that has just been verified so
+    // whatever we hash now is what the release shipped. Recording it lets
+    // the scrub (see verify_budget) cover them like any other file. Note
+    // that they have just been written so this is served from the page
+    // cache.
+    //
+    vector<string> hs (hash_files (ps));
+    int64_t now (current_timestamp ());
+
+    for (size_t i (0); i != ps.size (); ++i)
     {
+      const fs::path& p (ps[i]);
+
       if (!exists_quiet (p))
         continue;
       try
@@ -847,7 +1117,9 @@ namespace launcher
                           v,
                           c,
                           fs::file_size (p),
-                          "");
+                          hs[i],
+                          fingerprint (p),
+                          hs[i].empty () ? 0 : now);
       }
       catch (...)
       {
@@ -1013,7 +1285,7 @@ namespace launcher
       // Depending on the configured strategy, we might also verify the file
       // size. In pure timestamp mode, we skip this to save I/O overhead.
       //
-      if (strat_ == strategy::mixed || strat_ == strategy::hash)
+      if (strat_ != strategy::mtime)
       {
         if (fs::file_size (p) != f.size ())
         {
@@ -1024,6 +1296,19 @@ namespace launcher
         }
       }
 
+      // Without a recorded fingerprint we have nothing to compare against
+      // so report a mismatch and let the caller fully verify the file
+      // (which records one).
+      //
+      if (strat_ == strategy::fingerprint &&
+          (f.fingerprint ().empty () || fingerprint (p) != f.fingerprint ()))
+      {
+        launcher::log::trace_l3 (categories::cache {},
+                                 "fingerprint mismatch for {}",
+                                 p.string ());
+        return false;
+      }
+
       launcher::log::trace_l3 (categories::cache {},
                                "match found for {}",
                                p.string ());
@@ -1045,4 +1330,44 @@ namespace launcher
       return false;
     }
   }
+
+  string reconciler::
+  fingerprint (const fs::path& p) const
+  {
+    if (strat_ != strategy::fingerprint)
+      return string ();
+
+    return compute_fingerprint (p, fingerprint_key (), key (p));
+  }
+
+  const string& reconciler::
+  fingerprint_key () const
+  {
+    static const char setting[] = "fingerprint_key";
+
+    if (fkey_.empty ())
+    {
+      fkey_ = db_.setting_value (setting);
+
+      if (fkey_.empty ())
+      {
+        // 256 bits from the system's entropy source, hex-encoded.
+        //
+        random_device rd;
+        ostringstream o;
+        o << hex << setfill ('0');
+
+        for (size_t i (0); i != 8; ++i)
+          o << setw (8) << static_cast<uint32_t> (rd ());
+
+        fkey_ = o.str ();
+        db_.setting (setting, fkey_);
+
+        launcher::log::debug (categories::cache {},
+                              "generated new fingerprint key");
+      }
+    }
+
+    return fkey_;
+  }
 }
@@ -2,6 +2,8 @@
 
 #include <boost/asio/awaitable.hpp>
 
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <optional>
@@ -25,9 +27,26 @@ namespace launcher
   //
   enum class strategy
   {
-    mtime, // Trust mtime.
-    mixed, // Check mtime and size.
-    hash   // Verify content hash.
+    mtime,       // Trust mtime.
+    mixed,       // Check mtime and size.
+    fingerprint, // Check mtime, size, and sampled content fingerprint.
+    hash         // Verify content hash.
+  };
+
+  // Deep verification (scrub) budget.
+  //
+  // Planning only hashes files that look modified or are not tracked, so
+  // silent corruption of tracked files would go unnoticed. To catch it, each
+  // plan also re-hashes tracked files that were last verified more than the
+  // interval ago, oldest first, until either budget is exhausted. This way
+  // the whole installation is scrubbed over a number of launches without any
+  // single one paying for all of it. Zero bytes or time disables scrubbing.
+  //
+  struct verify_budget
+  {
+    std::uint64_t bytes = 256 * 1024 * 1024;
+    std::chrono::milliseconds time {2000};
+    std::chrono::seconds interval {30 * 24 * 60 * 60};
   };
 
   // Filesystem versus database versus manifest synchronizer.
@@ -69,6 +88,19 @@ namespace launcher
     strategy
     mode () const noexcept;
 
+    // The strategy of reconcilers constructed from now on (def_strat
+    // unless changed).
+    //
+    static void
+    default_mode (strategy s);
+
+    // The deep verification budget of reconcilers constructed from now on.
+    // Note that each reconciler has its own budget which it spends across
+    // all the plans it makes.
+    //
+    static void
+    default_budget (const verify_budget& b);
+
     void
     progress (progress_cb cb);
 
@@ -113,6 +145,13 @@ namespace launcher
     std::vector<std::pair<cached_file, file_state>>
     audit (component_type c) const;
 
+    // Scrub the component's tracked files (see verify_budget). This is
+    // normally done as part of planning but a component that is up to date
+    // is not planned. Return the number of corrupted files found.
+    //
+    std::size_t
+    scrub (component_type c);
+
     // Planning.
     //
 
@@ -144,6 +183,15 @@ namespace launcher
                 const std::string& v,
                 const cache_map& cm);
 
+    // Re-hash the tracked entries that are due for deep verification (see
+    // verify_budget) within the remaining budget. Those that match their
+    // recorded hash get their verification time updated while those that
+    // don't are dropped from the database (and the map) so that the planners
+    // treat them as untracked. Return the number of corrupted files found.
+    //
+    std::size_t
+    scrub (component_type c, cache_map& cm);
+
     reconcile_summary
     summarize (const std::vector<reconcile_item>& items) const;
 
@@ -164,7 +212,8 @@ namespace launcher
     // Commit extracted files.
     //
     // We batch this because an archive might explode into thousands of files.
-    // Touching the database that many times is too slow.
+    // Touching the database that many times is too slow. The files are also
+    // hashed so that they can be deep verified later (see verify_budget).
     //
     void
     track (const std::vector<fs::path>& ps,
@@ -226,14 +275,32 @@ namespace launcher
     // The actual comparison logic.
     //
     // If we are in mtime mode, we just check timestamps. If mixed, we check
-    // size too. If hash, we read the whole file.
+    // size too. If fingerprint, we also compare the sampled content
+    // fingerprint against the one recorded when the file was last fully
+    // verified (and treat its absence as a mismatch so that the file is
+    // hashed and the fingerprint recorded). If hash, we read the whole file.
     //
     bool
     match (const fs::path& p, const cached_file& entry) const;
 
+    // Return the file's fingerprint if we are in the fingerprint mode and
+    // empty string otherwise.
+    //
+    std::string
+    fingerprint (const fs::path& p) const;
+
+    // Per-installation fingerprint secret, generated on first use and kept
+    // in the database.
+    //
+    const std::string&
+    fingerprint_key () const;
+
     cache_database& db_;
     fs::path root_;
     strategy strat_;
     progress_cb cb_;
+    mutable std::string fkey_;
+
+    verify_budget budget_; // Remaining.
   };
 }
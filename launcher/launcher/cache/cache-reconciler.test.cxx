@@ -0,0 +1,112 @@
+#include <launcher/cache/cache-reconciler.hxx>
+#include <launcher/cache/cache-database.hxx>
+#include <launcher/manifest/manifest.hxx>
+
+#include <launcher/launcher-blake3.test.hxx>
+
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace launcher;
+
+// Files extracted from an archive are tracked in a batch. They have to be
+// recorded with their hash so that the deep verification covers them: a
+// member that is damaged without its size or modification time changing
+// must get its archive planned for download again.
+//
+
+static void
+write (const fs::path& p, const string& c)
+{
+  fs::create_directories (p.parent_path ());
+  ofstream os (p, ios::binary | ios::trunc);
+  os.write (c.data (), static_cast<streamsize> (c.size ()));
+  assert (os);
+}
+
+int
+main ()
+{
+  fs::path root (fs::temp_directory_path () /
+                 ("iw4x-reconciler-" + to_string (random_device {} ())));
+
+  fs::create_directories (root);
+  root = fs::canonical (root); // Keys are made from the canonical root.
+
+  // Make every tracked file due for verification right away.
+  //
+  verify_budget b;
+  b.interval = chrono::seconds (0);
+  reconciler::default_budget (b);
+
+  {
+    const string v ("v1");
+
+    vector<pair<string, string>> ms {
+      {"iw4x/iw_00.iwd",          string (64 * 1024, 'a')},
+      {"zone/english/iw4x_ui.ff", string (16 * 1024, 'b')}};
+
+    manifest m (manifest_format::update, manifest_format::update);
+    m.archives.emplace_back (launcher::hash (blake3_hex ("release")),
+                             7,
+                             "release.zip");
+
+    vector<fs::path> ps;
+
+    for (const auto& [p, c] : ms)
+    {
+      manifest_file f (launcher::hash (blake3_hex (c)), c.size (), p);
+      f.archive_name = m.archives.back ().name;
+
+      m.archives.back ().files.push_back (f);
+      m.files.push_back (move (f));
+
+      write (root / p, c);
+      ps.push_back (root / p);
+    }
+
+    cache_database db (root);
+
+    {
+      reconciler r (db, root);
+      r.track (ps, component_type::rawfiles, v);
+      r.stamp (component_type::rawfiles, v);
+
+      for (size_t i (0); i != ps.size (); ++i)
+      {
+        auto f (db.find (ps[i]));
+        assert (f && f->hash () == blake3_hex (ms[i].second));
+      }
+
+      assert (r.plan (m, component_type::rawfiles, v).empty ());
+    }
+
+    // Damage a member keeping its size and modification time.
+    //
+    {
+      fs::path p (ps.back ());
+      auto t (fs::last_write_time (p));
+      write (p, string (ms.back ().second.size (), 'c'));
+      fs::last_write_time (p, t);
+    }
+
+    {
+      reconciler r (db, root);
+      assert (r.scrub (component_type::rawfiles) == 1);
+
+      auto is (r.plan (m, component_type::rawfiles, v));
+      assert (is.size () == 1);
+      assert (is[0].action == reconcile_action::download);
+      assert (fs::path (is[0].path).filename () == "release.zip");
+    }
+  }
+
+  error_code ec;
+  fs::remove_all (root, ec);
+}
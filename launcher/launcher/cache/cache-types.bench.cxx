@@ -0,0 +1,151 @@
+#include <launcher/cache/cache-types.hxx>
+#include <launcher/launcher-resources.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+using namespace std;
+using namespace launcher;
+
+namespace asio = boost::asio;
+
+// Hashing placement benchmark.
+//
+// Usage: cache-types.bench [<files> [<size>]]
+//
+// Synthesize the specified number of files (32 by default) of the specified
+// size in MiB (32 by default) and hash them all in parallel the way the
+// reconciler does, with each placement policy and with as many workers as
+// there are physical cores and as there are CPUs. The files are read once
+// beforehand so this measures hashing and memory traffic rather than the
+// disk. Each configuration is run three times and the best run is reported.
+//
+// On a single-node machine without SMT the policies should perform about
+// the same; the interesting numbers are on multi-socket machines.
+//
+
+static double
+run (const vector<fs::path>& files, size_t n, placement_policy p)
+{
+  worker_placement wp (p);
+  asio::thread_pool pl (n);
+
+  auto t0 (chrono::steady_clock::now ());
+
+  for (const auto& f : files)
+  {
+    asio::post (pl, [&f, &wp] ()
+    {
+      wp.place ();
+
+      if (compute_blake3 (f).empty ())
+        cerr << "warning: unable to hash " << f.string () << endl;
+    });
+  }
+
+  pl.join ();
+
+  return chrono::duration<double> (chrono::steady_clock::now () - t0)
+    .count ();
+}
+
+int
+main (int argc, char* argv[])
+{
+  size_t nf (argc > 1 ? stoull (argv[1]) : 32);
+  size_t sz ((argc > 2 ? stoull (argv[2]) : 32) * 1024 * 1024);
+
+  const cpu_topology& t (system_topology ());
+
+  fs::path work (fs::temp_directory_path () / "iw4x-hashing-bench");
+
+  try
+  {
+    fs::remove_all (work);
+    fs::create_directories (work);
+
+    vector<fs::path> files;
+    {
+      mt19937_64 g (nf);
+      vector<uint64_t> b (1024 * 1024 / sizeof (uint64_t));
+
+      for (size_t i (0); i != nf; ++i)
+      {
+        fs::path p (work / ("f_" + std::to_string (i) + ".dat"));
+        ofstream os (p, ios::binary | ios::trunc);
+
+        for (size_t w (0); w < sz; w += b.size () * sizeof (uint64_t))
+        {
+          generate (b.begin (), b.end (), g);
+          os.write (reinterpret_cast<const char*> (b.data ()),
+                    static_cast<streamsize> (min (b.size () * sizeof (uint64_t),
+                                                  sz - w)));
+        }
+
+        files.push_back (move (p));
+      }
+    }
+
+    // Warm the page cache.
+    //
+    run (files, t.cpus.size (), placement_policy::none);
+
+    cout << "topology: " << t.string () << endl;
+
+    cout << setw (9)  << "policy"
+         << setw (9)  << "workers"
+         << setw (12) << "time (ms)"
+         << setw (12) << "MiB/s"
+         << endl;
+
+    vector<size_t> ns {t.cores ()};
+
+    if (t.cpus.size () != t.cores ())
+      ns.push_back (t.cpus.size ());
+
+    for (size_t n : ns)
+    {
+      for (placement_policy p : {placement_policy::none,
+                                 placement_policy::spread,
+                                 placement_policy::compact})
+      {
+        double b (0);
+
+        for (size_t i (0); i != 3; ++i)
+        {
+          double d (run (files, n, p));
+          b = (i == 0 ? d : min (b, d));
+        }
+
+        cout << setw (9)  << placement_name (p)
+             << setw (9)  << n
+             << setw (12) << fixed << setprecision (1) << b * 1000
+             << setw (12) << fixed << setprecision (1)
+                          << nf * sz / 1048576.0 / b
+             << endl;
+      }
+    }
+  }
+  catch (const exception& e)
+  {
+    cerr << "error: " << e.what () << endl;
+    return 1;
+  }
+
+  error_code ec;
+  fs::remove_all (work, ec);
+
+  return 0;
+}
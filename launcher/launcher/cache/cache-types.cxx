@@ -1,15 +1,37 @@
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#else
+#  include <windows.h>
+#endif
+
 #include <launcher/cache/cache-types.hxx>
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
 #include <sstream>
 #include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <launcher/blake3.h>
+#include <launcher/launcher-resources.hxx>
 
 using namespace std;
 
@@ -58,6 +80,19 @@ namespace launcher
     return o;
   }
 
+  ostream&
+  operator<< (ostream& o, durability_mode m)
+  {
+    switch (m)
+    {
+      case durability_mode::none:  return o << "none";
+      case durability_mode::batch: return o << "batch";
+      case durability_mode::full:  return o << "full";
+    }
+
+    return o;
+  }
+
   std::int64_t
   get_file_mtime (const fs::path& p)
   {
@@ -80,23 +115,710 @@ namespace launcher
     return chrono::duration_cast<chrono::seconds> (e).count ();
   }
 
+  namespace
+  {
+    string
+    digest (blake3_hasher& h)
+    {
+      uint8_t d[BLAKE3_OUT_LEN];
+      blake3_hasher_finalize (&h, d, BLAKE3_OUT_LEN);
+
+      // Format the hash as a lowercase hex string.
+      //
+      ostringstream o;
+      o << hex << setfill ('0');
+
+      for (int j (0); j < BLAKE3_OUT_LEN; ++j)
+        o << setw (2) << static_cast<int> (d[j]);
+
+      return o.str ();
+    }
+
+    mutex hash_mutex;
+    hash_pipeline hash_config; // Protected by hash_mutex.
+    hash_stats hash_totals;    // Protected by hash_mutex.
+
+    string
+    hashed (blake3_hasher& h, uint64_t n, chrono::steady_clock::time_point s)
+    {
+      double t (chrono::duration<double> (chrono::steady_clock::now () - s)
+                .count ());
+      {
+        lock_guard<mutex> l (hash_mutex);
+        ++hash_totals.files;
+        hash_totals.bytes += n;
+        hash_totals.time += t;
+      }
+
+      return digest (h);
+    }
+
+#ifndef _WIN32
+    constexpr size_t alignment     (4096); // O_DIRECT buffer/offset alignment.
+    constexpr size_t min_chunk     (256 * 1024);
+    constexpr size_t max_chunk     (4 * 1024 * 1024);
+    constexpr size_t default_chunk (1024 * 1024);
+    constexpr size_t default_depth (4);
+    constexpr size_t max_in_flight (16 * 1024 * 1024); // Per file.
+
+    // Read and hash throughput (bytes per second) observed on each device,
+    // exponentially smoothed. Protected by hash_mutex.
+    //
+    struct device_rates
+    {
+      double read = 0;
+      double hash = 0;
+    };
+
+    unordered_map<dev_t, device_rates> hash_rates;
+
+    struct pipeline_params
+    {
+      size_t chunk;
+      size_t depth;
+      bool direct;
+    };
+
+    pipeline_params
+    tune (dev_t d)
+    {
+      lock_guard<mutex> l (hash_mutex);
+
+      const hash_pipeline& c (hash_config);
+      pipeline_params r {c.chunk_size, c.depth, c.direct_io};
+
+      size_t mf (c.max_in_flight != 0
+                 ? max (c.max_in_flight, 2 * min_chunk)
+                 : max_in_flight);
+
+      auto i (hash_rates.find (d));
+      const device_rates* dr (i != hash_rates.end () ? &i->second : nullptr);
+
+      // Size chunks so that reading one takes about 10ms: long enough to
+      // amortize the per-request latency (which is what hurts on HDDs and
+      // network filesystems) but not so long that the pipeline takes ages to
+      // fill.
+      //
+      if (r.chunk == 0)
+      {
+        r.chunk = default_chunk;
+
+        if (dr != nullptr && dr->read != 0)
+        {
+          double t (dr->read / 100);
+
+          for (r.chunk = min_chunk; r.chunk < t && r.chunk < max_chunk; )
+            r.chunk *= 2;
+        }
+
+        // Leave room for at least two chunks.
+        //
+        while (r.chunk > min_chunk && r.chunk * 2 > mf)
+          r.chunk /= 2;
+      }
+      else
+        r.chunk = (r.chunk + alignment - 1) / alignment * alignment;
+
+      // If reading a chunk takes k times as long as hashing it, then we need
+      // k chunks in flight (plus the one being hashed) for the hasher never
+      // to wait.
+      //
+      if (r.depth == 0)
+      {
+        r.depth = default_depth;
+
+        if (dr != nullptr && dr->read != 0 && dr->hash != 0)
+          r.depth = static_cast<size_t> (ceil (dr->hash / dr->read)) + 1;
+
+        r.depth = clamp (r.depth,
+                         size_t (2),
+                         max (mf / r.chunk, size_t (2)));
+      }
+
+      return r;
+    }
+
+    void
+    record (dev_t d, uint64_t n, double rt, double ht)
+    {
+      if (n == 0 || rt <= 0 || ht <= 0)
+        return;
+
+      lock_guard<mutex> l (hash_mutex);
+
+      device_rates& r (hash_rates[d]);
+
+      auto avg ([] (double o, double v)
+      {
+        return o == 0 ? v : o * 0.75 + v * 0.25;
+      });
+
+      r.read = avg (r.read, n / rt);
+      r.hash = avg (r.hash, n / ht);
+    }
+
+    // Read a file chunk by chunk ahead of the consumer.
+    //
+    // We keep a ring of depth aligned buffers, one per chunk in flight, that
+    // the readers fill while the consumer works on the oldest one. Chunk k
+    // goes into slot k % depth and can only be claimed once chunk k - depth
+    // has been consumed.
+    //
+    // For direct I/O there is no readahead so we have one reader thread per
+    // slot, each with its own request in flight. For buffered I/O a single
+    // reader is enough since we ask the kernel to read the whole window (and
+    // then each chunk as it enters it) in the background.
+    //
+    class read_ahead
+    {
+    public:
+      read_ahead (int fd, const pipeline_params& p)
+        : fd_ (fd), chunk_ (p.chunk), direct_ (p.direct), ready_ (p.depth, 0)
+      {
+        for (size_t i (0); i != p.depth; ++i)
+        {
+          char* b (static_cast<char*> (aligned_alloc (alignment, chunk_)));
+
+          if (b == nullptr)
+            throw bad_alloc ();
+
+          slots_.push_back (slot {buffer (b), 0});
+        }
+
+        // If the consumer is pinned, then fault the buffers in from here so
+        // that they end up on its node rather than on whichever node the
+        // readers happen to be scheduled, and let the readers (which would
+        // otherwise inherit the consumer's single CPU) run anywhere on that
+        // node.
+        //
+        int n (worker_placement::current_node ());
+
+        if (n != -1)
+        {
+          for (slot& s : slots_)
+            for (size_t i (0); i < chunk_; i += alignment)
+              s.data.get ()[i] = 0;
+        }
+
+#ifdef POSIX_FADV_WILLNEED
+        if (!direct_)
+          posix_fadvise (fd_, 0, chunk_ * slots_.size (), POSIX_FADV_WILLNEED);
+#endif
+
+        size_t rn (direct_ ? slots_.size () : 1);
+
+        for (size_t i (0); i != rn; ++i)
+        {
+          threads_.emplace_back ([this, n]
+          {
+            if (n != -1)
+              pin_thread (system_topology ().node_cpus (
+                            static_cast<unsigned> (n)));
+
+            run ();
+          });
+        }
+      }
+
+      read_ahead (const read_ahead&) = delete;
+      read_ahead& operator= (const read_ahead&) = delete;
+
+      ~read_ahead ()
+      {
+        {
+          lock_guard<mutex> l (mutex_);
+          stop_ = true;
+        }
+
+        cv_.notify_all ();
+
+        for (thread& t : threads_)
+          t.join ();
+      }
+
+      // Return the next chunk or an empty one at the end of the file. The
+      // chunk stays valid until the next call. Throw system_error if reading
+      // failed.
+      //
+      pair<const char*, size_t>
+      next ()
+      {
+        unique_lock<mutex> l (mutex_);
+
+        if (out_)
+        {
+          out_ = false;
+          ready_[consumed_++ % slots_.size ()] = 0;
+          cv_.notify_all ();
+        }
+
+        cv_.wait (l, [this]
+        {
+          return error_ != 0 ||
+                 consumed_ >= end_ ||
+                 ready_[consumed_ % slots_.size ()] != 0;
+        });
+
+        if (error_ != 0)
+          throw system_error (error_, generic_category (), "unable to read");
+
+        if (consumed_ >= end_)
+          return {nullptr, 0};
+
+        const slot& s (slots_[consumed_ % slots_.size ()]);
+
+        out_ = true;
+        return {s.data.get (), s.size};
+      }
+
+      // Time spent reading (in seconds), that is, with at least one request
+      // in flight. Only valid at the end of the file.
+      //
+      double
+      read_time () const noexcept
+      {
+        return read_time_;
+      }
+
+    private:
+      void
+      run ()
+      {
+        for (;;)
+        {
+          size_t k;
+          {
+            unique_lock<mutex> l (mutex_);
+            cv_.wait (l, [this]
+            {
+              return stop_ ||
+                     error_ != 0 ||
+                     claimed_ >= end_ ||
+                     claimed_ < consumed_ + slots_.size ();
+            });
+
+            if (stop_ || error_ != 0 || claimed_ >= end_)
+              return;
+
+            k = claimed_++;
+
+            if (busy_++ == 0)
+              busy_start_ = chrono::steady_clock::now ();
+          }
+
+          // The chunk's slot is ours until we publish it.
+          //
+          char* b (slots_[k % slots_.size ()].data.get ());
+          uint64_t o (static_cast<uint64_t> (k) * chunk_);
+
+#ifdef POSIX_FADV_WILLNEED
+          if (!direct_)
+            posix_fadvise (fd_,
+                           o + chunk_ * slots_.size (),
+                           chunk_,
+                           POSIX_FADV_WILLNEED);
+#endif
+
+          size_t n (0);
+          int e (0);
+
+          while (n != chunk_)
+          {
+            ssize_t r (pread (fd_, b + n, chunk_ - n, o + n));
+
+            if (r == -1)
+            {
+              if (errno == EINTR)
+                continue;
+
+#ifdef O_DIRECT
+              // Some filesystems accept O_DIRECT when opening but not when
+              // reading. Fall back to buffered I/O in this case. Note that
+              // the other readers may get here as well.
+              //
+              if (errno == EINVAL && direct_)
+              {
+                int f (fcntl (fd_, F_GETFL));
+
+                if (f != -1 &&
+                    ((f & O_DIRECT) == 0 ||
+                     fcntl (fd_, F_SETFL, f & ~O_DIRECT) == 0))
+                {
+                  direct_ = false;
+                  continue;
+                }
+              }
+#endif
+              e = errno;
+              break;
+            }
+
+            if (r == 0)
+              break;
+
+            n += static_cast<size_t> (r);
+
+            // With direct I/O a short read can only mean the end of the file
+            // and trying to read past it at the unaligned offset would fail.
+            //
+            if (direct_ && n % alignment != 0)
+              break;
+          }
+
+          lock_guard<mutex> l (mutex_);
+
+          if (--busy_ == 0)
+            read_time_ += chrono::duration<double> (
+              chrono::steady_clock::now () - busy_start_).count ();
+
+          if (e != 0)
+            error_ = e;
+          else
+          {
+            slots_[k % slots_.size ()].size = n;
+            ready_[k % slots_.size ()] = 1;
+
+            // A short chunk is the last one (and an empty one is past the
+            // end).
+            //
+            if (n != chunk_)
+              end_ = min (end_, n != 0 ? k + 1 : k);
+          }
+
+          cv_.notify_all ();
+        }
+      }
+
+    private:
+      struct deleter
+      {
+        void
+        operator() (char* p) const noexcept
+        {
+          free (p);
+        }
+      };
+
+      using buffer = unique_ptr<char, deleter>;
+
+      struct slot
+      {
+        buffer data;
+        size_t size;
+      };
+
+      int fd_;
+      size_t chunk_;
+      atomic<bool> direct_;
+
+      vector<slot> slots_;
+      vector<char> ready_;   // Slot holds its chunk.
+      size_t claimed_ = 0;   // Chunks claimed by the readers.
+      size_t consumed_ = 0;  // Chunks handed out and released.
+      bool out_ = false;     // Next chunk handed out to the consumer.
+      bool stop_ = false;
+      int error_ = 0;
+
+      // Number of chunks in the file, once we know it.
+      //
+      size_t end_ = numeric_limits<size_t>::max ();
+
+      size_t busy_ = 0;      // Requests in flight.
+      chrono::steady_clock::time_point busy_start_;
+      double read_time_ = 0;
+
+      mutex mutex_;
+      condition_variable cv_;
+      vector<thread> threads_;
+    };
+
+    struct fd_guard
+    {
+      int fd;
+
+      ~fd_guard ()
+      {
+        if (fd != -1)
+          close (fd);
+      }
+    };
+#endif
+  }
+
+  void
+  configure_hashing (const hash_pipeline& c)
+  {
+    lock_guard<mutex> l (hash_mutex);
+    hash_config = c;
+  }
+
+  size_t
+  hashing_workers ()
+  {
+    {
+      lock_guard<mutex> l (hash_mutex);
+
+      if (hash_config.workers != 0)
+        return hash_config.workers;
+    }
+
+    // Hardware concurrency can return 0 on some platforms.
+    //
+    size_t n (thread::hardware_concurrency ());
+    return n != 0 ? n : 4;
+  }
+
+  namespace
+  {
+    atomic<durability_mode> durability (durability_mode::batch);
+  }
+
+  void
+  configure_durability (durability_mode m)
+  {
+    durability.store (m, memory_order_relaxed);
+  }
+
+  durability_mode
+  configured_durability ()
+  {
+    return durability.load (memory_order_relaxed);
+  }
+
+  void
+  sync_files (const vector<fs::path>& ps)
+  {
+#ifndef _WIN32
+    auto fail ([] (const char* w, const fs::path& p)
+    {
+      int e (errno);
+      throw system_error (e, generic_category (), w + p.string ());
+    });
+
+#ifdef __linux__
+    // Note that syncfs() flushes everything else written to the filesystem
+    // as well, which is the price we pay for making it a single call. In
+    // practice the update is most of it.
+    //
+    vector<dev_t> ds;
+
+    for (const fs::path& p: ps)
+    {
+      struct stat st;
+      if (stat (p.c_str (), &st) != 0)
+      {
+        if (errno == ENOENT)
+          continue;
+
+        fail ("unable to stat ", p);
+      }
+
+      if (find (ds.begin (), ds.end (), st.st_dev) != ds.end ())
+        continue;
+
+      fd_guard fd {open (p.c_str (), O_RDONLY | O_CLOEXEC)};
+
+      if (fd.fd == -1 || syncfs (fd.fd) != 0)
+        fail ("unable to sync filesystem of ", p);
+
+      ds.push_back (st.st_dev);
+    }
+#else
+    // The directories have to be flushed after the files they contain for
+    // the renames to be durable.
+    //
+    auto flush ([] (int fd)
+    {
+#ifdef F_FULLFSYNC
+      // On Mac OS fsync() doesn't flush the drive's cache.
+      //
+      if (fcntl (fd, F_FULLFSYNC) == 0)
+        return true;
+#endif
+      return fsync (fd) == 0;
+    });
+
+    vector<fs::path> ds;
+
+    for (const fs::path& p: ps)
+    {
+      fd_guard fd {open (p.c_str (), O_RDONLY | O_CLOEXEC)};
+
+      if (fd.fd == -1 && errno == ENOENT)
+        continue;
+
+      if (fd.fd == -1 || !flush (fd.fd))
+        fail ("unable to sync ", p);
+
+      fs::path d (p.has_parent_path () ? p.parent_path () : fs::path ("."));
+
+      if (find (ds.begin (), ds.end (), d) == ds.end ())
+        ds.push_back (move (d));
+    }
+
+    for (const fs::path& d: ds)
+    {
+      fd_guard fd {open (d.c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+
+      if (fd.fd == -1 || !flush (fd.fd))
+        fail ("unable to sync ", d);
+    }
+#endif
+#else
+    // There is no unprivileged way to flush a whole volume so flush each
+    // file. NTFS journals the directory entries itself.
+    //
+    for (const fs::path& p: ps)
+    {
+      HANDLE h (CreateFileW (p.c_str (),
+                             GENERIC_WRITE,
+                             FILE_SHARE_READ | FILE_SHARE_WRITE |
+                             FILE_SHARE_DELETE,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL,
+                             nullptr));
+
+      if (h == INVALID_HANDLE_VALUE)
+      {
+        DWORD e (GetLastError ());
+
+        if (e == ERROR_FILE_NOT_FOUND || e == ERROR_PATH_NOT_FOUND)
+          continue;
+
+        throw system_error (static_cast<int> (e),
+                            system_category (),
+                            "unable to open " + p.string ());
+      }
+
+      BOOL r (FlushFileBuffers (h));
+      DWORD e (GetLastError ());
+      CloseHandle (h);
+
+      if (!r)
+        throw system_error (static_cast<int> (e),
+                            system_category (),
+                            "unable to sync " + p.string ());
+    }
+#endif
+  }
+
+  hash_stats
+  hashing_stats ()
+  {
+    lock_guard<mutex> l (hash_mutex);
+    return hash_totals;
+  }
+
   string
   compute_blake3 (const fs::path& p)
   {
+    auto hs (chrono::steady_clock::now ());
+
+    blake3_hasher h;
+    blake3_hasher_init (&h);
+
+#ifndef _WIN32
     // Bail out if we cannot open the file. Returning an empty string cleanly
     // signals a failure to the caller.
     //
+    fd_guard fd {open (p.c_str (), O_RDONLY | O_CLOEXEC)};
+
+    struct stat st;
+    if (fd.fd == -1 || fstat (fd.fd, &st) != 0)
+      return string ();
+
+    pipeline_params pp (tune (st.st_dev));
+
+    // Files that fit into a single chunk are not worth the pipeline (or
+    // bypassing the cache).
+    //
+    if (static_cast<uint64_t> (st.st_size) <= pp.chunk)
+    {
+      vector<char> b (max<size_t> (static_cast<size_t> (st.st_size), 1));
+
+      for (;;)
+      {
+        ssize_t n (read (fd.fd, b.data (), b.size ()));
+
+        if (n == -1)
+        {
+          if (errno == EINTR)
+            continue;
+
+          return string ();
+        }
+
+        if (n == 0)
+          break;
+
+        blake3_hasher_update (&h, b.data (), static_cast<size_t> (n));
+      }
+
+      return hashed (h, static_cast<uint64_t> (st.st_size), hs);
+    }
+
+    if (pp.direct)
+    {
+#if defined(O_DIRECT)
+      int f (fcntl (fd.fd, F_GETFL));
+      pp.direct = (f != -1 && fcntl (fd.fd, F_SETFL, f | O_DIRECT) == 0);
+#elif defined(F_NOCACHE)
+      fcntl (fd.fd, F_NOCACHE, 1);
+      pp.direct = false; // No alignment requirements.
+#else
+      pp.direct = false;
+#endif
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!pp.direct)
+      posix_fadvise (fd.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+    double ht (0);
+    uint64_t tn (0);
+
+    try
+    {
+      read_ahead ra (fd.fd, pp);
+
+      for (;;)
+      {
+        auto [d, n] (ra.next ());
+
+        if (n == 0)
+          break;
+
+        auto hs (chrono::steady_clock::now ());
+        blake3_hasher_update (&h, d, n);
+        ht += chrono::duration<double> (chrono::steady_clock::now () - hs)
+          .count ();
+
+        tn += n;
+      }
+
+      record (st.st_dev, tn, ra.read_time (), ht);
+    }
+    catch (const system_error&)
+    {
+      return string ();
+    }
+
+    return hashed (h, tn, hs);
+#else
+    // @@ We don't have the pipeline on Windows yet (it would be overlapped
+    //    ReadFile() and FILE_FLAG_NO_BUFFERING) so read sequentially.
+    //
     ifstream i (p, ios::binary);
     if (!i)
       return string ();
 
-    blake3_hasher h;
-    blake3_hasher_init (&h);
-
     // Read and hash the file in 1M chunks.
     //
     constexpr size_t n (1048576);
     vector<char> b (n);
+    uint64_t tn (0);
 
     while (i)
     {
@@ -109,20 +831,12 @@ namespace launcher
       size_t c (static_cast<size_t> (i.gcount ()));
       if (c != 0)
         blake3_hasher_update (&h, b.data (), c);
-    }
 
-    uint8_t d[BLAKE3_OUT_LEN];
-    blake3_hasher_finalize (&h, d, BLAKE3_OUT_LEN);
-
-    // Format the hash as a lowercase hex string.
-    //
-    ostringstream o;
-    o << hex << setfill ('0');
-
-    for (int j (0); j < BLAKE3_OUT_LEN; ++j)
-      o << setw (2) << static_cast<int> (d[j]);
+      tn += c;
+    }
 
-    return o.str ();
+    return hashed (h, tn, hs);
+#endif
   }
 
   bool
@@ -163,6 +877,119 @@ namespace launcher
     return true;
   }
 
+  namespace
+  {
+    void
+    put64 (blake3_hasher& h, uint64_t v)
+    {
+      uint8_t b[8];
+
+      for (size_t i (0); i != 8; ++i)
+        b[i] = static_cast<uint8_t> (v >> (8 * i));
+
+      blake3_hasher_update (&h, b, sizeof (b));
+    }
+
+    // SplitMix64. We don't use the <random> distributions since their
+    // output is implementation-specific and the block choice has to stay
+    // the same across launcher builds.
+    //
+    uint64_t
+    next (uint64_t& s)
+    {
+      uint64_t z (s += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+  }
+
+  string
+  compute_fingerprint (const fs::path& p, const string& key, const string& id)
+  {
+    ifstream f (p, ios::binary);
+    if (!f)
+      return string ();
+
+    error_code ec;
+    uint64_t n (fs::file_size (p, ec));
+    if (ec)
+      return string ();
+
+    // Derive the hashing key from the secret so that it can be of any length
+    // (and so that the fingerprints are not directly related to anything
+    // else that may be keyed by it).
+    //
+    uint8_t k[BLAKE3_KEY_LEN];
+    {
+      blake3_hasher h;
+      blake3_hasher_init_derive_key (&h, "iw4x-launcher file fingerprint");
+      blake3_hasher_update (&h, key.data (), key.size ());
+      blake3_hasher_finalize (&h, k, sizeof (k));
+    }
+
+    const uint64_t bs (fingerprint_block);
+    uint64_t nb ((n + bs - 1) / bs);
+
+    // Pick the blocks: all of them for small files, otherwise the first, the
+    // last, and the samples seeded from the keyed hash of the id.
+    //
+    vector<uint64_t> bl;
+
+    if (nb <= fingerprint_samples + 2)
+    {
+      for (uint64_t i (0); i != nb; ++i)
+        bl.push_back (i);
+    }
+    else
+    {
+      blake3_hasher h;
+      blake3_hasher_init_keyed (&h, k);
+      blake3_hasher_update (&h, id.data (), id.size ());
+      put64 (h, n);
+
+      uint8_t d[8];
+      blake3_hasher_finalize (&h, d, sizeof (d));
+
+      uint64_t sd (0);
+      for (size_t i (0); i != sizeof (d); ++i)
+        sd |= static_cast<uint64_t> (d[i]) << (8 * i);
+
+      bl.push_back (0);
+      bl.push_back (nb - 1);
+
+      while (bl.size () != fingerprint_samples + 2)
+      {
+        uint64_t b (1 + next (sd) % (nb - 2));
+
+        if (find (bl.begin (), bl.end (), b) == bl.end ())
+          bl.push_back (b);
+      }
+
+      sort (bl.begin (), bl.end ());
+    }
+
+    blake3_hasher h;
+    blake3_hasher_init_keyed (&h, k);
+    put64 (h, n);
+
+    vector<char> buf (bs);
+
+    for (uint64_t b : bl)
+    {
+      uint64_t o (b * bs);
+      streamsize c (static_cast<streamsize> (min (bs, n - o)));
+
+      if (!f.seekg (static_cast<streamoff> (o)) || !f.read (buf.data (), c))
+        return string ();
+
+      put64 (h, b);
+      blake3_hasher_update (&h, buf.data (), static_cast<size_t> (c));
+    }
+
+    return digest (h);
+  }
+
   blake3_hash::
   blake3_hash (std::string hex)
   {
@@ -74,13 +74,17 @@ namespace launcher
                  std::string v,
                  component_type c,
                  std::uint64_t s = 0,
-                 std::string h = std::string ())
+                 std::string h = std::string (),
+                 std::string f = std::string (),
+                 std::int64_t vt = 0)
       : path_ (std::move (p)),
         mtime_ (t),
         version_ (std::move (v)),
         component_ (c),
         size_ (s),
-        hash_ (std::move (h))
+        hash_ (std::move (h)),
+        fingerprint_ (std::move (f)),
+        verified_ (vt)
     {
     }
 
@@ -102,6 +106,18 @@ namespace launcher
     const std::string&
     hash () const noexcept { return hash_; }
 
+    // Sampled content fingerprint (see compute_fingerprint()) recorded when
+    // the file was last fully verified. Empty if none was recorded.
+    //
+    const std::string&
+    fingerprint () const noexcept { return fingerprint_; }
+
+    // Time (seconds since epoch) the file's content was last verified
+    // against its hash or 0 if never.
+    //
+    std::int64_t
+    verified () const noexcept { return verified_; }
+
     void
     set_mtime (std::int64_t t) { mtime_ = t; }
 
@@ -114,6 +130,12 @@ namespace launcher
     void
     set_hash (std::string h) { hash_ = std::move (h); }
 
+    void
+    set_fingerprint (std::string f) { fingerprint_ = std::move (f); }
+
+    void
+    set_verified (std::int64_t t) { verified_ = t; }
+
   private:
     friend class odb::access;
 
@@ -131,6 +153,8 @@ namespace launcher
 
     std::uint64_t size_;
     std::string hash_;
+    std::string fingerprint_;
+    std::int64_t verified_;
   };
 
   // Tracks the currently installed version tag for each component. Note that a
@@ -357,6 +381,90 @@ namespace launcher
   std::int64_t
   current_timestamp ();
 
+  // Content hashing pipeline.
+  //
+  // Files larger than a chunk are hashed while the following chunks are read
+  // ahead by a separate thread so that the disk (or the network, for NFS/SMB
+  // installation roots) and the CPU don't take turns. A zero chunk size or
+  // depth (the number of chunks that can be read ahead) means to tune it
+  // automatically based on the read throughput observed on the file's device.
+  //
+  struct hash_pipeline
+  {
+    std::size_t chunk_size = 0;
+    std::size_t depth = 0;
+
+    // Bypass the page cache (O_DIRECT or equivalent) if the filesystem
+    // supports it. This avoids evicting the game's working set when
+    // verifying the whole installation. Since there is no kernel readahead
+    // in this case, we keep depth reads in flight ourselves.
+    //
+    bool direct_io = false;
+
+    // Upper bound on the memory (in bytes) a single file's pipeline may have
+    // in flight. Zero means the default (16MB).
+    //
+    std::size_t max_in_flight = 0;
+
+    // Number of files hashed in parallel. Zero means one per hardware
+    // thread.
+    //
+    std::size_t workers = 0;
+  };
+
+  void
+  configure_hashing (const hash_pipeline&);
+
+  std::size_t
+  hashing_workers ();
+
+  // Hashing totals since the start of the process. The time is from opening
+  // to finishing each file and is summed across the workers so bytes/time
+  // is the throughput of a single worker.
+  //
+  struct hash_stats
+  {
+    std::size_t files = 0;
+    std::uint64_t bytes = 0;
+    double time = 0; // Seconds.
+  };
+
+  hash_stats
+  hashing_stats ();
+
+  // Durability of applied updates.
+  //
+  // Updated files are moved (or extracted) into the installation and then
+  // recorded in the cache database with their new mtime. Without a barrier
+  // in between, a power loss can leave the database saying a file is valid
+  // while its data never made it to the disk and, since the mtime matches,
+  // nothing would trigger a re-download.
+  //
+  enum class durability_mode
+  {
+    none,  // No barrier, the database is not synchronized either.
+    batch, // One barrier per applied batch before it is recorded.
+    full   // Same plus every database commit is synchronized.
+  };
+
+  std::ostream&
+  operator<< (std::ostream& o, durability_mode m);
+
+  void
+  configure_durability (durability_mode);
+
+  durability_mode
+  configured_durability ();
+
+  // Flush the files, including the directory entries pointing to them, to
+  // stable storage. On Linux this is a single syncfs() per filesystem the
+  // files reside on rather than a call per file. Elsewhere every file (and
+  // then every parent directory) is flushed in turn. Files that don't exist
+  // are skipped. Throw system_error on failure.
+  //
+  void
+  sync_files (const std::vector<fs::path>& ps);
+
   // Blake3 is fast enough that we can usually compute it for the entire file in
   // one go.
   //
@@ -365,4 +473,25 @@ namespace launcher
 
   bool
   verify_blake3 (const fs::path& p, const std::string& h);
+
+  // Sampled content fingerprint.
+  //
+  // Hash the file size together with its first and last blocks plus a number
+  // of blocks in between. The latter are chosen pseudo-randomly based on the
+  // key (a per-installation secret) and the id (the file's cache key) so
+  // that someone who doesn't know the key cannot predict which parts of the
+  // file are going to be checked. Files that are not larger than the sample
+  // are hashed in their entirety.
+  //
+  // This catches truncation and most corruption while reading only a tiny
+  // fraction of a large file. Return empty string if the file cannot be
+  // read.
+  //
+  constexpr std::size_t fingerprint_block = 64 * 1024;
+  constexpr std::size_t fingerprint_samples = 16;
+
+  std::string
+  compute_fingerprint (const fs::path& p,
+                       const std::string& key,
+                       const std::string& id);
 }
@@ -0,0 +1,149 @@
+#include <launcher/cache/cache-types.hxx>
+
+#include <launcher/launcher-blake3.test.hxx>
+
+#include <cassert>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace launcher;
+
+// The read-ahead hashing pipeline has to produce exactly the same digest as
+// hashing the content in one go, whatever the chunk size, depth, and I/O mode
+// and wherever the end of the file happens to fall relative to the chunk
+// boundaries.
+//
+
+static void
+check (const fs::path& d, const string& c)
+{
+  fs::path p (d / ("f_" + to_string (c.size ())));
+
+  {
+    ofstream os (p, ios::binary | ios::trunc);
+    os.write (c.data (), static_cast<streamsize> (c.size ()));
+  }
+
+  string e (blake3_hex (c));
+
+  // Run twice so that the second pass uses the auto-tuned parameters.
+  //
+  assert (compute_blake3 (p) == e);
+  assert (compute_blake3 (p) == e);
+  assert (verify_blake3 (p, e));
+
+  fs::remove (p);
+}
+
+// The fingerprint has to be stable, depend on the key and (for files larger
+// than the sample) on the id, and change on truncation and on modification
+// of the blocks it always covers.
+//
+static void
+fingerprint (const fs::path& d, const string& c)
+{
+  fs::path p (d / ("g_" + to_string (c.size ())));
+
+  auto write ([&p] (const string& s)
+  {
+    ofstream os (p, ios::binary | ios::trunc);
+    os.write (s.data (), static_cast<streamsize> (s.size ()));
+  });
+
+  write (c);
+
+  const size_t bs (fingerprint_block);
+  bool sampled (c.size () > (fingerprint_samples + 2) * bs);
+
+  string f (compute_fingerprint (p, "k1", "a"));
+
+  assert (f.size () == 64);
+  assert (compute_fingerprint (p, "k1", "a") == f);
+  assert (compute_fingerprint (p, "k2", "a") != f);
+  assert ((compute_fingerprint (p, "k1", "b") != f) == sampled);
+
+  // Flipping a byte anywhere in a small file or in the first or last block
+  // of a large one.
+  //
+  if (!c.empty ())
+  {
+    for (size_t i : {size_t (0), c.size () / 2, c.size () - 1})
+    {
+      if (sampled && i / bs != 0 && i / bs != (c.size () - 1) / bs)
+        continue;
+
+      string m (c);
+      m[i] = static_cast<char> (m[i] ^ 0x01);
+      write (m);
+      assert (compute_fingerprint (p, "k1", "a") != f);
+    }
+
+    write (c.substr (0, c.size () - 1));
+    assert (compute_fingerprint (p, "k1", "a") != f);
+  }
+
+  fs::remove (p);
+}
+
+int
+main ()
+{
+  fs::path d (fs::temp_directory_path () / "iw4x-cache-types-test");
+  fs::remove_all (d);
+  fs::create_directories (d);
+
+  mt19937 g (42);
+  auto content ([&g] (size_t n)
+  {
+    string r (n, '\0');
+
+    for (char& c : r)
+      c = static_cast<char> (g ());
+
+    return r;
+  });
+
+  const size_t k (4096);
+
+  vector<size_t> sizes {0, 1, k - 1, k, k + 1,
+                        64 * k - 1, 64 * k, 64 * k + 1,
+                        256 * k, 256 * k + 17,
+                        3 * 1024 * 1024 + 5};
+
+  vector<hash_pipeline> configs {
+    {0, 0, false},       // Auto-tuned.
+    {k, 2, false},       // Smallest chunk and depth.
+    {64 * k, 8, false},
+    {5000, 3, false},    // Unaligned chunk size (rounded up).
+    {0, 0, true},        // Direct I/O (falls back if unsupported).
+    {k, 2, true},
+    {64 * k, 8, true}};  // Several direct reads in flight.
+
+  for (const hash_pipeline& c : configs)
+  {
+    configure_hashing (c);
+
+    for (size_t n : sizes)
+      check (d, content (n));
+  }
+
+  for (size_t n : {size_t (0), size_t (1), 64 * k, 64 * k + 1,
+                   (fingerprint_samples + 2) * fingerprint_block,
+                   (fingerprint_samples + 2) * fingerprint_block + 1,
+                   size_t (8 * 1024 * 1024 + 3)})
+    fingerprint (d, content (n));
+
+  // Nonexistent file.
+  //
+  configure_hashing (hash_pipeline ());
+  assert (compute_blake3 (d / "missing").empty ());
+  assert (!verify_blake3 (d / "missing", blake3_hex ("")));
+  assert (compute_fingerprint (d / "missing", "k1", "a").empty ());
+
+  fs::remove_all (d);
+}
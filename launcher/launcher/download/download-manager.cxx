@@ -1,8 +1,11 @@
 #include <launcher/download/download-manager.hxx>
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <fstream>
 #include <chrono>
+#include <sstream>
 
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/detached.hpp>
@@ -21,11 +24,240 @@ namespace launcher
   // How frequently we poll while a download is paused.
   //
   constexpr chrono::milliseconds pause_poll_interval {100};
+
+  // How many times we retry the last URL of a download if it stalls.
+  //
+  constexpr size_t max_stall_retries = 2;
+
+  namespace
+  {
+    // Return the host part of the URL (or the URL itself if it doesn't
+    // look like one).
+    //
+    string
+    url_host (const string& u)
+    {
+      size_t b (u.find ("://"));
+      b = (b != string::npos ? b + 3 : 0);
+
+      size_t e (u.find_first_of ("/?#", b));
+      string r (u, b, e != string::npos ? e - b : string::npos);
+
+      // Strip the userinfo and the port (but not an IPv6 address).
+      //
+      if (size_t p = r.rfind ('@'); p != string::npos)
+        r.erase (0, p + 1);
+
+      if (size_t p = r.rfind (':');
+          p != string::npos && r.find (']', p) == string::npos)
+        r.resize (p);
+
+      return r;
+    }
+
+    // Transfer state sidecar.
+    //
+    // Next to each partially downloaded file we keep its transfer state
+    // (see transfer_state) so that the download can be resumed safely by
+    // this or a later process:
+    //
+    // iw4x-resume 1
+    // offset <bytes>
+    // etag <value>
+    // last-modified <value>
+    // prefix <BLAKE3 of the first offset bytes>
+    // hasher <BLAKE3 version> <state size> <state>
+    //
+    // The hasher state is a raw copy of blake3_hasher (which holds no
+    // pointers) and is only used if it was saved by the same BLAKE3 version
+    // with the same layout. The prefix hash is used to detect a corrupted
+    // sidecar. Note that a crash can leave more content in the file than the
+    // sidecar accounts for, in which case we simply cut it off.
+    //
+    fs::path
+    sidecar (const fs::path& f)
+    {
+      fs::path r (f);
+      r += ".resume";
+      return r;
+    }
+
+    void
+    save_sidecar (const fs::path& f, const transfer_state& s)
+    {
+      static const char hx[] = "0123456789abcdef";
+
+      const uint8_t* b (reinterpret_cast<const uint8_t*> (&s.hasher));
+      string h;
+      h.reserve (sizeof (s.hasher) * 2);
+
+      for (size_t i (0); i != sizeof (s.hasher); ++i)
+      {
+        h += hx[b[i] >> 4];
+        h += hx[b[i] & 0x0f];
+      }
+
+      // Write to a temporary and rename so that the sidecar is never torn.
+      //
+      fs::path p (sidecar (f));
+      fs::path tp (p);
+      tp += ".tmp";
+
+      {
+        ofstream os (tp, ios::binary | ios::trunc);
+
+        os << "iw4x-resume 1\n"
+           << "offset " << s.offset << '\n'
+           << "etag " << s.etag << '\n'
+           << "last-modified " << s.last_modified << '\n'
+           << "prefix " << s.digest () << '\n'
+           << "hasher " << BLAKE3_VERSION_STRING << ' '
+                        << sizeof (s.hasher) << ' ' << h << '\n';
+
+        if (!os.flush ())
+          return;
+      }
+
+      error_code ec;
+      fs::rename (tp, p, ec);
+    }
+
+    // Return false if there is no usable sidecar.
+    //
+    bool
+    load_sidecar (const fs::path& f, transfer_state& s)
+    {
+      ifstream is (sidecar (f), ios::binary);
+
+      if (!is)
+        return false;
+
+      string l;
+      if (!getline (is, l) || l != "iw4x-resume 1")
+        return false;
+
+      transfer_state r;
+      string prefix;
+      bool hs (false);
+
+      while (getline (is, l))
+      {
+        size_t p (l.find (' '));
+        string k (l.substr (0, p));
+        string v (p != string::npos ? l.substr (p + 1) : string ());
+
+        if (k == "offset")
+          r.offset = strtoull (v.c_str (), nullptr, 10);
+        else if (k == "etag")
+          r.etag = move (v);
+        else if (k == "last-modified")
+          r.last_modified = move (v);
+        else if (k == "prefix")
+          prefix = move (v);
+        else if (k == "hasher")
+        {
+          istringstream vs (v);
+          string ver, h;
+          size_t n (0);
+
+          if (!(vs >> ver >> n >> h)              ||
+              ver != BLAKE3_VERSION_STRING        ||
+              n != sizeof (r.hasher)              ||
+              h.size () != n * 2)
+            return false;
+
+          uint8_t b[sizeof (r.hasher)];
+
+          for (size_t i (0); i != n; ++i)
+          {
+            auto x ([] (char c) -> int
+            {
+              return c >= '0' && c <= '9' ? c - '0' :
+                     c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            });
+
+            int hi (x (h[2 * i])), lo (x (h[2 * i + 1]));
+
+            if (hi < 0 || lo < 0)
+              return false;
+
+            b[i] = static_cast<uint8_t> (hi << 4 | lo);
+          }
+
+          memcpy (&r.hasher, b, n);
+          hs = true;
+        }
+      }
+
+      if (!hs || r.digest () != prefix)
+        return false;
+
+      s.offset = r.offset;
+      s.etag = move (r.etag);
+      s.last_modified = move (r.last_modified);
+      s.hasher = r.hasher;
+      return true;
+    }
+
+    // Restore the transfer state of the request's target or, if there is
+    // nothing we can resume, clean up so that we start from scratch.
+    //
+    void
+    restore (const download_request& rq, transfer_state& s)
+    {
+      const fs::path& f (rq.target);
+      error_code ec;
+
+      if (rq.resume && load_sidecar (f, s) && s.offset != 0)
+      {
+        uint64_t n (fs::file_size (f, ec));
+
+        if (!ec && n >= s.offset)
+        {
+          if (n == s.offset)
+            return;
+
+          fs::resize_file (f, s.offset, ec);
+
+          if (!ec)
+            return;
+        }
+      }
+
+      s.reset ();
+      fs::remove (f, ec);
+      fs::remove (sidecar (f), ec);
+    }
+
+    // Bring the file in line with the transfer state after a failed attempt
+    // and save the latter so that a later attempt (possibly by another
+    // process) can pick up from there.
+    //
+    void
+    suspend (const download_request& rq, const transfer_state& s)
+    {
+      const fs::path& f (rq.target);
+      error_code ec;
+
+      if (!rq.resume || s.offset == 0)
+      {
+        fs::remove (f, ec);
+        fs::remove (sidecar (f), ec);
+        return;
+      }
+
+      uint64_t n (fs::file_size (f, ec));
+
+      if (!ec && n > s.offset)
+        fs::resize_file (f, s.offset, ec);
+
+      save_sidecar (f, s);
+    }
+  }
   download_manager::
   download_manager (boost::asio::io_context& c,
                     size_t m)
-    : ioc_ (c),
-      max_parallel_ (m)
+    : download_manager (c, m, http_client_traits ())
   {
   }
 
@@ -37,6 +269,13 @@ namespace launcher
       max_parallel_ (m),
       traits_ (t)
   {
+    // Share connections and redirects between all our clients.
+    //
+    if (traits_.pool == nullptr)
+      traits_.pool = make_shared<http_pool> (c, traits_);
+
+    if (traits_.redirects == nullptr)
+      traits_.redirects = make_shared<http_redirect_cache> ();
   }
 
   void
@@ -51,6 +290,36 @@ namespace launcher
     return max_parallel_;
   }
 
+  const map<string, size_t>&
+  download_manager::stalls () const
+  {
+    return stalls_;
+  }
+
+  const map<string, transfer_stats>&
+  download_manager::transfers () const
+  {
+    return transfers_;
+  }
+
+  void
+  download_manager::warm (const vector<string>& us)
+  {
+    // If we already know where a URL redirects to, then that is where the
+    // content will come from.
+    //
+    for (const string& u : us)
+    {
+      traits_.pool->warm (u, max_parallel_);
+
+      if (traits_.redirects != nullptr)
+      {
+        if (optional<string> t = traits_.redirects->find (u))
+          traits_.pool->warm (*t, max_parallel_);
+      }
+    }
+  }
+
   shared_ptr<launcher::download_task>
   download_manager::add_task (download_request r)
   {
@@ -292,24 +561,35 @@ namespace launcher
 
     http_client c (ioc_, tr);
 
-    optional<uint64_t> r;
-
     // Check if we have a partial payload lying around on disk that we can
     // resume from.
     //
-    if (t->request.resume && fs::exists (t->request.target))
-    {
-      error_code ec;
-      uint64_t s (fs::file_size (t->request.target, ec));
+    transfer_state st;
+    restore (t->request, st);
 
-      if (!ec && s > 0)
+    if (t->request.resume)
+      st.checkpoint = [t] (const transfer_state& s)
       {
-        r = s;
-        t->update_progress (s, t->request.expected_size.value_or (0));
-      }
-    }
+        save_sidecar (t->request.target, s);
+      };
+
+    // The transfer publishes its progress straight into the task counters
+    // from where the UI and statistics pick it up (see progress_entry).
+    //
+    st.progress_bytes = &t->downloaded_bytes;
+    st.progress_total = &t->total_bytes;
+    st.cancel = &t->cancel_requested;
+
+    if (st.offset != 0)
+      t->update_progress (st.offset, t->request.expected_size.value_or (0));
+
+    string eh (t->request.expected_hash);
+    transform (eh.begin (), eh.end (), eh.begin (),
+               [] (unsigned char c) {return tolower (c);});
+
+    size_t stalled (0);  // Stalled attempts of the last URL.
+    size_t attempts (0);
 
-    bool ok (false);
     for (size_t i (0); i < t->request.urls.size (); ++i)
     {
       if (t->should_cancel ())
@@ -329,35 +609,70 @@ namespace launcher
       }
 
       const auto& u (t->request.urls[i]);
+      bool last (i == t->request.urls.size () - 1);
+      bool resumed (st.offset != 0);
+      string m;
+
+      // Account for the attempt in the host's statistics. Note that the
+      // task counters include what was received before resuming.
+      //
+      transfer_stats& hs (transfers_[url_host (u)]);
+      auto as (chrono::steady_clock::now ());
+      uint64_t ab (t->downloaded_bytes.load (memory_order_relaxed));
+
+      if (attempts++ != 0)
+        ++hs.retries;
+
+      auto account ([&hs, &t, as, ab] (bool ok)
+      {
+        uint64_t n (t->downloaded_bytes.load (memory_order_relaxed));
+
+        hs.bytes += n > ab ? n - ab : 0;
+        hs.time += chrono::steady_clock::now () - as;
+
+        if (ok)
+          ++hs.files;
+        else
+          ++hs.errors;
+      });
 
       try
       {
         t->set_state (download_state::connecting);
         t->set_state (download_state::downloading);
 
-        auto cb ([t, this] (uint64_t tx, uint64_t tot)
-        {
-          if (t->should_cancel ())
-            throw runtime_error ("Download cancelled");
-
-          t->update_progress (tx, tot);
-          t->response.progress.speed_bps = 0;
-        });
-
         uint64_t b (
           co_await c.download (u,
                                t->request.target,
-                               cb,
-                               r,
+                               st,
+                               nullptr,
                                t->request.rate_limit_bytes_per_second));
 
+        error_code ec;
+        fs::remove (sidecar (t->request.target), ec);
+
+        t->response.content_hash = st.digest ();
+
+        // We have hashed the content as it arrived so verifying it is free.
+        // A mismatch means this mirror is serving something else, so start
+        // over with the next one.
+        //
+        if (!eh.empty () && t->response.content_hash != eh)
+        {
+          fs::remove (t->request.target, ec);
+          st.reset ();
+
+          throw runtime_error ("content hash mismatch: expected " + eh +
+                               ", got " + t->response.content_hash);
+        }
+
         t->update_progress (b, b);
         t->response.http_status_code = 200;
         t->response.server_reported_size = b;
 
         t->response.successful_url_index = i;
         t->set_state (download_state::completed);
-        ok = true;
+        account (true);
         break;
       }
       catch (const http_status_error& e)
@@ -367,11 +682,11 @@ namespace launcher
         // downloaded the whole thing and got confused trying to resume. Nuke
         // the file and retry the exact same URL from scratch.
         //
-        if (e.status () == http_status::range_not_satisfiable && r)
+        if (e.status () == http_status::range_not_satisfiable && resumed)
         {
-          error_code ec;
-          fs::remove (t->request.target, ec);
-          r = nullopt;
+          account (false);
+          st.reset ();
+          suspend (t->request, st);
 
           --i; // keep the index exactly where it is for the retry.
           continue;
@@ -379,55 +694,48 @@ namespace launcher
 
         // Fall through to generic error handling.
         //
-        string m (e.what ());
+        m = e.what ();
+      }
+      catch (const http_stall_error& e)
+      {
+        // The transfer was crawling. Keep what we've got and move on to the
+        // next mirror or, if this was the last one, try it again on a new
+        // connection (with luck to a different server behind it) a couple
+        // of times.
+        //
+        ++stalls_[e.host ()];
 
-        if (i == t->request.urls.size () - 1)
-        {
-          t->set_error (download_error (
-              string ("Download failed: ") + m,
-              u,
-              0));
-        }
-        else
+        if (last && ++stalled <= max_stall_retries)
         {
-          if (t->request.resume && fs::exists (t->request.target))
-          {
-            error_code ec;
-            uint64_t s (fs::file_size (t->request.target, ec));
+          account (false);
+          suspend (t->request, st);
 
-            if (!ec && s > 0)
-              r = s;
-          }
+          --i;
+          continue;
         }
+
+        m = e.what ();
       }
       catch (const exception& e)
       {
-        string m (e.what ());
+        m = e.what ();
+      }
 
-        // We've exhausted our list of fallback mirrors. Bail out.
-        //
-        if (i == t->request.urls.size () - 1)
-        {
-          t->set_error (download_error (
-              string ("Download failed: ") + m,
-              u,
-              0));
-        }
-        else
-        {
-          // We have more URLs to try. Check the partial file size again in case
-          // this last failed attempt managed to write some bytes before blowing
-          // up.
-          //
-          if (t->request.resume && fs::exists (t->request.target))
-          {
-            error_code ec;
-            uint64_t s (fs::file_size (t->request.target, ec));
+      account (false);
 
-            if (!ec && s > 0)
-              r = s;
-          }
-        }
+      // Keep whatever this attempt managed to receive for the next mirror
+      // (or a later retry).
+      //
+      suspend (t->request, st);
+
+      // We've exhausted our list of fallback mirrors. Bail out.
+      //
+      if (last)
+      {
+        t->set_error (download_error (
+            string ("Download failed: ") + m,
+            u,
+            0));
       }
     }
 
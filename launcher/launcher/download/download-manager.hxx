@@ -1,9 +1,11 @@
 #pragma once
 
+#include <map>
 #include <vector>
 #include <memory>
 #include <queue>
 #include <functional>
+#include <string>
 #include <cstddef>
 
 #include <boost/asio.hpp>
@@ -46,6 +48,13 @@ namespace launcher
     std::size_t
     max_parallel () const;
 
+    // Speculatively open connections to the origins of the URLs, as many
+    // per origin as we download in parallel, for the downloads that will
+    // follow (see http_pool).
+    //
+    void
+    warm (const std::vector<std::string>& urls);
+
     // Task management.
     //
     std::shared_ptr<launcher::download_task>
@@ -88,6 +97,17 @@ namespace launcher
     download_progress
     overall_progress () const;
 
+    // Number of stalled transfers (see http_client_traits::low_speed_limit)
+    // per host.
+    //
+    const std::map<std::string, std::size_t>&
+    stalls () const;
+
+    // Transfer statistics per host.
+    //
+    const std::map<std::string, transfer_stats>&
+    transfers () const;
+
     // Callbacks.
     //
     void
@@ -123,6 +143,8 @@ namespace launcher
     std::size_t max_parallel_;
     http_client_traits traits_;
     std::vector<std::shared_ptr<launcher::download_task>> tasks_;
+    std::map<std::string, std::size_t> stalls_;
+    std::map<std::string, transfer_stats> transfers_;
 
     completion_callback on_task_complete_;
     batch_completion_callback on_batch_complete_;
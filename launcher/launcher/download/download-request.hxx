@@ -35,8 +35,17 @@ namespace launcher
 
     // Resume support.
     //
+    // The transfer state of a partial download is kept in a sidecar next to
+    // the target (see download_manager) and the partial content is only
+    // reused if it can be validated.
+    //
     bool resume {true};
 
+    // Expected BLAKE3 of the content (hex) or empty if unknown. Since the
+    // content is hashed as it is received, verifying it is essentially free.
+    //
+    std::string expected_hash;
+
     // Timeout settings.
     //
     std::chrono::seconds connect_timeout {30};
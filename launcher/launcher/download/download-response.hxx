@@ -40,6 +40,10 @@ namespace launcher
     std::string content_type;
     std::optional<std::uint64_t> server_reported_size;
 
+    // BLAKE3 (lowercase hex) of the downloaded content.
+    //
+    std::string content_hash;
+
     // Constructors.
     //
     download_response () = default;
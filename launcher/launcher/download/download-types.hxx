@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 #include <ostream>
@@ -70,4 +72,19 @@ namespace launcher
   };
 
   std::ostream& operator<< (std::ostream& os, const download_error& e);
+
+  // Transfer statistics of a single host.
+  //
+  struct transfer_stats
+  {
+    std::size_t files {0};   // Downloads completed from this host.
+    std::uint64_t bytes {0}; // Received, including failed attempts.
+    std::size_t errors {0};  // Failed attempts.
+    std::size_t retries {0}; // Attempts beyond the first of each download.
+
+    // Time spent in attempts. Note that attempts overlap so this is not the
+    // wall time.
+    //
+    std::chrono::steady_clock::duration time {};
+  };
 }
@@ -200,6 +200,9 @@ namespace launcher
 
       if (o.contains ("url"))
         a.url = json::value_to<string> (o.at ("url"));
+
+      if (o.contains ("digest") && !o.at ("digest").is_null ())
+        a.digest = json::value_to<string> (o.at ("digest"));
     }
 
     return a;
@@ -544,12 +547,53 @@ namespace launcher
     o["draft"] = r.draft;
     o["prerelease"] = r.prerelease;
 
+    if (!r.target_commitish.empty ())
+      o["target_commitish"] = r.target_commitish;
+
+    if (!r.html_url.empty ())
+      o["html_url"] = r.html_url;
+
+    json::array as;
+    for (const auto& a : r.assets)
+      as.push_back (to_json (a));
+
+    o["assets"] = move (as);
+
+    return o;
+  }
+
+  json::value github_api_traits::
+  to_json (const asset_type& a)
+  {
+    json::object o;
+    o["id"] = a.id;
+    o["name"] = a.name;
+
+    if (!a.label.empty ())
+      o["label"] = a.label;
+
+    if (!a.content_type.empty ())
+      o["content_type"] = a.content_type;
+
+    if (!a.state.empty ())
+      o["state"] = a.state;
+
+    o["size"] = a.size;
+    o["browser_download_url"] = a.browser_download_url;
+
+    if (!a.url.empty ())
+      o["url"] = a.url;
+
+    if (!a.digest.empty ())
+      o["digest"] = a.digest;
+
     return o;
   }
 
   github_api::
   github_api (asio::io_context& c)
-    : ioc_ (c)
+    : ioc_ (c),
+      api_base_ (endpoint_type::api_base)
   {
     traits_.user_agent = traits_type::user_agent ();
   }
@@ -557,7 +601,8 @@ namespace launcher
   github_api::
   github_api (asio::io_context& c, string tok)
     : ioc_ (c),
-      token_ (move (tok))
+      token_ (move (tok)),
+      api_base_ (endpoint_type::api_base)
   {
     traits_.user_agent = traits_type::user_agent ();
   }
@@ -578,12 +623,27 @@ namespace launcher
     client_.reset ();
   }
 
+  void github_api::
+  set_api_base (string u)
+  {
+    while (!u.empty () && u.back () == '/')
+      u.pop_back ();
+
+    api_base_ = move (u);
+  }
+
   void github_api::
   set_progress_callback (progress_callback_type cb)
   {
     progress_callback_ = move (cb);
   }
 
+  void github_api::
+  set_wait_on_rate_limit (bool w)
+  {
+    wait_on_rate_limit_ = w;
+  }
+
   http_client& github_api::
   ensure_client ()
   {
@@ -694,14 +754,20 @@ namespace launcher
     // Build the full URL. The github_request stores just the endpoint path
     // (e.g. "/repos/iw4x/launcher/releases"), so we prepend the API base.
     //
+    // Endpoints built by github_endpoint already carry the default base
+    // which we rebase if it was overridden.
+    //
     string u (req.url ());
-    const string pre (endpoint_type::api_base);
+    const string def (endpoint_type::api_base);
+
+    if (api_base_ != def && u.compare (0, def.size (), def) == 0)
+      u.erase (0, def.size ());
 
     string full_url;
     if (u.find ("https://") == 0 || u.find ("http://") == 0)
       full_url = move (u);
     else
-      full_url = pre + u;
+      full_url = api_base_ + u;
 
     // Build the http_request from the github_request.
     //
@@ -1096,6 +1162,11 @@ namespace launcher
     if (l.is_exceeded ())
     {
       auto w (l.seconds_until_reset () + 1);
+
+      if (!wait_on_rate_limit_)
+        throw runtime_error ("GitHub API rate limit exceeded (resets in " +
+                             std::to_string (w) + " seconds)");
+
       asio::steady_timer t (ioc_);
 
       if (progress_callback_)
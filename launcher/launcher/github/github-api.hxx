@@ -133,6 +133,9 @@ namespace launcher
     static json::value
     to_json (const release_type& r);
 
+    static json::value
+    to_json (const asset_type& a);
+
     // Default User-Agent header.
     //
     static std::string
@@ -183,6 +186,15 @@ namespace launcher
     void
     set_proxy (std::string proxy_url);
 
+    // Set API base URL.
+    //
+    // Requests are sent to this base instead of api.github.com. Mostly
+    // useful for testing against a local server or for GitHub Enterprise
+    // installations.
+    //
+    void
+    set_api_base (std::string base_url);
+
     // Set progress callback for rate limit notifications.
     //
     using progress_callback_type =
@@ -191,6 +203,15 @@ namespace launcher
     void
     set_progress_callback (progress_callback_type callback);
 
+    // Control whether an exhausted rate limit is waited out.
+    //
+    // By default we sleep until the limit resets. Callers that have a
+    // fallback (say, a previously resolved release) can turn this off in
+    // which case the request fails immediately instead.
+    //
+    void
+    set_wait_on_rate_limit (bool wait);
+
     // Execute generic request.
     //
     asio::awaitable<response_type>
@@ -276,8 +297,10 @@ namespace launcher
     http_client_traits traits_;
     std::optional<http_client> client_;
     std::optional<std::string> token_;
+    std::string api_base_;
     std::optional<github_rate_limit> last_rate_limit_;
     progress_callback_type progress_callback_;
+    bool wait_on_rate_limit_ = true;
 
     // Ensure the HTTP client is initialized.
     //
@@ -18,6 +18,12 @@ namespace launcher
     static constexpr const char* api_host = "api.github.com";
     static constexpr const char* api_base = "https://api.github.com";
 
+    // Release asset downloads (browser_download_url) redirect to signed URLs
+    // on this host which is where the content actually comes from.
+    //
+    static constexpr const char* asset_base =
+      "https://objects.githubusercontent.com";
+
     // Repository endpoints.
     //
     static std::string
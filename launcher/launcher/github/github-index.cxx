@@ -0,0 +1,366 @@
+#include <launcher/github/github-index.hxx>
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#include <launcher/github/github-api.hxx>
+
+using namespace std;
+
+namespace launcher
+{
+  namespace
+  {
+    using pkey_ptr = unique_ptr<EVP_PKEY, decltype (&EVP_PKEY_free)>;
+    using md_ctx_ptr = unique_ptr<EVP_MD_CTX, decltype (&EVP_MD_CTX_free)>;
+
+    vector<unsigned char>
+    from_hex (const string& s)
+    {
+      auto d ([&s] (char c) -> unsigned char
+      {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+
+        throw invalid_argument ("invalid hex string '" + s + "'");
+      });
+
+      if (s.size () % 2 != 0)
+        throw invalid_argument ("invalid hex string '" + s + "'");
+
+      vector<unsigned char> r;
+      r.reserve (s.size () / 2);
+
+      for (size_t i (0); i != s.size (); i += 2)
+        r.push_back (static_cast<unsigned char> (d (s[i]) << 4 | d (s[i + 1])));
+
+      return r;
+    }
+
+    string
+    to_hex (const unsigned char* p, size_t n)
+    {
+      static const char ds[] = "0123456789abcdef";
+
+      string r;
+      r.reserve (n * 2);
+
+      for (size_t i (0); i != n; ++i)
+      {
+        r += ds[p[i] >> 4];
+        r += ds[p[i] & 0x0f];
+      }
+
+      return r;
+    }
+
+    string
+    to_base64 (const unsigned char* p, size_t n)
+    {
+      string r (4 * ((n + 2) / 3) + 1, '\0');
+      int l (EVP_EncodeBlock (reinterpret_cast<unsigned char*> (r.data ()),
+                              p,
+                              static_cast<int> (n)));
+      r.resize (static_cast<size_t> (l));
+      return r;
+    }
+
+    vector<unsigned char>
+    from_base64 (const string& s)
+    {
+      vector<unsigned char> r (3 * (s.size () / 4) + 3);
+      int l (EVP_DecodeBlock (r.data (),
+                              reinterpret_cast<const unsigned char*> (s.data ()),
+                              static_cast<int> (s.size ())));
+
+      if (l < 0)
+        throw invalid_argument ("invalid base64 signature");
+
+      // EVP_DecodeBlock() counts the padding as zero bytes.
+      //
+      size_t n (static_cast<size_t> (l));
+
+      for (auto i (s.rbegin ()); i != s.rend () && *i == '=' && n != 0; ++i)
+        --n;
+
+      r.resize (n);
+      return r;
+    }
+
+    pkey_ptr
+    read_private_key (const string& pem)
+    {
+      unique_ptr<BIO, decltype (&BIO_free)> b (
+        BIO_new_mem_buf (pem.data (), static_cast<int> (pem.size ())),
+        &BIO_free);
+
+      pkey_ptr k (b != nullptr
+                  ? PEM_read_bio_PrivateKey (b.get (), nullptr, nullptr, nullptr)
+                  : nullptr,
+                  &EVP_PKEY_free);
+
+      if (k == nullptr || EVP_PKEY_id (k.get ()) != EVP_PKEY_ED25519)
+        throw invalid_argument ("signing key is not a PEM-encoded Ed25519 "
+                                "private key");
+
+      return k;
+    }
+
+    github_index::release_type
+    parse_entry_release (const json::object& o, const char* n)
+    {
+      return github_api_traits::parse_release (o.at (n));
+    }
+  }
+
+  github_index::
+  github_index (asio::io_context& c, string u, string k)
+    : ioc_ (c),
+      url_ (move (u)),
+      key_ (move (k))
+  {
+    traits_.user_agent = github_api_traits::user_agent ();
+  }
+
+  void github_index::
+  set_proxy (string u)
+  {
+    traits_.proxy_url = move (u);
+  }
+
+  const string& github_index::
+  url () const noexcept
+  {
+    return url_;
+  }
+
+  void github_index::
+  set_floor (uint64_t g)
+  {
+    floor_ = g;
+  }
+
+  void github_index::
+  set_max_age (chrono::seconds a)
+  {
+    max_age_ = a;
+  }
+
+  uint64_t github_index::
+  generated () const noexcept
+  {
+    return generated_;
+  }
+
+  asio::awaitable<optional<github_index::release_type>> github_index::
+  find_latest_release (const string& own, const string& rep, bool pre)
+  {
+    if (!entries_)
+    {
+      http_client c (ioc_, traits_);
+      http_response r (co_await c.get (url_));
+
+      if (!r.is_success ())
+        throw runtime_error ("unable to fetch release index " + url_ +
+                             ": HTTP " + std::to_string (r.status_code ()));
+
+      uint64_t g (0);
+      entries_type es (parse (r.body.value_or (string ()), key_, &g));
+
+      if (g < floor_)
+        throw runtime_error ("release index generated at " +
+                             std::to_string (g) + " is older than the one "
+                             "accepted previously (generated at " +
+                             std::to_string (floor_) + ")");
+
+      if (max_age_.count () != 0)
+      {
+        auto now (static_cast<uint64_t> (
+          chrono::duration_cast<chrono::seconds> (
+            chrono::system_clock::now ().time_since_epoch ()).count ()));
+
+        if (g + static_cast<uint64_t> (max_age_.count ()) < now)
+          throw runtime_error ("release index generated at " +
+                               std::to_string (g) + " is older than " +
+                               std::to_string (max_age_.count ()) +
+                               " seconds");
+      }
+
+      entries_ = move (es);
+      generated_ = g;
+    }
+
+    auto i (entries_->find (own + '/' + rep));
+
+    if (i == entries_->end ())
+      co_return nullopt;
+
+    const entry& e (i->second);
+
+    co_return pre && e.latest_prerelease ? *e.latest_prerelease : e.latest;
+  }
+
+  github_index::entries_type github_index::
+  parse (const string& doc, const string& key, uint64_t* gen)
+  {
+    string p;
+    vector<unsigned char> sig;
+
+    try
+    {
+      json::value v (json::parse (doc));
+      const json::object& o (v.as_object ());
+
+      p = json::value_to<string> (o.at ("payload"));
+      sig = from_base64 (json::value_to<string> (o.at ("signature")));
+    }
+    catch (const invalid_argument&)
+    {
+      throw;
+    }
+    catch (const exception& e)
+    {
+      throw invalid_argument (string ("malformed release index: ") +
+                              e.what ());
+    }
+
+    // Verify before we look at anything inside the payload.
+    //
+    vector<unsigned char> kb (from_hex (key));
+
+    pkey_ptr k (EVP_PKEY_new_raw_public_key (EVP_PKEY_ED25519,
+                                             nullptr,
+                                             kb.data (),
+                                             kb.size ()),
+                &EVP_PKEY_free);
+
+    if (k == nullptr)
+      throw invalid_argument ("invalid release index public key");
+
+    md_ctx_ptr c (EVP_MD_CTX_new (), &EVP_MD_CTX_free);
+
+    if (c == nullptr ||
+        EVP_DigestVerifyInit (c.get (), nullptr, nullptr, nullptr, k.get ()) != 1 ||
+        EVP_DigestVerify (c.get (),
+                          sig.data (), sig.size (),
+                          reinterpret_cast<const unsigned char*> (p.data ()),
+                          p.size ()) != 1)
+      throw invalid_argument ("release index signature does not match");
+
+    entries_type r;
+
+    try
+    {
+      json::value v (json::parse (p));
+      const json::object& o (v.as_object ());
+
+      uint64_t fv (json::value_to<uint64_t> (o.at ("version")));
+
+      if (fv != format_version)
+        throw invalid_argument ("unsupported release index version " +
+                                std::to_string (fv));
+
+      uint64_t g (json::value_to<uint64_t> (o.at ("generated")));
+
+      if (gen != nullptr)
+        *gen = g;
+
+      for (const auto& [n, ev] : o.at ("repositories").as_object ())
+      {
+        const json::object& eo (ev.as_object ());
+
+        entry e;
+        e.latest = parse_entry_release (eo, "latest");
+
+        if (eo.contains ("latest_prerelease"))
+          e.latest_prerelease = parse_entry_release (eo, "latest_prerelease");
+
+        r.emplace (string (n), move (e));
+      }
+    }
+    catch (const invalid_argument&)
+    {
+      throw;
+    }
+    catch (const exception& e)
+    {
+      throw invalid_argument (string ("malformed release index: ") +
+                              e.what ());
+    }
+
+    return r;
+  }
+
+  string github_index::
+  generate (const entries_type& es, const string& key)
+  {
+    json::object rs;
+
+    for (const auto& [n, e] : es)
+    {
+      json::object o;
+      o["latest"] = github_api_traits::to_json (e.latest);
+
+      if (e.latest_prerelease &&
+          e.latest_prerelease->tag_name != e.latest.tag_name)
+        o["latest_prerelease"] = github_api_traits::to_json (
+          *e.latest_prerelease);
+
+      rs[n] = move (o);
+    }
+
+    json::object po;
+    po["version"] = format_version;
+    po["generated"] = static_cast<uint64_t> (
+      chrono::duration_cast<chrono::seconds> (
+        chrono::system_clock::now ().time_since_epoch ()).count ());
+    po["repositories"] = move (rs);
+
+    string p (json::serialize (po));
+
+    // Sign the exact payload bytes. Note that Ed25519 is used in the "one
+    // shot" mode without a separate digest.
+    //
+    pkey_ptr k (read_private_key (key));
+    md_ctx_ptr c (EVP_MD_CTX_new (), &EVP_MD_CTX_free);
+
+    const auto* pd (reinterpret_cast<const unsigned char*> (p.data ()));
+    size_t n (0);
+
+    if (c == nullptr ||
+        EVP_DigestSignInit (c.get (), nullptr, nullptr, nullptr, k.get ()) != 1 ||
+        EVP_DigestSign (c.get (), nullptr, &n, pd, p.size ()) != 1)
+      throw runtime_error ("unable to sign release index");
+
+    vector<unsigned char> sig (n);
+
+    if (EVP_DigestSign (c.get (), sig.data (), &n, pd, p.size ()) != 1)
+      throw runtime_error ("unable to sign release index");
+
+    json::object o;
+    o["payload"] = p;
+    o["signature"] = to_base64 (sig.data (), n);
+
+    return json::serialize (o);
+  }
+
+  string github_index::
+  public_key (const string& key)
+  {
+    pkey_ptr k (read_private_key (key));
+
+    unsigned char b[32];
+    size_t n (sizeof (b));
+
+    if (EVP_PKEY_get_raw_public_key (k.get (), b, &n) != 1)
+      throw runtime_error ("unable to extract release index public key");
+
+    return to_hex (b, n);
+  }
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+
+#include <boost/asio.hpp>
+#include <boost/json.hpp>
+
+#include <launcher/http/http-client.hxx>
+
+#include <launcher/github/github-types.hxx>
+
+namespace launcher
+{
+  namespace asio = boost::asio;
+  namespace json = boost::json;
+
+  // Static release index.
+  //
+  // A JSON document listing the latest releases (tags, assets, sizes, and
+  // digests) of a set of repositories. It is generated when publishing and
+  // served from a CDN so that discovery becomes a single cacheable GET
+  // instead of a handful of rate-limited API calls, which adds up quickly
+  // when many machines share one public IP.
+  //
+  // Since whoever controls the index controls what we install, the document
+  // is signed with Ed25519:
+  //
+  // {
+  //   "payload": "<index>",
+  //   "signature": "<base64 signature of the payload bytes>"
+  // }
+  //
+  // The payload is itself serialized JSON (we sign the exact bytes and so
+  // don't need to worry about canonicalization):
+  //
+  // {
+  //   "version": 1,
+  //   "generated": <UNIX time>,
+  //   "repositories": {
+  //     "<owner>/<repo>": {
+  //       "latest": <release>,
+  //       "latest_prerelease": <release>
+  //     }
+  //   }
+  // }
+  //
+  // Where releases are in the GitHub API format, "latest" is the newest
+  // stable release, and the optional "latest_prerelease" is the newest
+  // release of any kind (omitted if it is the same).
+  //
+  // A valid signature only tells us that the index was published at some
+  // point, so anyone serving the URL could replay an older one and pin us
+  // to old releases. To prevent this, the caller is expected to remember
+  // the generation time of the index accepted last and pass it back as the
+  // floor next time. Optionally, indexes older than the maximum age are
+  // rejected as well.
+  //
+  class github_index
+  {
+  public:
+    using release_type = github_release;
+
+    struct entry
+    {
+      release_type latest;
+      std::optional<release_type> latest_prerelease;
+    };
+
+    // Keyed by "<owner>/<repo>".
+    //
+    using entries_type = std::map<std::string, entry>;
+
+    static constexpr std::uint64_t format_version = 1;
+
+    // The public key is a hex-encoded raw (32-byte) Ed25519 key.
+    //
+    github_index (asio::io_context& ioc,
+                  std::string url,
+                  std::string public_key);
+
+    github_index (const github_index&) = delete;
+    github_index& operator= (const github_index&) = delete;
+
+    void
+    set_proxy (std::string proxy_url);
+
+    // Reject indexes generated before this time (UNIX time).
+    //
+    void
+    set_floor (std::uint64_t generated);
+
+    // Reject indexes older than this. Zero means no limit.
+    //
+    void
+    set_max_age (std::chrono::seconds age);
+
+    // Return the generation time of the accepted index or 0 if it hasn't
+    // been fetched (or was rejected).
+    //
+    std::uint64_t
+    generated () const noexcept;
+
+    const std::string&
+    url () const noexcept;
+
+    // Return the latest release of owner/repo or nullopt if the index does
+    // not list it.
+    //
+    // The index is fetched and verified on the first call and reused after
+    // that. Throw if it cannot be fetched or fails verification.
+    //
+    asio::awaitable<std::optional<release_type>>
+    find_latest_release (const std::string& owner,
+                         const std::string& repo,
+                         bool include_prerelease);
+
+    // Verify the signed document and return its entries and, if requested,
+    // its generation time. Throw invalid_argument if the signature does not
+    // match or the document is malformed.
+    //
+    static entries_type
+    parse (const std::string& document,
+           const std::string& public_key,
+           std::uint64_t* generated = nullptr);
+
+    // Serialize the entries and sign them with the PEM-encoded Ed25519
+    // private key, returning the document.
+    //
+    static std::string
+    generate (const entries_type& entries, const std::string& private_key);
+
+    // Return the hex-encoded public key corresponding to the PEM-encoded
+    // private key.
+    //
+    static std::string
+    public_key (const std::string& private_key);
+
+  private:
+    asio::io_context& ioc_;
+    std::string url_;
+    std::string key_;
+    http_client_traits traits_;
+    std::optional<entries_type> entries_;
+    std::uint64_t floor_ = 0;
+    std::chrono::seconds max_age_ {0};
+    std::uint64_t generated_ = 0;
+  };
+}
@@ -0,0 +1,331 @@
+#include <launcher/github/github-index.hxx>
+
+#include <launcher/launcher-mock.test.hxx>
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+using namespace std;
+using namespace launcher;
+
+// Whoever controls the release index controls what we install so what we
+// check here is that we only ever accept an index that was signed with our
+// key, was not modified on the way, and is not an older one replayed at us
+// (either older than the one accepted last time or simply too old).
+//
+
+using release = github_index::release_type;
+using entries = github_index::entries_type;
+
+// Generate a fresh Ed25519 key and return it PEM-encoded.
+//
+static string
+private_key ()
+{
+  unique_ptr<EVP_PKEY_CTX, decltype (&EVP_PKEY_CTX_free)> c (
+    EVP_PKEY_CTX_new_id (EVP_PKEY_ED25519, nullptr),
+    &EVP_PKEY_CTX_free);
+
+  EVP_PKEY* k (nullptr);
+  int r (EVP_PKEY_keygen_init (c.get ()));
+
+  if (r == 1)
+    r = EVP_PKEY_keygen (c.get (), &k);
+
+  assert (r == 1 && k != nullptr);
+
+  unique_ptr<BIO, decltype (&BIO_free)> b (BIO_new (BIO_s_mem ()), &BIO_free);
+  r = PEM_write_bio_PrivateKey (b.get (), k, nullptr, nullptr, 0, nullptr, nullptr);
+  assert (r == 1);
+
+  EVP_PKEY_free (k);
+
+  char* d (nullptr);
+  long n (BIO_get_mem_data (b.get (), &d));
+  return string (d, static_cast<size_t> (n));
+}
+
+// Sign an arbitrary payload the way generate() does. This allows us to make
+// documents that generate() would never produce: old, malformed, etc.
+//
+static string
+document (const string& payload, const string& key)
+{
+  unique_ptr<BIO, decltype (&BIO_free)> b (
+    BIO_new_mem_buf (key.data (), static_cast<int> (key.size ())),
+    &BIO_free);
+
+  unique_ptr<EVP_PKEY, decltype (&EVP_PKEY_free)> k (
+    PEM_read_bio_PrivateKey (b.get (), nullptr, nullptr, nullptr),
+    &EVP_PKEY_free);
+
+  unique_ptr<EVP_MD_CTX, decltype (&EVP_MD_CTX_free)> c (EVP_MD_CTX_new (),
+                                                         &EVP_MD_CTX_free);
+
+  const auto* p (reinterpret_cast<const unsigned char*> (payload.data ()));
+
+  unsigned char s[64];
+  size_t n (sizeof (s));
+
+  int r (EVP_DigestSignInit (c.get (), nullptr, nullptr, nullptr, k.get ()));
+
+  if (r == 1)
+    r = EVP_DigestSign (c.get (), s, &n, p, payload.size ());
+
+  assert (r == 1);
+
+  string e (4 * ((n + 2) / 3) + 1, '\0');
+  e.resize (static_cast<size_t> (
+    EVP_EncodeBlock (reinterpret_cast<unsigned char*> (e.data ()),
+                     s,
+                     static_cast<int> (n))));
+
+  json::object o;
+  o["payload"] = payload;
+  o["signature"] = e;
+  return json::serialize (o);
+}
+
+static uint64_t
+now ()
+{
+  return static_cast<uint64_t> (
+    chrono::duration_cast<chrono::seconds> (
+      chrono::system_clock::now ().time_since_epoch ()).count ());
+}
+
+// Index payload generated at the specified time with a single repository.
+//
+static string
+payload (uint64_t generated, const string& tag)
+{
+  json::object l;
+  l["tag_name"] = tag;
+  l["draft"] = false;
+  l["prerelease"] = false;
+
+  json::object r;
+  r["latest"] = move (l);
+
+  json::object rs;
+  rs["iw4x/iw4x-client"] = move (r);
+
+  json::object o;
+  o["version"] = github_index::format_version;
+  o["generated"] = generated;
+  o["repositories"] = move (rs);
+  return json::serialize (o);
+}
+
+static bool
+rejected (const string& doc, const string& key)
+{
+  try
+  {
+    github_index::parse (doc, key);
+    return false;
+  }
+  catch (const invalid_argument&)
+  {
+    return true;
+  }
+}
+
+// Fetch the index from the specified URL and look up the release of owner/
+// repo, returning the release (if listed) and the accepted generation time.
+// Throw if the index is rejected.
+//
+static pair<optional<release>, uint64_t>
+lookup (const string& url,
+        const string& key,
+        const string& repo,
+        bool pre,
+        uint64_t floor = 0,
+        chrono::seconds max_age = chrono::seconds (0))
+{
+  asio::io_context io;
+
+  github_index x (io, url, key);
+  x.set_floor (floor);
+  x.set_max_age (max_age);
+
+  optional<release> r;
+  exception_ptr ep;
+
+  asio::co_spawn (io,
+                  x.find_latest_release ("iw4x", repo, pre),
+                  [&r, &ep] (exception_ptr e, optional<release> v)
+  {
+    ep = e;
+    r = move (v);
+  });
+
+  io.run ();
+
+  if (ep)
+    rethrow_exception (ep);
+
+  return {move (r), x.generated ()};
+}
+
+static bool
+refused (const string& url,
+         const string& key,
+         uint64_t floor,
+         chrono::seconds max_age = chrono::seconds (0))
+{
+  try
+  {
+    lookup (url, key, "iw4x-client", false, floor, max_age);
+    return false;
+  }
+  catch (const exception&)
+  {
+    return true;
+  }
+}
+
+int
+main ()
+{
+  const string sk (private_key ());
+  const string pk (github_index::public_key (sk));
+
+  entries es;
+  {
+    release s {};
+    s.tag_name = "v1.0.0";
+    s.name = "v1.0.0";
+
+    release::asset_type a {};
+    a.name = "release.zip";
+    a.size = 1234;
+    a.digest = "sha256:00ff";
+    a.browser_download_url = "https://example.org/release.zip";
+    s.assets.push_back (a);
+
+    release p {};
+    p.tag_name = "v1.1.0-beta.1";
+    p.name = "v1.1.0-beta.1";
+    p.prerelease = true;
+
+    es["iw4x/iw4x-client"] = {s, p};
+    es["iw4x/iw4x-rawfiles"] = {s, nullopt};
+  }
+
+  const string doc (github_index::generate (es, sk));
+
+  // Round trip.
+  //
+  {
+    uint64_t g (0);
+    entries r (github_index::parse (doc, pk, &g));
+
+    assert (g != 0 && g <= now ());
+    assert (r.size () == 2);
+
+    const auto& c (r.at ("iw4x/iw4x-client"));
+    assert (c.latest.tag_name == "v1.0.0");
+    assert (c.latest.assets.size () == 1);
+    assert (c.latest.assets[0].name == "release.zip");
+    assert (c.latest.assets[0].size == 1234);
+    assert (c.latest.assets[0].digest == "sha256:00ff");
+    assert (c.latest_prerelease &&
+            c.latest_prerelease->tag_name == "v1.1.0-beta.1");
+
+    assert (!r.at ("iw4x/iw4x-rawfiles").latest_prerelease);
+  }
+
+  // Tampered payload: bump the tag while keeping the signature.
+  //
+  {
+    json::value v (json::parse (doc));
+    json::object& o (v.as_object ());
+
+    string p (json::value_to<string> (o.at ("payload")));
+    size_t i (p.find ("v1.0.0"));
+    assert (i != string::npos);
+    p.replace (i, 6, "v9.0.0");
+    o["payload"] = p;
+
+    assert (rejected (json::serialize (v), pk));
+  }
+
+  // Wrong key.
+  //
+  assert (rejected (doc, github_index::public_key (private_key ())));
+
+  // Malformed documents, signed or not.
+  //
+  assert (rejected ("", pk));
+  assert (rejected ("not json", pk));
+  assert (rejected ("{\"payload\": \"{}\"}", pk));
+  assert (rejected ("{\"payload\": \"{}\", \"signature\": 1}", pk));
+  assert (rejected (document ("not json", sk), pk));
+  assert (rejected (document ("{\"version\": 1, \"generated\": 1}", sk), pk));
+  assert (rejected (
+    document ("{\"version\": 2, \"generated\": 1, \"repositories\": {}}", sk),
+    pk));
+
+  // Lookups through the server.
+  //
+  mock_server srv;
+
+  const string url (srv.http_base () + "/cdn/index.json");
+  srv.publish ("index.json", doc);
+
+  {
+    auto [r, g] (lookup (url, pk, "iw4x-client", false));
+    assert (r && r->tag_name == "v1.0.0" && g != 0);
+  }
+
+  {
+    auto [r, g] (lookup (url, pk, "iw4x-client", true));
+    assert (r && r->tag_name == "v1.1.0-beta.1");
+  }
+
+  {
+    auto [r, g] (lookup (url, pk, "iw4x-rawfiles", true));
+    assert (r && r->tag_name == "v1.0.0");
+  }
+
+  assert (!lookup (url, pk, "iw4x-unknown", false).first);
+
+  // Replay of an index older than the one accepted previously.
+  //
+  {
+    const uint64_t t (now () - 600);
+
+    srv.publish ("index.json", document (payload (t, "v0.9.0"), sk));
+
+    assert (refused (url, pk, t + 1));
+
+    auto [r, g] (lookup (url, pk, "iw4x-client", false, t));
+    assert (r && r->tag_name == "v0.9.0" && g == t);
+  }
+
+  // Maximum age.
+  //
+  {
+    srv.publish ("index.json", document (payload (now () - 3600, "v0.8.0"), sk));
+
+    assert (refused (url, pk, 0, chrono::seconds (60)));
+    assert (!refused (url, pk, 0, chrono::seconds (7200)));
+    assert (!refused (url, pk, 0)); // No limit.
+  }
+
+  // An index signed with some other key is refused when fetched as well.
+  //
+  srv.publish ("index.json", github_index::generate (es, private_key ()));
+  assert (refused (url, pk, 0));
+}
@@ -69,6 +69,7 @@ namespace launcher
     std::uint64_t download_count;
     std::string browser_download_url;
     std::string url; // API URL
+    std::string digest; // "sha256:<hex>", if provided
 
     github_asset () = default;
     github_asset (std::string n, std::string u, std::uint64_t s);
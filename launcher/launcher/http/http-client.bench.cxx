@@ -0,0 +1,338 @@
+#ifdef __linux__
+#  include <sys/resource.h>
+#  include <time.h>
+#endif
+
+#include <launcher/http/http-client.hxx>
+#include <launcher/download/download-manager.hxx>
+#include <launcher/download/download-request.hxx>
+
+#include <launcher/launcher-mock.test.hxx>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace launcher;
+
+// HTTP transfer throughput benchmark.
+//
+// Usage: http-client.bench [disk] [ktls] [driver=client|manager]
+//                          [<workload>...]
+//
+// Download a workload (small, medium, large or mixed, all by default) from
+// the loopback mock server sweeping concurrency (1, 4, 16), TLS (off, on),
+// and proxying (none, HTTP, SOCKS5) through the loopback mock proxy. For
+// plain HTTP the HTTP proxy is a forward proxy while for HTTPS it's a
+// CONNECT tunnel.
+//
+// Each combination is driven both by a pool of http_client workers and by
+// download_manager (with max_parallel set to the concurrency) unless
+// restricted with driver=. The response bodies go to /dev/null unless disk
+// is specified in which case they are written to temporary files. If ktls is
+// specified, then TLS is offloaded to the kernel where supported (reported as
+// ktls in the tls column) and the bodies are spliced into the files (which
+// makes sense with disk).
+//
+// For each run we report the throughput (GB/s), request rate (req/s), and
+// CPU seconds per GB, both of the client thread (which is what the launcher
+// pays) and of the whole process (which also includes the server and proxy
+// threads and so is only useful for comparison).
+//
+// Note that everything is in-process and over loopback so the numbers are
+// an upper bound that is dominated by our own per-byte and per-request
+// overhead, which is exactly what we want to measure.
+//
+
+struct workload
+{
+  const char* name;
+  vector<uint64_t> sizes; // One request per entry.
+};
+
+static vector<uint64_t>
+repeat (size_t n, uint64_t s)
+{
+  return vector<uint64_t> (n, s);
+}
+
+static vector<workload>
+workloads ()
+{
+  const uint64_t kib (1024), mib (1024 * kib);
+
+  vector<uint64_t> mx;
+
+  for (size_t i (0); i != 8; ++i)
+  {
+    mx.insert (mx.end (), 64, 16 * kib);
+    mx.push_back (1 * mib);
+  }
+
+  mx.push_back (32 * mib);
+
+  return {
+    {"small",  repeat (1024, 16 * kib)},
+    {"medium", repeat (64, 1 * mib)},
+    {"large",  repeat (4, 32 * mib)},
+    {"mixed",  move (mx)}};
+}
+
+// CPU time in seconds of the calling thread and of the whole process (zero
+// outside Linux).
+//
+struct cpu
+{
+  double thread = 0;
+  double process = 0;
+
+  static cpu
+  sample ()
+  {
+    cpu r;
+
+#ifdef __linux__
+    timespec ts;
+    if (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+      r.thread = ts.tv_sec + ts.tv_nsec / 1e9;
+
+    rusage ru;
+    if (getrusage (RUSAGE_SELF, &ru) == 0)
+      r.process = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+                  ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+#endif
+
+    return r;
+  }
+};
+
+struct run_config
+{
+  const workload* w;
+  size_t concurrency;
+  bool tls;
+  string proxy; // Empty, http, or socks5.
+  bool manager;
+  bool disk;
+  bool ktls;
+};
+
+static fs::path
+sink (const fs::path& work, const run_config& c, size_t i)
+{
+#ifdef _WIN32
+  const char* null ("NUL");
+#else
+  const char* null ("/dev/null");
+#endif
+
+  return c.disk ? work / ("f_" + to_string (i)) : fs::path (null);
+}
+
+static asio::awaitable<void>
+worker (asio::io_context& ioc,
+        const http_client_traits& tr,
+        const vector<string>& us,
+        const fs::path& work,
+        const run_config& c,
+        size_t& next)
+{
+  http_client hc (ioc, tr);
+
+  // Single-threaded io_context so a plain counter will do.
+  //
+  for (size_t i; (i = next++) < us.size (); )
+    co_await hc.download (us[i], sink (work, c, i));
+}
+
+static void
+run (mock_server& srv,
+     mock_proxy& px,
+     const fs::path& work,
+     const run_config& c)
+{
+  const workload& w (*c.w);
+
+  http_client_traits tr;
+  tr.verify_ssl = c.tls;
+  tr.ktls = c.ktls;
+  tr.ssl_cert_file = srv.certificate ().string ();
+
+  if (!c.proxy.empty ())
+    tr.proxy_url = px.url (c.proxy);
+
+  string base (c.tls ? srv.https_base () : srv.http_base ());
+
+  vector<string> us;
+  uint64_t bytes (0);
+
+  for (uint64_t s : w.sizes)
+  {
+    us.push_back (base + "/cdn/" + to_string (s));
+    bytes += s;
+  }
+
+  if (c.disk)
+    fs::create_directories (work);
+
+  asio::io_context ioc;
+
+  auto s0 (srv.stats ());
+  cpu c0 (cpu::sample ());
+  auto t0 (chrono::steady_clock::now ());
+
+  if (c.manager)
+  {
+    download_manager m (ioc, c.concurrency, tr);
+
+    for (size_t i (0); i != us.size (); ++i)
+    {
+      download_request r (us[i], sink (work, c, i));
+      r.resume = false;
+      m.add_task (move (r));
+    }
+
+    asio::co_spawn (ioc, m.download_all (), asio::detached);
+    ioc.run ();
+
+    if (m.failed_count () != 0)
+      throw runtime_error (to_string (m.failed_count ()) + " downloads failed");
+  }
+  else
+  {
+    size_t next (0);
+    exception_ptr ep;
+
+    for (size_t i (0); i != c.concurrency; ++i)
+      asio::co_spawn (ioc,
+                      worker (ioc, tr, us, work, c, next),
+                      [&ep] (exception_ptr e) {if (e && !ep) ep = e;});
+
+    ioc.run ();
+
+    if (ep)
+      rethrow_exception (ep);
+  }
+
+  double d (
+    chrono::duration<double> (chrono::steady_clock::now () - t0).count ());
+  cpu c1 (cpu::sample ());
+  auto s1 (srv.stats ());
+
+  if (s1.bytes - s0.bytes != bytes)
+    throw runtime_error ("transferred " + to_string (s1.bytes - s0.bytes) +
+                         " bytes instead of " + to_string (bytes));
+
+  double gb (bytes / 1e9);
+
+  cout << setw (8)  << w.name
+       << setw (9)  << (c.manager ? "manager" : "client")
+       << setw (5)  << c.concurrency
+       << setw (6)  << (c.tls ? (c.ktls ? "ktls" : "on") : "off")
+       << setw (8)  << (c.proxy.empty () ? "none" : c.proxy.c_str ())
+       << setw (10) << fixed << setprecision (1) << d * 1000
+       << setw (9)  << fixed << setprecision (3) << gb / d
+       << setw (10) << fixed << setprecision (0) << us.size () / d
+       << setw (12) << fixed << setprecision (3)
+                    << (c1.thread - c0.thread) / gb
+       << setw (12) << fixed << setprecision (3)
+                    << (c1.process - c0.process) / gb
+       << endl;
+
+  if (c.disk)
+    fs::remove_all (work);
+}
+
+int
+main (int argc, char* argv[])
+{
+  bool disk (false);
+  bool ktls (false);
+  vector<bool> drivers {false, true};
+  vector<string> names;
+
+  for (int i (1); i < argc; ++i)
+  {
+    string a (argv[i]);
+
+    if (a == "disk")
+      disk = true;
+    else if (a == "ktls")
+      ktls = true;
+    else if (a == "driver=client")
+      drivers = {false};
+    else if (a == "driver=manager")
+      drivers = {true};
+    else if (a.find ('=') == string::npos)
+      names.push_back (a);
+    else
+    {
+      cerr << "error: unknown argument '" << a << "'" << endl;
+      return 1;
+    }
+  }
+
+  vector<workload> ws (workloads ());
+  fs::path work (fs::temp_directory_path () / "iw4x-http-bench");
+
+  cout << setw (8)  << "load"
+       << setw (9)  << "driver"
+       << setw (5)  << "conc"
+       << setw (6)  << "tls"
+       << setw (8)  << "proxy"
+       << setw (10) << "time (ms)"
+       << setw (9)  << "GB/s"
+       << setw (10) << "req/s"
+       << setw (12) << "cpu/GB (s)"
+       << setw (12) << "proc/GB (s)"
+       << endl;
+
+  try
+  {
+    mock_server srv;
+    mock_proxy px;
+
+    // Publish one object per distinct size, named after it.
+    //
+    set<uint64_t> ss;
+
+    for (const workload& w : ws)
+      ss.insert (w.sizes.begin (), w.sizes.end ());
+
+    for (uint64_t s : ss)
+      srv.publish (to_string (s), string (s, 'x'));
+
+    for (const workload& w : ws)
+    {
+      if (!names.empty () &&
+          find (names.begin (), names.end (), w.name) == names.end ())
+        continue;
+
+      for (bool m : drivers)
+      for (size_t n : {1, 4, 16})
+      for (bool tls : {false, true})
+      for (const char* p : {"", "http", "socks5"})
+        run (srv, px, work, run_config {&w, n, tls, p, m, disk, ktls});
+    }
+  }
+  catch (const exception& e)
+  {
+    cerr << "error: " << e.what () << endl;
+    return 1;
+  }
+
+  error_code ec;
+  fs::remove_all (work, ec);
+
+  return 0;
+}
@@ -1,3 +1,8 @@
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
 #include <launcher/http/http-client.hxx>
 
 #include <filesystem>
@@ -19,6 +24,15 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+// Kernel TLS offload (see http_client_traits::ktls) requires OpenSSL 3 built
+// with kTLS support.
+//
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#  define LAUNCHER_KTLS 1
+#else
+#  define LAUNCHER_KTLS 0
+#endif
+
 using namespace std;
 
 namespace launcher
@@ -42,6 +56,15 @@ namespace launcher
   //
   constexpr size_t download_buffer_size  = 8192;
 
+  // Size of the pipe used when splicing download bodies (see ktls_stream).
+  //
+  constexpr size_t splice_pipe_size      = 1024 * 1024;
+
+  // Maximum redirect response body we read out in order to reuse the
+  // connection.
+  //
+  constexpr uint64_t redirect_drain_limit = 64 * 1024;
+
   namespace
   {
     struct url_parts
@@ -273,9 +296,17 @@ namespace launcher
       stream.expires_after (request_timeout);
       co_await http_beast::async_write (stream, creq, asio::use_awaitable);
 
+      // Note that a successful reply to CONNECT has no body even though it
+      // normally comes without Content-Length (RFC 9110 9.3.6). Left to its
+      // own devices the parser would wait for the proxy to close the
+      // connection so tell it to stop after the header.
+      //
       beast::flat_buffer buf;
-      http_beast::response<http_beast::empty_body> cres;
-      co_await http_beast::async_read (stream, buf, cres, asio::use_awaitable);
+      http_beast::response_parser<http_beast::empty_body> cp;
+      cp.skip (true);
+      co_await http_beast::async_read (stream, buf, cp, asio::use_awaitable);
+
+      const auto& cres (cp.get ());
 
       if (cres.result () != http_beast::status::ok)
         throw runtime_error (
@@ -478,232 +509,1081 @@ namespace launcher
       co_await asio::async_read (
         stream, asio::buffer (sink), asio::use_awaitable);
     }
-  }
-
-  http_session::
-  http_session (asio::io_context& c, const http_client_traits& t)
-    : ioc_ (c),
-      traits_ (t),
-      ssl_ctx_ (ssl::context::tlsv12_client)
-  {
-    configure_ssl ();
-  }
 
-  void http_session::
-  configure_ssl ()
-  {
-    // Load certificates if provided, otherwise fallback to defaults.
+    // Connect the stream to the origin, directly or through the proxy, if
+    // any. If tunnel is false, then for an HTTP proxy we only connect to the
+    // proxy itself, in which case return true to indicate that the request
+    // target must be an absolute URI.
     //
-    if (!traits_.ssl_cert_file.empty ())
-      ssl_ctx_.load_verify_file (traits_.ssl_cert_file);
-    else
-      ssl_ctx_.set_default_verify_paths ();
+    asio::awaitable<bool>
+    connect_origin (beast::tcp_stream& s,
+                    asio::io_context& c,
+                    const http_client_traits& t,
+                    const url_parts& p,
+                    bool tunnel)
+    {
+      bool r (false);
 
-    // Toggle peer verification based on traits.
-    //
-    ssl_ctx_.set_verify_mode (
-      traits_.verify_ssl ? ssl::verify_peer : ssl::verify_none);
+      if (!t.proxy_url.empty ())
+      {
+        url_parts pp (parse_proxy_url (t.proxy_url));
 
-    // Apply standard security workarounds and disable old protocols.
-    //
-    ssl_ctx_.set_options (ssl::context::default_workarounds |
-                          ssl::context::no_sslv2 |
-                          ssl::context::no_sslv3 |
-                          ssl::context::single_dh_use);
+        if (is_socks_proxy (pp))
+        {
+          co_await socks5_connect (s, c, pp, t.proxy_url,
+                                   p.host, p.port,
+                                   t.connect_timeout, t.request_timeout);
+        }
+        else if (tunnel)
+        {
+          co_await proxy_connect (s, c, pp, p.host, p.port,
+                                  t.connect_timeout, t.request_timeout);
+        }
+        else
+        {
+          tcp::resolver rv (c);
+          auto as (co_await rv.async_resolve (
+            pp.host, pp.port, asio::use_awaitable));
 
-    SSL_CTX_set_tlsext_servername_callback (
-      ssl_ctx_.native_handle (), nullptr);
-  }
+          s.expires_after (t.connect_timeout);
+          co_await s.async_connect (as, asio::use_awaitable);
 
-  http_client::
-  http_client (asio::io_context& c)
-    : session_ (c, http_client_traits ())
-  {
-  }
+          r = true;
+        }
+      }
+      else
+      {
+        tcp::resolver rv (c);
+        auto as (co_await rv.async_resolve (
+          p.host, p.port, asio::use_awaitable));
 
-  http_client::
-  http_client (asio::io_context& c, const http_client_traits& t)
-    : session_ (c, t)
-  {
-  }
+        s.expires_after (t.connect_timeout);
+        co_await s.async_connect (as, asio::use_awaitable);
+      }
 
-  asio::awaitable<http_response> http_client::
-  get (const string& u)
-  {
-    http_request rq (http_method::get, u);
-    rq.normalize ();
-    co_return co_await request (rq);
-  }
+      co_return r;
+    }
 
-  asio::awaitable<http_response> http_client::
-  post (const string& u, const string& b, const string& ct)
-  {
-    http_request rq (http_method::post, u);
-    rq.set_content_type (ct);
-    rq.set_body (b);
-    rq.normalize ();
-    co_return co_await request (rq);
-  }
+    void
+    set_sni (beast::ssl_stream<beast::tcp_stream>& s, const string& h)
+    {
+      if (!SSL_set_tlsext_host_name (s.native_handle (), h.c_str ()))
+      {
+        beast::error_code ec (
+          static_cast<int> (::ERR_get_error ()),
+          asio::error::get_ssl_category ());
 
-  asio::awaitable<http_response> http_client::
-  put (const string& u, const string& b, const string& ct)
-  {
-    http_request rq (http_method::put, u);
-    rq.set_content_type (ct);
-    rq.set_body (b);
-    rq.normalize ();
-    co_return co_await request (rq);
-  }
+        throw beast::system_error (ec, "failed to set SNI hostname");
+      }
+    }
 
-  asio::awaitable<http_response> http_client::
-  delete_ (const string& u)
-  {
-    http_request rq (http_method::delete_, u);
-    rq.normalize ();
-    co_return co_await request (rq);
-  }
+    // Pool key for the URL's origin.
+    //
+    string
+    origin (const url_parts& p)
+    {
+      return p.scheme + "://" + p.host + ':' + p.port;
+    }
 
-  asio::awaitable<http_response> http_client::
-  head (const string& u)
-  {
-    http_request rq (http_method::head, u);
-    rq.normalize ();
-    co_return co_await request (rq);
-  }
+    // Return true if an idle connection still looks usable, that is, the
+    // peer hasn't closed it. Note that we may legitimately have something
+    // to read on an idle TLS connection (TLS 1.3 session tickets, etc).
+    //
+    bool
+    idle_alive (tcp::socket& s)
+    {
+      if (!s.is_open ())
+        return false;
 
-  asio::awaitable<http_response> http_client::
-  request (const http_request& rq)
-  {
-    validate_proxy_url (session_.traits ().proxy_url);
-    co_return co_await request_impl (rq, 0);
-  }
+      beast::error_code ec;
+      s.non_blocking (true, ec);
 
-  asio::awaitable<http_response> http_client::
-  request_impl (http_request rq, uint8_t rc)
-  {
-    const auto& t (session_.traits ());
+      char b;
+      size_t n (s.receive (asio::buffer (&b, 1), tcp::socket::message_peek, ec));
+      bool r (ec == asio::error::would_block || (!ec && n != 0));
 
-    // Bail out if we're caught in a redirect loop.
-    //
-    if (rc >= t.max_redirects)
-      throw runtime_error ("maximum redirects exceeded");
+      beast::error_code e;
+      s.non_blocking (false, e);
 
-    url_parts p (parse_url (rq.url));
-    bool s (p.scheme == "https");
+      return r;
+    }
 
-    http_response rs (s ? co_await request_ssl (rq) : co_await request_tcp (rq));
+    http_client_traits
+    unpooled (http_client_traits t)
+    {
+      t.pool.reset ();
+      return t;
+    }
 
-    if (t.follow_redirects && rs.is_redirection ())
+    // Return the (percent-decoded) value of the URL query parameter or
+    // nullopt if there is no such parameter.
+    //
+    optional<string>
+    query_param (const string& u, const string& n)
     {
-      auto l (rs.location ());
+      size_t q (u.find ('?'));
 
-      if (l)
+      if (q == string::npos)
+        return nullopt;
+
+      size_t e (u.find ('#', q));
+      if (e == string::npos)
+        e = u.size ();
+
+      for (size_t b (q + 1); b < e; )
       {
-        http_request n (rq.method, *l, rq.version);
-        n.headers = rq.headers;
+        size_t a (u.find ('&', b));
+        if (a == string::npos || a > e)
+          a = e;
 
-        url_parts np (parse_url (*l));
-        n.set_header ("Host", np.host);
+        size_t eq (u.find ('=', b));
 
-        // Downgrade POST/PUT to GET on 303 See Other.
-        //
-        if (rs.status == http_status::see_other)
+        if (eq < a && eq - b == n.size () && u.compare (b, eq - b, n) == 0)
         {
-          if (rq.method == http_method::post || rq.method == http_method::put)
+          string r;
+
+          for (size_t i (eq + 1); i < a; ++i)
           {
-            n.method = http_method::get;
-            n.body = nullopt;
+            char c (u[i]);
+
+            if (c == '%' && i + 2 < a &&
+                isxdigit (static_cast<unsigned char> (u[i + 1])) &&
+                isxdigit (static_cast<unsigned char> (u[i + 2])))
+            {
+              r += static_cast<char> (stoi (u.substr (i + 1, 2), nullptr, 16));
+              i += 2;
+            }
+            else
+              r += (c == '+' ? ' ' : c);
           }
+
+          return r;
         }
 
-        n.normalize ();
-        co_return co_await request_impl (move (n), rc + 1);
+        b = a + 1;
       }
-    }
-
-    co_return rs;
-  }
-
-  asio::awaitable<http_response> http_client::
-  request_ssl (const http_request& rq)
-  {
-    using stream = beast::ssl_stream<beast::tcp_stream>;
-    using beast_req = http_beast::request<http_beast::string_body>;
-    using beast_res = http_beast::response<http_beast::string_body>;
-
-    auto& c (session_.io_context ());
-    auto& x (session_.ssl_context ());
-    const auto& t (session_.traits ());
-
-    url_parts p (parse_url (rq.url));
 
-    stream s (c, x);
+      return nullopt;
+    }
 
-    // Configure SNI for TLS.
+    // Parse a UTC timestamp in the ISO 8601 basic (20250102T030405Z) or
+    // extended (2025-01-02T03:04:05Z) format. The time may be omitted, in
+    // which case it is midnight.
     //
-    if (!SSL_set_tlsext_host_name (s.native_handle (), p.host.c_str ()))
+    optional<chrono::system_clock::time_point>
+    parse_utc (const string& s)
     {
-      int e (static_cast<int> (::ERR_get_error ()));
-      beast::error_code ec (e, asio::error::get_ssl_category ());
-      throw beast::system_error (ec, "failed to set SNI hostname");
-    }
+      using namespace chrono;
 
-    auto& l (beast::get_lowest_layer (s));
+      string d;
+      for (char c : s)
+      {
+        if (c >= '0' && c <= '9')
+          d += c;
+        else if (c != '-' && c != ':' && c != 'T' && c != 'Z')
+          return nullopt;
+      }
 
-    if (!t.proxy_url.empty ())
-    {
-      // Tunnel through the proxy, then TLS-handshake.
-      //
-      url_parts pp (parse_proxy_url (t.proxy_url));
+      if (d.size () == 8)
+        d += "000000";
 
-      if (is_socks_proxy (pp))
-        co_await socks5_connect (l, c, pp, t.proxy_url,
-                                 p.host, p.port,
-                                 t.connect_timeout, t.request_timeout);
-      else
-        co_await proxy_connect (l, c, pp, p.host, p.port,
-                                t.connect_timeout, t.request_timeout);
-    }
-    else
-    {
-      tcp::resolver rv (c);
-      auto as (co_await rv.async_resolve (
-        p.host, p.port, asio::use_awaitable));
+      if (d.size () != 14)
+        return nullopt;
 
-      l.expires_after (t.connect_timeout);
-      co_await l.async_connect (as, asio::use_awaitable);
-    }
+      auto n ([&d] (size_t p, size_t l) {return stoi (d.substr (p, l));});
 
-    // Establish the connection and perform the handshake.
-    //
-    co_await s.async_handshake (ssl::stream_base::client, asio::use_awaitable);
+      year_month_day ymd (year (n (0, 4)),
+                          month (static_cast<unsigned> (n (4, 2))),
+                          day (static_cast<unsigned> (n (6, 2))));
 
-    beast_req br;
-    br.method (to_beast_verb (rq.method));
-    br.target (rq.target ());
-    br.version (rq.version.major * 10 + rq.version.minor);
+      if (!ymd.ok ())
+        return nullopt;
 
-    for (const auto& h : rq.headers)
-      br.set (h.name, h.value);
+      return sys_days (ymd) +
+             hours (n (8, 2)) + minutes (n (10, 2)) + seconds (n (12, 2));
+    }
 
-    // Assign body if it exists.
+#if LAUNCHER_KTLS
+    // A client TLS connection that OpenSSL drives directly over the socket
+    // (rather than through memory BIOs like ssl::stream does) so that it can
+    // hand the record layer over to the kernel (kTLS) once the handshake is
+    // done. Whether that actually happens depends on the kernel and the
+    // negotiated cipher; if not, this is just userspace TLS.
     //
-    if (rq.body)
+    // We implement just enough of AsyncReadStream and AsyncWriteStream for
+    // Beast. Similar to beast::tcp_stream, the timeout set with
+    // expires_after() applies to all the subsequent operations.
+    //
+    class ktls_stream
     {
-      br.body () = *rq.body;
-      br.prepare_payload ();
-    }
+    public:
+      using executor_type = tcp::socket::executor_type;
 
-    l.expires_after (t.request_timeout);
+      ktls_stream (tcp::socket& s, ssl::context& c, const string& host)
+        : sock_ (s),
+          timer_ (s.get_executor ()),
+          state_ (make_shared<state> ())
+      {
+        state_->sock = &s;
 
-    // Dispatch the request.
-    //
-    co_await http_beast::async_write (s, br, asio::use_awaitable);
+        ssl_ = SSL_new (c.native_handle ());
 
-    beast::flat_buffer b;
-    beast_res bres;
+        if (ssl_ == nullptr ||
+            SSL_set_fd (ssl_, static_cast<int> (s.native_handle ())) != 1 ||
+            SSL_set_tlsext_host_name (ssl_, host.c_str ()) != 1)
+        {
+          beast::error_code ec (static_cast<int> (::ERR_get_error ()),
+                                asio::error::get_ssl_category ());
 
-    // Read the response back.
+          SSL_free (ssl_);
+          throw beast::system_error (ec, "failed to setup TLS connection");
+        }
+
+        SSL_set_options (ssl_, SSL_OP_ENABLE_KTLS);
+        s.non_blocking (true);
+      }
+
+      ~ktls_stream ()
+      {
+        state_->sock = nullptr;
+        timer_.cancel ();
+        SSL_free (ssl_);
+
+        for (int fd : {pipe_[0], pipe_[1], file_})
+        {
+          if (fd != -1)
+            ::close (fd);
+        }
+      }
+
+      ktls_stream (const ktls_stream&) = delete;
+      ktls_stream& operator= (const ktls_stream&) = delete;
+
+      executor_type
+      get_executor () noexcept
+      {
+        return sock_.get_executor ();
+      }
+
+      void
+      expires_after (chrono::steady_clock::duration d)
+      {
+        uint64_t g (++state_->generation);
+        state_->expired = false;
+
+        timer_.expires_after (d);
+        timer_.async_wait ([s = state_, g] (const boost::system::error_code& e)
+        {
+          if (!e && s->generation == g && s->sock != nullptr)
+          {
+            s->expired = true;
+            s->sock->cancel ();
+          }
+        });
+      }
+
+      asio::awaitable<void>
+      handshake ()
+      {
+        for (;;)
+        {
+          ERR_clear_error ();
+          int r (SSL_connect (ssl_));
+
+          if (r == 1)
+            break;
+
+          int e (SSL_get_error (ssl_, r));
+
+          if (e == SSL_ERROR_WANT_READ)
+            co_await wait (tcp::socket::wait_read);
+          else if (e == SSL_ERROR_WANT_WRITE)
+            co_await wait (tcp::socket::wait_write);
+          else
+            throw beast::system_error (error (e), "TLS handshake failed");
+        }
+      }
+
+      // Return true if the kernel does the decryption.
+      //
+      bool
+      ktls_recv () const
+      {
+        return BIO_get_ktls_recv (SSL_get_rbio (ssl_));
+      }
+
+      // Return the number of decrypted bytes buffered by OpenSSL.
+      //
+      size_t
+      pending () const
+      {
+        return static_cast<size_t> (SSL_pending (ssl_));
+      }
+
+      template <typename B, typename T>
+      auto
+      async_read_some (const B& b, T&& t)
+      {
+        asio::mutable_buffer m (*asio::buffer_sequence_begin (b));
+
+        return io ([this, m] ()
+                   {
+                     return SSL_read (ssl_, m.data (), clamp (m.size ()));
+                   },
+                   std::forward<T> (t));
+      }
+
+      template <typename B, typename T>
+      auto
+      async_write_some (const B& b, T&& t)
+      {
+        asio::const_buffer m (*asio::buffer_sequence_begin (b));
+
+        return io ([this, m] ()
+                   {
+                     return SSL_write (ssl_, m.data (), clamp (m.size ()));
+                   },
+                   std::forward<T> (t));
+      }
+
+      // Move up to n bytes of application data from the connection into the
+      // file at the specified offset without them ever entering userspace.
+      // Return the number of bytes moved.
+      //
+      // Only valid if the kernel does the decryption and nothing is pending.
+      //
+      asio::awaitable<size_t>
+      splice (const fs::path& f, uint64_t off, uint64_t n)
+      {
+        if (file_ == -1)
+        {
+          file_ = ::open (f.c_str (), O_RDWR | O_CLOEXEC);
+
+          if (file_ == -1)
+            throw system_error (errno, generic_category (),
+                                "failed to open file for writing");
+        }
+
+        if (pipe_[0] == -1)
+        {
+          if (::pipe2 (pipe_, O_CLOEXEC | O_NONBLOCK) != 0)
+            throw system_error (errno, generic_category (),
+                                "failed to create pipe");
+
+          // Best effort: the larger the pipe, the fewer the round trips.
+          //
+          ::fcntl (pipe_[1], F_SETPIPE_SZ, static_cast<int> (splice_pipe_size));
+        }
+
+        // Note that the kernel fails with EINVAL if the next record is not
+        // application data (say, an alert), which we don't expect in the
+        // middle of a body.
+        //
+        ssize_t r;
+        for (;;)
+        {
+          r = ::splice (static_cast<int> (sock_.native_handle ()), nullptr,
+                        pipe_[1], nullptr,
+                        static_cast<size_t> (
+                          min<uint64_t> (n, splice_pipe_size)),
+                        SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+          if (r > 0)
+            break;
+
+          if (r == 0)
+            throw beast::system_error (asio::ssl::error::stream_truncated);
+
+          if (errno == EINTR)
+            continue;
+
+          if (errno != EAGAIN)
+            throw system_error (errno, generic_category (),
+                                "failed to splice from socket");
+
+          co_await wait (tcp::socket::wait_read);
+        }
+
+        loff_t o (static_cast<loff_t> (off));
+
+        for (size_t k (static_cast<size_t> (r)); k != 0; )
+        {
+          ssize_t w (::splice (pipe_[0], nullptr, file_, &o, k, SPLICE_F_MOVE));
+
+          if (w < 0 && errno == EINTR)
+            continue;
+
+          if (w <= 0)
+            throw system_error (errno, generic_category (),
+                                "failed to splice to file");
+
+          k -= static_cast<size_t> (w);
+        }
+
+        co_return static_cast<size_t> (r);
+      }
+
+      // Feed n bytes of the file starting at the specified offset to the
+      // hasher, reading them through the specified buffer. Meant for what
+      // was just spliced and so is still in the page cache.
+      //
+      void
+      hash (blake3_hasher& h, uint64_t off, uint64_t n, char* b, size_t bn)
+      {
+        while (n != 0)
+        {
+          ssize_t r (::pread (file_,
+                              b,
+                              static_cast<size_t> (min<uint64_t> (n, bn)),
+                              static_cast<off_t> (off)));
+
+          if (r < 0 && errno == EINTR)
+            continue;
+
+          if (r <= 0)
+            throw system_error (r < 0 ? errno : EIO, generic_category (),
+                                "failed to read spliced data back");
+
+          blake3_hasher_update (&h, b, static_cast<size_t> (r));
+
+          off += static_cast<uint64_t> (r);
+          n -= static_cast<uint64_t> (r);
+        }
+      }
+
+    private:
+      // The part shared with the timer handler which can outlive us.
+      //
+      struct state
+      {
+        tcp::socket* sock = nullptr;
+        uint64_t generation = 0;
+        bool expired = false;
+      };
+
+      static int
+      clamp (size_t n)
+      {
+        return static_cast<int> (
+          min<size_t> (n, static_cast<size_t> (numeric_limits<int>::max ())));
+      }
+
+      // Map an OpenSSL failure to an error code the way ssl::stream does.
+      //
+      static boost::system::error_code
+      error (int e)
+      {
+        unsigned long x (ERR_peek_error ());
+
+        switch (e)
+        {
+        case SSL_ERROR_ZERO_RETURN:
+          return asio::error::eof;
+        case SSL_ERROR_SYSCALL:
+          if (x == 0)
+            return errno != 0
+              ? boost::system::error_code (errno,
+                                           boost::system::system_category ())
+              : boost::system::error_code (asio::ssl::error::stream_truncated);
+          break;
+        }
+
+        if (ERR_GET_REASON (x) == SSL_R_UNEXPECTED_EOF_WHILE_READING)
+          return asio::ssl::error::stream_truncated;
+
+        return boost::system::error_code (static_cast<int> (x),
+                                          asio::error::get_ssl_category ());
+      }
+
+      asio::awaitable<void>
+      wait (tcp::socket::wait_type w)
+      {
+        boost::system::error_code ec;
+
+        if (!state_->expired)
+          co_await sock_.async_wait (
+            w, asio::redirect_error (asio::use_awaitable, ec));
+
+        if (state_->expired)
+          ec = beast::error::timeout;
+
+        if (ec)
+          throw beast::system_error (ec);
+      }
+
+      // Retry the OpenSSL operation until it succeeds or fails, waiting for
+      // the socket as requested by OpenSSL in between.
+      //
+      // Note that we never complete from within the initiating function (we
+      // start by posting) since that would make a streaming read recursive.
+      //
+      template <typename F, typename T>
+      auto
+      io (F f, T&& t)
+      {
+        return asio::async_compose<T, void (boost::system::error_code,
+                                            size_t)> (
+          [this, f, st = false] (auto& self,
+                                 boost::system::error_code ec = {}) mutable
+          {
+            if (!st)
+            {
+              st = true;
+              asio::post (sock_.get_executor (), std::move (self));
+              return;
+            }
+
+            if (state_->expired)
+              ec = beast::error::timeout;
+
+            if (ec)
+            {
+              self.complete (ec, 0);
+              return;
+            }
+
+            ERR_clear_error ();
+            int r (f ());
+
+            if (r > 0)
+            {
+              self.complete (ec, static_cast<size_t> (r));
+              return;
+            }
+
+            int e (SSL_get_error (ssl_, r));
+
+            if (e == SSL_ERROR_WANT_READ)
+              sock_.async_wait (tcp::socket::wait_read, std::move (self));
+            else if (e == SSL_ERROR_WANT_WRITE)
+              sock_.async_wait (tcp::socket::wait_write, std::move (self));
+            else
+              self.complete (error (e), 0);
+          },
+          t,
+          sock_);
+      }
+
+      tcp::socket& sock_;
+      asio::steady_timer timer_;
+      shared_ptr<state> state_;
+      SSL* ssl_ = nullptr;
+      int pipe_[2] = {-1, -1};
+      int file_ = -1;
+    };
+#endif
+  }
+
+  http_session::
+  http_session (asio::io_context& c, const http_client_traits& t)
+    : ioc_ (c),
+      traits_ (t),
+      ssl_ctx_ (ssl::context::tlsv12_client)
+  {
+    configure_ssl ();
+  }
+
+  void http_session::
+  configure_ssl ()
+  {
+    // Load certificates if provided, otherwise fallback to defaults.
+    //
+    if (!traits_.ssl_cert_file.empty ())
+      ssl_ctx_.load_verify_file (traits_.ssl_cert_file);
+    else
+      ssl_ctx_.set_default_verify_paths ();
+
+    // Toggle peer verification based on traits.
+    //
+    ssl_ctx_.set_verify_mode (
+      traits_.verify_ssl ? ssl::verify_peer : ssl::verify_none);
+
+    // Apply standard security workarounds and disable old protocols.
+    //
+    ssl_ctx_.set_options (ssl::context::default_workarounds |
+                          ssl::context::no_sslv2 |
+                          ssl::context::no_sslv3 |
+                          ssl::context::single_dh_use);
+
+    SSL_CTX_set_tlsext_servername_callback (
+      ssl_ctx_.native_handle (), nullptr);
+  }
+
+  http_pool::
+  http_pool (asio::io_context& c,
+             const http_client_traits& t,
+             chrono::steady_clock::duration it)
+      : session_ (c, unpooled (t)),
+        idle_timeout_ (it),
+        timer_ (c)
+  {
+  }
+
+  void http_pool::
+  warm (const string& u, size_t n)
+  {
+    url_parts p (parse_url (u));
+    string o (origin (p));
+
+    auto size ([&o] (const auto& m) -> size_t
+    {
+      auto i (m.find (o));
+      return i != m.end () ? i->second.size () : 0;
+    });
+
+    size_t& k (connecting_[o]);
+
+    for (size_t h ((p.scheme == "https" ? size (ssl_) : size (tcp_)) + k);
+         h < n;
+         ++h)
+    {
+      ++k;
+
+      asio::co_spawn (session_.io_context (),
+                      [self = shared_from_this (), u] ()
+                      {
+                        return self->connect (u);
+                      },
+                      asio::detached);
+    }
+  }
+
+  asio::awaitable<void> http_pool::
+  connect (string u)
+  {
+    auto& c (session_.io_context ());
+    const auto& t (session_.traits ());
+
+    url_parts p (parse_url (u));
+    string o (origin (p));
+
+    try
+    {
+      if (p.scheme == "https")
+      {
+        auto s (make_unique<ssl_stream> (c, session_.ssl_context ()));
+        set_sni (*s, p.host);
+
+        auto& l (beast::get_lowest_layer (*s));
+        co_await connect_origin (l, c, t, p, true /* tunnel */);
+
+        l.expires_after (t.connect_timeout);
+        co_await s->async_handshake (ssl::stream_base::client,
+                                     asio::use_awaitable);
+        l.expires_never ();
+
+        put (ssl_, o, move (s));
+      }
+      else
+      {
+        auto s (make_unique<tcp_stream> (c));
+
+        // Note that a connection to an HTTP proxy is also good for any
+        // origin but we don't bother.
+        //
+        co_await connect_origin (*s, c, t, p, false /* tunnel */);
+        s->expires_never ();
+
+        put (tcp_, o, move (s));
+      }
+    }
+    catch (const exception&)
+    {
+      // Speculative, so ignore.
+    }
+
+    --connecting_[o];
+  }
+
+  unique_ptr<http_pool::ssl_stream> http_pool::
+  take_ssl (const string& u)
+  {
+    return take (ssl_, origin (parse_url (u)));
+  }
+
+  unique_ptr<http_pool::tcp_stream> http_pool::
+  take_tcp (const string& u)
+  {
+    return take (tcp_, origin (parse_url (u)));
+  }
+
+  void http_pool::
+  put (const string& u, unique_ptr<ssl_stream> s)
+  {
+    put (ssl_, origin (parse_url (u)), move (s));
+  }
+
+  void http_pool::
+  put (const string& u, unique_ptr<tcp_stream> s)
+  {
+    put (tcp_, origin (parse_url (u)), move (s));
+  }
+
+  size_t http_pool::
+  idle () const
+  {
+    size_t r (0);
+
+    for (const auto& [o, es] : ssl_)
+      r += es.size ();
+
+    for (const auto& [o, es] : tcp_)
+      r += es.size ();
+
+    return r;
+  }
+
+  template <typename S>
+  unique_ptr<S> http_pool::
+  take (map<S>& m, const string& o)
+  {
+    auto i (m.find (o));
+
+    if (i == m.end ())
+      return nullptr;
+
+    // Take the most recently returned connection, which is the least likely
+    // to have been closed by the server, discarding any that are no longer
+    // usable.
+    //
+    auto now (chrono::steady_clock::now ());
+
+    for (auto& es (i->second); !es.empty (); )
+    {
+      entry<S> e (move (es.back ()));
+      es.pop_back ();
+
+      if (e.expires > now &&
+          idle_alive (beast::get_lowest_layer (*e.stream).socket ()))
+        return move (e.stream);
+    }
+
+    return nullptr;
+  }
+
+  template <typename S>
+  void http_pool::
+  put (map<S>& m, const string& o, unique_ptr<S> s)
+  {
+    auto e (chrono::steady_clock::now () + idle_timeout_);
+    m[o].push_back (entry<S> {move (s), e});
+
+    if (!scheduled_)
+      schedule (e);
+  }
+
+  void http_pool::
+  sweep ()
+  {
+    auto now (chrono::steady_clock::now ());
+    auto next (chrono::steady_clock::time_point::max ());
+
+    auto prune ([now, &next] (auto& m)
+    {
+      for (auto i (m.begin ()); i != m.end (); )
+      {
+        auto& es (i->second);
+        erase_if (es, [now] (const auto& e) {return e.expires <= now;});
+
+        // Entries are added in the expiration order.
+        //
+        if (!es.empty ())
+          next = min (next, es.front ().expires);
+
+        i = es.empty () ? m.erase (i) : std::next (i);
+      }
+    });
+
+    prune (ssl_);
+    prune (tcp_);
+
+    if (next != chrono::steady_clock::time_point::max ())
+      schedule (next);
+  }
+
+  void http_pool::
+  schedule (chrono::steady_clock::time_point t)
+  {
+    scheduled_ = true;
+    timer_.expires_at (t);
+    timer_.async_wait ([w = weak_from_this ()] (const beast::error_code& ec)
+    {
+      if (auto self = w.lock ())
+      {
+        self->scheduled_ = false;
+
+        if (!ec)
+          self->sweep ();
+      }
+    });
+  }
+
+  optional<string> http_redirect_cache::
+  find (const string& u)
+  {
+    auto i (map_.find (u));
+
+    if (i == map_.end ())
+      return nullopt;
+
+    if (i->second.expires <= chrono::system_clock::now ())
+    {
+      map_.erase (i);
+      return nullopt;
+    }
+
+    return i->second.target;
+  }
+
+  bool http_redirect_cache::
+  insert (const string& u, const string& t)
+  {
+    optional<chrono::system_clock::time_point> e (signature_expiry (t));
+
+    if (!e)
+      return false;
+
+    *e -= expiry_margin;
+
+    if (*e <= chrono::system_clock::now ())
+      return false;
+
+    map_[u] = entry {t, *e};
+    return true;
+  }
+
+  void http_redirect_cache::
+  erase (const string& u)
+  {
+    map_.erase (u);
+  }
+
+  optional<chrono::system_clock::time_point> http_redirect_cache::
+  signature_expiry (const string& u)
+  {
+    using namespace chrono;
+
+    try
+    {
+      // S3 SigV4: signing time plus validity in seconds.
+      //
+      if (auto d = query_param (u, "X-Amz-Date"))
+      {
+        if (auto x = query_param (u, "X-Amz-Expires"))
+        {
+          if (auto t = parse_utc (*d))
+            return *t + seconds (stoll (*x));
+        }
+
+        return nullopt;
+      }
+
+      // Azure SAS: signed expiry time.
+      //
+      if (auto e = query_param (u, "se"))
+        return parse_utc (*e);
+
+      // S3 SigV2 and CloudFront: expiry in seconds since epoch.
+      //
+      if (auto e = query_param (u, "Expires"))
+        return system_clock::time_point (seconds (stoll (*e)));
+    }
+    catch (const exception&) // Invalid number.
+    {
+    }
+
+    return nullopt;
+  }
+
+  http_client::
+  http_client (asio::io_context& c)
+    : session_ (c, http_client_traits ())
+  {
+  }
+
+  http_client::
+  http_client (asio::io_context& c, const http_client_traits& t)
+    : session_ (c, t)
+  {
+  }
+
+  asio::awaitable<http_response> http_client::
+  get (const string& u)
+  {
+    http_request rq (http_method::get, u);
+    rq.normalize ();
+    co_return co_await request (rq);
+  }
+
+  asio::awaitable<http_response> http_client::
+  post (const string& u, const string& b, const string& ct)
+  {
+    http_request rq (http_method::post, u);
+    rq.set_content_type (ct);
+    rq.set_body (b);
+    rq.normalize ();
+    co_return co_await request (rq);
+  }
+
+  asio::awaitable<http_response> http_client::
+  put (const string& u, const string& b, const string& ct)
+  {
+    http_request rq (http_method::put, u);
+    rq.set_content_type (ct);
+    rq.set_body (b);
+    rq.normalize ();
+    co_return co_await request (rq);
+  }
+
+  asio::awaitable<http_response> http_client::
+  delete_ (const string& u)
+  {
+    http_request rq (http_method::delete_, u);
+    rq.normalize ();
+    co_return co_await request (rq);
+  }
+
+  asio::awaitable<http_response> http_client::
+  head (const string& u)
+  {
+    http_request rq (http_method::head, u);
+    rq.normalize ();
+    co_return co_await request (rq);
+  }
+
+  asio::awaitable<http_response> http_client::
+  request (const http_request& rq)
+  {
+    validate_proxy_url (session_.traits ().proxy_url);
+    co_return co_await request_impl (rq, 0);
+  }
+
+  asio::awaitable<http_response> http_client::
+  request_impl (http_request rq, uint8_t rc)
+  {
+    const auto& t (session_.traits ());
+
+    // Bail out if we're caught in a redirect loop.
+    //
+    if (rc >= t.max_redirects)
+      throw runtime_error ("maximum redirects exceeded");
+
+    url_parts p (parse_url (rq.url));
+    bool s (p.scheme == "https");
+
+    http_response rs (s ? co_await request_ssl (rq) : co_await request_tcp (rq));
+
+    if (t.follow_redirects && rs.is_redirection ())
+    {
+      auto l (rs.location ());
+
+      if (l)
+      {
+        http_request n (rq.method, *l, rq.version);
+        n.headers = rq.headers;
+
+        url_parts np (parse_url (*l));
+        n.set_header ("Host", np.host);
+
+        // Downgrade POST/PUT to GET on 303 See Other.
+        //
+        if (rs.status == http_status::see_other)
+        {
+          if (rq.method == http_method::post || rq.method == http_method::put)
+          {
+            n.method = http_method::get;
+            n.body = nullopt;
+          }
+        }
+
+        n.normalize ();
+        co_return co_await request_impl (move (n), rc + 1);
+      }
+    }
+
+    co_return rs;
+  }
+
+  asio::awaitable<http_response> http_client::
+  request_ssl (const http_request& rq)
+  {
+    using stream = beast::ssl_stream<beast::tcp_stream>;
+    using beast_req = http_beast::request<http_beast::string_body>;
+    using beast_res = http_beast::response<http_beast::string_body>;
+
+    auto& c (session_.io_context ());
+    auto& x (session_.ssl_context ());
+    const auto& t (session_.traits ());
+
+    url_parts p (parse_url (rq.url));
+
+    stream s (c, x);
+
+    // Configure SNI for TLS.
+    //
+    if (!SSL_set_tlsext_host_name (s.native_handle (), p.host.c_str ()))
+    {
+      int e (static_cast<int> (::ERR_get_error ()));
+      beast::error_code ec (e, asio::error::get_ssl_category ());
+      throw beast::system_error (ec, "failed to set SNI hostname");
+    }
+
+    auto& l (beast::get_lowest_layer (s));
+
+    if (!t.proxy_url.empty ())
+    {
+      // Tunnel through the proxy, then TLS-handshake.
+      //
+      url_parts pp (parse_proxy_url (t.proxy_url));
+
+      if (is_socks_proxy (pp))
+        co_await socks5_connect (l, c, pp, t.proxy_url,
+                                 p.host, p.port,
+                                 t.connect_timeout, t.request_timeout);
+      else
+        co_await proxy_connect (l, c, pp, p.host, p.port,
+                                t.connect_timeout, t.request_timeout);
+    }
+    else
+    {
+      tcp::resolver rv (c);
+      auto as (co_await rv.async_resolve (
+        p.host, p.port, asio::use_awaitable));
+
+      l.expires_after (t.connect_timeout);
+      co_await l.async_connect (as, asio::use_awaitable);
+    }
+
+    // Establish the connection and perform the handshake.
+    //
+    co_await s.async_handshake (ssl::stream_base::client, asio::use_awaitable);
+
+    beast_req br;
+    br.method (to_beast_verb (rq.method));
+    br.target (rq.target ());
+    br.version (rq.version.major * 10 + rq.version.minor);
+
+    for (const auto& h : rq.headers)
+      br.set (h.name, h.value);
+
+    // Assign body if it exists.
+    //
+    if (rq.body)
+    {
+      br.body () = *rq.body;
+      br.prepare_payload ();
+    }
+
+    l.expires_after (t.request_timeout);
+
+    // Dispatch the request.
+    //
+    co_await http_beast::async_write (s, br, asio::use_awaitable);
+
+    beast::flat_buffer b;
+    beast_res bres;
+
+    // Read the response back.
     //
     co_await http_beast::async_read (s, b, bres, asio::use_awaitable);
 
@@ -829,6 +1709,43 @@ namespace launcher
     co_return rs;
   }
 
+  transfer_state::
+  transfer_state ()
+  {
+    blake3_hasher_init (&hasher);
+  }
+
+  void transfer_state::
+  reset ()
+  {
+    offset = 0;
+    etag.clear ();
+    last_modified.clear ();
+    blake3_hasher_init (&hasher);
+  }
+
+  string transfer_state::
+  digest () const
+  {
+    // Finalizing doesn't modify the hasher so we can keep feeding it.
+    //
+    uint8_t d[BLAKE3_OUT_LEN];
+    blake3_hasher_finalize (&hasher, d, BLAKE3_OUT_LEN);
+
+    static const char hx[] = "0123456789abcdef";
+
+    string r;
+    r.reserve (BLAKE3_OUT_LEN * 2);
+
+    for (uint8_t b : d)
+    {
+      r += hx[b >> 4];
+      r += hx[b & 0x0f];
+    }
+
+    return r;
+  }
+
   asio::awaitable<uint64_t> http_client::
   download (const string& u,
             const fs::path& f,
@@ -837,7 +1754,29 @@ namespace launcher
             uint64_t rl)
   {
     validate_proxy_url (session_.traits ().proxy_url);
-    co_return co_await download_impl (u, f, cb, rs, rl, 0);
+    co_return co_await download_impl (u, f, cb, rs, rl, 0, nullptr);
+  }
+
+  asio::awaitable<uint64_t> http_client::
+  download (const string& u,
+            const fs::path& f,
+            transfer_state& st,
+            progress_callback cb,
+            uint64_t rl)
+  {
+    validate_proxy_url (session_.traits ().proxy_url);
+
+    // Without a validator we have no way to tell whether the bytes we have
+    // belong to the current entity.
+    //
+    if (st.offset != 0 && st.etag.empty () && st.last_modified.empty ())
+      st.reset ();
+
+    optional<uint64_t> rs;
+    if (st.offset != 0)
+      rs = st.offset;
+
+    co_return co_await download_impl (u, f, cb, rs, rl, 0, &st);
   }
 
   asio::awaitable<uint64_t> http_client::
@@ -846,7 +1785,8 @@ namespace launcher
                  progress_callback cb,
                  optional<uint64_t> rs,
                  uint64_t rl,
-                 uint8_t rc)
+                 uint8_t rc,
+                 transfer_state* ts)
   {
     using namespace chrono;
     using parser = http_beast::response_parser<http_beast::buffer_body>;
@@ -858,13 +1798,45 @@ namespace launcher
     if (rc >= t.max_redirects)
       throw runtime_error ("maximum redirects exceeded");
 
+    // Go straight to the cached redirect target, if any. Should the server
+    // reject it (the signature got revoked, our clock is off, etc), forget
+    // it and take the long way.
+    //
+    if (rc == 0 && t.redirects != nullptr)
+    {
+      if (optional<string> r = t.redirects->find (u))
+      {
+        try
+        {
+          co_return co_await download_impl (*r, f, cb, rs, rl, rc + 1, ts);
+        }
+        catch (const http_status_error&)
+        {
+        }
+
+        t.redirects->erase (u);
+      }
+    }
+
     http_request rq (http_method::get, u);
 
     // Setup the byte range if we are resuming.
     //
     if (rs)
+    {
       rq.set_header ("Range", "bytes=" + std::to_string (*rs) + "-");
 
+      // Note that a weak ETag cannot be used in If-Range (RFC 9110 13.1.5).
+      //
+      if (ts != nullptr)
+      {
+        if (!ts->etag.empty () && ts->etag.compare (0, 2, "W/") != 0)
+          rq.set_header ("If-Range", ts->etag);
+        else if (!ts->last_modified.empty ())
+          rq.set_header ("If-Range", ts->last_modified);
+      }
+    }
+
     rq.normalize ();
 
     url_parts p (parse_url (u));
@@ -882,6 +1854,9 @@ namespace launcher
 
     uint64_t off (rs ? *rs : 0);
     uint64_t tot (0);
+    bool hdr (false);   // Got response headers.
+    bool reuse (false); // Connection can be reused.
+    string loc;         // Redirect location.
 
     // Generic transfer lambda to handle both plaintext and TLS streams uniformly.
     //
@@ -912,18 +1887,42 @@ namespace launcher
       // and setup our buffer before pulling the body.
       //
       co_await http_beast::async_read_header (s, b, ps, asio::use_awaitable);
+      hdr = true;
 
       auto st (ps.get ().result_int ());
 
+      // Let the caller follow the redirect. If the body is small, read it
+      // out so that the connection can be reused (normally for the next
+      // request to the same host).
+      //
       if (t.follow_redirects && st >= 300 && st < 400)
       {
-        auto loc (ps.get ()[http_beast::field::location]);
+        auto l (ps.get ()[http_beast::field::location]);
 
-        if (!loc.empty ())
+        if (!l.empty ())
         {
-          os.close ();
-          co_return co_await download_impl (
-            string (loc), f, cb, rs, rl, rc + 1);
+          loc = string (l);
+
+          if (t.keep_alive && ps.keep_alive ())
+          {
+            char d[1024];
+            uint64_t n (0);
+
+            while (!ps.is_done () && n <= redirect_drain_limit)
+            {
+              ps.get ().body ().data = d;
+              ps.get ().body ().size = sizeof (d);
+
+              co_await http_beast::async_read_some (
+                s, b, ps, asio::use_awaitable);
+
+              n += sizeof (d) - ps.get ().body ().size;
+            }
+
+            reuse = ps.is_done () && b.size () == 0;
+          }
+
+          co_return 0;
         }
       }
 
@@ -931,23 +1930,293 @@ namespace launcher
         throw http_status_error (
           static_cast<http_status> (st), "download failed");
 
+      // A full response to a range request means the entity has changed
+      // (If-Range) or the server doesn't do ranges. Either way, what we have
+      // is useless so start over.
+      //
+      if (st == 200 && off != 0)
+      {
+        os.close ();
+        os.open (f, ios::binary | ios::out | ios::trunc);
+
+        if (!os)
+          throw runtime_error ("failed to open file for writing");
+
+        off = 0;
+
+        if (ts != nullptr)
+          ts->reset ();
+      }
+
+      // Make sure the range is the one we asked for.
+      //
+      if (st == 206)
+      {
+        string cr (ps.get ()[http_beast::field::content_range]);
+        string ex ("bytes " + std::to_string (off) + "-");
+
+        if (cr.compare (0, ex.size (), ex) != 0)
+          throw runtime_error ("unexpected content range '" + cr + "'");
+      }
+
+      if (ts != nullptr)
+      {
+        auto et (ps.get ()[http_beast::field::etag]);
+        auto lm (ps.get ()[http_beast::field::last_modified]);
+
+        // Some servers ignore If-Range and send the range regardless.
+        //
+        if (st == 206 &&
+            !et.empty () &&
+            !ts->etag.empty () &&
+            string (et) != ts->etag)
+        {
+          os.close ();
+          os.open (f, ios::binary | ios::out | ios::trunc);
+          ts->reset ();
+
+          throw runtime_error ("entity changed during resumed download");
+        }
+
+        if (!et.empty ())
+          ts->etag = string (et);
+
+        if (!lm.empty ())
+          ts->last_modified = string (lm);
+
+        ts->offset = off;
+
+        if (ts->checkpoint)
+        {
+          os.flush ();
+          ts->checkpoint (*ts);
+        }
+      }
+
+      uint64_t cp (off); // Last checkpoint offset.
+
       if (ps.content_length ())
         tot = *ps.content_length () + off;
 
+      // Publish the progress to the counters and check for cancellation
+      // (see transfer_state).
+      //
+      uint64_t pb (off);                 // Last published offset.
+      auto pt (steady_clock::now ());    // Last published time.
+
+      auto publish ([&] (steady_clock::time_point now)
+      {
+        if (ts->progress_bytes != nullptr)
+          ts->progress_bytes->store (off, memory_order_relaxed);
+
+        if (ts->progress_total != nullptr && tot != 0)
+          ts->progress_total->store (tot, memory_order_relaxed);
+
+        if (ts->cancel != nullptr && ts->cancel->load (memory_order_relaxed))
+          throw runtime_error ("download cancelled");
+
+        pb = off;
+        pt = now;
+      });
+
+      if (ts != nullptr)
+        publish (pt);
+
       char db[download_buffer_size];
       ps.get ().body ().data = db;
       ps.get ().body ().size = sizeof (db);
 
-      auto start (steady_clock::now ());
+      auto start (pt);
       uint64_t tr (0);
 
+      // Account for the next n body bytes having landed in the file:
+      // checkpoint, report progress, and calculate the delay to stay under
+      // the rate limit, if requested.
+      //
+      // Note that this is called for every chunk so it should stay cheap:
+      // besides the (optional) legacy callback there is nothing type-erased
+      // here unless it's time to checkpoint.
+      //
+      auto advance ([&] (size_t n) -> milliseconds
+      {
+        off += n;
+        tr += n;
+
+        if (cb)
+          cb (off, tot);
+
+        if (ts == nullptr && rl == 0)
+          return milliseconds (0);
+
+        auto now (steady_clock::now ());
+
+        if (ts != nullptr)
+        {
+          ts->offset = off;
+
+          if (ts->checkpoint && off - cp >= ts->checkpoint_interval)
+          {
+            os.flush ();
+            ts->checkpoint (*ts);
+            cp = off;
+          }
+
+          if (off - pb >= ts->publish_bytes ||
+              now - pt >= ts->publish_interval)
+            publish (now);
+        }
+
+        milliseconds d (0);
+
+        if (rl > 0)
+        {
+          auto el (duration_cast<milliseconds> (now - start).count ());
+          auto ex (static_cast<int64_t> ((tr * 1000) / rl));
+
+          if (el < ex)
+            d = milliseconds (ex - el);
+
+          if (el >= 1000)
+          {
+            start = now;
+            tr = 0;
+          }
+        }
+
+        return d;
+      });
+
+      // Low speed detection (see http_client_traits): we must receive the
+      // quota of low_speed_limit * low_speed_time bytes within the window of
+      // low_speed_time that starts once the previous one is filled. Limiting
+      // each read to the end of the window also catches a connection that
+      // has gone completely quiet. Note that a rate limit below the low
+      // speed limit would trigger it by design so we don't check then.
+      //
+      bool ls (t.low_speed_limit != 0 &&
+               t.low_speed_time.count () != 0 &&
+               (rl == 0 || rl > t.low_speed_limit));
+
+      uint64_t lq (t.low_speed_limit *
+                   static_cast<uint64_t> (t.low_speed_time.count ()));
+
+      auto lt (steady_clock::now ()); // Window start time.
+      uint64_t lb (off);              // Window start offset.
+
+      auto stall ([&] ()
+      {
+        return http_stall_error (
+          p.host,
+          "transfer stalled: less than " +
+          std::to_string (t.low_speed_limit) + " bytes/s over " +
+          std::to_string (t.low_speed_time.count ()) + " seconds");
+      });
+
+      auto timeout ([&] () -> steady_clock::duration
+      {
+        if (!ls)
+          return t.request_timeout;
+
+        auto now (steady_clock::now ());
+
+        if (off - lb >= lq)
+        {
+          lt = now;
+          lb = off;
+        }
+
+        auto r (lt + t.low_speed_time - now);
+
+        if (r <= steady_clock::duration::zero ())
+          throw stall ();
+
+        return min<steady_clock::duration> (r, t.request_timeout);
+      });
+
+      auto stalled ([&] ()
+      {
+        return ls &&
+               off - lb < lq &&
+               steady_clock::now () >= lt + t.low_speed_time;
+      });
+
+      // With the kernel doing the decryption we can move the body straight
+      // from the socket into the file without it going through userspace.
+      // We only do this for a plain Content-Length body, once whatever is
+      // already buffered (by us and by OpenSSL) has gone through the parser
+      // as usual. If the transfer is hashed, we read each spliced range back
+      // for the hasher while it is still in the page cache.
+      //
+#if LAUNCHER_KTLS
+      constexpr bool kt (is_same_v<decay_t<decltype (s)>, ktls_stream>);
+      bool zc (false);
+
+      if constexpr (kt)
+        zc = s.ktls_recv () &&
+             !ps.chunked () &&
+             ps.content_length ().has_value ();
+#endif
+
       // Stream the body chunks into the file.
       //
       while (!ps.is_done ())
       {
-        l.expires_after (t.request_timeout);
+        l.expires_after (timeout ());
+
+#if LAUNCHER_KTLS
+        if constexpr (kt)
+        {
+          if (zc && b.size () == 0 && s.pending () == 0)
+          {
+            os.flush ();
+
+            for (uint64_t r (*ps.content_length_remaining ()); r != 0; )
+            {
+              l.expires_after (timeout ());
+
+              size_t n (0);
+
+              try
+              {
+                n = co_await s.splice (f, off, r);
+              }
+              catch (const boost::system::system_error&)
+              {
+                if (stalled ())
+                  throw stall ();
+
+                throw;
+              }
+
+              if (ts != nullptr)
+                s.hash (ts->hasher, off, n, db, sizeof (db));
+
+              r -= n;
+
+              if (milliseconds d (advance (n)); d.count () != 0)
+              {
+                asio::steady_timer tm (c, d);
+                co_await tm.async_wait (asio::use_awaitable);
+              }
+            }
+
+            break;
+          }
+        }
+#endif
+
+        try
+        {
+          co_await http_beast::async_read_some (
+            s, b, ps, asio::use_awaitable);
+        }
+        catch (const boost::system::system_error&)
+        {
+          if (stalled ())
+            throw stall ();
 
-        co_await http_beast::async_read_some (s, b, ps, asio::use_awaitable);
+          throw;
+        }
 
         // The actual body bytes written into db is the buffer space
         // consumed by the parser, not the stream-level byte count
@@ -959,31 +2228,14 @@ namespace launcher
         if (n > 0)
         {
           os.write (db, n);
-          off += n;
-          tr += n;
 
-          if (cb)
-            cb (off, tot);
+          if (ts != nullptr)
+            blake3_hasher_update (&ts->hasher, db, n);
 
-          // Apply rate limiting if requested.
-          //
-          if (rl > 0)
+          if (milliseconds d (advance (n)); d.count () != 0)
           {
-            auto now (steady_clock::now ());
-            auto el (duration_cast<milliseconds> (now - start).count ());
-            auto ex ((tr * 1000) / rl);
-
-            if (el < ex)
-            {
-              asio::steady_timer tm (c, milliseconds (ex - el));
-              co_await tm.async_wait (asio::use_awaitable);
-            }
-
-            if (el >= 1000)
-            {
-              start = now;
-              tr = 0;
-            }
+            asio::steady_timer tm (c, d);
+            co_await tm.async_wait (asio::use_awaitable);
           }
 
           ps.get ().body ().data = db;
@@ -992,100 +2244,163 @@ namespace launcher
       }
 
       os.flush ();
+
+      if (ts != nullptr)
+        publish (steady_clock::now ());
+
+      reuse = t.keep_alive && ps.keep_alive () && b.size () == 0;
+
       co_return off;
     };
 
+    // Use a warm connection from the pool if there is one. Such a
+    // connection may still turn out to have been closed by the server in
+    // the meantime, in which case, if we haven't got the response headers
+    // yet, we try again on a fresh one.
+    //
+    // Once done, return the connection to the pool, if possible, for the
+    // next request to the same origin, including the one we are being
+    // redirected to. Otherwise, gracefully shut down the TCP connection so
+    // the peer sees a clean close rather than a RST.
+    //
+    bool warm (false);
+    bool retry (false);
+    uint64_t r (0);
+
     if (ssl)
     {
       using stream = beast::ssl_stream<beast::tcp_stream>;
-      stream s (c, session_.ssl_context ());
 
-      if (!SSL_set_tlsext_host_name (s.native_handle (), p.host.c_str ()))
+      // When driving TLS ourselves we need a fresh connection.
+      //
+      unique_ptr<stream> sp;
+      if (t.pool != nullptr && !t.ktls)
+        sp = t.pool->take_ssl (u);
+
+      warm = (sp != nullptr);
+      bool kt (false); // Transferred over kTLS.
+
+      if (!warm)
       {
-        beast::error_code ec (
-          static_cast<int> (::ERR_get_error ()),
-          asio::error::get_ssl_category ());
+        sp = make_unique<stream> (c, session_.ssl_context ());
+        set_sni (*sp, p.host);
 
-        throw beast::system_error (ec, "failed to set SNI hostname");
-      }
+        auto& l (beast::get_lowest_layer (*sp));
+        co_await connect_origin (l, c, t, p, true /* tunnel */);
 
-      auto& l (beast::get_lowest_layer (s));
+#if LAUNCHER_KTLS
+        if (t.ktls)
+        {
+          ktls_stream k (l.socket (), session_.ssl_context (), p.host);
 
-      if (!t.proxy_url.empty ())
-      {
-        url_parts pp (parse_proxy_url (t.proxy_url));
+          k.expires_after (t.connect_timeout);
+          co_await k.handshake ();
 
-        if (is_socks_proxy (pp))
-          co_await socks5_connect (l, c, pp, t.proxy_url,
-                                   p.host, p.port,
-                                   t.connect_timeout, t.request_timeout);
-        else
-          co_await proxy_connect (l, c, pp, p.host, p.port,
-                                  t.connect_timeout, t.request_timeout);
-      }
-      else
-      {
-        tcp::resolver rv (c);
-        auto as (co_await rv.async_resolve (
-          p.host, p.port, asio::use_awaitable));
+          r = co_await transfer (k, false);
+          kt = true;
 
-        l.expires_after (t.connect_timeout);
-        co_await l.async_connect (as, asio::use_awaitable);
+          beast::error_code ec;
+          l.socket ().shutdown (tcp::socket::shutdown_both, ec);
+        }
+#endif
+
+        if (!kt)
+          co_await sp->async_handshake (ssl::stream_base::client,
+                                        asio::use_awaitable);
       }
 
-      co_await s.async_handshake (ssl::stream_base::client, asio::use_awaitable);
+      if (!kt)
+      {
+        stream& s (*sp);
 
-      auto r (co_await transfer (s, false));
+        try
+        {
+          r = co_await transfer (s, false);
+        }
+        catch (const boost::system::system_error&)
+        {
+          if (!warm || hdr)
+            throw;
 
-      beast::error_code ec;
-      beast::get_lowest_layer (s).socket ().shutdown (tcp::socket::shutdown_both, ec);
+          retry = true;
+        }
 
-      co_return r;
+        if (!retry)
+        {
+          if (reuse && t.pool != nullptr)
+            t.pool->put (u, move (sp));
+          else
+          {
+            beast::error_code ec;
+            beast::get_lowest_layer (s).socket ().shutdown (
+              tcp::socket::shutdown_both, ec);
+          }
+        }
+      }
     }
     else
     {
-      beast::tcp_stream s (c);
+      unique_ptr<beast::tcp_stream> sp;
+      if (t.pool != nullptr)
+        sp = t.pool->take_tcp (u);
+
+      warm = (sp != nullptr);
 
       bool use_absolute_target (false);
 
-      if (!t.proxy_url.empty ())
+      if (!warm)
       {
-        url_parts pp (parse_proxy_url (t.proxy_url));
-
-        if (is_socks_proxy (pp))
-        {
-          co_await socks5_connect (s, c, pp, t.proxy_url,
-                                   p.host, p.port,
-                                   t.connect_timeout, t.request_timeout);
-        }
-        else
-        {
-          tcp::resolver rv (c);
-          auto as (co_await rv.async_resolve (
-            pp.host, pp.port, asio::use_awaitable));
+        sp = make_unique<beast::tcp_stream> (c);
+        use_absolute_target =
+          co_await connect_origin (*sp, c, t, p, false /* tunnel */);
+      }
+      else if (!t.proxy_url.empty ())
+        use_absolute_target = !is_socks_proxy (parse_proxy_url (t.proxy_url));
 
-          s.expires_after (t.connect_timeout);
-          co_await s.async_connect (as, asio::use_awaitable);
+      beast::tcp_stream& s (*sp);
 
-          use_absolute_target = true;
-        }
+      try
+      {
+        r = co_await transfer (s, use_absolute_target);
       }
-      else
+      catch (const boost::system::system_error&)
       {
-        tcp::resolver rv (c);
-        auto as (co_await rv.async_resolve (
-          p.host, p.port, asio::use_awaitable));
+        if (!warm || hdr)
+          throw;
 
-        s.expires_after (t.connect_timeout);
-        co_await s.async_connect (as, asio::use_awaitable);
+        retry = true;
       }
 
-      auto r (co_await transfer (s, use_absolute_target));
+      if (!retry)
+      {
+        if (reuse && t.pool != nullptr)
+          t.pool->put (u, move (sp));
+        else
+        {
+          beast::error_code ec;
+          s.socket ().shutdown (tcp::socket::shutdown_both, ec);
+        }
+      }
+    }
 
-      beast::error_code ec;
-      s.socket ().shutdown (tcp::socket::shutdown_both, ec);
+    // The warm connection was stale (see above).
+    //
+    if (retry)
+    {
+      os.close ();
+      co_return co_await download_impl (u, f, cb, rs, rl, rc, ts);
+    }
 
-      co_return r;
+    if (!loc.empty ())
+    {
+      os.close ();
+
+      if (t.redirects != nullptr)
+        t.redirects->insert (u, loc);
+
+      co_return co_await download_impl (loc, f, cb, rs, rl, rc + 1, ts);
     }
+
+    co_return r;
   }
 }
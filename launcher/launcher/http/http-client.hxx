@@ -1,17 +1,24 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <filesystem>
 #include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
 
 #include <optional>
 
+#include <launcher/blake3.h>
+
 #include <launcher/http/http-request.hxx>
 #include <launcher/http/http-response.hxx>
 #include <launcher/http/http-types.hxx>
@@ -22,6 +29,9 @@ namespace launcher
   namespace beast = boost::beast;
   namespace ssl = boost::asio::ssl;
 
+  class http_pool;
+  class http_redirect_cache;
+
   struct http_client_traits
   {
     std::chrono::milliseconds connect_timeout {30000};
@@ -33,6 +43,83 @@ namespace launcher
     bool follow_redirects         = true;
     bool keep_alive               = true;
     std::string proxy_url;
+
+    // Offload TLS to the kernel (kTLS) for downloads and splice the body
+    // straight from the socket into the file (hashed downloads read it back
+    // from the page cache). Only supported on Linux and only effective
+    // if the kernel and the negotiated cipher support it; otherwise we
+    // quietly end up with plain userspace TLS.
+    //
+    bool ktls                     = false;
+
+    // Abort a download (with http_stall_error) if it receives less than
+    // low_speed_limit bytes per second over low_speed_time, similar to
+    // curl's --speed-limit and --speed-time. Zero limit disables this.
+    //
+    std::uint64_t low_speed_limit = 0;
+    std::chrono::seconds low_speed_time {30};
+
+    // Pool of warm connections to take from, if any (see http_pool).
+    //
+    std::shared_ptr<http_pool> pool;
+
+    // Cache of redirects to signed URLs to consult, if any (see
+    // http_redirect_cache).
+    //
+    std::shared_ptr<http_redirect_cache> redirects;
+  };
+
+  // Resumable download state.
+  //
+  // If the offset is not zero, then download() resumes from it with an
+  // If-Range precondition on the recorded validator (the strong ETag or,
+  // failing that, Last-Modified). This way, if the remote entity has changed
+  // since, the server sends all of it and we start over instead of splicing
+  // two versions together. Without a validator we cannot tell so we don't
+  // resume at all.
+  //
+  // The validators are updated from the response and the body is fed to the
+  // hasher as it is written, so the hasher must be in the state that
+  // corresponds to the first offset bytes of the file. Once the response
+  // headers are in and then every checkpoint_interval bytes the file is
+  // flushed and checkpoint (if any) is called so that the state can be
+  // persisted (see download_manager).
+  //
+  struct transfer_state
+  {
+    std::uint64_t offset = 0;
+    std::string etag;
+    std::string last_modified;
+    blake3_hasher hasher;
+
+    std::uint64_t checkpoint_interval = 4 * 1024 * 1024;
+    std::function<void (const transfer_state&)> checkpoint;
+
+    // Rather than calling back for every chunk, the progress (offset and,
+    // if known, total size) is published to these counters (if not NULL)
+    // once the headers are in, then at most every publish_interval or
+    // publish_bytes, whichever comes first, and at the end. This is also
+    // when the cancellation flag (if not NULL) is checked.
+    //
+    std::atomic<std::uint64_t>* progress_bytes = nullptr;
+    std::atomic<std::uint64_t>* progress_total = nullptr;
+    const std::atomic<bool>* cancel = nullptr;
+
+    std::chrono::milliseconds publish_interval {100};
+    std::uint64_t publish_bytes = 1024 * 1024;
+
+    transfer_state ();
+
+    // Start over from the beginning, keeping the checkpoint and progress
+    // settings.
+    //
+    void
+    reset ();
+
+    // BLAKE3 (lowercase hex) of the first offset bytes.
+    //
+    std::string
+    digest () const;
   };
 
   class http_session
@@ -73,6 +160,157 @@ namespace launcher
     ssl::context ssl_ctx_;
   };
 
+  // Pool of idle, established connections keyed by origin (scheme, host,
+  // and port).
+  //
+  // Connections get here by being opened speculatively with warm(), for
+  // example, while we are still busy planning, so that the first downloads
+  // don't pay for the DNS lookup, TCP, and TLS setup. They leave it by being
+  // taken by a download to the same origin. Connections that have been idle
+  // for longer than the idle timeout are closed.
+  //
+  // Note that the pool is not thread-safe and should only be used from the
+  // io_context thread.
+  //
+  class http_pool: public std::enable_shared_from_this<http_pool>
+  {
+  public:
+    using ssl_stream = beast::ssl_stream<beast::tcp_stream>;
+    using tcp_stream = beast::tcp_stream;
+
+    static constexpr std::chrono::seconds default_idle_timeout {15};
+
+    // Note that the pool connects according to the traits (proxy, timeouts,
+    // etc) so they should be the same as those of the clients using it.
+    //
+    http_pool (asio::io_context& ioc,
+               const http_client_traits& traits,
+               std::chrono::steady_clock::duration idle_timeout =
+                 default_idle_timeout);
+
+    http_pool (const http_pool&) = delete;
+    http_pool& operator = (const http_pool&) = delete;
+
+    // Start opening connections to the origin of the URL in the background
+    // until there are n idle or being opened. Connection failures are
+    // ignored (they will be diagnosed by the download itself).
+    //
+    void
+    warm (const std::string& url, std::size_t n);
+
+    // Take an idle connection to the origin of the URL or return NULL if
+    // there is none that is still alive.
+    //
+    std::unique_ptr<ssl_stream>
+    take_ssl (const std::string& url);
+
+    std::unique_ptr<tcp_stream>
+    take_tcp (const std::string& url);
+
+    // Return the connection to the pool.
+    //
+    void
+    put (const std::string& url, std::unique_ptr<ssl_stream>);
+
+    void
+    put (const std::string& url, std::unique_ptr<tcp_stream>);
+
+    // Number of idle connections.
+    //
+    std::size_t
+    idle () const;
+
+  private:
+    template <typename S>
+    struct entry
+    {
+      std::unique_ptr<S> stream;
+      std::chrono::steady_clock::time_point expires;
+    };
+
+    template <typename S>
+    using map = std::map<std::string, std::vector<entry<S>>>;
+
+    asio::awaitable<void>
+    connect (std::string url);
+
+    template <typename S>
+    std::unique_ptr<S>
+    take (map<S>&, const std::string& url);
+
+    template <typename S>
+    void
+    put (map<S>&, const std::string& url, std::unique_ptr<S>);
+
+    // Close expired connections and, if any are left, schedule the next
+    // sweep for when the earliest of them expires.
+    //
+    void
+    sweep ();
+
+    void
+    schedule (std::chrono::steady_clock::time_point);
+
+  private:
+    http_session session_;
+    std::chrono::steady_clock::duration idle_timeout_;
+    asio::steady_timer timer_;
+    bool scheduled_ = false;
+
+    map<ssl_stream> ssl_;
+    map<tcp_stream> tcp_;
+    std::map<std::string, std::size_t> connecting_;
+  };
+
+  // Per-run cache of redirects to signed URLs keyed by the original URL.
+  //
+  // GitHub release asset URLs redirect to signed URLs on a different host
+  // that stay valid for a while. Going there directly saves a round trip
+  // (and a connection) per asset, which adds up when resuming or retrying.
+  // A redirect is only cached if its target carries a signature expiry
+  // that we understand (S3's X-Amz-Date and X-Amz-Expires or Expires,
+  // Azure's se) and only until shortly before then.
+  //
+  // Note that the cache is not thread-safe and should only be used from
+  // the io_context thread.
+  //
+  class http_redirect_cache
+  {
+  public:
+    // Leeway for the signature expiry (clock skew, transfer time).
+    //
+    static constexpr std::chrono::seconds expiry_margin {60};
+
+    // Return the cached target or nullopt if there is none or it has
+    // expired.
+    //
+    std::optional<std::string>
+    find (const std::string& url);
+
+    // Cache the redirect if the target has a (future) signature expiry.
+    // Return true if cached.
+    //
+    bool
+    insert (const std::string& url, const std::string& target);
+
+    void
+    erase (const std::string& url);
+
+    // Return the signature expiry of the URL, if any.
+    //
+    static std::optional<std::chrono::system_clock::time_point>
+    signature_expiry (const std::string& url);
+
+  private:
+    struct entry
+    {
+      std::string target;
+      std::chrono::system_clock::time_point expires;
+    };
+
+    std::map<std::string, entry> map_;
+  };
+
   class http_client
   {
   public:
@@ -115,6 +353,16 @@ namespace launcher
               std::optional<std::uint64_t> resume_from = std::nullopt,
               std::uint64_t rate_limit_bytes_per_second = 0);
 
+    // As above but resume (and hash) according to the transfer state (see
+    // above), which is updated as the download progresses.
+    //
+    asio::awaitable<std::uint64_t>
+    download (const std::string& url,
+              const std::filesystem::path& target_path,
+              transfer_state& state,
+              progress_callback progress = nullptr,
+              std::uint64_t rate_limit_bytes_per_second = 0);
+
     http_session&
     session () noexcept
     {
@@ -137,7 +385,8 @@ namespace launcher
                    progress_callback progress,
                    std::optional<std::uint64_t> resume_from,
                    std::uint64_t rate_limit_bytes_per_second,
-                   std::uint8_t redirect_count);
+                   std::uint8_t redirect_count,
+                   transfer_state* state);
 
     asio::awaitable<http_response>
     request_ssl (const http_request& req);
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <sstream>
 #include <cctype>
+#include <utility>
 
 using namespace std;
 
@@ -238,4 +239,13 @@ namespace launcher
       status_ (s)
   {
   }
+
+  // http_stall_error
+  //
+  http_stall_error::
+  http_stall_error (string h, const string& w)
+    : runtime_error (w),
+      host_ (move (h))
+  {
+  }
 }
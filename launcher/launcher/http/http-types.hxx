@@ -255,4 +255,22 @@ namespace launcher
   private:
     http_status status_;
   };
+
+  // Download stall.
+  //
+  // Thrown when a download falls below the low speed limit (see
+  // http_client_traits). Carries the host that was being downloaded from
+  // so that callers can keep track of the slow ones.
+  //
+  class http_stall_error : public std::runtime_error
+  {
+  public:
+    http_stall_error (std::string host, const std::string& what);
+
+    const std::string&
+    host () const noexcept { return host_; }
+
+  private:
+    std::string host_;
+  };
 }
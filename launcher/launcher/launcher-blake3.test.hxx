@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include <launcher/blake3.h>
+
+namespace launcher
+{
+  // Return the hex-encoded BLAKE3 digest of the specified content.
+  //
+  // Note that this goes straight to the BLAKE3 implementation rather than
+  // through the launcher's hashing so that it can serve as the reference in
+  // tests.
+  //
+  inline std::string
+  blake3_hex (const std::string& s)
+  {
+    blake3_hasher h;
+    blake3_hasher_init (&h);
+    blake3_hasher_update (&h, s.data (), s.size ());
+
+    std::uint8_t d[BLAKE3_OUT_LEN];
+    blake3_hasher_finalize (&h, d, BLAKE3_OUT_LEN);
+
+    std::ostringstream o;
+    o << std::hex << std::setfill ('0');
+
+    for (int i (0); i < BLAKE3_OUT_LEN; ++i)
+      o << std::setw (2) << static_cast<int> (d[i]);
+
+    return o.str ();
+  }
+}
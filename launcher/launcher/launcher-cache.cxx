@@ -133,6 +133,12 @@ namespace launcher
     return rec_.audit (c);
   }
 
+  size_t cache_coordinator::
+  scrub (component_type c)
+  {
+    return rec_.scrub (c);
+  }
+
   vector<reconcile_item> cache_coordinator::
   plan (const manifest& m,
         component_type c,
@@ -272,6 +278,7 @@ namespace launcher
       r.target = fs::path (i.path);
       r.name = fs::path (i.path).filename ().string ();
       r.expected_size = i.expected_size;
+      r.expected_hash = i.expected_hash;
 
       dl_->queue_download (move (r));
     }
@@ -426,22 +433,23 @@ namespace launcher
       r.target = t;
       r.name = t.filename ().string ();
       r.expected_size = i->expected_size;
+      r.expected_hash = i->expected_hash;
 
       auto task (dl_->queue_download (move (r)));
       tm[task] = i;
 
       // Wire up the progress UI.
       //
+      // Note that the entry follows the task's counters which the transfer
+      // updates in batches.
+      //
       if (prog_ != nullptr)
       {
-        auto e (prog_->add_entry (r.name));
+        auto e (prog_->add_entry (task->request.name,
+                                  {task, &task->downloaded_bytes},
+                                  {task, &task->total_bytes}));
         e->metrics ().total_bytes.store (i->expected_size,
                                          memory_order_relaxed);
-
-        task->on_progress = [this, e] (const download_progress& p)
-        {
-          prog_->update_progress (e, p.downloaded_bytes, p.total_bytes);
-        };
       }
     }
 
@@ -168,6 +168,12 @@ namespace launcher
     std::vector<std::pair<cached_file, file_state>>
     audit (component_type c) const;
 
+    // Re-hash the tracked files that are due for deep verification and drop
+    // the corrupted ones. Return the number of corrupted files found.
+    //
+    std::size_t
+    scrub (component_type c);
+
     // Planning.
     //
 
@@ -0,0 +1,495 @@
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <windows.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+#include <launcher/launcher-daemon.hxx>
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+
+#include <launcher/launcher-log.hxx>
+
+using namespace std;
+
+namespace launcher
+{
+  namespace
+  {
+    using protocol_type = daemon_coordinator::protocol_type;
+
+    // Resolve the endpoint path into a socket endpoint.
+    //
+    // Note that we use a path relative to the current working directory
+    // (which is the installation root) if that is shorter since socket paths
+    // are limited to about a hundred bytes and installation roots can be
+    // deep.
+    //
+    optional<protocol_type::endpoint>
+    resolve (const fs::path& p)
+    {
+      error_code ec;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+      fs::path r (fs::proximate (p, ec));
+
+      if (ec || r.native ().size () > p.native ().size ())
+        r = p;
+
+      return protocol_type::endpoint (r.string ());
+#else
+      ifstream ifs (p);
+      unsigned short port (0);
+
+      if (!(ifs >> port) || port == 0)
+        return nullopt;
+
+      return protocol_type::endpoint (asio::ip::address_v4::loopback (), port);
+#endif
+    }
+
+    // Send a single command and return the reply or nullopt if nobody is
+    // listening or the reply didn't arrive in time.
+    //
+    asio::awaitable<optional<string>>
+    request (asio::io_context& ioc,
+             const fs::path& p,
+             const string& c,
+             chrono::seconds t)
+    {
+      error_code ec;
+
+      if (!fs::exists (p, ec))
+        co_return nullopt;
+
+      auto e (resolve (p));
+
+      if (!e)
+        co_return nullopt;
+
+      protocol_type::socket s (ioc);
+
+      // A daemon that is hung (or stopped in a debugger) would keep us
+      // waiting forever so close the socket once the deadline passes, which
+      // fails whatever is in progress.
+      //
+      asio::steady_timer dl (ioc, t);
+      dl.async_wait ([&s] (const boost::system::error_code& x)
+      {
+        if (!x)
+        {
+          boost::system::error_code ec;
+          s.close (ec);
+        }
+      });
+
+      // A stale endpoint left behind by a daemon that didn't exit cleanly
+      // is indistinguishable from no daemon at all.
+      //
+      boost::system::error_code ce;
+      co_await s.async_connect (*e,
+                                asio::redirect_error (asio::use_awaitable, ce));
+
+      if (ce)
+        co_return nullopt;
+
+      string m (c + '\n');
+      co_await asio::async_write (
+        s,
+        asio::buffer (m),
+        asio::redirect_error (asio::use_awaitable, ce));
+
+      asio::streambuf b;
+
+      if (!ce)
+        co_await asio::async_read_until (
+          s,
+          b,
+          '\n',
+          asio::redirect_error (asio::use_awaitable, ce));
+
+      if (ce)
+      {
+        launcher::log::warning (categories::daemon {},
+                                "background updater did not answer '{}': {}",
+                                c,
+                                ce.message ());
+        co_return nullopt;
+      }
+
+      istream is (&b);
+      string r;
+      getline (is, r);
+
+      co_return r;
+    }
+
+    // Lower our scheduling priority so that pre-downloading doesn't compete
+    // with the game (or anything else) for CPU and disk.
+    //
+    void
+    lower_priority ()
+    {
+#ifdef _WIN32
+      if (!SetPriorityClass (GetCurrentProcess (),
+                             PROCESS_MODE_BACKGROUND_BEGIN))
+        launcher::log::warning (categories::daemon {},
+                                "unable to enter background processing mode");
+#else
+      if (setpriority (PRIO_PROCESS, 0, 10) != 0)
+        launcher::log::warning (categories::daemon {},
+                                "unable to lower process priority");
+#endif
+    }
+  }
+
+  daemon_coordinator::
+  daemon_coordinator (asio::io_context& c, fs::path e)
+    : ioc_ (c),
+      endpoint_ (move (e)),
+      timer_ (c),
+      lock_ (c.get_executor (), 1)
+  {
+  }
+
+  daemon_coordinator::
+  ~daemon_coordinator ()
+  {
+    stop ();
+  }
+
+  void daemon_coordinator::
+  set_cycle_handler (handler_type h)
+  {
+    cycle_ = move (h);
+  }
+
+  void daemon_coordinator::
+  set_apply_handler (apply_handler_type h)
+  {
+    apply_ = move (h);
+  }
+
+  asio::awaitable<void> daemon_coordinator::
+  run (chrono::seconds iv)
+  {
+    // Make sure we are the only daemon for this installation. Two would
+    // fight over the staging area and the cache database.
+    //
+    if (co_await request (ioc_, endpoint_, "ping", request_timeout))
+      throw runtime_error ("background updater is already running");
+
+    listen ();
+    lower_priority ();
+
+    asio::co_spawn (ioc_,
+                    accept (),
+                    [] (exception_ptr ep)
+    {
+      if (ep)
+      {
+        try
+        {
+          rethrow_exception (ep);
+        }
+        catch (const exception& e)
+        {
+          launcher::log::error (categories::daemon {},
+                                "stopped accepting requests: {}",
+                                e.what ());
+        }
+      }
+    });
+
+    launcher::log::info (categories::daemon {},
+                         "background updater running (interval: {}s)",
+                         iv.count ());
+
+    // Note that we only consider ourselves cycling once we hold the lock
+    // since until then we may be waiting for an apply to complete.
+    //
+    handler_type c ([this] () -> asio::awaitable<void>
+    {
+      if (!cycle_)
+        co_return;
+
+      cycling_ = true;
+
+      try
+      {
+        co_await cycle_ ();
+      }
+      catch (...)
+      {
+        cycling_ = false;
+        throw;
+      }
+
+      cycling_ = false;
+    });
+
+    while (!stopped_)
+    {
+      // Don't let a failed cycle (network hiccup, rate limit, etc) bring the
+      // daemon down. We will simply try again on the next one.
+      //
+      try
+      {
+        co_await exclusive (c);
+      }
+      catch (const exception& e)
+      {
+        launcher::log::warning (categories::daemon {},
+                                "update cycle failed: {}",
+                                e.what ());
+      }
+
+      if (stopped_)
+        break;
+
+      boost::system::error_code ec;
+      timer_.expires_after (iv);
+      co_await timer_.async_wait (
+        asio::redirect_error (asio::use_awaitable, ec));
+
+      // Sit out any hold requested in the meantime.
+      //
+      while (!stopped_ && chrono::steady_clock::now () < hold_)
+      {
+        timer_.expires_at (hold_);
+        co_await timer_.async_wait (
+          asio::redirect_error (asio::use_awaitable, ec));
+      }
+    }
+  }
+
+  void daemon_coordinator::
+  stop ()
+  {
+    if (stopped_)
+      return;
+
+    stopped_ = true;
+    timer_.cancel ();
+
+    if (acceptor_ != nullptr)
+    {
+      boost::system::error_code ec;
+      acceptor_->close (ec);
+      acceptor_.reset ();
+
+      error_code fe;
+      fs::remove (endpoint_, fe);
+    }
+  }
+
+  asio::awaitable<bool> daemon_coordinator::
+  request_apply (asio::io_context& c, const fs::path& e)
+  {
+    auto r (co_await request (c, e, "apply", apply_timeout));
+
+    if (!r || *r == "none")
+      co_return false;
+
+    if (*r == "busy")
+    {
+      launcher::log::info (categories::daemon {},
+                           "background updater is in the middle of a cycle");
+      co_return false;
+    }
+
+    if (*r != "ok")
+    {
+      launcher::log::warning (categories::daemon {},
+                              "background updater failed to apply updates: {}",
+                              r->starts_with ("error ") ? r->substr (6) : *r);
+      co_return false;
+    }
+
+    co_return true;
+  }
+
+  asio::awaitable<bool> daemon_coordinator::
+  request_hold (asio::io_context& c, const fs::path& e, chrono::seconds d)
+  {
+    auto r (co_await request (c,
+                              e,
+                              "hold " + to_string (d.count ()),
+                              request_timeout));
+    co_return !r || *r == "ok";
+  }
+
+  fs::path daemon_coordinator::
+  default_endpoint (const fs::path& cr)
+  {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    return cr / "daemon.sock";
+#else
+    return cr / "daemon.port";
+#endif
+  }
+
+  void daemon_coordinator::
+  listen ()
+  {
+    error_code ec;
+
+    // Whatever is there is stale since nobody answered our ping.
+    //
+    fs::remove (endpoint_, ec);
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    acceptor_ = make_unique<acceptor_type> (ioc_, *resolve (endpoint_));
+#else
+    acceptor_ = make_unique<acceptor_type> (
+      ioc_,
+      protocol_type::endpoint (asio::ip::address_v4::loopback (), 0));
+
+    ofstream ofs (endpoint_, ios::trunc);
+    ofs << acceptor_->local_endpoint ().port () << '\n';
+
+    if (!ofs)
+      throw runtime_error ("unable to write daemon endpoint: " +
+                           endpoint_.string ());
+#endif
+
+    launcher::log::trace_l2 (categories::daemon {},
+                             "listening on {}",
+                             endpoint_.string ());
+  }
+
+  asio::awaitable<void> daemon_coordinator::
+  accept ()
+  {
+    while (acceptor_ != nullptr && acceptor_->is_open ())
+    {
+      boost::system::error_code ec;
+      socket_type s (co_await acceptor_->async_accept (
+        asio::redirect_error (asio::use_awaitable, ec)));
+
+      if (ec)
+      {
+        if (ec == asio::error::operation_aborted)
+          break;
+
+        continue;
+      }
+
+      asio::co_spawn (ioc_, serve (move (s)), asio::detached);
+    }
+  }
+
+  asio::awaitable<void> daemon_coordinator::
+  serve (socket_type s)
+  {
+    string r;
+
+    try
+    {
+      asio::streambuf b;
+      co_await asio::async_read_until (s, b, '\n', asio::use_awaitable);
+
+      istream is (&b);
+      string c;
+      getline (is, c);
+
+      launcher::log::trace_l2 (categories::daemon {}, "request: {}", c);
+
+      if (c == "ping")
+        r = "ok";
+      else if (c == "apply" && cycling_)
+        r = "busy";
+      else if (c == "apply")
+      {
+        try
+        {
+          bool a (false);
+
+          handler_type h ([this, &a] () -> asio::awaitable<void>
+          {
+            if (apply_)
+              a = co_await apply_ ();
+          });
+
+          co_await exclusive (h);
+          r = a ? "ok" : "none";
+        }
+        catch (const exception& e)
+        {
+          r = string ("error ") + e.what ();
+          replace (r.begin (), r.end (), '\n', ' ');
+
+          launcher::log::error (categories::daemon {},
+                                "failed to apply pending updates: {}",
+                                e.what ());
+        }
+      }
+      else if (c.starts_with ("hold "))
+      {
+        // Note that we don't wait for the current cycle (if any) to
+        // complete: it could take a while and the caller is about to start
+        // the game.
+        //
+        try
+        {
+          chrono::seconds d (stoul (c.substr (5)));
+          hold_ = max (hold_, chrono::steady_clock::now () + d);
+          r = cycling_ ? "busy" : "ok";
+        }
+        catch (const exception&)
+        {
+          r = "error invalid hold duration '" + c.substr (5) + "'";
+        }
+      }
+      else
+        r = "error unknown command '" + c + "'";
+
+      r += '\n';
+      co_await asio::async_write (s, asio::buffer (r), asio::use_awaitable);
+    }
+    catch (const exception& e)
+    {
+      // The launcher went away before we could answer. Nothing we can do
+      // about it.
+      //
+      launcher::log::trace_l2 (categories::daemon {},
+                               "request failed: {}",
+                               e.what ());
+    }
+  }
+
+  asio::awaitable<void> daemon_coordinator::
+  exclusive (const handler_type& h)
+  {
+    if (!h)
+      co_return;
+
+    // Sending blocks while the slot is filled and completes (in the order
+    // the senders arrived) once the holder empties it.
+    //
+    co_await lock_.async_send (boost::system::error_code (),
+                               asio::use_awaitable);
+
+    auto release ([this] ()
+    {
+      lock_.try_receive ([] (boost::system::error_code) {});
+    });
+
+    try
+    {
+      co_await h ();
+    }
+    catch (...)
+    {
+      release ();
+      throw;
+    }
+
+    release ();
+  }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/experimental/channel.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace launcher
+{
+  namespace fs = std::filesystem;
+  namespace asio = boost::asio;
+
+  // Background updater.
+  //
+  // On the daemon side we listen on a local socket in the cache directory
+  // and periodically invoke the cycle handler (which is expected to discover
+  // and pre-download pending updates). On the launcher side we connect to
+  // this socket and ask the daemon to apply whatever it has staged.
+  //
+  // The protocol is line-based: the client sends a single command (ping,
+  // apply, or hold) and the daemon answers with either `ok` or `error
+  // <message>`. An apply with nothing staged is answered with `none`. An
+  // apply or hold that arrives in the middle of a cycle is answered with
+  // `busy` right away: a cycle pre-downloads at a low priority and could
+  // take a long time, so the launcher is better off synchronizing itself.
+  //
+  class daemon_coordinator
+  {
+  public:
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    using protocol_type = asio::local::stream_protocol;
+#else
+    using protocol_type = asio::ip::tcp;
+#endif
+    using socket_type = protocol_type::socket;
+    using acceptor_type = protocol_type::acceptor;
+
+    using handler_type = std::function<asio::awaitable<void> ()>;
+
+    // Return false if there was nothing to apply.
+    //
+    using apply_handler_type = std::function<asio::awaitable<bool> ()>;
+
+    // Constructors.
+    //
+    // The endpoint is the socket path or, on platforms without local socket
+    // support, the file that stores the loopback port we are listening on.
+    //
+    daemon_coordinator (asio::io_context& ioc, fs::path endpoint);
+
+    daemon_coordinator (const daemon_coordinator&) = delete;
+    daemon_coordinator& operator= (const daemon_coordinator&) = delete;
+
+    ~daemon_coordinator ();
+
+    // Handlers.
+    //
+    // Note that the cycle and apply handlers are never executed
+    // concurrently.
+    //
+    void
+    set_cycle_handler (handler_type h);
+
+    void
+    set_apply_handler (apply_handler_type h);
+
+    // Serve requests and run a cycle every interval until stopped.
+    //
+    // Throw if another daemon is already listening on the endpoint.
+    //
+    asio::awaitable<void>
+    run (std::chrono::seconds interval);
+
+    void
+    stop ();
+
+    // Deadlines for the daemon's answer. Applying is mostly renames but may
+    // involve extracting archives.
+    //
+    static constexpr std::chrono::seconds request_timeout {2};
+    static constexpr std::chrono::seconds apply_timeout {120};
+
+    // Ask a running daemon to apply its pending updates.
+    //
+    // Return true if the daemon applied them and false if there is no daemon,
+    // it is busy, had nothing staged, failed to apply, or didn't answer in
+    // time, in which case the caller should perform the update itself.
+    //
+    static asio::awaitable<bool>
+    request_apply (asio::io_context& ioc, const fs::path& endpoint);
+
+    // Ask a running daemon not to start any cycles for the specified
+    // duration (for example, while we record what the game opens).
+    //
+    // Return true if there is no daemon or it is idle and agreed, and false
+    // if it is in the middle of a cycle (which it will finish) or doesn't
+    // understand the request.
+    //
+    static asio::awaitable<bool>
+    request_hold (asio::io_context& ioc,
+                  const fs::path& endpoint,
+                  std::chrono::seconds duration);
+
+    // Return the endpoint for the specified cache root.
+    //
+    static fs::path
+    default_endpoint (const fs::path& cache_root);
+
+  private:
+    void
+    listen ();
+
+    asio::awaitable<void>
+    accept ();
+
+    asio::awaitable<void>
+    serve (socket_type s);
+
+    // Run the handler once nobody else is running one.
+    //
+    asio::awaitable<void>
+    exclusive (const handler_type& h);
+
+  private:
+    asio::io_context& ioc_;
+    fs::path endpoint_;
+
+    handler_type cycle_;
+    apply_handler_type apply_;
+
+    bool cycling_ = false;
+    bool stopped_ = false;
+
+    std::chrono::steady_clock::time_point hold_;
+
+    asio::steady_timer timer_;
+    std::unique_ptr<acceptor_type> acceptor_;
+
+    // Lock for exclusive(): holding it is having the single slot filled.
+    //
+    asio::experimental::channel<void (boost::system::error_code)> lock_;
+  };
+}
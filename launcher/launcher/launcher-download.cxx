@@ -52,6 +52,12 @@ namespace launcher
     return manager_.max_parallel ();
   }
 
+  void download_coordinator::
+  warm (const vector<string>& us)
+  {
+    manager_.warm (us);
+  }
+
   void download_coordinator::
   set_completion_callback (completion_callback cb)
   {
@@ -134,6 +140,18 @@ namespace launcher
     return manager_.overall_progress ();
   }
 
+  const map<string, size_t>& download_coordinator::
+  stalls () const
+  {
+    return manager_.stalls ();
+  }
+
+  const map<string, transfer_stats>& download_coordinator::
+  transfers () const
+  {
+    return manager_.transfers ();
+  }
+
   vector<shared_ptr<download_coordinator::task_type>> download_coordinator::
   tasks () const
   {
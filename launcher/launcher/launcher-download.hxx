@@ -8,6 +8,9 @@
 #include <functional>
 #include <filesystem>
 #include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
 
 namespace launcher
 {
@@ -61,6 +64,17 @@ namespace launcher
     void
     set_completion_callback (completion_callback cb);
 
+    // Connection warm-up.
+    //
+    // Start opening connections to the hosts that the upcoming downloads
+    // will use, sized to the download concurrency. Call this before the
+    // (lengthy) planning so that they are established by the time the
+    // downloads start. Unused connections are closed after a short idle
+    // timeout.
+    //
+    void
+    warm (const std::vector<std::string>& urls);
+
     void
     set_batch_completion_callback (batch_completion_callback cb);
 
@@ -101,6 +115,16 @@ namespace launcher
     download_progress
     overall_progress () const;
 
+    // Number of stalled transfers per host.
+    //
+    const std::map<std::string, std::size_t>&
+    stalls () const;
+
+    // Transfer statistics per host.
+    //
+    const std::map<std::string, transfer_stats>&
+    transfers () const;
+
     // Task access.
     //
     // Get all queued tasks.
@@ -0,0 +1,654 @@
+#include <launcher/launcher-mock.test.hxx>
+
+#include <launcher/launcher-cache.hxx>
+#include <launcher/launcher-download.hxx>
+#include <launcher/launcher-github.hxx>
+#include <launcher/launcher-http.hxx>
+#include <launcher/launcher-manifest.hxx>
+#include <launcher/launcher-sync.hxx>
+#include <launcher/manifest/manifest.hxx>
+
+#include <launcher/launcher-blake3.test.hxx>
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace launcher;
+
+// End-to-end update tests against the local mock server.
+//
+// We drive the launcher's own synchronization (see launcher-sync.hxx) in
+// each of its modes through the four situations that matter in practice: a
+// cold install (with the DLC deferred), a warm no-op run, a repair of a
+// single damaged file (by the background updater), and a resume of
+// interrupted downloads. For each we also report the wall time, the
+// number of bytes that went over the wire and to disk, and the number of
+// file I/O system calls which makes this double as a benchmark.
+//
+
+struct blob
+{
+  string path;    // Installation-relative path.
+  string content;
+};
+
+// Generate reproducible incompressible content.
+//
+static string
+noise (size_t n, uint32_t seed)
+{
+  mt19937 g (seed);
+  string r (n, '\0');
+
+  for (char& c : r)
+    c = static_cast<char> (g ());
+
+  return r;
+}
+
+static string
+filename (const string& p)
+{
+  return fs::path (p).filename ().string ();
+}
+
+struct fixture
+{
+  mock_server& server;
+  fs::path root;
+  http_client_traits traits;
+
+  vector<blob> client;
+  vector<blob> rawfiles;
+  vector<blob> dlc;
+  vector<blob> helper; // Only synchronized on Linux.
+
+  string client_manifest;
+  string rawfiles_manifest;
+  string dlc_manifest;
+};
+
+#ifdef __linux__
+static const bool helper_synced (true);
+#else
+static const bool helper_synced (false);
+#endif
+
+// Publish a release with the files as assets plus the update manifest
+// listing them and return the manifest.
+//
+static string
+publish (mock_server& s, const string& repo, const vector<blob>& bs)
+{
+  manifest m (manifest_format::update, manifest_format::update);
+  vector<pair<string, string>> as;
+
+  for (const auto& b : bs)
+  {
+    m.files.emplace_back (launcher::hash (blake3_hex (b.content)),
+                          b.content.size (),
+                          b.path,
+                          filename (b.path));
+
+    as.emplace_back (filename (b.path), b.content);
+  }
+
+  string r (m.string ());
+  as.emplace_back ("update.json", r);
+
+  s.publish (repo, "v1.0.0", as);
+  return r;
+}
+
+static void
+publish (fixture& fx)
+{
+  fx.client_manifest = publish (fx.server, "iw4x/iw4x-client", fx.client);
+  fx.rawfiles_manifest = publish (fx.server,
+                                  "iw4x/iw4x-rawfiles",
+                                  fx.rawfiles);
+
+  // The Steam helper release has no manifest, the assets are installed as
+  // is.
+  //
+  {
+    vector<pair<string, string>> as;
+
+    for (const auto& b : fx.helper)
+      as.emplace_back (b.path, b.content);
+
+    fx.server.publish ("iw4x/launcher-steam", "v1.0.0", as);
+  }
+
+  manifest dm (manifest_format::dlc, manifest_format::dlc);
+
+  for (const auto& b : fx.dlc)
+  {
+    dm.files.emplace_back (launcher::hash (blake3_hex (b.content)),
+                           b.content.size (),
+                           b.path);
+
+    fx.server.publish (b.path, b.content);
+  }
+
+  fx.dlc_manifest = dm.string ();
+  fx.server.publish ("update.json", fx.dlc_manifest);
+}
+
+// How to bring the installation up to date, mirroring the launcher's modes.
+//
+enum class sync_mode
+{
+  full,     // Apply everything before launching (--sync-before-launch).
+  deferred, // Apply the boot-critical part, then the rest (the default).
+  daemon    // Stage in a background updater cycle, then apply on request.
+};
+
+// Bring the installation up to date and return the number of files we had to
+// download. If specified, call prepared() with the pending updates before
+// anything is downloaded.
+//
+static asio::awaitable<size_t>
+update (asio::io_context& io,
+        const fixture& fx,
+        sync_mode sm,
+        const function<void (const vector<staged_update>&)>& prepared)
+{
+  github_coordinator gh (io);
+  gh.set_api_base (fx.server.base ());
+
+  http_coordinator hc (io, fx.traits);
+  download_coordinator dc (io, 4, fx.traits);
+
+  auto count ([] (const vector<staged_update>& us)
+  {
+    size_t r (0);
+
+    for (const auto& u : us)
+      for (const auto& i : u.plan)
+        if (i.action == reconcile_action::download)
+          ++r;
+
+    return r;
+  });
+
+  size_t r (0);
+
+  switch (sm)
+  {
+  case sync_mode::full:
+    {
+      cache_coordinator cc (io, fx.root);
+
+      auto us (co_await prepare_all (gh, hc, cc, fx.root, false));
+      r = count (us);
+
+      if (prepared)
+        prepared (us);
+
+      for (const auto& u : us)
+        co_await apply_update (io, dc, nullptr, cc, fx.root, u);
+
+      break;
+    }
+  case sync_mode::deferred:
+    {
+      vector<staged_update> df;
+
+      {
+        cache_coordinator cc (io, fx.root);
+
+        auto us (co_await prepare_all (gh, hc, cc, fx.root, false));
+        r = count (us);
+
+        if (prepared)
+          prepared (us);
+
+        df = co_await apply_critical (io, dc, nullptr, cc, fx.root,
+                                      move (us), {});
+      }
+
+      // Only DLC can wait and none of it is in place yet.
+      //
+      for (const auto& u : df)
+      {
+        assert (u.comp == component_type::dlc);
+
+        for (const auto& i : u.plan)
+          assert (!verify_blake3 (i.path, i.expected_hash));
+      }
+
+      co_await apply_deferred (io, dc, fx.root, df, 0, 4);
+      break;
+    }
+  case sync_mode::daemon:
+    {
+      vector<staged_update> us;
+
+      {
+        cache_coordinator cc (io, fx.root);
+        us = co_await stage_updates (io, gh, hc, dc, cc, fx.root, false);
+        r = count (us);
+
+        if (prepared)
+          prepared (us);
+      }
+
+      // By now everything is staged so applying must not download
+      // anything.
+      //
+      uint64_t n (fx.server.stats ().downloads);
+
+      {
+        cache_coordinator cc (io, fx.root);
+        co_await apply_updates (io, dc, cc, fx.root, us);
+      }
+
+      assert (fx.server.stats ().downloads == n);
+      break;
+    }
+  }
+
+  co_return r;
+}
+
+static size_t
+run (const fixture& fx,
+     sync_mode sm,
+     const function<void (const vector<staged_update>&)>& prepared = {})
+{
+  asio::io_context io;
+  size_t r (0);
+
+  asio::co_spawn (io,
+                  update (io, fx, sm, prepared),
+                  [&r] (exception_ptr e, size_t n)
+  {
+    if (e)
+      rethrow_exception (e);
+
+    r = n;
+  });
+
+  io.run ();
+  return r;
+}
+
+struct measurement
+{
+  string scenario;
+  string scheme;
+  size_t files;
+  chrono::duration<double, milli> wall;
+  mock_server::statistics net;
+  io_counters io;
+};
+
+static vector<measurement> results;
+
+template <typename F>
+static const measurement&
+measure (const string& n, fixture& fx, F&& f)
+{
+  mock_server::statistics s0 (fx.server.stats ());
+  io_counters i0 (io_counters::sample ());
+  auto t0 (chrono::steady_clock::now ());
+
+  size_t r (f ());
+
+  auto t1 (chrono::steady_clock::now ());
+  io_counters i1 (io_counters::sample ());
+  mock_server::statistics s1 (fx.server.stats ());
+
+  mock_server::statistics d;
+  d.requests      = s1.requests      - s0.requests;
+  d.api_requests  = s1.api_requests  - s0.api_requests;
+  d.redirects     = s1.redirects     - s0.redirects;
+  d.downloads     = s1.downloads     - s0.downloads;
+  d.ranges        = s1.ranges        - s0.ranges;
+  d.unsatisfiable = s1.unsatisfiable - s0.unsatisfiable;
+  d.interrupted   = s1.interrupted   - s0.interrupted;
+  d.bytes         = s1.bytes         - s0.bytes;
+
+  results.push_back ({n,
+                      fx.traits.verify_ssl ? "https" : "http",
+                      r,
+                      t1 - t0,
+                      d,
+                      i1 - i0});
+
+  return results.back ();
+}
+
+static void
+overwrite (const fs::path& p, const string& s)
+{
+  ofstream os (p, ios::binary | ios::trunc);
+  os << s;
+  assert (os);
+}
+
+// Leave a partial download behind the way the download manager does: the
+// content received so far plus the transfer state sidecar (see
+// download-manager.cxx for the format).
+//
+static void
+leave_partial (const fs::path& f, const string& c, const string& etag)
+{
+  overwrite (f, c);
+
+  transfer_state s;
+  blake3_hasher_update (&s.hasher, c.data (), c.size ());
+
+  const auto* b (reinterpret_cast<const uint8_t*> (&s.hasher));
+
+  ostringstream h;
+  h << hex << setfill ('0');
+
+  for (size_t i (0); i != sizeof (s.hasher); ++i)
+    h << setw (2) << static_cast<int> (b[i]);
+
+  fs::path p (f);
+  p += ".resume";
+
+  ofstream os (p, ios::binary | ios::trunc);
+
+  os << "iw4x-resume 1\n"
+     << "offset " << c.size () << '\n'
+     << "etag " << etag << '\n'
+     << "last-modified \n"
+     << "prefix " << s.digest () << '\n'
+     << "hasher " << BLAKE3_VERSION_STRING << ' '
+                  << sizeof (s.hasher) << ' ' << h.str () << '\n';
+
+  assert (os);
+}
+
+static void
+scenarios (mock_server& srv, const fs::path& work, bool tls)
+{
+  srv.secure (tls);
+
+  // The client ships the same archive under two paths and it must only be
+  // downloaded once.
+  //
+  fixture fx {srv,
+              work / "root",
+              {},
+              {{"iw4x.dll",                         noise (2 << 20, 1)},
+               {"iw4x/iw_00.iwd",                   noise (4 << 20, 2)},
+               {"iw4x/iw_01.iwd",                   noise (4 << 20, 3)},
+               {"iw4x/iw_02.iwd",                   noise (16 << 20, 4)},
+               {"iw4x/localized_english_iw00.iwd",  noise (512 << 10, 5)},
+               {"zone/english/iw4x_ui.ff",          noise (1 << 20, 6)},
+               {"iw4x/iw_03.iwd",                   noise (4 << 20, 2)}},
+              {{"main/iw_20.iwd",                   noise (2 << 20, 9)},
+               {"main/iw_21.iwd",                   noise (1 << 20, 12)}},
+              {{"zone/dlc/mp_a.ff",                 noise (3 << 20, 7)},
+               {"zone/dlc/mp_b.ff",                 noise (3 << 20, 8)}},
+              {{"steam.exe",                        noise (256 << 10, 10)},
+               {"steam_api64.dll",                  noise (128 << 10, 11)}},
+              {},
+              {},
+              {}};
+
+  const blob& dup (fx.client.back ());
+
+  fs::create_directories (fx.root);
+
+  // The staging area and the cache live in the installation root's cache
+  // directory, which is found from the working directory (just like the
+  // launcher, which runs from the root).
+  //
+  fs::current_path (fx.root);
+
+  configure_cdn (srv.base () + "/cdn/");
+
+  // Exercise both the path with barriers before recording the applied files
+  // (every database commit synchronized as well) and the one without.
+  //
+  configure_durability (tls ? durability_mode::full : durability_mode::none);
+
+  fx.traits.verify_ssl = tls;
+  fx.traits.ssl_cert_file = srv.certificate ().string ();
+
+  publish (fx);
+
+  vector<const blob*> bs;
+
+  for (const auto& b : fx.client)   bs.push_back (&b);
+  for (const auto& b : fx.rawfiles) bs.push_back (&b);
+  for (const auto& b : fx.dlc)      bs.push_back (&b);
+
+  if (helper_synced)
+    for (const auto& b : fx.helper) bs.push_back (&b);
+
+  uint64_t total (0);
+
+  for (const blob* b : bs)
+    total += b->content.size ();
+
+  auto on_disk ([&fx] (const blob& b)
+  {
+    return verify_blake3 (fx.root / b.path, blake3_hex (b.content));
+  });
+
+  // Cold install: everything comes over the wire exactly once, including
+  // the archive the client ships twice. The DLC only
+  // arrives after the boot-critical part is in place.
+  //
+  {
+    const auto& m (measure ("cold-install", fx, [&fx]
+    {
+      return run (fx, sync_mode::deferred);
+    }));
+
+    assert (m.files == bs.size ());
+    assert (m.net.bytes == total - dup.content.size () +
+                           fx.client_manifest.size () +
+                           fx.rawfiles_manifest.size () +
+                           fx.dlc_manifest.size ());
+
+    // Release assets (including the manifests) are redirected to the
+    // object storage, the DLC is not.
+    //
+    assert (m.net.redirects == bs.size () - fx.dlc.size () - 1 + 2);
+
+    for (const blob* b : bs)
+      assert (on_disk (*b));
+  }
+
+  // Warm no-op: only the DLC manifest is fetched.
+  //
+  {
+    const auto& m (measure ("warm-noop", fx, [&fx]
+    {
+      return run (fx, sync_mode::full);
+    }));
+
+    assert (m.files == 0);
+    assert (m.net.bytes == fx.dlc_manifest.size ());
+  }
+
+  // Single-file repair: damage one file (keeping its size so that only the
+  // hash can tell) and expect exactly that file to be fetched again, by the
+  // background updater this time. The client manifest is remembered from
+  // the previous runs so it is not fetched again.
+  //
+  {
+    const blob& b (fx.client[2]);
+    overwrite (fx.root / b.path, noise (b.content.size (), 42));
+
+    const auto& m (measure ("single-repair", fx, [&fx]
+    {
+      return run (fx, sync_mode::daemon);
+    }));
+
+    assert (m.files == 1);
+    assert (m.net.bytes == b.content.size () + fx.dlc_manifest.size ());
+    assert (on_disk (b));
+  }
+
+  // Interrupted resume: the largest file is cut off half way and must be
+  // resumed (206) rather than restarted. A DLC file with a bogus full-size
+  // file in its staging slot (whose sidecar still matches the entity) must
+  // be discarded and downloaded again rather than trusted.
+  //
+  {
+    const blob& c (fx.client[3]);
+    const blob& d (fx.dlc[1]);
+
+    fs::remove (fx.root / c.path);
+    fs::remove (fx.root / d.path);
+
+    srv.interrupt (filename (c.path), c.content.size () / 2);
+
+    auto bogus ([&fx, &d] (const vector<staged_update>& us)
+    {
+      for (const auto& u : us)
+      {
+        for (const auto& i : u.plan)
+        {
+          if (fs::path (i.path).filename () != filename (d.path))
+            continue;
+
+          vector<staged_file> fs (staged_files ({i}, staging_directory ()));
+
+          leave_partial (fs.front ().tmp,
+                         noise (d.content.size (), 43),
+                         fx.server.etag (filename (d.path)));
+        }
+      }
+    });
+
+    const auto& m (measure ("interrupted-resume", fx, [&fx, &bogus]
+    {
+      return run (fx, sync_mode::full, bogus);
+    }));
+
+    assert (m.files == 2);
+    assert (m.net.interrupted == 1);
+    assert (m.net.ranges == 1);
+    assert (m.net.unsatisfiable == 0);
+    assert (m.net.bytes == c.content.size () +
+                           d.content.size () +
+                           fx.dlc_manifest.size ());
+    assert (on_disk (c));
+    assert (on_disk (d));
+  }
+}
+
+// The client is expected to wait for the rate limit window to reset rather
+// than keep hitting the API.
+//
+static void
+rate_limit (mock_server& srv)
+{
+  srv.rate_limit (1, chrono::seconds (1));
+
+  asio::io_context io;
+  github_coordinator gh (io);
+  gh.set_api_base (srv.base ());
+
+  uint64_t r0 (srv.stats ().rate_limited);
+  auto t0 (chrono::steady_clock::now ());
+
+  asio::co_spawn (io,
+                  [&gh] () -> asio::awaitable<void>
+  {
+    auto x (co_await gh.fetch_latest_release ("iw4x", "iw4x-client"));
+    auto y (co_await gh.fetch_latest_release ("iw4x", "iw4x-client"));
+    assert (x.tag_name == y.tag_name);
+  },
+                  [] (exception_ptr e)
+  {
+    if (e)
+      rethrow_exception (e);
+  });
+
+  io.run ();
+
+  assert (srv.stats ().rate_limited == r0);
+  assert (chrono::steady_clock::now () - t0 >= chrono::seconds (1));
+
+  srv.rate_limit (5000, chrono::seconds (3600));
+}
+
+static void
+report ()
+{
+  cout << left
+       << setw (20) << "scenario"
+       << setw (7)  << "scheme"
+       << right
+       << setw (7)  << "files"
+       << setw (12) << "wall (ms)"
+       << setw (8)  << "reqs"
+       << setw (14) << "net (bytes)"
+       << setw (14) << "disk (bytes)"
+       << setw (10) << "syscalls"
+       << '\n';
+
+  for (const auto& m : results)
+  {
+    cout << left
+         << setw (20) << m.scenario
+         << setw (7)  << m.scheme
+         << right
+         << setw (7)  << m.files
+         << setw (12) << fixed << setprecision (1) << m.wall.count ()
+         << setw (8)  << m.net.requests
+         << setw (14) << m.net.bytes
+         << setw (14) << m.io.wchar
+         << setw (10) << m.io.syscalls ()
+         << '\n';
+  }
+}
+
+int
+main ()
+{
+  fs::path work (fs::temp_directory_path () /
+                 ("iw4x-e2e-" + to_string (random_device {} ())));
+
+  // The scenarios change into the installation root so restore the working
+  // directory before cleaning up.
+  //
+  fs::path cwd (fs::current_path ());
+  int r (0);
+
+  try
+  {
+    mock_server srv;
+
+    scenarios (srv, work / "http", false);
+    scenarios (srv, work / "https", true);
+    rate_limit (srv);
+
+    report ();
+  }
+  catch (const exception& e)
+  {
+    cerr << "error: " << e.what () << endl;
+    r = 1;
+  }
+
+  error_code ec;
+  fs::current_path (cwd, ec);
+  fs::remove_all (work, ec);
+
+  return r;
+}
@@ -10,6 +10,7 @@
 
 #include <launcher/github/github-api.hxx>
 #include <launcher/launcher-http.hxx>
+#include <launcher/launcher-log.hxx>
 #include <launcher/manifest/manifest.hxx>
 
 using namespace std;
@@ -42,17 +43,72 @@ namespace launcher
     api_.set_proxy (move (u));
   }
 
+  void github_coordinator::
+  set_api_base (string u)
+  {
+    api_.set_api_base (move (u));
+  }
+
   void github_coordinator::
   set_progress_callback (progress_callback_type cb)
   {
     api_.set_progress_callback (move (cb));
   }
 
+  void github_coordinator::
+  set_wait_on_rate_limit (bool w)
+  {
+    api_.set_wait_on_rate_limit (w);
+  }
+
+  void github_coordinator::
+  set_deadline (chrono::milliseconds d)
+  {
+    deadline_ = d;
+  }
+
+  chrono::milliseconds github_coordinator::
+  deadline () const noexcept
+  {
+    return deadline_;
+  }
+
+  void github_coordinator::
+  set_release_index (shared_ptr<github_index> i)
+  {
+    index_ = move (i);
+  }
+
   asio::awaitable<github_coordinator::release_type> github_coordinator::
   fetch_latest_release (const string& own,
                         const string& rep,
                         bool pre)
   {
+    // The index is a single (cacheable) request for everything so try it
+    // first. If it is unusable, we fall back to the API for the rest of the
+    // run rather than fetching it again for every repository.
+    //
+    if (index_ != nullptr)
+    {
+      optional<release_type> r;
+
+      try
+      {
+        r = co_await index_->find_latest_release (own, rep, pre);
+      }
+      catch (const exception& e)
+      {
+        launcher::log::warning (categories::github {},
+                                "unable to use release index {}: {}",
+                                index_->url (),
+                                e.what ());
+        index_.reset ();
+      }
+
+      if (r)
+        co_return *r;
+    }
+
     // GitHub's "latest" endpoint strictly returns the most recent stable
     // release. If we are willing to accept a pre-release (e.g., for staging
     // or nightly builds), we can't use that shortcut. We have to list them
@@ -87,6 +143,13 @@ namespace launcher
 
   asio::awaitable<manifest> github_coordinator::
   fetch_manifest (const release_type& r, manifest_format fmt)
+  {
+    string s (co_await fetch_manifest_text (r));
+    co_return load_manifest (r, s, fmt);
+  }
+
+  asio::awaitable<string> github_coordinator::
+  fetch_manifest_text (const release_type& r)
   {
     // In the standard layout, the manifest is always named 'update.json'.
     //
@@ -97,15 +160,28 @@ namespace launcher
       throw runtime_error ("manifest asset '" + n + "' not found in " +
                            r.tag_name);
 
-    // Download, parse, and then stitch the URLs.
+    http_coordinator h (ioc_);
+    string s (co_await h.get (a->browser_download_url));
+
+    if (s.empty ())
+      throw runtime_error ("manifest is empty");
+
+    co_return s;
+  }
+
+  manifest github_coordinator::
+  load_manifest (const release_type& r,
+                 const string& s,
+                 manifest_format fmt) const
+  {
+    // Parse and then stitch the URLs.
     //
-    manifest m (
-      co_await download_and_parse_manifest (a->browser_download_url, fmt));
+    manifest m (s, fmt);
 
     m.link_files ();
     resolve_manifest_urls (m, r);
 
-    co_return m;
+    return m;
   }
 
   asio::awaitable<manifest> github_coordinator::
@@ -1,15 +1,18 @@
 #pragma once
 
 #include <launcher/github/github-api.hxx>
+#include <launcher/github/github-index.hxx>
 #include <launcher/manifest/manifest.hxx>
 
 #include <boost/asio.hpp>
 
+#include <chrono>
 #include <string>
 #include <optional>
 #include <vector>
 #include <regex>
 #include <functional>
+#include <memory>
 
 namespace launcher
 {
@@ -45,6 +48,11 @@ namespace launcher
     void
     set_proxy (std::string proxy_url);
 
+    // Set API base URL (for example, a local mirror or test server).
+    //
+    void
+    set_api_base (std::string base_url);
+
     // Set progress callback for rate limit notifications.
     //
     using progress_callback_type =
@@ -53,6 +61,30 @@ namespace launcher
     void
     set_progress_callback (progress_callback_type callback);
 
+    // Fail instead of waiting when the rate limit is exhausted.
+    //
+    void
+    set_wait_on_rate_limit (bool wait);
+
+    // Set how long callers that have a fallback (for example, the release
+    // resolved on the previous run) are prepared to wait for the API. Zero
+    // means no deadline.
+    //
+    void
+    set_deadline (std::chrono::milliseconds deadline);
+
+    std::chrono::milliseconds
+    deadline () const noexcept;
+
+    // Consult a static release index before the API.
+    //
+    // Repositories listed in the index are resolved from it. Anything else
+    // (or everything, if the index cannot be fetched or verified) goes to
+    // the API.
+    //
+    void
+    set_release_index (std::shared_ptr<github_index> index);
+
     // Fetch latest release.
     //
     // If include_prerelease is true, returns the most recent release
@@ -81,6 +113,21 @@ namespace launcher
     fetch_manifest (const release_type& release,
                     manifest_format kind = manifest_format::update);
 
+    // Fetch raw manifest text from release.
+    //
+    // Like fetch_manifest() but returns the unparsed asset content so that
+    // it can be stored and turned into a manifest later with load_manifest().
+    //
+    asio::awaitable<std::string>
+    fetch_manifest_text (const release_type& release);
+
+    // Parse manifest text that belongs to release.
+    //
+    manifest
+    load_manifest (const release_type& release,
+                   const std::string& text,
+                   manifest_format kind = manifest_format::update) const;
+
     // Fetch manifest by pattern.
     //
     // Searches for an asset matching the given regex pattern.
@@ -140,6 +187,8 @@ namespace launcher
 
     asio::io_context& ioc_;
     api_type api_;
+    std::chrono::milliseconds deadline_ {0};
+    std::shared_ptr<github_index> index_;
   };
 
   // Find all assets matching a pattern.
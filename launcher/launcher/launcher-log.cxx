@@ -115,6 +115,12 @@ namespace launcher
                          pf,
                          log::policy<update>::threshold);
 
+    log::detail::logger<daemon> () =
+      register_category (string (log::policy<daemon>::name),
+                         {fs},
+                         pf,
+                         log::policy<daemon>::threshold);
+
     // In development builds, drop the runtime threshold on every category so
     // trace statements compiled in by the minimum-level guard actually reach
     // the sinks.
@@ -129,6 +135,7 @@ namespace launcher
     log::detail::logger<progress> ()->set_log_level (LogLevel::TraceL3);
     log::detail::logger<steam>    ()->set_log_level (LogLevel::TraceL3);
     log::detail::logger<update>   ()->set_log_level (LogLevel::TraceL3);
+    log::detail::logger<daemon>   ()->set_log_level (LogLevel::TraceL3);
 #endif
   }
 
@@ -146,6 +153,7 @@ namespace launcher
     log::detail::logger<progress> () = nullptr;
     log::detail::logger<steam>    () = nullptr;
     log::detail::logger<update>   () = nullptr;
+    log::detail::logger<daemon>   () = nullptr;
 
     Backend::stop ();
   }
@@ -0,0 +1,1089 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/beast.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/json.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace launcher
+{
+  namespace fs = std::filesystem;
+  namespace asio = boost::asio;
+  namespace beast = boost::beast;
+  namespace ssl = asio::ssl;
+
+  // I/O counters as reported by /proc/<pid>/io on Linux (all zero
+  // elsewhere).
+  //
+  // Note that the kernel only accounts the read(2)/write(2) family in syscr
+  // and syscw and not sendmsg(2)/recvmsg(2) which is what asio uses for
+  // sockets. So in practice these are the file I/O system calls.
+  //
+  struct io_counters
+  {
+    std::uint64_t rchar = 0;
+    std::uint64_t wchar = 0;
+    std::uint64_t syscr = 0;
+    std::uint64_t syscw = 0;
+
+    std::uint64_t
+    syscalls () const noexcept
+    {
+      return syscr + syscw;
+    }
+
+    io_counters
+    operator- (const io_counters& x) const noexcept
+    {
+      io_counters r;
+      r.rchar = rchar - x.rchar;
+      r.wchar = wchar - x.wchar;
+      r.syscr = syscr - x.syscr;
+      r.syscw = syscw - x.syscw;
+      return r;
+    }
+
+    static io_counters
+    sample ()
+    {
+      io_counters r;
+
+#ifdef __linux__
+      std::ifstream is ("/proc/self/io");
+
+      for (std::string k; is >> k; )
+      {
+        std::uint64_t v (0);
+        is >> v;
+
+        if      (k == "rchar:") r.rchar = v;
+        else if (k == "wchar:") r.wchar = v;
+        else if (k == "syscr:") r.syscr = v;
+        else if (k == "syscw:") r.syscw = v;
+      }
+#endif
+
+      return r;
+    }
+  };
+
+  // Local stand-in for the GitHub REST API, the release asset storage, and
+  // the DLC CDN.
+  //
+  // We listen on two loopback ports, one plaintext and one TLS (with a
+  // self-signed certificate generated on startup), and serve everything from
+  // memory on a dedicated thread. The routes mirror what the launcher talks
+  // to in production:
+  //
+  // /repos/<owner>/<repo>/releases[/latest|/tags/<tag>]
+  //
+  //   Release JSON with the x-ratelimit-* headers. Once the configured budget
+  //   is exhausted we answer with 403 until the window resets.
+  //
+  // /<owner>/<repo>/releases/download/<tag>/<name>
+  //
+  //   Redirect (302) to the object storage, just like GitHub does.
+  //
+  // /objects/<owner>/<repo>/<tag>/<name>
+  // /cdn/<path>
+  //
+  //   Asset and CDN content with Range support (206 and 416). Every object
+  //   carries an ETag (which changes when it is replaced) as well as a fixed
+  //   Last-Modified and If-Range is honored.
+  //
+  // For fault injection a response can be cut short after the specified
+  // number of body bytes (see interrupt()) which is what an interrupted
+  // download looks like from the client side.
+  //
+  class mock_server
+  {
+  public:
+    struct statistics
+    {
+      std::uint64_t connections   = 0;
+      std::uint64_t requests      = 0;
+      std::uint64_t api_requests  = 0;
+      std::uint64_t rate_limited  = 0;
+      std::uint64_t redirects     = 0;
+      std::uint64_t downloads     = 0; // 200 and 206 content responses.
+      std::uint64_t ranges        = 0; // 206 responses.
+      std::uint64_t unsatisfiable = 0; // 416 responses.
+      std::uint64_t interrupted   = 0;
+      std::uint64_t bytes         = 0; // Content body bytes sent.
+    };
+
+    mock_server ()
+      : tls_ (ssl::context::tls_server),
+        plain_ (ioc_, {asio::ip::address_v4::loopback (), 0}),
+        secure_ (ioc_, {asio::ip::address_v4::loopback (), 0})
+    {
+      certify ();
+
+      asio::co_spawn (ioc_, accept (plain_, false), asio::detached);
+      asio::co_spawn (ioc_, accept (secure_, true), asio::detached);
+
+      thread_ = std::thread ([this] {ioc_.run ();});
+    }
+
+    mock_server (const mock_server&) = delete;
+    mock_server& operator= (const mock_server&) = delete;
+
+    ~mock_server ()
+    {
+      ioc_.stop ();
+
+      if (thread_.joinable ())
+        thread_.join ();
+
+      std::error_code ec;
+      fs::remove (cert_, ec);
+    }
+
+    std::string
+    http_base () const
+    {
+      return "http://127.0.0.1:" + std::to_string (plain_.local_endpoint ().port ());
+    }
+
+    std::string
+    https_base () const
+    {
+      return "https://127.0.0.1:" + std::to_string (secure_.local_endpoint ().port ());
+    }
+
+    // Base URL for the links we hand out (asset URLs, redirects), depending
+    // on whether we are in the TLS mode (the default).
+    //
+    std::string
+    base () const
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      return tls_links_ ? https_base () : http_base ();
+    }
+
+    void
+    secure (bool v)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      tls_links_ = v;
+    }
+
+    // PEM file with the self-signed certificate, suitable for
+    // http_client_traits::ssl_cert_file.
+    //
+    const fs::path&
+    certificate () const noexcept
+    {
+      return cert_;
+    }
+
+    // Publish a release of the specified repository ("owner/name") with the
+    // specified assets (name to content). The latest published release is
+    // what /releases/latest returns.
+    //
+    void
+    publish (const std::string& repo,
+             const std::string& tag,
+             const std::vector<std::pair<std::string, std::string>>& assets)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+
+      release r {tag, ++release_id_, {}};
+
+      for (const auto& [n, c] : assets)
+      {
+        std::string k ("/objects/" + repo + '/' + tag + '/' + n);
+
+        r.assets.push_back (n);
+        objects_[k] = c;
+        etags_[k] = next_etag ();
+      }
+
+      releases_[repo].push_back (std::move (r));
+    }
+
+    // Publish (or replace) a file on the CDN.
+    //
+    void
+    publish (const std::string& path, std::string content)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      objects_["/cdn/" + path] = std::move (content);
+      etags_["/cdn/" + path] = next_etag ();
+    }
+
+    // Replace the content of a published object (release asset name or CDN
+    // path) without changing anything else.
+    //
+    void
+    replace (const std::string& name, std::string content)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+
+      for (auto& [k, v] : objects_)
+      {
+        if (k.ends_with ('/' + name))
+        {
+          v = content;
+          etags_[k] = next_etag ();
+        }
+      }
+    }
+
+    // Return the ETag of a published object (release asset name or CDN
+    // path) or empty if there is no such object.
+    //
+    std::string
+    etag (const std::string& name) const
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+
+      for (const auto& [k, v] : etags_)
+      {
+        if (k.ends_with ('/' + name))
+          return v;
+      }
+
+      return std::string ();
+    }
+
+    // Configure the API rate limit: the number of requests allowed per
+    // window.
+    //
+    void
+    rate_limit (std::uint64_t limit, std::chrono::seconds window)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      limit_ = limit;
+      remaining_ = limit;
+      window_ = window;
+      reset_ = std::chrono::system_clock::now () + window;
+    }
+
+    // Cut the next response for the object (release asset name or CDN path)
+    // short after the specified number of body bytes.
+    //
+    void
+    interrupt (const std::string& name, std::uint64_t after)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      faults_[name] = after;
+    }
+
+    statistics
+    stats () const
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      return stats_;
+    }
+
+  private:
+    using tcp = asio::ip::tcp;
+
+    struct release
+    {
+      std::string tag;
+      std::uint64_t id;
+      std::vector<std::string> assets;
+    };
+
+    struct reply
+    {
+      beast::http::response<beast::http::string_body> r;
+      std::optional<std::uint64_t> cut; // Interrupt after this many bytes.
+    };
+
+    // Generate a throw-away key and a self-signed certificate for 127.0.0.1,
+    // install them into the TLS context and write the certificate out for
+    // the client.
+    //
+    void
+    certify ()
+    {
+      auto fail ([] (const char* w) {throw std::runtime_error (w);});
+
+      std::unique_ptr<EVP_PKEY_CTX, decltype (&EVP_PKEY_CTX_free)> kc (
+        EVP_PKEY_CTX_new_id (EVP_PKEY_EC, nullptr), &EVP_PKEY_CTX_free);
+
+      EVP_PKEY* kp (nullptr);
+
+      if (kc == nullptr ||
+          EVP_PKEY_keygen_init (kc.get ()) <= 0 ||
+          EVP_PKEY_CTX_set_ec_paramgen_curve_nid (kc.get (),
+                                                  NID_X9_62_prime256v1) <= 0 ||
+          EVP_PKEY_keygen (kc.get (), &kp) <= 0)
+        fail ("unable to generate key");
+
+      std::unique_ptr<EVP_PKEY, decltype (&EVP_PKEY_free)> k (kp,
+                                                              &EVP_PKEY_free);
+      std::unique_ptr<X509, decltype (&X509_free)> x (X509_new (),
+                                                      &X509_free);
+
+      X509_set_version (x.get (), 2);
+      ASN1_INTEGER_set (X509_get_serialNumber (x.get ()), 1);
+      X509_gmtime_adj (X509_getm_notBefore (x.get ()), -60);
+      X509_gmtime_adj (X509_getm_notAfter (x.get ()), 24 * 60 * 60);
+      X509_set_pubkey (x.get (), k.get ());
+
+      X509_NAME* n (X509_get_subject_name (x.get ()));
+      X509_NAME_add_entry_by_txt (
+        n, "CN", MBSTRING_ASC,
+        reinterpret_cast<const unsigned char*> ("127.0.0.1"), -1, -1, 0);
+      X509_set_issuer_name (x.get (), n);
+
+      X509V3_CTX xc;
+      X509V3_set_ctx_nodb (&xc);
+      X509V3_set_ctx (&xc, x.get (), x.get (), nullptr, nullptr, 0);
+
+      for (const auto& [id, v] : {std::pair {NID_subject_alt_name, "IP:127.0.0.1"},
+                                 std::pair {NID_basic_constraints, "critical,CA:TRUE"}})
+      {
+        X509_EXTENSION* e (X509V3_EXT_conf_nid (nullptr, &xc, id, v));
+
+        if (e == nullptr)
+          fail ("unable to create certificate extension");
+
+        X509_add_ext (x.get (), e, -1);
+        X509_EXTENSION_free (e);
+      }
+
+      if (X509_sign (x.get (), k.get (), EVP_sha256 ()) <= 0)
+        fail ("unable to sign certificate");
+
+      auto pem ([] (auto&& w)
+      {
+        std::unique_ptr<BIO, decltype (&BIO_free)> b (BIO_new (BIO_s_mem ()),
+                                                      &BIO_free);
+        w (b.get ());
+
+        char* d (nullptr);
+        long n (BIO_get_mem_data (b.get (), &d));
+        return std::string (d, static_cast<std::size_t> (n));
+      });
+
+      std::string cp (pem ([&x] (BIO* b) {PEM_write_bio_X509 (b, x.get ());}));
+      std::string kd (pem ([&k] (BIO* b) {
+        PEM_write_bio_PrivateKey (b, k.get (), nullptr, nullptr, 0, nullptr,
+                                  nullptr);}));
+
+      tls_.use_certificate_chain (asio::buffer (cp));
+      tls_.use_private_key (asio::buffer (kd), ssl::context::pem);
+
+      cert_ = fs::temp_directory_path () /
+        ("iw4x-mock-" + std::to_string (secure_.local_endpoint ().port ()) +
+         ".pem");
+
+      std::ofstream os (cert_, std::ios::binary | std::ios::trunc);
+      os << cp;
+
+      if (!os)
+        fail ("unable to write certificate");
+    }
+
+    asio::awaitable<void>
+    accept (tcp::acceptor& a, bool tls)
+    {
+      for (;;)
+      {
+        boost::system::error_code ec;
+        tcp::socket s (
+          co_await a.async_accept (asio::redirect_error (asio::use_awaitable,
+                                                         ec)));
+        if (ec)
+        {
+          if (ec == asio::error::operation_aborted)
+            co_return;
+
+          continue;
+        }
+
+        // Don't let Nagle's algorithm (interacting with delayed ACKs on the
+        // client side) skew the timings of small responses.
+        //
+        s.set_option (tcp::no_delay (true), ec);
+
+        {
+          std::lock_guard<std::mutex> l (mutex_);
+          stats_.connections++;
+        }
+
+        if (tls)
+          asio::co_spawn (ioc_, session_tls (std::move (s)), asio::detached);
+        else
+          asio::co_spawn (ioc_,
+                          session (beast::tcp_stream (std::move (s))),
+                          asio::detached);
+      }
+    }
+
+    asio::awaitable<void>
+    session_tls (tcp::socket s)
+    {
+      beast::ssl_stream<beast::tcp_stream> ts (beast::tcp_stream (std::move (s)),
+                                               tls_);
+      try
+      {
+        co_await ts.async_handshake (ssl::stream_base::server,
+                                     asio::use_awaitable);
+      }
+      catch (const std::exception&)
+      {
+        co_return;
+      }
+
+      co_await session (std::move (ts));
+    }
+
+    template <typename S>
+    asio::awaitable<void>
+    session (S s)
+    {
+      namespace http = beast::http;
+
+      try
+      {
+        beast::flat_buffer b;
+
+        for (;;)
+        {
+          http::request<http::empty_body> rq;
+          co_await http::async_read (s, b, rq, asio::use_awaitable);
+
+          reply rp (respond (rq));
+          rp.r.keep_alive (rq.keep_alive () && !rp.cut);
+
+          if (!rp.cut)
+          {
+            rp.r.prepare_payload ();
+            co_await http::async_write (s, rp.r, asio::use_awaitable);
+
+            if (!rq.keep_alive ())
+              break;
+
+            continue;
+          }
+
+          // Send the headers claiming the full length, then only part of the
+          // body, and drop the connection.
+          //
+          std::string bd (std::move (rp.r.body ()));
+          http::response<http::empty_body> h (std::move (rp.r.base ()));
+          h.content_length (bd.size ());
+
+          http::response_serializer<http::empty_body> sr (h);
+          co_await http::async_write_header (s, sr, asio::use_awaitable);
+          co_await asio::async_write (s,
+                                      asio::buffer (bd.data (), *rp.cut),
+                                      asio::use_awaitable);
+          break;
+        }
+      }
+      catch (const std::exception&)
+      {
+        // Client went away. That's fine.
+      }
+
+      boost::system::error_code ec;
+      beast::get_lowest_layer (s).socket ().shutdown (tcp::socket::shutdown_both,
+                                                      ec);
+      beast::get_lowest_layer (s).close ();
+    }
+
+    reply
+    respond (const beast::http::request<beast::http::empty_body>& rq)
+    {
+      namespace http = beast::http;
+      using namespace std::chrono;
+
+      std::lock_guard<std::mutex> l (mutex_);
+
+      stats_.requests++;
+
+      std::string t (rq.target ());
+
+      // Absolute-form target as sent to a forward proxy (see mock_proxy).
+      //
+      if (std::size_t p = t.find ("://"); p != std::string::npos)
+      {
+        std::size_t s (t.find ('/', p + 3));
+        t.erase (0, s != std::string::npos ? s : t.size ());
+      }
+
+      if (std::size_t q = t.find ('?'); q != std::string::npos)
+        t.resize (q);
+
+      reply rp;
+      rp.r.version (rq.version ());
+      rp.r.set (http::field::server, "iw4x-mock");
+
+      auto status ([&rp] (http::status s, std::string m)
+      {
+        rp.r.result (s);
+        rp.r.set (http::field::content_type, "application/json");
+        rp.r.body () = boost::json::serialize (
+          boost::json::object {{"message", std::move (m)}});
+      });
+
+      std::vector<std::string> ps;
+      {
+        std::istringstream is (t);
+        for (std::string p; std::getline (is, p, '/'); )
+          if (!p.empty ())
+            ps.push_back (std::move (p));
+      }
+
+      // /repos/<owner>/<repo>/releases...
+      //
+      if (ps.size () >= 4 && ps[0] == "repos" && ps[3] == "releases")
+      {
+        stats_.api_requests++;
+
+        auto now (system_clock::now ());
+
+        if (now >= reset_)
+        {
+          remaining_ = limit_;
+          reset_ = now + window_;
+        }
+
+        auto rs (duration_cast<seconds> (reset_.time_since_epoch ()).count ());
+
+        rp.r.set ("x-ratelimit-limit", std::to_string (limit_));
+        rp.r.set ("x-ratelimit-reset", std::to_string (rs));
+        rp.r.set ("x-ratelimit-resource", "core");
+
+        if (remaining_ == 0)
+        {
+          stats_.rate_limited++;
+          rp.r.set ("x-ratelimit-remaining", "0");
+          rp.r.set ("x-ratelimit-used", std::to_string (limit_));
+          status (http::status::forbidden, "API rate limit exceeded");
+          return rp;
+        }
+
+        --remaining_;
+        rp.r.set ("x-ratelimit-remaining", std::to_string (remaining_));
+        rp.r.set ("x-ratelimit-used", std::to_string (limit_ - remaining_));
+
+        auto i (releases_.find (ps[1] + '/' + ps[2]));
+
+        if (i == releases_.end () || i->second.empty ())
+        {
+          status (http::status::not_found, "Not Found");
+          return rp;
+        }
+
+        const auto& rl (i->second);
+        const std::string repo (i->first);
+
+        auto json ([this, &repo] (const release& r)
+        {
+          boost::json::array as;
+          std::uint64_t id (r.id * 1000);
+
+          for (const auto& n : r.assets)
+          {
+            const std::string& c (objects_["/objects/" + repo + '/' + r.tag +
+                                           '/' + n]);
+            as.push_back (boost::json::object {
+              {"id", ++id},
+              {"name", n},
+              {"state", "uploaded"},
+              {"content_type", "application/octet-stream"},
+              {"size", c.size ()},
+              {"browser_download_url",
+               base_unlocked () + '/' + repo + "/releases/download/" + r.tag +
+                 '/' + n}});
+          }
+
+          return boost::json::object {{"id", r.id},
+                                      {"tag_name", r.tag},
+                                      {"name", r.tag},
+                                      {"draft", false},
+                                      {"prerelease", false},
+                                      {"assets", std::move (as)}};
+        });
+
+        rp.r.result (http::status::ok);
+        rp.r.set (http::field::content_type, "application/json");
+
+        if (ps.size () == 4)
+        {
+          boost::json::array a;
+          for (auto j (rl.rbegin ()); j != rl.rend (); ++j)
+            a.push_back (json (*j));
+
+          rp.r.body () = boost::json::serialize (a);
+        }
+        else if (ps.size () == 5 && ps[4] == "latest")
+          rp.r.body () = boost::json::serialize (json (rl.back ()));
+        else if (ps.size () == 6 && ps[4] == "tags")
+        {
+          auto j (std::find_if (rl.begin (), rl.end (),
+                                [&ps] (const release& r)
+          {
+            return r.tag == ps[5];
+          }));
+
+          if (j == rl.end ())
+            status (http::status::not_found, "Not Found");
+          else
+            rp.r.body () = boost::json::serialize (json (*j));
+        }
+        else
+          status (http::status::not_found, "Not Found");
+
+        return rp;
+      }
+
+      // /<owner>/<repo>/releases/download/<tag>/<name>
+      //
+      if (ps.size () == 6 && ps[2] == "releases" && ps[3] == "download")
+      {
+        std::string o ("/objects/" + ps[0] + '/' + ps[1] + '/' + ps[4] + '/' +
+                       ps[5]);
+
+        if (objects_.find (o) == objects_.end ())
+        {
+          status (http::status::not_found, "Not Found");
+          return rp;
+        }
+
+        stats_.redirects++;
+        rp.r.result (http::status::found);
+        rp.r.set (http::field::location, base_unlocked () + o);
+        return rp;
+      }
+
+      // Content.
+      //
+      auto i (objects_.find (t));
+
+      if (i == objects_.end ())
+      {
+        status (http::status::not_found, "Not Found");
+        return rp;
+      }
+
+      const std::string& c (i->second);
+      const std::string& et (etags_[t]);
+      std::uint64_t n (c.size ());
+      std::uint64_t b (0);
+
+      rp.r.set (http::field::accept_ranges, "bytes");
+      rp.r.set (http::field::content_type, "application/octet-stream");
+      rp.r.set (http::field::etag, et);
+      rp.r.set (http::field::last_modified, last_modified);
+
+      // A range with a validator that doesn't match is ignored and the whole
+      // entity is sent instead (RFC 9110 13.1.5).
+      //
+      std::string ir (rq[http::field::if_range]);
+      bool rg (ir.empty () || ir == et || ir == last_modified);
+
+      if (auto rh (rq[http::field::range]); !rh.empty () && rg)
+      {
+        // We only support the single open-ended form (bytes=<first>-) which
+        // is what the launcher sends.
+        //
+        std::string r (rh);
+
+        if (r.starts_with ("bytes=") && r.ends_with ('-'))
+          b = std::stoull (r.substr (6, r.size () - 7));
+
+        if (b >= n)
+        {
+          stats_.unsatisfiable++;
+          rp.r.result (http::status::range_not_satisfiable);
+          rp.r.set (http::field::content_range,
+                    "bytes */" + std::to_string (n));
+          return rp;
+        }
+
+        stats_.ranges++;
+        rp.r.result (http::status::partial_content);
+        rp.r.set (http::field::content_range,
+                  "bytes " + std::to_string (b) + '-' +
+                  std::to_string (n - 1) + '/' + std::to_string (n));
+      }
+      else
+        rp.r.result (http::status::ok);
+
+      stats_.downloads++;
+      rp.r.body () = c.substr (b);
+
+      std::uint64_t sz (rp.r.body ().size ());
+
+      for (auto f (faults_.begin ()); f != faults_.end (); ++f)
+      {
+        if (t.ends_with ('/' + f->first))
+        {
+          if (f->second < sz)
+          {
+            rp.cut = f->second;
+            sz = f->second;
+            stats_.interrupted++;
+          }
+
+          faults_.erase (f);
+          break;
+        }
+      }
+
+      stats_.bytes += sz;
+      return rp;
+    }
+
+    std::string
+    base_unlocked () const
+    {
+      return tls_links_ ? https_base () : http_base ();
+    }
+
+    std::string
+    next_etag ()
+    {
+      return '"' + std::to_string (++etag_id_) + '"';
+    }
+
+    static constexpr const char* last_modified =
+      "Mon, 01 Jan 2024 00:00:00 GMT";
+
+  private:
+    asio::io_context ioc_;
+    ssl::context tls_;
+    tcp::acceptor plain_;
+    tcp::acceptor secure_;
+    std::thread thread_;
+    fs::path cert_;
+
+    mutable std::mutex mutex_;
+    bool tls_links_ = true;
+
+    std::map<std::string, std::vector<release>> releases_;
+    std::map<std::string, std::string> objects_;
+    std::map<std::string, std::string> etags_;
+    std::uint64_t etag_id_ = 0;
+    std::map<std::string, std::uint64_t> faults_;
+    std::uint64_t release_id_ = 0;
+
+    std::uint64_t limit_ = 5000;
+    std::uint64_t remaining_ = 5000;
+    std::chrono::seconds window_ {3600};
+    std::chrono::system_clock::time_point reset_ {};
+
+    statistics stats_;
+  };
+
+  // Loopback proxy stub that speaks just enough of SOCKS5 (RFC 1928, no
+  // authentication) and HTTP (CONNECT tunnels as well as absolute-form
+  // forward requests) to put a real proxy hop between the client and
+  // mock_server. Like the server it runs in its own thread.
+  //
+  // Once the upstream connection is established, bytes are relayed blindly
+  // in both directions. In particular, a forward proxy connection stays with
+  // the first origin, which is all the client needs since it doesn't reuse
+  // download connections.
+  //
+  class mock_proxy
+  {
+  public:
+    struct statistics
+    {
+      std::uint64_t connections = 0;
+      std::uint64_t socks       = 0; // SOCKS5 CONNECT requests.
+      std::uint64_t tunnels     = 0; // HTTP CONNECT requests.
+      std::uint64_t forwards    = 0; // Absolute-form HTTP requests.
+      std::uint64_t bytes       = 0; // Bytes relayed (both directions).
+    };
+
+    mock_proxy ()
+      : acceptor_ (ioc_, {asio::ip::address_v4::loopback (), 0})
+    {
+      asio::co_spawn (ioc_, accept (), asio::detached);
+      thread_ = std::thread ([this] {ioc_.run ();});
+    }
+
+    mock_proxy (const mock_proxy&) = delete;
+    mock_proxy& operator= (const mock_proxy&) = delete;
+
+    ~mock_proxy ()
+    {
+      ioc_.stop ();
+
+      if (thread_.joinable ())
+        thread_.join ();
+    }
+
+    // Proxy URL for http_client_traits::proxy_url with the specified scheme
+    // (http or socks5).
+    //
+    std::string
+    url (const std::string& scheme) const
+    {
+      return scheme + "://127.0.0.1:" +
+        std::to_string (acceptor_.local_endpoint ().port ());
+    }
+
+    statistics
+    stats () const
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      return stats_;
+    }
+
+  private:
+    using tcp = asio::ip::tcp;
+    using socket_ptr = std::shared_ptr<tcp::socket>;
+
+    asio::awaitable<void>
+    accept ()
+    {
+      for (;;)
+      {
+        boost::system::error_code ec;
+        tcp::socket s (
+          co_await acceptor_.async_accept (
+            asio::redirect_error (asio::use_awaitable, ec)));
+        if (ec)
+        {
+          if (ec == asio::error::operation_aborted)
+            co_return;
+
+          continue;
+        }
+
+        // As in mock_server, keep Nagle out of the picture.
+        //
+        s.set_option (tcp::no_delay (true), ec);
+
+        {
+          std::lock_guard<std::mutex> l (mutex_);
+          stats_.connections++;
+        }
+
+        asio::co_spawn (ioc_,
+                        session (std::make_shared<tcp::socket> (std::move (s))),
+                        asio::detached);
+      }
+    }
+
+    asio::awaitable<void>
+    session (socket_ptr c)
+    {
+      namespace http = beast::http;
+
+      auto u (std::make_shared<tcp::socket> (ioc_));
+
+      try
+      {
+        // Tell the protocols apart by the first byte: SOCKS5 starts with its
+        // version while HTTP starts with the method.
+        //
+        std::uint8_t v (0);
+        co_await c->async_receive (asio::buffer (&v, 1),
+                                   tcp::socket::message_peek,
+                                   asio::use_awaitable);
+        if (v == 0x05)
+        {
+          co_await socks5 (*c, *u);
+        }
+        else
+        {
+          beast::flat_buffer b;
+          http::request<http::empty_body> rq;
+          co_await http::async_read (*c, b, rq, asio::use_awaitable);
+
+          std::string t (rq.target ());
+
+          if (rq.method () == http::verb::connect)
+          {
+            std::size_t p (t.rfind (':'));
+            std::string h (t.substr (0, p));
+            std::string pt (t.substr (p + 1));
+
+            co_await connect (*u, h, pt);
+
+            count (&statistics::tunnels);
+
+            std::string r ("HTTP/1.1 200 Connection Established\r\n\r\n");
+            co_await asio::async_write (*c, asio::buffer (r),
+                                        asio::use_awaitable);
+          }
+          else
+          {
+            // http://<host>:<port>/<path>
+            //
+            std::size_t hb (t.find ("://"));
+
+            if (hb == std::string::npos)
+              co_return;
+
+            hb += 3;
+            std::size_t he (t.find ('/', hb));
+            std::string a (t.substr (hb, he - hb));
+            std::size_t p (a.rfind (':'));
+            std::string h (a.substr (0, p));
+            std::string pt (p != std::string::npos ? a.substr (p + 1) : "80");
+
+            co_await connect (*u, h, pt);
+
+            count (&statistics::forwards);
+
+            co_await http::async_write (*u, rq, asio::use_awaitable);
+          }
+
+          // Whatever the client sent past the request head (it shouldn't
+          // but let's not lose it).
+          //
+          if (b.size () != 0)
+            co_await asio::async_write (*u, b.data (), asio::use_awaitable);
+        }
+
+        asio::co_spawn (ioc_, relay (u, c), asio::detached);
+        co_await relay (c, u);
+      }
+      catch (const std::exception&)
+      {
+        // Either side went away. That's fine.
+      }
+    }
+
+    asio::awaitable<void>
+    socks5 (tcp::socket& c, tcp::socket& u)
+    {
+      // | VER | NMETHODS | METHODS  |
+      //
+      std::uint8_t h[4];
+      co_await asio::async_read (c, asio::buffer (h, 2), asio::use_awaitable);
+
+      std::vector<std::uint8_t> ms (h[1]);
+      co_await asio::async_read (c, asio::buffer (ms), asio::use_awaitable);
+
+      const std::uint8_t na[] {0x05, 0x00};
+      co_await asio::async_write (c, asio::buffer (na), asio::use_awaitable);
+
+      // | VER | CMD | RSV | ATYP | DST.ADDR | DST.PORT |
+      //
+      co_await asio::async_read (c, asio::buffer (h, 4), asio::use_awaitable);
+
+      std::string host;
+
+      switch (h[3])
+      {
+      case 0x01:
+        {
+          asio::ip::address_v4::bytes_type a;
+          co_await asio::async_read (c, asio::buffer (a), asio::use_awaitable);
+          host = asio::ip::address_v4 (a).to_string ();
+          break;
+        }
+      case 0x03:
+        {
+          std::uint8_t n (0);
+          co_await asio::async_read (c, asio::buffer (&n, 1),
+                                     asio::use_awaitable);
+          host.resize (n);
+          co_await asio::async_read (c, asio::buffer (host),
+                                     asio::use_awaitable);
+          break;
+        }
+      case 0x04:
+        {
+          asio::ip::address_v6::bytes_type a;
+          co_await asio::async_read (c, asio::buffer (a), asio::use_awaitable);
+          host = asio::ip::address_v6 (a).to_string ();
+          break;
+        }
+      default:
+        throw std::runtime_error ("unsupported SOCKS5 address type");
+      }
+
+      std::uint8_t pb[2];
+      co_await asio::async_read (c, asio::buffer (pb), asio::use_awaitable);
+
+      std::string pt (std::to_string (pb[0] << 8 | pb[1]));
+      co_await connect (u, host, pt);
+
+      count (&statistics::socks);
+
+      // | VER | REP | RSV | ATYP | BND.ADDR | BND.PORT |
+      //
+      const std::uint8_t ok[] {0x05, 0x00, 0x00, 0x01, 0, 0, 0, 0, 0, 0};
+      co_await asio::async_write (c, asio::buffer (ok), asio::use_awaitable);
+    }
+
+    asio::awaitable<void>
+    connect (tcp::socket& u, const std::string& host, const std::string& port)
+    {
+      tcp::resolver r (ioc_);
+      auto es (co_await r.async_resolve (host, port, asio::use_awaitable));
+      co_await asio::async_connect (u, es, asio::use_awaitable);
+      u.set_option (tcp::no_delay (true));
+    }
+
+    asio::awaitable<void>
+    relay (socket_ptr from, socket_ptr to)
+    {
+      std::vector<char> b (64 * 1024);
+      boost::system::error_code ec;
+
+      for (;;)
+      {
+        std::size_t n (
+          co_await from->async_read_some (
+            asio::buffer (b), asio::redirect_error (asio::use_awaitable, ec)));
+        if (ec)
+          break;
+
+        co_await asio::async_write (
+          *to, asio::buffer (b.data (), n),
+          asio::redirect_error (asio::use_awaitable, ec));
+        if (ec)
+          break;
+
+        std::lock_guard<std::mutex> l (mutex_);
+        stats_.bytes += n;
+      }
+
+      to->shutdown (tcp::socket::shutdown_send, ec);
+    }
+
+    void
+    count (std::uint64_t statistics::*m)
+    {
+      std::lock_guard<std::mutex> l (mutex_);
+      stats_.*m += 1;
+    }
+
+  private:
+    asio::io_context ioc_;
+    tcp::acceptor acceptor_;
+    std::thread thread_;
+
+    mutable std::mutex mutex_;
+    statistics stats_;
+  };
+}
@@ -0,0 +1,370 @@
+#include <launcher/launcher-prefetch.hxx>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+#ifndef _WIN32
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+#ifdef __linux__
+#  include <poll.h>
+#  include <sys/fanotify.h>
+#endif
+
+using namespace std;
+
+namespace launcher
+{
+  namespace
+  {
+    // Files read in parallel by default. The point is to keep the device
+    // queue full rather than to use the CPUs.
+    //
+    constexpr size_t default_workers (4);
+
+#ifdef __linux__
+    // Upper bound on the directories we mark. The installation normally has
+    // a few dozen.
+    //
+    constexpr size_t max_dirs (4096);
+#endif
+
+    bool
+    prefetch_file (const fs::path& f, uint64_t n)
+    {
+#ifndef _WIN32
+      int fd (open (f.c_str (), O_RDONLY | O_CLOEXEC));
+
+      if (fd == -1)
+        return false;
+
+#  if defined(__linux__)
+      bool r (readahead (fd, 0, static_cast<size_t> (n)) == 0);
+#  elif defined(POSIX_FADV_WILLNEED)
+      bool r (posix_fadvise (fd, 0, static_cast<off_t> (n),
+                             POSIX_FADV_WILLNEED) == 0);
+#  else
+      bool r (true);
+      char b[64 * 1024];
+
+      for (ssize_t l; (l = read (fd, b, sizeof (b))) != 0; )
+      {
+        if (l == -1 && errno != EINTR)
+        {
+          r = false;
+          break;
+        }
+      }
+#  endif
+
+      close (fd);
+      return r;
+#else
+      // Windows has no readahead hint for regular files so we read them
+      // through.
+      //
+      (void) n;
+
+      ifstream i (f, ios::binary);
+
+      if (!i)
+        return false;
+
+      vector<char> b (1024 * 1024);
+
+      while (i.read (b.data (), static_cast<streamsize> (b.size ())))
+        ;
+
+      return i.eof ();
+#endif
+    }
+  }
+
+  prefetch_result
+  prefetch_files (const prefetch_plan& p)
+  {
+    prefetch_result r;
+
+    // Decide what fits into the budget before starting so that it is taken
+    // in order.
+    //
+    vector<pair<const fs::path*, uint64_t>> ws;
+
+    for (const fs::path& f : p.files)
+    {
+      error_code ec;
+      uint64_t n (fs::is_regular_file (f, ec) ? fs::file_size (f, ec) : 0);
+
+      if (ec || n == 0 || (p.budget != 0 && r.bytes + n > p.budget))
+      {
+        ++r.skipped;
+        continue;
+      }
+
+      ws.emplace_back (&f, n);
+      r.bytes += n;
+    }
+
+    if (ws.empty ())
+      return r;
+
+    atomic<size_t> next (0);
+    atomic<size_t> failed (0);
+    atomic<uint64_t> failed_bytes (0);
+
+    auto work ([&ws, &next, &failed, &failed_bytes] ()
+    {
+      for (size_t i; (i = next.fetch_add (1)) < ws.size (); )
+      {
+        if (!prefetch_file (*ws[i].first, ws[i].second))
+        {
+          failed.fetch_add (1);
+          failed_bytes.fetch_add (ws[i].second);
+        }
+      }
+    });
+
+    size_t n (min (ws.size (), p.workers != 0 ? p.workers : default_workers));
+    vector<thread> ts;
+
+    for (size_t i (1); i < n; ++i)
+      ts.emplace_back (work);
+
+    work ();
+
+    for (thread& t : ts)
+      t.join ();
+
+    r.files = ws.size () - failed;
+    r.bytes -= failed_bytes;
+    r.skipped += failed;
+
+    return r;
+  }
+
+#ifdef __linux__
+  namespace
+  {
+    string
+    handle_key (const file_handle& h)
+    {
+      string r (reinterpret_cast<const char*> (&h.handle_type),
+                sizeof (h.handle_type));
+      r.append (reinterpret_cast<const char*> (h.f_handle), h.handle_bytes);
+      return r;
+    }
+  }
+#endif
+
+  prefetch_recorder::
+  prefetch_recorder (const fs::path& r)
+    : root_ (r)
+  {
+#if defined(__linux__) && defined(FAN_REPORT_DFID_NAME)
+    // Unprivileged listeners have to use file handles rather than file
+    // descriptors and can only mark inodes. So we mark every directory and
+    // map the handles reported in the events back to the directories.
+    //
+    fd_ = fanotify_init (FAN_CLASS_NOTIF |
+                         FAN_CLOEXEC |
+                         FAN_NONBLOCK |
+                         FAN_REPORT_DFID_NAME,
+                         O_RDONLY | O_LARGEFILE);
+
+    if (fd_ == -1)
+      return;
+
+    auto mark ([this] (const fs::path& d)
+    {
+      alignas (file_handle) unsigned char b[sizeof (file_handle) +
+                                            MAX_HANDLE_SZ];
+      file_handle* h (reinterpret_cast<file_handle*> (b));
+      h->handle_bytes = MAX_HANDLE_SZ;
+
+      int m;
+      if (name_to_handle_at (AT_FDCWD, d.c_str (), h, &m, 0) != 0 ||
+          fanotify_mark (fd_,
+                         FAN_MARK_ADD | FAN_MARK_ONLYDIR,
+                         FAN_OPEN | FAN_EVENT_ON_CHILD,
+                         AT_FDCWD,
+                         d.c_str ()) != 0)
+        return false;
+
+      dirs_.emplace (handle_key (*h),
+                     d == root_ ? fs::path () : d.lexically_relative (root_));
+      return true;
+    });
+
+    if (!mark (root_))
+    {
+      close (fd_);
+      fd_ = -1;
+      return;
+    }
+
+    // Skip our own cache directory: the database lives there.
+    //
+    error_code ec;
+    for (fs::recursive_directory_iterator
+           i (root_, fs::directory_options::skip_permission_denied, ec), e;
+         i != e && dirs_.size () < max_dirs;
+         i.increment (ec))
+    {
+      if (ec)
+        break;
+
+      if (!i->is_directory (ec) || i->is_symlink (ec))
+        continue;
+
+      if (i.depth () == 0 && i->path ().filename () == "cache")
+      {
+        i.disable_recursion_pending ();
+        continue;
+      }
+
+      mark (i->path ());
+    }
+
+    thread_ = thread ([this] () {run ();});
+#endif
+  }
+
+  prefetch_recorder::
+  ~prefetch_recorder ()
+  {
+    stop ();
+  }
+
+  bool prefetch_recorder::
+  active () const noexcept
+  {
+    return fd_ != -1;
+  }
+
+  void prefetch_recorder::
+  deadline (chrono::steady_clock::time_point t)
+  {
+    deadline_ = t;
+  }
+
+  vector<fs::path> prefetch_recorder::
+  stop ()
+  {
+    stop_ = true;
+
+    if (thread_.joinable ())
+      thread_.join ();
+
+#ifndef _WIN32
+    if (fd_ != -1)
+    {
+      close (fd_);
+      fd_ = -1;
+    }
+#endif
+
+    // Besides files the game also opens directories (to list them) which
+    // are reported the same way.
+    //
+    vector<fs::path> r;
+
+    for (fs::path& f : files_)
+    {
+      error_code ec;
+      if (fs::is_regular_file (root_ / f, ec))
+        r.push_back (move (f));
+    }
+
+    files_.clear ();
+    return r;
+  }
+
+  void prefetch_recorder::
+  run ()
+  {
+#if defined(__linux__) && defined(FAN_REPORT_DFID_NAME)
+    pid_t self (getpid ());
+    pollfd pf {fd_, POLLIN, 0};
+
+    alignas (fanotify_event_metadata) char b[16384];
+
+    while (!stop_)
+    {
+      int n (poll (&pf, 1, 100));
+
+      if (n == -1 && errno != EINTR)
+        break;
+
+      if (n <= 0)
+        continue;
+
+      ssize_t l (read (fd_, b, sizeof (b)));
+
+      // Whatever is opened past the deadline is not part of the startup.
+      //
+      if (chrono::steady_clock::now () >= deadline_.load ())
+        break;
+
+      if (l == -1)
+      {
+        if (errno == EAGAIN || errno == EINTR)
+          continue;
+
+        break;
+      }
+
+      for (auto* m (reinterpret_cast<fanotify_event_metadata*> (b));
+           FAN_EVENT_OK (m, l);
+           m = FAN_EVENT_NEXT (m, l))
+      {
+        if (m->vers != FANOTIFY_METADATA_VERSION)
+          return;
+
+        // Note that for unprivileged listeners the pid is only reported for
+        // our own events (and is 0 otherwise), which is all we need.
+        //
+        if (m->pid == self || (m->mask & FAN_Q_OVERFLOW) != 0)
+          continue;
+
+        const char* p (reinterpret_cast<const char*> (m));
+
+        for (size_t o (m->metadata_len); o < m->event_len; )
+        {
+          auto* i (reinterpret_cast<const fanotify_event_info_fid*> (p + o));
+
+          if (i->hdr.len == 0)
+            break;
+
+          o += i->hdr.len;
+
+          if (i->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+            continue;
+
+          auto* h (reinterpret_cast<const file_handle*> (i->handle));
+          auto d (dirs_.find (handle_key (*h)));
+
+          if (d == dirs_.end ())
+            continue;
+
+          const char* nm (reinterpret_cast<const char*> (h->f_handle) +
+                          h->handle_bytes);
+
+          if (strcmp (nm, ".") == 0)
+            continue;
+
+          fs::path f (d->second / nm);
+
+          if (seen_.insert (f).second)
+            files_.push_back (move (f));
+        }
+      }
+    }
+#endif
+  }
+}
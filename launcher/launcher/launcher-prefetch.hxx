@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace launcher
+{
+  namespace fs = std::filesystem;
+
+  // Page cache prefetch.
+  //
+  // On the first start after an update or a reboot the game reads hundreds
+  // of megabytes of archives and fastfiles, mostly one after another. If we
+  // ask the kernel to read them all in parallel while the game (and Proton)
+  // is still starting up, then most of those reads are served from memory.
+  //
+  struct prefetch_plan
+  {
+    std::vector<fs::path> files; // In the order the game needs them.
+    std::uint64_t budget = 0;    // Bytes to prefetch at most, 0 for no limit.
+    std::size_t workers = 0;     // Files read in parallel, 0 for the default.
+  };
+
+  struct prefetch_result
+  {
+    std::size_t files = 0;
+    std::uint64_t bytes = 0;
+    std::size_t skipped = 0; // Missing or over the budget.
+  };
+
+  // Issue the reads and wait for them to be queued (or, where the platform
+  // has no way to hint the kernel, to complete).
+  //
+  // Files are taken in order until the budget is exhausted; the rest are
+  // skipped. On Linux this is readahead(), on other POSIX systems
+  // posix_fadvise(POSIX_FADV_WILLNEED) where available, and elsewhere we
+  // simply read the files.
+  //
+  prefetch_result
+  prefetch_files (const prefetch_plan&);
+
+  // Record the regular files below the installation root that other
+  // processes open, in the order they are first opened. This is how we
+  // learn what the game reads at startup.
+  //
+  // On Linux this uses fanotify with directory marks, which doesn't require
+  // any privileges since 5.13. Elsewhere (or on older kernels) the recorder
+  // is inactive and stop() returns nothing.
+  //
+  // Recording starts on construction and runs on a separate thread until
+  // stop() is called, the deadline passes, or the recorder is destroyed.
+  //
+  // Note that only our own opens can be told apart (and are ignored): the
+  // opens of any other process, such as the background updater, end up in
+  // the recording. So the caller should make sure nothing else is reading
+  // the installation while we record.
+  //
+  class prefetch_recorder
+  {
+  public:
+    explicit
+    prefetch_recorder (const fs::path& root);
+
+    ~prefetch_recorder ();
+
+    prefetch_recorder (const prefetch_recorder&) = delete;
+    prefetch_recorder& operator= (const prefetch_recorder&) = delete;
+
+    bool
+    active () const noexcept;
+
+    // Ignore anything opened after the specified time.
+    //
+    void
+    deadline (std::chrono::steady_clock::time_point);
+
+    // Stop recording and return the files relative to the root.
+    //
+    std::vector<fs::path>
+    stop ();
+
+  private:
+    void
+    run ();
+
+    fs::path root_;
+    int fd_ = -1;
+
+    // Marked directories (relative to the root) keyed by their file handle.
+    //
+    std::map<std::string, fs::path> dirs_;
+
+    std::vector<fs::path> files_;
+    std::set<fs::path> seen_;
+
+    std::atomic<bool> stop_ {false};
+    std::atomic<std::chrono::steady_clock::time_point> deadline_ {
+      std::chrono::steady_clock::time_point::max ()};
+    std::thread thread_;
+  };
+}
@@ -42,6 +42,12 @@ namespace launcher
     return manager_.add_entry (move (l));
   }
 
+  shared_ptr<progress_coordinator::entry_type> progress_coordinator::
+  add_entry (string l, entry_type::counter c, entry_type::counter t)
+  {
+    return manager_.add_entry (move (l), move (c), move (t));
+  }
+
   void progress_coordinator::
   remove_entry (shared_ptr<entry_type> e)
   {
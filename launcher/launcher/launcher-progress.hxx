@@ -55,6 +55,15 @@ namespace launcher
     std::shared_ptr<entry_type>
     add_entry (std::string label);
 
+    // As above but follow the specified counters (for example, those of a
+    // download task) instead of having the progress pushed with
+    // update_progress().
+    //
+    std::shared_ptr<entry_type>
+    add_entry (std::string label,
+               entry_type::counter current,
+               entry_type::counter total);
+
     // Remove progress entry.
     //
     void
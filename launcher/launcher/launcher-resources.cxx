@@ -0,0 +1,735 @@
+#include <launcher/launcher-resources.hxx>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#ifdef __linux__
+#  include <sched.h>
+#endif
+
+#ifdef _WIN32
+#  include <windows.h>
+#endif
+
+using namespace std;
+
+namespace launcher
+{
+  namespace
+  {
+    // Roughly what a single worker can hash (and read) per second. Beyond
+    // that an I/O limit makes additional workers pointless.
+    //
+    constexpr uint64_t hash_rate (256ULL * 1024 * 1024);
+
+    // Same for what a single apply worker can write (extracting or copying
+    // into a root) per second.
+    //
+    constexpr uint64_t apply_rate (128ULL * 1024 * 1024);
+
+    // Bounds on the memory a single file's hashing pipeline has in flight
+    // (see hash_pipeline). The lower bound is two smallest chunks.
+    //
+    constexpr size_t min_hash_memory (512 * 1024);
+    constexpr size_t max_hash_memory (16 * 1024 * 1024);
+
+    // Memory we expect a download to need (socket, TLS, and body buffers
+    // plus the splice pipe).
+    //
+    constexpr uint64_t connection_memory (2 * 1024 * 1024);
+
+    // Downloads are mostly waiting on the network but TLS and the
+    // bookkeeping are not free so don't run more than this many per CPU.
+    //
+    constexpr size_t connections_per_cpu (16);
+    constexpr size_t min_connections (4);
+
+    string
+    format_bytes (uint64_t n)
+    {
+      if (n == 0)
+        return "unlimited";
+
+      ostringstream o;
+
+      if (n >= 1024 * 1024 * 1024)
+        o << n / (1024 * 1024 * 1024) << " GiB";
+      else if (n >= 1024 * 1024)
+        o << n / (1024 * 1024) << " MiB";
+      else
+        o << n / 1024 << " KiB";
+
+      return o.str ();
+    }
+
+    // Parse a controller limit value returning 0 if it is "max" (or
+    // invalid).
+    //
+    uint64_t
+    parse_limit (const string& s)
+    {
+      if (s == "max")
+        return 0;
+
+      try
+      {
+        return stoull (s);
+      }
+      catch (const exception&)
+      {
+        return 0;
+      }
+    }
+
+    // Return the value of a single-value controller file (such as
+    // memory.max) or 0 if it is absent or unlimited.
+    //
+    uint64_t
+    read_limit (const fs::path& f)
+    {
+      ifstream i (f);
+      string s;
+
+      return i >> s ? parse_limit (s) : 0;
+    }
+
+    // Keep the smaller of two limits where 0 means unlimited.
+    //
+    template <typename T>
+    void
+    tighten (T& l, T v)
+    {
+      if (v != 0 && (l == 0 || v < l))
+        l = v;
+    }
+
+    void
+    read_cgroup (const fs::path& d, resource_limits& r)
+    {
+      // cpu.max is "<quota> <period>" with quota being "max" if unlimited.
+      //
+      {
+        ifstream i (d / "cpu.max");
+        string q;
+        uint64_t p (0);
+
+        if (i >> q >> p && p != 0)
+        {
+          if (uint64_t v = parse_limit (q))
+            tighten (r.cpu_quota, static_cast<double> (v) / p);
+        }
+      }
+
+      tighten (r.memory, read_limit (d / "memory.max"));
+      tighten (r.memory, read_limit (d / "memory.high"));
+
+      // io.max has a line per device:
+      //
+      // 8:16 rbps=2097152 wbps=max riops=max wiops=120
+      //
+      // We don't bother matching the device against the installation root:
+      // the limits are normally set on the disk that holds the container
+      // and everything else is likely on it as well.
+      //
+      {
+        ifstream i (d / "io.max");
+
+        for (string l; getline (i, l); )
+        {
+          istringstream ls (l);
+          string t;
+
+          for (ls >> t; ls >> t; )
+          {
+            size_t p (t.find ('='));
+
+            if (p == string::npos)
+              continue;
+
+            string k (t, 0, p);
+            uint64_t v (parse_limit (t.substr (p + 1)));
+
+            if (k == "rbps")
+              tighten (r.read_bps, v);
+            else if (k == "wbps")
+              tighten (r.write_bps, v);
+          }
+        }
+      }
+    }
+  }
+
+  namespace
+  {
+    // Parse a sysfs CPU list such as "0-3,8-11".
+    //
+    vector<unsigned>
+    parse_cpu_list (const string& s)
+    {
+      vector<unsigned> r;
+      istringstream is (s);
+
+      for (string t; getline (is, t, ','); )
+      {
+        try
+        {
+          size_t p (t.find ('-'));
+          unsigned b (static_cast<unsigned> (stoul (t.substr (0, p))));
+          unsigned e (p != string::npos
+                      ? static_cast<unsigned> (stoul (t.substr (p + 1)))
+                      : b);
+
+          for (unsigned i (b); i <= e; ++i)
+            r.push_back (i);
+        }
+        catch (const exception&)
+        {
+        }
+      }
+
+      return r;
+    }
+
+    optional<unsigned>
+    read_unsigned (const fs::path& f)
+    {
+      ifstream i (f);
+      long v;
+
+      if (i >> v && v >= 0)
+        return static_cast<unsigned> (v);
+
+      return nullopt;
+    }
+
+    mutex placement_mutex;
+    placement_policy placement_config (placement_policy::none);
+
+    thread_local const worker_placement* placed_by (nullptr);
+    thread_local int placed_node (-1);
+  }
+
+  size_t resource_limits::
+  cpu_count () const
+  {
+    size_t n (cpus != 0 ? cpus : 1);
+
+    if (cpu_quota != 0)
+      n = min (n, max (static_cast<size_t> (ceil (cpu_quota)), size_t (1)));
+
+    return n;
+  }
+
+  string resource_limits::
+  string () const
+  {
+    ostringstream o;
+
+    o << "cpus " << cpus;
+
+    if (cpu_quota != 0)
+      o << " (quota " << cpu_quota << ")";
+
+    o << ", memory " << format_bytes (memory)
+      << ", read " << format_bytes (read_bps) << (read_bps != 0 ? "/s" : "")
+      << ", write " << format_bytes (write_bps) << (write_bps != 0 ? "/s" : "");
+
+    return o.str ();
+  }
+
+  resource_limits
+  detect_resource_limits ()
+  {
+#ifdef __linux__
+    // With cgroup v2 there is a single "0::<path>" entry. On hybrid setups
+    // the v2 hierarchy is mounted under unified/ and normally has no
+    // controllers enabled, but it doesn't hurt to look.
+    //
+    string cg;
+    {
+      ifstream i ("/proc/self/cgroup");
+
+      for (string l; getline (i, l); )
+      {
+        if (l.compare (0, 3, "0::") == 0)
+        {
+          cg = l.substr (3);
+          break;
+        }
+      }
+    }
+
+    fs::path m ("/sys/fs/cgroup");
+    error_code ec;
+
+    if (!fs::exists (m / "cgroup.controllers", ec) &&
+        fs::exists (m / "unified" / "cgroup.controllers", ec))
+      m /= "unified";
+
+    return detect_resource_limits (m, cg);
+#else
+    return detect_resource_limits (fs::path (), std::string ());
+#endif
+  }
+
+  resource_limits
+  detect_resource_limits (const fs::path& m, const std::string& cg)
+  {
+    resource_limits r;
+
+#ifdef __linux__
+    cpu_set_t s;
+    CPU_ZERO (&s);
+
+    if (sched_getaffinity (0, sizeof (s), &s) == 0)
+      r.cpus = static_cast<size_t> (CPU_COUNT (&s));
+#endif
+
+    if (r.cpus == 0)
+      r.cpus = thread::hardware_concurrency ();
+
+    // Limits are hierarchical so the effective one is the tightest between
+    // our cgroup and the root. Note that inside a cgroup namespace our own
+    // cgroup is "/" but its limits are still visible at the mount point.
+    //
+    if (!m.empty () && !cg.empty ())
+    {
+      fs::path d (m);
+
+      for (const auto& c : fs::path (cg).relative_path ())
+        d /= c;
+
+      for (;;)
+      {
+        read_cgroup (d, r);
+
+        if (d == m || !d.has_parent_path ())
+          break;
+
+        d = d.parent_path ();
+      }
+    }
+
+    return r;
+  }
+
+  uint64_t
+  available_memory ()
+  {
+#if defined(__linux__)
+    // MemAvailable is in KiB.
+    //
+    ifstream i ("/proc/meminfo");
+
+    for (string l; getline (i, l); )
+    {
+      if (l.compare (0, 13, "MemAvailable:") == 0)
+      {
+        try
+        {
+          return stoull (l.substr (13)) * 1024;
+        }
+        catch (const exception&)
+        {
+          break;
+        }
+      }
+    }
+
+    return 0;
+#elif defined(_WIN32)
+    MEMORYSTATUSEX s;
+    s.dwLength = sizeof (s);
+
+    return GlobalMemoryStatusEx (&s) ? s.ullAvailPhys : 0;
+#else
+    return 0;
+#endif
+  }
+
+  string resource_plan::
+  string () const
+  {
+    ostringstream o;
+
+    o << hash_workers << " hash worker(s) with "
+      << (hash_memory != 0 ? format_bytes (hash_memory) : "default")
+      << " in flight each, "
+      << apply_workers << " apply worker(s), "
+      << connections << " connection(s)";
+
+    return o.str ();
+  }
+
+  resource_plan
+  plan_resources (const resource_limits& l,
+                  size_t jobs,
+                  bool fixed,
+                  uint64_t hr)
+  {
+    resource_plan r;
+    size_t n (l.cpu_count ());
+
+    // Hashing is CPU-bound unless reading is throttled, in which case there
+    // is no point in having more workers than the bandwidth can feed.
+    //
+    r.hash_workers = n;
+
+    if (hr == 0)
+      hr = hash_rate;
+
+    if (l.read_bps != 0)
+      r.hash_workers = min (r.hash_workers,
+                            max<size_t> ((l.read_bps + hr - 1) / hr, 1));
+
+    // Give hashing up to a quarter of the memory limit. If that doesn't
+    // cover the minimum per worker, then drop workers rather than starve the
+    // pipelines.
+    //
+    if (l.memory != 0)
+    {
+      uint64_t b (l.memory / 4);
+
+      r.hash_workers = min<size_t> (r.hash_workers,
+                                    max<uint64_t> (b / min_hash_memory, 1));
+
+      r.hash_memory = static_cast<size_t> (
+        clamp<uint64_t> (b / r.hash_workers, min_hash_memory, max_hash_memory));
+    }
+
+    // Applying a root is a mix of extraction (CPU) and file I/O. Like with
+    // hashing, if writing is throttled, then the bandwidth rather than the
+    // CPUs is what limits us.
+    //
+    r.apply_workers = n;
+
+    if (l.write_bps != 0)
+      r.apply_workers = min (r.apply_workers,
+                             max<size_t> ((l.write_bps + apply_rate - 1) /
+                                          apply_rate,
+                                          1));
+
+    // Connections are capped by the CPU quota and by an eighth of the memory
+    // limit.
+    //
+    r.connections = max<size_t> (jobs, 1);
+
+    if (!fixed)
+    {
+      if (l.cpu_quota != 0)
+        r.connections = min (r.connections,
+                             max (n * connections_per_cpu, min_connections));
+
+      if (l.memory != 0)
+        r.connections = min<size_t> (
+          r.connections,
+          max<uint64_t> (l.memory / 8 / connection_memory, min_connections));
+    }
+
+    return r;
+  }
+
+  size_t cpu_topology::
+  cores () const
+  {
+    set<unsigned> r;
+
+    for (const cpu_info& c : cpus)
+      r.insert (c.core);
+
+    return r.size ();
+  }
+
+  size_t cpu_topology::
+  packages () const
+  {
+    set<unsigned> r;
+
+    for (const cpu_info& c : cpus)
+      r.insert (c.package);
+
+    return r.size ();
+  }
+
+  size_t cpu_topology::
+  nodes () const
+  {
+    set<unsigned> r;
+
+    for (const cpu_info& c : cpus)
+      r.insert (c.node);
+
+    return r.size ();
+  }
+
+  vector<unsigned> cpu_topology::
+  node_cpus (unsigned n) const
+  {
+    vector<unsigned> r;
+
+    for (const cpu_info& c : cpus)
+      if (c.node == n)
+        r.push_back (c.id);
+
+    return r;
+  }
+
+  string cpu_topology::
+  string () const
+  {
+    ostringstream o;
+
+    o << nodes () << " node(s), "
+      << packages () << " package(s), "
+      << cores () << " core(s), "
+      << cpus.size () << " cpu(s)";
+
+    return o.str ();
+  }
+
+  cpu_topology
+  detect_cpu_topology ()
+  {
+    return detect_cpu_topology ("/sys/devices/system");
+  }
+
+  cpu_topology
+  detect_cpu_topology (const fs::path& sys)
+  {
+    cpu_topology r;
+
+    // The CPUs we may run on.
+    //
+    vector<unsigned> ids;
+
+#ifdef __linux__
+    cpu_set_t s;
+    CPU_ZERO (&s);
+
+    if (sched_getaffinity (0, sizeof (s), &s) == 0)
+    {
+      for (unsigned i (0); i != CPU_SETSIZE; ++i)
+        if (CPU_ISSET (i, &s))
+          ids.push_back (i);
+    }
+#endif
+
+    if (ids.empty ())
+    {
+      for (unsigned i (0), n (thread::hardware_concurrency ()); i != n; ++i)
+        ids.push_back (i);
+
+      if (ids.empty ())
+        ids.push_back (0);
+    }
+
+    // Map CPUs to nodes. Without NUMA support there is no node directory
+    // and everything is on node 0.
+    //
+    map<unsigned, unsigned> nodes;
+    {
+      error_code ec;
+
+      for (fs::directory_iterator i (sys / "node", ec), e; !ec && i != e;
+           i.increment (ec))
+      {
+        string n (i->path ().filename ().string ());
+
+        if (n.compare (0, 4, "node") != 0 || n.size () == 4 ||
+            n.find_first_not_of ("0123456789", 4) != string::npos)
+          continue;
+
+        unsigned id (static_cast<unsigned> (stoul (n.substr (4))));
+        ifstream is (i->path () / "cpulist");
+        string l;
+
+        if (getline (is, l))
+          for (unsigned c : parse_cpu_list (l))
+            nodes[c] = id;
+      }
+    }
+
+    // Core ids are only unique within a package so renumber them.
+    //
+    map<pair<unsigned, unsigned>, unsigned> cores;
+
+    for (unsigned id : ids)
+    {
+      fs::path t (sys / "cpu" / ("cpu" + std::to_string (id)) / "topology");
+
+      unsigned p (read_unsigned (t / "physical_package_id").value_or (0));
+      optional<unsigned> c (read_unsigned (t / "core_id"));
+
+      // If we don't know the core, assume the CPU is one.
+      //
+      pair<unsigned, unsigned> k (p, c ? *c : 0x10000 + id);
+      auto i (cores.emplace (k, static_cast<unsigned> (cores.size ())).first);
+
+      auto n (nodes.find (id));
+
+      r.cpus.push_back (cpu_info {id,
+                                  i->second,
+                                  p,
+                                  n != nodes.end () ? n->second : 0});
+    }
+
+    return r;
+  }
+
+  const cpu_topology&
+  system_topology ()
+  {
+    static const cpu_topology t (detect_cpu_topology ());
+    return t;
+  }
+
+  string
+  placement_name (placement_policy p)
+  {
+    switch (p)
+    {
+    case placement_policy::none:    return "none";
+    case placement_policy::spread:  return "spread";
+    case placement_policy::compact: return "compact";
+    }
+
+    return string ();
+  }
+
+  placement_policy
+  to_placement_policy (const string& s)
+  {
+    if (s == "none")    return placement_policy::none;
+    if (s == "spread")  return placement_policy::spread;
+    if (s == "compact") return placement_policy::compact;
+
+    throw invalid_argument ("invalid placement policy '" + s + "'");
+  }
+
+  vector<cpu_info>
+  placement_order (const cpu_topology& t, placement_policy p)
+  {
+    if (p == placement_policy::none)
+      return vector<cpu_info> ();
+
+    // Arrange the CPUs as node -> core -> SMT threads, each in the order of
+    // the first CPU id.
+    //
+    map<unsigned, map<unsigned, vector<cpu_info>>> ns;
+
+    for (const cpu_info& c : t.cpus)
+      ns[c.node][c.core].push_back (c);
+
+    // Rank is the position of a thread within its core: all the rank 0
+    // threads (one per physical core) come first, then rank 1, and so on.
+    //
+    vector<vector<vector<cpu_info>>> nc; // Node -> core -> threads.
+    size_t mr (0), mc (0);
+
+    for (auto& [n, cs] : ns)
+    {
+      vector<vector<cpu_info>> v;
+
+      for (auto& [c, ts] : cs)
+      {
+        mr = max (mr, ts.size ());
+        v.push_back (move (ts));
+      }
+
+      mc = max (mc, v.size ());
+      nc.push_back (move (v));
+    }
+
+    vector<cpu_info> r;
+
+    for (size_t k (0); k != mr; ++k)
+    {
+      if (p == placement_policy::compact)
+      {
+        for (const auto& cs : nc)
+          for (const auto& ts : cs)
+            if (k < ts.size ())
+              r.push_back (ts[k]);
+      }
+      else
+      {
+        for (size_t i (0); i != mc; ++i)
+          for (const auto& cs : nc)
+            if (i < cs.size () && k < cs[i].size ())
+              r.push_back (cs[i][k]);
+      }
+    }
+
+    return r;
+  }
+
+  void
+  configure_placement (placement_policy p)
+  {
+    lock_guard<mutex> l (placement_mutex);
+    placement_config = p;
+  }
+
+  placement_policy
+  configured_placement ()
+  {
+    lock_guard<mutex> l (placement_mutex);
+    return placement_config;
+  }
+
+  worker_placement::
+  worker_placement (placement_policy p, const cpu_topology& t)
+    : order_ (placement_order (t, p))
+  {
+  }
+
+  void worker_placement::
+  place ()
+  {
+    if (order_.empty () || placed_by == this)
+      return;
+
+    // With more workers than CPUs we wrap around, which is no worse than
+    // not pinning.
+    //
+    const cpu_info& c (order_[next_++ % order_.size ()]);
+
+    placed_by = this;
+    placed_node = pin_thread ({c.id}) ? static_cast<int> (c.node) : -1;
+  }
+
+  int worker_placement::
+  current_node ()
+  {
+    return placed_node;
+  }
+
+  bool
+  pin_thread (const vector<unsigned>& cpus)
+  {
+#ifdef __linux__
+    cpu_set_t s;
+    CPU_ZERO (&s);
+
+    for (unsigned c : cpus)
+      if (c < CPU_SETSIZE)
+        CPU_SET (c, &s);
+
+    // Note that for pid 0 this applies to the calling thread only.
+    //
+    return !cpus.empty () && sched_setaffinity (0, sizeof (s), &s) == 0;
+#else
+    (void) cpus;
+    return false;
+#endif
+  }
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace launcher
+{
+  namespace fs = std::filesystem;
+
+  // Resource limits imposed on the process.
+  //
+  // Inside containers (and systemd slices) the machine may have plenty of
+  // CPUs and memory while we are only allowed a fraction of them. Sizing our
+  // worker pools from the hardware then oversubscribes the quota and gets us
+  // throttled. On Linux we read the limits from the cgroup v2 controllers of
+  // the cgroup we are in (and its ancestors) plus the CPU affinity mask.
+  // Elsewhere only the hardware concurrency is known.
+  //
+  // Zero means unlimited (or unknown).
+  //
+  struct resource_limits
+  {
+    std::size_t cpus = 0;      // Hardware threads we may run on.
+    double cpu_quota = 0;      // cpu.max quota/period, in CPUs.
+    std::uint64_t memory = 0;  // Smallest of memory.max and memory.high.
+    std::uint64_t read_bps = 0;  // Smallest io.max rbps across devices.
+    std::uint64_t write_bps = 0; // Smallest io.max wbps across devices.
+
+    // Number of CPUs worth of work we can actually get done: the quota
+    // rounded up and capped by the affinity. Never zero.
+    //
+    std::size_t
+    cpu_count () const;
+
+    std::string
+    string () const;
+  };
+
+  // Detect the limits of the current process.
+  //
+  resource_limits
+  detect_resource_limits ();
+
+  // Same but read the cgroup v2 hierarchy mounted at the specified directory
+  // starting from the specified cgroup (as listed in /proc/self/cgroup).
+  // Mostly useful for testing.
+  //
+  resource_limits
+  detect_resource_limits (const fs::path& mount, const std::string& cgroup);
+
+  // Return the memory (in bytes) that can be used without pushing anything
+  // out to swap, including what the page cache would give up, or 0 if
+  // unknown. Note that this is the system-wide figure: combine it with the
+  // limits to get what is available to us.
+  //
+  std::uint64_t
+  available_memory ();
+
+  // Worker pool sizes derived from the limits.
+  //
+  struct resource_plan
+  {
+    std::size_t hash_workers = 0;  // Files hashed in parallel.
+    std::size_t hash_memory = 0;   // Bytes in flight per hashed file, 0 for
+                                   // the default.
+    std::size_t apply_workers = 0; // Roots applied (and extracted) in
+                                   // parallel in the fleet mode.
+    std::size_t connections = 0;   // Concurrent downloads.
+
+    std::string
+    string () const;
+  };
+
+  // Size the pools. The connections are capped at jobs; if fixed is true,
+  // then jobs is used as is (it was requested explicitly). The hash rate is
+  // what a single worker can hash per second (in bytes), normally observed
+  // on previous runs; 0 means to assume the default.
+  //
+  resource_plan
+  plan_resources (const resource_limits&,
+                  std::size_t jobs,
+                  bool fixed,
+                  std::uint64_t hash_rate = 0);
+
+  // CPU topology.
+  //
+  // Only the CPUs in our affinity mask are listed. Core ids are unique
+  // across packages (we renumber them).
+  //
+  struct cpu_info
+  {
+    unsigned id;
+    unsigned core;
+    unsigned package;
+    unsigned node;
+  };
+
+  struct cpu_topology
+  {
+    std::vector<cpu_info> cpus;
+
+    std::size_t
+    cores () const;
+
+    std::size_t
+    packages () const;
+
+    std::size_t
+    nodes () const;
+
+    // CPUs that belong to the node.
+    //
+    std::vector<unsigned>
+    node_cpus (unsigned node) const;
+
+    std::string
+    string () const;
+  };
+
+  // Detect the topology from sysfs on Linux. Elsewhere (or if sysfs is not
+  // available) every hardware thread is reported as a core of its own on a
+  // single node.
+  //
+  cpu_topology
+  detect_cpu_topology ();
+
+  // Same but read the specified sysfs directory (normally /sys/devices/
+  // system). Mostly useful for testing.
+  //
+  cpu_topology
+  detect_cpu_topology (const fs::path& sysfs);
+
+  // Detected once and cached.
+  //
+  const cpu_topology&
+  system_topology ();
+
+  // Worker placement policy.
+  //
+  // On multi-socket machines threads that float freely end up hashing (or
+  // inflating) buffers that live on another node and sharing a core with
+  // an SMT sibling while other cores are idle. Both pinning policies put one
+  // worker on each physical core before using SMT siblings and differ in
+  // the order in which nodes are filled: spread goes round-robin across
+  // nodes (more memory bandwidth) while compact fills a node before moving
+  // to the next (less cross-node traffic when there are few workers).
+  //
+  enum class placement_policy
+  {
+    none,   // Let the scheduler decide.
+    spread,
+    compact
+  };
+
+  std::string
+  placement_name (placement_policy);
+
+  // Throw invalid_argument if the name is not recognized.
+  //
+  placement_policy
+  to_placement_policy (const std::string&);
+
+  // Return the CPUs in the order workers should take them.
+  //
+  std::vector<cpu_info>
+  placement_order (const cpu_topology&, placement_policy);
+
+  // Process-wide policy for the CPU-bound pools (none by default).
+  //
+  void
+  configure_placement (placement_policy);
+
+  placement_policy
+  configured_placement ();
+
+  // Place the worker threads of a pool.
+  //
+  // Pool threads call place() at the start of each task. The first call on
+  // a thread claims the next CPU in the placement order and pins the thread
+  // to it; subsequent calls do nothing. Buffers that the worker then
+  // allocates and touches first end up on its node (see current_node()).
+  //
+  class worker_placement
+  {
+  public:
+    explicit
+    worker_placement (placement_policy = configured_placement (),
+                      const cpu_topology& = system_topology ());
+
+    worker_placement (const worker_placement&) = delete;
+    worker_placement& operator= (const worker_placement&) = delete;
+
+    void
+    place ();
+
+    // Return the node the calling thread was placed on or -1 if it was not
+    // placed.
+    //
+    static int
+    current_node ();
+
+  private:
+    std::vector<cpu_info> order_;
+    std::atomic<std::size_t> next_ {0};
+  };
+
+  // Pin the calling thread to the CPUs. Return false if not supported or
+  // failed.
+  //
+  bool
+  pin_thread (const std::vector<unsigned>& cpus);
+}
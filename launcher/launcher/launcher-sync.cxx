@@ -0,0 +1,1661 @@
+#include <launcher/launcher-sync.hxx>
+
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <linux/fs.h>
+#  include <sys/ioctl.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+
+#include <launcher/launcher-log.hxx>
+#include <launcher/launcher-resources.hxx>
+
+namespace views = std::views;
+namespace ranges = std::ranges;
+
+using namespace std;
+using namespace std::filesystem;
+using namespace boost::asio::experimental::awaitable_operators;
+
+namespace launcher
+{
+  namespace
+  {
+    string cdn ("https://cdn.iw4x.io/");
+
+    constexpr auto
+    info ([] (auto&&... args)
+    {
+      log::info (categories::launcher (),
+                 std::forward<decltype (args)> (args)...);
+    });
+
+    constexpr auto
+    trace_l3 ([] (auto&&... args)
+    {
+      log::trace_l3 (categories::launcher (),
+                     std::forward<decltype (args)> (args)...);
+    });
+
+    constexpr auto
+    trace_l2 ([] (auto&&... args)
+    {
+      log::trace_l2 (categories::launcher (),
+                     std::forward<decltype (args)> (args)...);
+    });
+
+    constexpr auto
+    warning ([] (auto&&... args)
+    {
+      log::warning (categories::launcher (),
+                    std::forward<decltype (args)> (args)...);
+    });
+
+    string
+    to_utf8 (const path& p)
+    {
+      auto s (p.u8string ());
+      return string (s.begin (), s.end ());
+    }
+
+    path
+    from_utf8 (string_view s)
+    {
+      return path (reinterpret_cast<const char8_t*> (s.data ()),
+                   reinterpret_cast<const char8_t*> (s.data () + s.size ()));
+    }
+
+    string
+    path_digest (const path& p)
+    {
+      std::hash<string> h;
+      string r (std::to_string (h (to_utf8 (p))));
+
+      trace_l3 ("computed path digest for {}: {}", to_utf8 (p), r);
+      return r;
+    }
+
+    // Return the key identifying the content of a staged file: its hash or,
+    // failing that, its URL.
+    //
+    string
+    object_key (const staged_file& f)
+    {
+      return f.hash.empty ()
+        ? f.url
+        : f.hash + '/' + std::to_string (f.size);
+    }
+
+    // Clone the file if the filesystem supports it (Btrfs, XFS, etc), in
+    // which case the two share the storage until either is modified. Return
+    // false if that's not possible (including across filesystems).
+    //
+    bool
+    reflink (const path& f, const path& t)
+    {
+#ifdef __linux__
+      int i (::open (f.c_str (), O_RDONLY | O_CLOEXEC));
+
+      if (i == -1)
+        return false;
+
+      struct stat s;
+      int o (::fstat (i, &s) == 0
+             ? ::open (t.c_str (),
+                       O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                       s.st_mode & 0777)
+             : -1);
+
+      bool r (o != -1 && ::ioctl (o, FICLONE, i) == 0);
+
+      if (o != -1)
+        ::close (o);
+
+      ::close (i);
+
+      if (!r && o != -1)
+      {
+        error_code e;
+        remove (t, e);
+      }
+
+      return r;
+#else
+      (void) f;
+      (void) t;
+      return false;
+#endif
+    }
+
+    // Materialize an object at another location.
+    //
+    // We prefer a reflink, then (if requested) a hard link so that the two end
+    // up sharing the storage, and fall back to a copy if the two locations are
+    // on different filesystems (or the filesystem supports neither). Note that
+    // a hard link is only appropriate if neither side is modified in place,
+    // which is not something we can assume for installed files.
+    //
+    void
+    materialize (const path& f, const path& t, bool link = false)
+    {
+      error_code e;
+
+      remove (t, e);
+
+      if (reflink (f, t))
+        return;
+
+      if (link)
+      {
+        create_hard_link (f, t, e);
+
+        if (!e)
+          return;
+      }
+
+      copy_file (f, t, copy_options::overwrite_existing, e);
+
+      if (e)
+        throw system_error (e, "failed to materialize " + to_utf8 (t));
+    }
+
+    // Satisfy the plan's downloads from identical files (same hash and size)
+    // that are already installed elsewhere in the tree, for example, shared
+    // between components or moved between releases.
+    //
+    // We materialize such files in their staging slots where stage_plan()
+    // picks them up as pre-staged (verifying the hash on the way). Return the
+    // number of files so materialized.
+    //
+    size_t
+    stage_installed (cache_coordinator& cc, const vector<reconcile_item>& pl)
+    {
+      vector<staged_file> ds (staged_files (pl, staging_directory ()));
+
+      if (ds.empty ())
+        return 0;
+
+      unordered_multimap<string, path> ix;
+
+      for (const cached_file& f : cc.database ().files ())
+      {
+        if (!f.hash ().empty ())
+          ix.emplace (f.hash () + '/' + std::to_string (f.size ()),
+                      from_utf8 (f.path ()));
+      }
+
+      size_t r (0);
+      error_code e;
+
+      for (const staged_file& d : ds)
+      {
+        if (d.hash.empty () || d.size == 0 || exists (d.tmp, e))
+          continue;
+
+        auto [b, x] (ix.equal_range (object_key (d)));
+
+        for (auto i (b); i != x; ++i)
+        {
+          const path& s (i->second);
+
+          // Only trust files that haven't changed since we tracked them.
+          //
+          if (s == d.dst || cc.stat (s) != file_state::valid)
+            continue;
+
+          try
+          {
+            materialize (s, d.tmp);
+
+            trace_l2 ("materialized {} from installed {}",
+                      to_utf8 (d.tmp),
+                      to_utf8 (s));
+            ++r;
+            break;
+          }
+          catch (const system_error& ex)
+          {
+            warning ("unable to reuse {}: {}", to_utf8 (s), ex.what ());
+          }
+        }
+      }
+
+      return r;
+    }
+
+    asio::awaitable<void>
+    execute_plan (asio::io_context& io,
+                  download_coordinator& dc,
+                  progress_coordinator* pc,
+                  cache_coordinator& cc,
+                  const vector<reconcile_item>& pl,
+                  const manifest& md,
+                  const path& ir,
+                  download_priority pr = download_priority::normal,
+                  uint64_t rl = 0)
+    {
+      if (size_t n = stage_installed (cc, pl))
+        info ("reusing {} identical installed file(s)", n);
+
+      auto ds (co_await stage_plan (io, dc, pc, pl, pr, rl));
+
+      if (!ds.empty ())
+        co_await apply_plan (cc, ds, md, ir);
+    }
+
+    // Return true if the plan item is boot-critical, that is, it has to be in
+    // place before the game can be launched.
+    //
+    // Everything except DLC is (the client binaries, the core rawfiles, and
+    // the Steam helper). On top of that, individual DLC files or directories
+    // can be pulled into the set with --boot-critical (paths relative to the
+    // installation root).
+    //
+    bool
+    boot_critical (const reconcile_item& i,
+                   const path& root,
+                   const vector<string>& ps)
+    {
+      if (i.component != component_type::dlc)
+        return true;
+
+      path p (from_utf8 (i.path));
+
+      if (p.is_absolute ())
+        p = p.lexically_relative (root);
+
+      string r (to_utf8 (p.generic_path ()));
+
+      return ranges::any_of (ps, [&r] (const string& x)
+      {
+        string g (to_utf8 (from_utf8 (x).generic_path ()));
+        return !g.empty () && r.starts_with (g);
+      });
+    }
+
+    // Last known release metadata.
+    //
+    // We remember the release (and the raw manifest) resolved for each
+    // repository in the cache database. If on the next run the API is
+    // rate-limited or slower than the deadline, we carry on with what we saw
+    // last time instead of holding up the launch. The record is revalidated
+    // (and replaced) on the next run that gets through.
+    //
+    string
+    release_key (const string& repo, bool pre)
+    {
+      return "release_" + repo + (pre ? "_pre" : "");
+    }
+
+    string
+    manifest_key (const string& repo)
+    {
+      return "manifest_" + repo;
+    }
+
+    optional<github_release>
+    load_release (const cache_database& db, const string& k)
+    {
+      string s (db.setting_value (k));
+
+      if (s.empty ())
+        return nullopt;
+
+      try
+      {
+        github_release r (github_api_traits::parse_release (json::parse (s)));
+
+        if (!r.tag_name.empty ())
+          return r;
+      }
+      catch (const exception& e)
+      {
+        trace_l2 ("ignoring malformed {} record: {}", k, e.what ());
+      }
+
+      return nullopt;
+    }
+
+    // Return the stored manifest text if it was taken from the manifest asset
+    // of the specified release.
+    //
+    optional<string>
+    load_manifest_text (const cache_database& db,
+                        const string& k,
+                        const github_asset& a)
+    {
+      string s (db.setting_value (k));
+
+      if (s.empty ())
+        return nullopt;
+
+      try
+      {
+        json::value v (json::parse (s));
+        const json::object& o (v.as_object ());
+
+        if (json::value_to<uint64_t> (o.at ("asset")) == a.id &&
+            json::value_to<uint64_t> (o.at ("size")) == a.size)
+          return json::value_to<string> (o.at ("text"));
+      }
+      catch (const exception& e)
+      {
+        trace_l2 ("ignoring malformed {} record: {}", k, e.what ());
+      }
+
+      return nullopt;
+    }
+
+    void
+    save_manifest_text (cache_database& db,
+                        const string& k,
+                        const github_asset& a,
+                        const string& t)
+    {
+      json::object o;
+      o["asset"] = a.id;
+      o["size"] = a.size;
+      o["text"] = t;
+
+      db.setting (k, json::serialize (o));
+    }
+
+    asio::awaitable<github_release>
+    resolve_release (github_coordinator& gh,
+                     cache_coordinator& cc,
+                     const string& repo,
+                     bool pre,
+                     release_memo* rm)
+    {
+      if (rm != nullptr)
+      {
+        auto i (rm->releases.find (repo));
+
+        if (i != rm->releases.end ())
+          co_return i->second;
+      }
+
+      cache_database& db (cc.database ());
+      string k (release_key (repo, pre));
+      optional<github_release> lr (load_release (db, k));
+
+      optional<github_release> r;
+      bool stale (false);
+
+      if (!lr)
+        r = co_await gh.fetch_latest_release (github_org, repo, pre);
+      else if (rm != nullptr && rm->api_unavailable)
+      {
+        info ("using last known {} release {}", repo, lr->tag_name);
+
+        r = std::move (lr);
+        stale = true;
+      }
+      else
+      {
+        // Since we have something to fall back to, don't sit out the rate
+        // limit and don't wait for a sluggish API past the deadline.
+        //
+        string e;
+        gh.set_wait_on_rate_limit (false);
+
+        try
+        {
+          auto f (gh.fetch_latest_release (github_org, repo, pre));
+
+          if (gh.deadline () != chrono::milliseconds::zero ())
+          {
+            asio::steady_timer t (co_await asio::this_coro::executor);
+            t.expires_after (gh.deadline ());
+
+            auto w (t.async_wait (asio::use_awaitable));
+            auto v (co_await (std::move (f) || std::move (w)));
+
+            if (v.index () == 0)
+              r = std::move (get<0> (v));
+            else
+              e = "timed out";
+          }
+          else
+            r = co_await std::move (f);
+        }
+        catch (const exception& x)
+        {
+          e = x.what ();
+        }
+
+        gh.set_wait_on_rate_limit (true);
+
+        if (!r)
+        {
+          warning ("unable to query latest {} release ({}), using last known "
+                   "release {}",
+                   repo, e, lr->tag_name);
+
+          r = std::move (lr);
+          stale = true;
+
+          if (rm != nullptr)
+            rm->api_unavailable = true;
+        }
+      }
+
+      if (!stale)
+        db.setting (k, json::serialize (github_api_traits::to_json (*r)));
+
+      if (rm != nullptr)
+        rm->releases.emplace (repo, *r);
+
+      co_return *r;
+    }
+
+    asio::awaitable<manifest>
+    resolve_manifest (github_coordinator& gh,
+                      cache_coordinator& cc,
+                      const string& repo,
+                      const github_release& rel,
+                      release_memo* rm)
+    {
+      if (rm != nullptr)
+      {
+        auto i (rm->manifests.find (repo));
+
+        if (i != rm->manifests.end ())
+          co_return i->second;
+      }
+
+      // Release assets are practically immutable (re-uploading one gives it a
+      // new id) so if we already have the manifest for this asset, there is
+      // no need to download it again. This also covers the case where we are
+      // running off the last known release.
+      //
+      cache_database& db (cc.database ());
+      string k (manifest_key (repo));
+
+      optional<string> t;
+      optional<github_asset> a (gh.find_asset (rel, "update.json"));
+
+      if (a)
+        t = load_manifest_text (db, k, *a);
+
+      if (!t)
+      {
+        t = co_await gh.fetch_manifest_text (rel);
+
+        if (a)
+          save_manifest_text (db, k, *a, *t);
+      }
+
+      manifest m (gh.load_manifest (rel, *t));
+
+      if (rm != nullptr)
+        rm->manifests.emplace (repo, m);
+
+      co_return m;
+    }
+
+    asio::awaitable<string>
+    resolve_content (http_coordinator& hc, const string& url, release_memo* rm)
+    {
+      if (rm != nullptr)
+      {
+        auto i (rm->content.find (url));
+
+        if (i != rm->content.end ())
+          co_return i->second;
+      }
+
+      auto c (co_await hc.get (url));
+
+      if (rm != nullptr)
+        rm->content.emplace (url, c);
+
+      co_return c;
+    }
+
+    // Plan the reconciliation on a separate thread, leaving the I/O context
+    // free to make progress with whatever is in flight in the meantime (see
+    // download_coordinator::warm()).
+    //
+    asio::awaitable<vector<reconcile_item>>
+    plan_async (cache_coordinator& cc,
+                const manifest& m,
+                component_type c,
+                const string& v)
+    {
+      asio::thread_pool tp (1);
+
+      auto op (asio::co_spawn (
+        tp,
+        [&cc, &m, c, &v] () -> asio::awaitable<vector<reconcile_item>>
+        {
+          co_return cc.plan (m, c, v);
+        },
+        asio::use_awaitable));
+
+      co_return co_await std::move (op);
+    }
+
+    // Return the download URLs of all the release assets plus the host they
+    // redirect to, for warming connections.
+    //
+    vector<string>
+    asset_urls (const github_release& rel)
+    {
+      vector<string> r;
+
+      for (const auto& a : rel.assets)
+        r.push_back (a.browser_download_url);
+
+      if (!r.empty ())
+        r.push_back (github_endpoint::asset_base);
+
+      return r;
+    }
+
+    // Prepare the core client update, if any.
+    //
+    asio::awaitable<optional<staged_update>>
+    prepare_client (github_coordinator& gh,
+                    cache_coordinator& cc,
+                    bool pre,
+                    release_memo* rm = nullptr,
+                    download_coordinator* dc = nullptr)
+    {
+      info ("synchronizing client component...");
+
+      auto rel (co_await resolve_release (gh, cc, client_repo, pre, rm));
+      bool out (cc.outdated (component_type::client, rel.tag_name));
+
+      if (!out)
+      {
+        auto s (cc.audit (component_type::client));
+        bool ok (ranges::all_of (s | views::values, [] (auto st) {
+          return st == file_state::valid; }));
+
+        // Deep-verify here since we won't get to planning otherwise.
+        //
+        ok = ok && cc.scrub (component_type::client) == 0;
+
+        if (ok)
+        {
+          info ("client components are valid and up to date");
+          co_return nullopt;
+        }
+
+        warning ("client physical audit failed, forcing reconcile");
+      }
+
+      auto ms (co_await resolve_manifest (gh, cc, client_repo, rel, rm));
+      manifest m (ms);
+
+      if (dc != nullptr)
+        dc->warm (asset_urls (rel));
+
+      auto p (co_await plan_async (cc, m, component_type::client,
+                                   rel.tag_name));
+
+      for (auto& i : p | views::filter ([] (const auto& x) {
+        return x.action == reconcile_action::download && x.url.empty (); }))
+      {
+        string fn (to_utf8 (from_utf8 (i.path).filename ()));
+        auto it (ranges::find_if (rel.assets, [&fn] (const auto& a) {
+          return a.name == fn; }));
+
+        if (it != rel.assets.end ())
+          i.url = it->browser_download_url;
+
+        if (i.url.empty ())
+        {
+          throw runtime_error (
+            "reconciliation failed: unable to resolve URL for " +
+            i.path);
+        }
+      }
+
+      co_return staged_update {component_type::client,
+                               rel.tag_name,
+                               std::move (m),
+                               std::move (p)};
+    }
+
+    // Prepare the rawfiles repository update, if any.
+    //
+    asio::awaitable<optional<staged_update>>
+    prepare_rawfiles (github_coordinator& gh,
+                      cache_coordinator& cc,
+                      bool pre,
+                      release_memo* rm = nullptr,
+                      download_coordinator* dc = nullptr)
+    {
+      info ("synchronizing rawfiles component...");
+
+      auto rel (co_await resolve_release (gh, cc, rawfiles_repo, pre, rm));
+      bool out (cc.outdated (component_type::rawfiles, rel.tag_name));
+
+      if (!out)
+      {
+        auto s (cc.audit (component_type::rawfiles));
+        bool ok (ranges::all_of (s | views::values, [] (auto st) {
+          return st == file_state::valid; }));
+
+        // Deep-verify here since we won't get to planning otherwise.
+        //
+        ok = ok && cc.scrub (component_type::rawfiles) == 0;
+
+        if (ok)
+        {
+          info ("rawfiles components are valid and up to date");
+          co_return nullopt;
+        }
+
+        warning ("rawfiles physical audit failed, forcing reconcile");
+      }
+
+      auto ms (co_await resolve_manifest (gh, cc, rawfiles_repo, rel, rm));
+      manifest m (ms);
+
+      for (auto& a : m.archives)
+      {
+        if (a.name == "__launcher_archive.zip")
+          a.name = "release.zip";
+      }
+
+      if (dc != nullptr)
+        dc->warm (asset_urls (rel));
+
+      auto p (co_await plan_async (cc, m, component_type::rawfiles,
+                                   rel.tag_name));
+
+      for (auto& i : p | views::filter ([] (const auto& x) {
+        return x.action == reconcile_action::download && x.url.empty (); }))
+      {
+        string fn (to_utf8 (from_utf8 (i.path).filename ()));
+
+        auto it (ranges::find_if (rel.assets, [&fn] (const auto& a) {
+          return a.name == fn; }));
+
+        if (it == rel.assets.end ())
+        {
+          string asset_name = fn;
+          replace (asset_name.begin (), asset_name.end (), '.', '_');
+          asset_name = "__launcher_" + asset_name + ".bin";
+
+          it = ranges::find_if (rel.assets, [&asset_name] (const auto& a) {
+            return a.name == asset_name; });
+        }
+
+        if (it != rel.assets.end ())
+          i.url = it->browser_download_url;
+
+        if (i.url.empty ())
+        {
+          throw runtime_error (
+            "reconciliation failed: unable to resolve URL for " +
+            i.path);
+        }
+      }
+
+      co_return staged_update {component_type::rawfiles,
+                               rel.tag_name,
+                               std::move (m),
+                               std::move (p)};
+    }
+
+    // Prepare the dynamic downloadable content (DLC) update.
+    //
+    asio::awaitable<optional<staged_update>>
+    prepare_dlc (http_coordinator& hc,
+                 cache_coordinator& cc,
+                 const path& root,
+                 release_memo* rm = nullptr,
+                 download_coordinator* dc = nullptr)
+    {
+      info ("synchronizing dlc component...");
+
+      auto ms (co_await resolve_content (hc, cdn + "update.json", rm));
+      manifest dlc (ms, manifest_format::dlc);
+
+      manifest m;
+      for (const auto& f : dlc.files)
+      {
+        manifest_archive x;
+        x.name = f.path;
+        x.url = cdn + f.path;
+        x.size = f.size;
+        x.hash = f.hash;
+
+        m.archives.push_back (std::move (x));
+      }
+
+      if (dc != nullptr)
+        dc->warm ({cdn});
+
+      auto p (co_await plan_async (cc, m, component_type::dlc, "dlc"));
+
+      for (auto& i : p | views::filter ([] (const auto& x) {
+        return x.action == reconcile_action::download && x.url.empty (); }))
+      {
+        auto it (ranges::find_if (m.archives,
+                                  [&i, &root] (const auto& a)
+        {
+          return to_utf8 (from_utf8 (i.path)) ==
+            to_utf8 (manifest_coordinator::resolve_path (a, root));
+        }));
+
+        if (it != m.archives.end ())
+          i.url = it->url;
+
+        if (i.url.empty ())
+        {
+          throw runtime_error (
+            "reconciliation failed: unable to resolve URL for " + i.path);
+        }
+      }
+
+      co_return staged_update {component_type::dlc,
+                               "dlc",
+                               std::move (m),
+                               std::move (p)};
+    }
+
+#ifdef __linux__
+    asio::awaitable<optional<staged_update>>
+    prepare_helper (github_coordinator& gh,
+                    cache_coordinator& cc,
+                    bool pre,
+                    release_memo* rm = nullptr,
+                    download_coordinator* dc = nullptr)
+    {
+      info ("synchronizing linux steam helper component...");
+
+      auto rel (co_await resolve_release (gh, cc, steam_helper_repo, pre, rm));
+      bool out (cc.outdated (component_type::helper, rel.tag_name));
+
+      if (!out)
+      {
+        auto s (cc.audit (component_type::helper));
+        bool ok (ranges::all_of (s | views::values, [] (auto st) {
+          return st == file_state::valid; }));
+
+        // Deep-verify here since we won't get to planning otherwise.
+        //
+        ok = ok && cc.scrub (component_type::helper) == 0;
+
+        if (ok)
+        {
+          info ("steam helper components are valid and up to date");
+          co_return nullopt;
+        }
+
+        warning ("steam helper physical audit failed, forcing reconcile");
+      }
+
+      manifest m;
+      for (const auto& a : rel.assets)
+      {
+        if (a.name != "steam.exe" && a.name != "steam_api64.dll")
+          continue;
+
+        manifest_archive x;
+        x.name = a.name;
+        x.url = a.browser_download_url;
+        x.size = a.size;
+
+        m.archives.push_back (std::move (x));
+      }
+
+      if (dc != nullptr)
+        dc->warm (asset_urls (rel));
+
+      auto p (co_await plan_async (cc, m, component_type::helper,
+                                   rel.tag_name));
+
+      for (auto& i : p | views::filter ([] (const auto& x) {
+        return x.action == reconcile_action::download && x.url.empty (); }))
+      {
+        string fn (to_utf8 (from_utf8 (i.path).filename ()));
+        auto it (ranges::find_if (rel.assets, [&fn] (const auto& a) {
+          return a.name == fn; }));
+
+        if (it != rel.assets.end ())
+          i.url = it->browser_download_url;
+
+        if (i.url.empty ())
+          throw runtime_error (
+            "reconciliation failed: unable to resolve URL for " +
+            i.path);
+      }
+
+      co_return staged_update {component_type::helper,
+                               rel.tag_name,
+                               std::move (m),
+                               std::move (p)};
+    }
+#endif
+
+    // Call f(n, io) for each installation root on a pool of workers, each with
+    // its own I/O context, and rethrow the first failure once they are all
+    // done.
+    //
+    template <typename F>
+    void
+    for_each_root (const vector<path>& roots, size_t workers, const F& f)
+    {
+      worker_placement wp;
+      asio::thread_pool tp (min (roots.size (), max<size_t> (workers, 1)));
+      vector<exception_ptr> es (roots.size ());
+
+      for (size_t n (0); n != roots.size (); ++n)
+      {
+        asio::post (tp, [&f, &es, &wp, n] ()
+        {
+          wp.place ();
+
+          try
+          {
+            asio::io_context rio;
+            exception_ptr ep;
+
+            asio::co_spawn (rio,
+                            f (n, rio),
+                            [&ep] (exception_ptr e) { ep = e; });
+
+            rio.run ();
+
+            if (ep)
+              rethrow_exception (ep);
+          }
+          catch (...)
+          {
+            es[n] = current_exception ();
+          }
+        });
+      }
+
+      tp.join ();
+
+      for (const auto& e : es)
+      {
+        if (e)
+          rethrow_exception (e);
+      }
+    }
+  }
+
+  void
+  configure_cdn (string b)
+  {
+    cdn = move (b);
+  }
+
+  const string&
+  configured_cdn ()
+  {
+    return cdn;
+  }
+
+  path
+  resolve_cache_root ()
+  {
+    path d (current_path () / "cache");
+
+    trace_l2 ("cache root: {}", to_utf8 (d));
+
+    error_code ec;
+
+    create_directories (d, ec);
+
+    if (ec)
+      throw system_error (ec,
+                          "failed to create cache directory: " + to_utf8 (d));
+
+    return d;
+  }
+
+  path
+  staging_directory ()
+  {
+    error_code e;
+    path sd (weakly_canonical (resolve_cache_root () / "staging", e));
+
+    if (e)
+      throw system_error (e,
+                          "failed to canonicalize staging directory: " +
+                            to_utf8 (sd));
+
+    create_directories (sd, e);
+
+    if (e)
+      throw system_error (e,
+                          "failed to create staging directory: " +
+                            to_utf8 (sd));
+
+    return sd;
+  }
+
+  // Note that we use hashes of the destination paths in the staging area to
+  // avoid name collisions if two files have the same basename but belong to
+  // different subdirectories (or installation roots).
+  //
+  vector<staged_file>
+  staged_files (const vector<reconcile_item>& pl, const path& sd)
+  {
+    auto is_dl ([] (const auto& i)
+    {
+      return i.action == reconcile_action::download;
+    });
+
+    auto to_dl ([&sd] (const auto& i)
+    {
+      if (i.url.empty ())
+        throw runtime_error (
+          "reconciliation failed: missing download URL for " + i.path);
+
+      path d (from_utf8 (i.path));
+      path t (sd / (path_digest (d) + "_" + to_utf8 (d.filename ())));
+
+      return staged_file {i.url,
+                          t,
+                          d,
+                          i.expected_size,
+                          i.component,
+                          i.version,
+                          i.expected_hash,
+                          0,
+                          false};
+    });
+
+    vector<staged_file> ds;
+    for (auto&& x : pl | views::filter (is_dl) | views::transform (to_dl))
+      ds.push_back (std::move (x));
+
+    return ds;
+  }
+
+  asio::awaitable<vector<staged_file>>
+  stage_plan (asio::io_context& io,
+              download_coordinator& dc,
+              progress_coordinator* pc,
+              const vector<reconcile_item>& pl,
+              download_priority pr,
+              uint64_t rl)
+  {
+    error_code e;
+    vector<staged_file> ds (staged_files (pl, staging_directory ()));
+
+    if (ds.empty ())
+      co_return ds;
+
+    // Skip files that are already fully staged, for example, pre-downloaded
+    // by the background daemon.
+    //
+    // Note that the staging name only depends on the destination path so a
+    // leftover from an older release can have the right name but the wrong
+    // content. That's why we verify the hash if we have one and discard
+    // anything that doesn't match (partial files are left for the download
+    // manager to resume).
+    //
+    for (auto& d : ds)
+    {
+      if (d.size == 0 || !exists (d.tmp, e))
+        continue;
+
+      uintmax_t fs (file_size (d.tmp, e));
+
+      if (e || fs < d.size)
+        continue;
+
+      if (fs == d.size && (d.hash.empty () || verify_blake3 (d.tmp, d.hash)))
+      {
+        trace_l2 ("using pre-staged file: {}", to_utf8 (d.tmp));
+        d.done = true;
+      }
+      else
+        remove (d.tmp, e);
+    }
+
+    // The same content can appear under several paths (or in several
+    // components). Download it once, preferring an occurrence that is
+    // already staged, and materialize the rest from it at the end. Until
+    // then the duplicates are marked as done so that they are not queued.
+    //
+    unordered_map<string, staged_file*> os;
+
+    for (auto& d : ds)
+    {
+      auto [i, n] (os.emplace (object_key (d), &d));
+
+      if (!n && d.done && !i->second->done)
+        i->second = &d;
+    }
+
+    vector<pair<staged_file*, const staged_file*>> dups;
+
+    for (auto& d : ds)
+    {
+      const staged_file* o (os.at (object_key (d)));
+
+      if (o != &d && !d.done)
+      {
+        dups.emplace_back (&d, o);
+        d.done = true;
+      }
+    }
+
+    if (!dups.empty ())
+      info ("skipping {} duplicate download(s)", dups.size ());
+
+    struct active_task
+    {
+      shared_ptr<download_coordinator::task_type> h;
+      shared_ptr<progress_entry> ui;
+      staged_file* ctx;
+
+      active_task (shared_ptr<download_coordinator::task_type> h_,
+                   shared_ptr<progress_entry> ui_,
+                   staged_file* ctx_)
+        : h (std::move (h_)),
+          ui (std::move (ui_)),
+          ctx (ctx_)
+      {
+      }
+    };
+
+    // Loop as long as there are incomplete downloads that have not exhausted
+    // their retry budget.
+    //
+    // Notice that network drops are common during bulk asset fetching. We are
+    // slightly forgiving here and allow a few retries before failing.
+    //
+    auto is_pd ([] (const auto& d)
+    {
+      return !d.done && d.retries < 3;
+    });
+
+    bool hp (ranges::any_of (ds, is_pd));
+
+    while (hp)
+    {
+      vector<active_task> ts;
+
+      auto pds (ds | views::filter (is_pd));
+
+      for (auto& d : pds)
+      {
+        download_request r;
+        r.urls.push_back (d.url);
+        r.target = d.tmp;
+        r.name = to_utf8 (d.dst.filename ());
+        r.expected_size = d.size;
+        r.expected_hash = d.hash;
+        r.priority = pr;
+        r.rate_limit_bytes_per_second = rl;
+
+        auto t (dc.queue_download (std::move (r)));
+
+        // The entry follows the task's counters which the transfer updates
+        // in batches.
+        //
+        shared_ptr<progress_entry> en;
+
+        if (pc != nullptr)
+        {
+          en = pc->add_entry (t->request.name,
+                              {t, &t->downloaded_bytes},
+                              {t, &t->total_bytes});
+
+          en->metrics ().total_bytes.store (d.size, memory_order_relaxed);
+        }
+
+        ts.emplace_back (t, en, &d);
+      }
+
+      if (ts.empty ())
+        break;
+
+      info ("executing download batch ({} queued files)", ts.size ());
+
+      if (pc != nullptr)
+        pc->start ();
+
+      auto ml ([&io, &ts, pc] () -> asio::awaitable<void>
+      {
+        // Periodically scan the active tasks to see if any have finished.
+        //
+        // If they have, we clean up their UI entries and mark them done. If a
+        // task fails, we increment its retry counter so it will be picked up
+        // again in the next outer loop iteration.
+        //
+        asio::steady_timer tm (io);
+        while (!ts.empty ())
+        {
+          erase_if (ts,
+                    [pc] (const auto& at)
+          {
+            if (at.h->completed () || at.h->failed ())
+            {
+              if (at.ui != nullptr)
+                pc->remove_entry (at.ui);
+
+              if (at.h->completed ())
+                at.ctx->done = true;
+              else
+                at.ctx->retries++;
+
+              return true;
+            }
+
+            return false;
+          });
+
+          if (!ts.empty ())
+          {
+            tm.expires_after (chrono::milliseconds (25));
+            co_await tm.async_wait (asio::use_awaitable);
+          }
+        }
+      });
+
+      // Run the downloads and the monitoring loop concurrently, yielding back
+      // until everything completes.
+      //
+      // Notice that we use wait_for_all() to avoid orphaned operations running
+      // in the background if an exception is thrown.
+      //
+      auto [order, err_dl, err_ui](
+        co_await asio::experimental::make_parallel_group (
+          asio::co_spawn (io, dc.execute_all (), asio::deferred),
+          asio::co_spawn (io, ml (), asio::deferred))
+          .async_wait (asio::experimental::wait_for_all (),
+                       asio::use_awaitable));
+
+      if (err_dl)
+        std::rethrow_exception (err_dl);
+      if (err_ui)
+        std::rethrow_exception (err_ui);
+
+      if (pc != nullptr)
+        co_await pc->stop ();
+
+      hp = ranges::any_of (ds, is_pd);
+    }
+
+    auto is_f ([] (const auto& d)
+    {
+      return !d.done;
+    });
+
+    ptrdiff_t fc (ranges::count_if (ds, is_f));
+
+    if (fc > 0)
+      throw runtime_error (std::to_string (fc) +
+                           " downloads failed permanently after retries");
+
+    // Note that the duplicates end up as separate installed files so they
+    // must not share an inode.
+    //
+    for (const auto& [d, o] : dups)
+      materialize (o->tmp, d->tmp);
+
+    co_return ds;
+  }
+
+  asio::awaitable<void>
+  apply_plan (cache_coordinator& cc,
+              const vector<staged_file>& ds,
+              const manifest& md,
+              const path& ir)
+  {
+    error_code e;
+
+    info ("validating and applying staged files...");
+
+    for (const auto& d : ds)
+    {
+      // Validate that the file actually ended up on disk and matches our
+      // expected dimensions.
+      //
+      // A missing file or a size mismatch at this stage strongly implies a
+      // truncated download or a local filesystem failure.
+      //
+      if (!exists (d.tmp, e))
+        throw runtime_error ("downloaded file missing from staging area: " +
+                             to_utf8 (d.tmp));
+
+      uintmax_t fs (file_size (d.tmp, e));
+
+      if (e || fs == 0 || (d.size > 0 && fs != d.size))
+      {
+        throw runtime_error ("downloaded file failed size validation: " +
+                             to_utf8 (d.tmp));
+      }
+
+      if (d.dst.has_parent_path ())
+      {
+        path pd (weakly_canonical (d.dst.parent_path (), e));
+
+        if (e)
+          throw system_error (e,
+                              "failed to canonicalize parent directory: " +
+                                to_utf8 (pd));
+
+        create_directories (pd, e);
+
+        if (e)
+          throw system_error (e,
+                              "failed to create parent directory: " +
+                                to_utf8 (pd));
+      }
+
+      if (exists (d.dst))
+        remove (d.dst, e);
+
+      rename (d.tmp, d.dst, e);
+
+      // If a simple rename fails, it is usually because the staging directory
+      // and the destination directory reside on different filesystem mounts. In
+      // this case, the best we can do is attempt a full copy.
+      //
+      if (e)
+      {
+        copy_file (d.tmp, d.dst, copy_options::overwrite_existing, e);
+
+        if (!e)
+          remove (d.tmp, e);
+        else
+          throw runtime_error ("failed to apply file: " + to_utf8 (d.dst));
+      }
+    }
+
+    unordered_map<string, const manifest_archive*> am;
+
+    for (const auto& a : md.archives)
+      am[to_utf8 (manifest_coordinator::resolve_path (a, ir))] = &a;
+
+    // Extract the archives but hold off recording anything until it is all
+    // on disk (see below). For an archive we track what it contained rather
+    // than the archive itself.
+    //
+    vector<pair<const staged_file*, optional<vector<path>>>> ts;
+    ts.reserve (ds.size ());
+
+    for (const auto& d : ds)
+    {
+      // If the item is a zip file and matches a known archive in our manifest,
+      // extract it directly into the root and track its contents.
+      //
+      if (d.dst.extension () == ".zip" || d.dst.extension () == ".ZIP")
+      {
+        auto i (am.find (to_utf8 (d.dst)));
+
+        if (i != am.end ())
+        {
+          info ("extracting downloaded archive: {}", to_utf8 (d.dst));
+          co_await manifest_coordinator::extract_archive (*i->second,
+                                                          d.dst,
+                                                          ir);
+
+          auto resolve_p ([&ir] (const auto& s)
+          {
+            return manifest_coordinator::resolve_path (s, ir);
+          });
+
+          vector<path> efs;
+          for (auto&& x : i->second->files | views::transform (resolve_p))
+            efs.push_back (std::move (x));
+
+          remove (d.dst, e);
+          ts.emplace_back (&d, std::move (efs));
+
+          continue;
+        }
+      }
+
+      ts.emplace_back (&d, nullopt);
+    }
+
+    // Once recorded (and the component stamped by our caller), the files are
+    // only checked by mtime. So if the records make it to the disk before the
+    // data does, a power loss leaves us with corrupt files that look valid.
+    // Issue a single barrier for the whole batch to prevent that.
+    //
+    if (configured_durability () != durability_mode::none)
+    {
+      vector<path> ps;
+
+      for (const auto& [d, efs] : ts)
+      {
+        if (efs)
+          ps.insert (ps.end (), efs->begin (), efs->end ());
+        else
+          ps.push_back (d->dst);
+      }
+
+      trace_l2 ("synchronizing {} applied file(s)", ps.size ());
+      sync_files (ps);
+    }
+
+    for (const auto& [d, efs] : ts)
+    {
+      if (efs)
+        cc.track (*efs, d->comp, d->ver);
+      else
+        cc.track (to_utf8 (d->dst), d->comp, d->ver, d->hash);
+    }
+  }
+
+  asio::awaitable<void>
+  apply_update (asio::io_context& io,
+                download_coordinator& dc,
+                progress_coordinator* pc,
+                cache_coordinator& cc,
+                const path& root,
+                const staged_update& u,
+                download_priority pr,
+                uint64_t rl)
+  {
+    co_await execute_plan (io, dc, pc, cc, u.plan, u.m, root, pr, rl);
+    cc.clean (u.m, u.comp);
+    cc.stamp (u.comp, u.ver);
+  }
+
+  asio::awaitable<vector<staged_update>>
+  apply_critical (asio::io_context& io,
+                  download_coordinator& dc,
+                  progress_coordinator* pc,
+                  cache_coordinator& cc,
+                  const path& root,
+                  vector<staged_update> us,
+                  const vector<string>& ps)
+  {
+    vector<staged_update> r;
+
+    for (auto& u : us)
+    {
+      vector<reconcile_item> cp, dp;
+
+      for (auto& i : u.plan)
+      {
+        bool c (i.action != reconcile_action::download ||
+                boot_critical (i, root, ps));
+
+        (c ? cp : dp).push_back (std::move (i));
+      }
+
+      u.plan = std::move (cp);
+
+      if (dp.empty ())
+      {
+        co_await apply_update (io, dc, pc, cc, root, u,
+                               download_priority::critical);
+        continue;
+      }
+
+      co_await execute_plan (io, dc, pc, cc, u.plan, u.m, root,
+                             download_priority::critical);
+
+      info ("deferring {} file(s) until after launch", dp.size ());
+
+      u.plan = std::move (dp);
+      r.push_back (std::move (u));
+    }
+
+    co_return r;
+  }
+
+  // The download manager can only limit individual downloads so we split the
+  // cap evenly between the downloads that can run in parallel. This
+  // undershoots once fewer of them are left but never overshoots.
+  //
+  asio::awaitable<void>
+  apply_deferred (asio::io_context& io,
+                  download_coordinator& dc,
+                  const path& root,
+                  const vector<staged_update>& us,
+                  uint64_t cap,
+                  size_t jobs)
+  {
+    cache_coordinator cc (io, root);
+
+    for (const auto& u : us)
+    {
+      size_t dn (ranges::count_if (u.plan, [] (const auto& i)
+      {
+        return i.action == reconcile_action::download;
+      }));
+
+      size_t n (max<size_t> (min (dn, jobs), 1));
+
+      uint64_t rl (cap != 0 ? max<uint64_t> (cap / n, 1) : 0);
+
+      info ("downloading {} deferred file(s) in the background", dn);
+
+      co_await apply_update (io, dc, nullptr, cc, root, u,
+                             download_priority::low, rl);
+    }
+  }
+
+  asio::awaitable<vector<staged_update>>
+  stage_updates (asio::io_context& io,
+                 github_coordinator& gh,
+                 http_coordinator& hc,
+                 download_coordinator& dc,
+                 cache_coordinator& cc,
+                 const path& root,
+                 bool pre)
+  {
+    auto r (co_await prepare_all (gh, hc, cc, root, pre, nullptr, &dc));
+
+    for (const auto& u : r)
+      co_await stage_plan (io, dc, nullptr, u.plan, download_priority::low);
+
+    co_return r;
+  }
+
+  asio::awaitable<void>
+  apply_updates (asio::io_context& io,
+                 download_coordinator& dc,
+                 cache_coordinator& cc,
+                 const path& root,
+                 const vector<staged_update>& us)
+  {
+    for (const auto& u : us)
+      co_await apply_update (io, dc, nullptr, cc, root, u);
+  }
+
+  asio::awaitable<vector<staged_update>>
+  prepare_all (github_coordinator& gh,
+               http_coordinator& hc,
+               cache_coordinator& cc,
+               const path& root,
+               bool pre,
+               release_memo* rm,
+               download_coordinator* dc)
+  {
+    vector<staged_update> r;
+
+    // Share what we resolve (and how the API fared) across the components
+    // even if the caller doesn't.
+    //
+    release_memo lm;
+
+    if (rm == nullptr)
+      rm = &lm;
+
+    if (auto u = co_await prepare_client (gh, cc, pre, rm, dc))
+      r.push_back (std::move (*u));
+
+    if (auto u = co_await prepare_rawfiles (gh, cc, pre, rm, dc))
+      r.push_back (std::move (*u));
+
+    if (auto u = co_await prepare_dlc (hc, cc, root, rm, dc))
+      r.push_back (std::move (*u));
+
+#ifdef __linux__
+    if (auto u = co_await prepare_helper (gh, cc, true, rm, dc))
+      r.push_back (std::move (*u));
+#endif
+
+    co_return r;
+  }
+
+  asio::awaitable<void>
+  resolve_all (github_coordinator& gh,
+               http_coordinator& hc,
+               download_coordinator& dc,
+               cache_coordinator& cc,
+               bool pre,
+               release_memo& rm)
+  {
+    for (const char* r : {client_repo, rawfiles_repo})
+    {
+      auto rel (co_await resolve_release (gh, cc, r, pre, &rm));
+      co_await resolve_manifest (gh, cc, r, rel, &rm);
+      dc.warm (asset_urls (rel));
+    }
+
+    co_await resolve_content (hc, cdn + "update.json", &rm);
+    dc.warm ({cdn});
+
+#ifdef __linux__
+    dc.warm (asset_urls (
+      co_await resolve_release (gh, cc, steam_helper_repo, true, &rm)));
+#endif
+  }
+
+  asio::awaitable<void>
+  sync_fleet (asio::io_context& io,
+              github_coordinator& gh,
+              http_coordinator& hc,
+              download_coordinator& dc,
+              progress_coordinator& pc,
+              const vector<path>& roots,
+              bool pre,
+              size_t workers,
+              bool link)
+  {
+    release_memo rm;
+
+    {
+      cache_coordinator cc (io, roots.front ());
+      co_await resolve_all (gh, hc, dc, cc, pre, rm);
+    }
+
+    // Plan each root on its own thread. This is where the hashing is.
+    //
+    // Note that the coordinators are only used for what is not in the memo
+    // and so are never touched from the workers.
+    //
+    vector<vector<staged_update>> us (roots.size ());
+
+    for_each_root (
+      roots,
+      workers,
+      [&gh, &hc, &roots, &rm, &us, pre] (size_t n, asio::io_context& rio)
+        -> asio::awaitable<void>
+    {
+      info ("planning installation root {}", to_utf8 (roots[n]));
+
+      cache_coordinator cc (rio, roots[n]);
+      us[n] = co_await prepare_all (gh, hc, cc, roots[n], pre, &rm);
+    });
+
+    path sd (staging_directory ());
+
+    // Note that we download each object under the staging name of the first
+    // root that needs it.
+    //
+    unordered_map<string, path> os;
+    vector<reconcile_item> pl;
+
+    for (const auto& ru : us)
+    {
+      for (const auto& u : ru)
+      {
+        for (const auto& i : u.plan)
+        {
+          if (i.action != reconcile_action::download)
+            continue;
+
+          vector<staged_file> fs (staged_files ({i}, sd));
+
+          if (os.emplace (object_key (fs.front ()), fs.front ().tmp).second)
+            pl.push_back (i);
+        }
+      }
+    }
+
+    info ("downloading {} unique object(s) for {} installation root(s)",
+          pl.size (),
+          roots.size ());
+
+    co_await stage_plan (io, dc, &pc, pl);
+
+    // Materialize every object in the staging slot of each root that needs
+    // it. This has to be done for all the roots before we apply any of them
+    // since applying moves the downloaded copy away.
+    //
+    vector<vector<vector<staged_file>>> ds (us.size ());
+
+    for (size_t n (0); n != us.size (); ++n)
+    {
+      for (const auto& u : us[n])
+      {
+        vector<staged_file> fs (staged_files (u.plan, sd));
+
+        for (auto& f : fs)
+        {
+          const path& o (os.at (object_key (f)));
+
+          if (f.tmp != o)
+            materialize (o, f.tmp, link);
+
+          f.done = true;
+        }
+
+        ds[n].push_back (std::move (fs));
+      }
+    }
+
+    // Now apply each root on its own thread. At this point there is no
+    // network involved and each root has its own cache database so the only
+    // thing they share is the disk.
+    //
+    for_each_root (
+      roots,
+      workers,
+      [&us, &ds, &roots] (size_t n, asio::io_context& rio)
+        -> asio::awaitable<void>
+    {
+      cache_coordinator cc (rio, roots[n]);
+
+      for (size_t i (0); i != us[n].size (); ++i)
+      {
+        const staged_update& u (us[n][i]);
+
+        co_await apply_plan (cc, ds[n][i], u.m, roots[n]);
+        cc.clean (u.m, u.comp);
+        cc.stamp (u.comp, u.ver);
+      }
+
+      info ("installation root {} is up to date", to_utf8 (roots[n]));
+    });
+  }
+
+}
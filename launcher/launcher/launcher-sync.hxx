@@ -0,0 +1,263 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <launcher/launcher-cache.hxx>
+#include <launcher/launcher-download.hxx>
+#include <launcher/launcher-github.hxx>
+#include <launcher/launcher-http.hxx>
+#include <launcher/launcher-manifest.hxx>
+#include <launcher/launcher-progress.hxx>
+
+namespace launcher
+{
+  namespace asio = boost::asio;
+  namespace fs = std::filesystem;
+
+  // Installation synchronization.
+  //
+  // Bringing an installation up to date happens in three steps: prepare
+  // (resolve the release of each component and plan the reconciliation),
+  // stage (download whatever the plan needs into the staging area without
+  // touching the installation), and apply (move the staged files into
+  // place, extracting archives on the way, and record the result in the
+  // cache). The launcher, the background updater, and the fleet mode all
+  // combine these steps differently.
+  //
+
+  // GitHub repository coordinates of our distribution infrastructure.
+  //
+  inline constexpr const char* github_org        = "iw4x";
+  inline constexpr const char* launcher_repo     = "launcher";
+  inline constexpr const char* client_repo       = "iw4x-client";
+  inline constexpr const char* rawfiles_repo     = "iw4x-rawfiles";
+  inline constexpr const char* steam_helper_repo = "launcher-steam";
+
+  // Base URL the DLC is served from: the manifest is update.json and the
+  // files are at their paths relative to the base. The default is our CDN.
+  //
+  void
+  configure_cdn (std::string base);
+
+  const std::string&
+  configured_cdn ();
+
+  // Return the cache directory of the installation in the current working
+  // directory, creating it if necessary.
+  //
+  fs::path
+  resolve_cache_root ();
+
+  // Return the (canonicalized) staging directory, creating it if necessary.
+  //
+  fs::path
+  staging_directory ();
+
+  // A plan item that requires downloading along with its location in the
+  // staging area.
+  //
+  struct staged_file
+  {
+    std::string    url;
+    fs::path       tmp;
+    fs::path       dst;
+    std::uint64_t  size;
+    component_type comp;
+    std::string    ver;
+    std::string    hash;
+    int            retries;
+    bool           done;
+  };
+
+  // A component update that has been discovered and planned but not yet
+  // applied to the installation.
+  //
+  struct staged_update
+  {
+    component_type              comp;
+    std::string                 ver;
+    manifest                    m;
+    std::vector<reconcile_item> plan;
+  };
+
+  // Releases and manifests resolved during this run.
+  //
+  // In the fleet mode we prepare the same components for several
+  // installation roots and there is no reason to ask GitHub (or the CDN) more
+  // than once. Likewise, once the API has failed us (rate limit, deadline),
+  // we don't ask it again for the other components.
+  //
+  struct release_memo
+  {
+    std::map<std::string, github_release> releases;  // Keyed by repository.
+    std::map<std::string, manifest>       manifests; // Keyed by repository.
+    std::map<std::string, std::string>    content;   // Keyed by URL.
+
+    bool api_unavailable = false;
+  };
+
+  // Extract only items that require downloading and build tracking
+  // structures.
+  //
+  // Note that the staging name of an item only depends on its destination
+  // path.
+  //
+  std::vector<staged_file>
+  staged_files (const std::vector<reconcile_item>& plan,
+                const fs::path& staging);
+
+  // Prepare every component in turn and return the pending updates.
+  //
+  // If the download coordinator is not NULL, then warm the connections to
+  // the hosts we are going to download from while planning.
+  //
+  asio::awaitable<std::vector<staged_update>>
+  prepare_all (github_coordinator&,
+               http_coordinator&,
+               cache_coordinator&,
+               const fs::path& root,
+               bool prerelease,
+               release_memo* = nullptr,
+               download_coordinator* = nullptr);
+
+  // Resolve the releases and manifests of every component into the memo
+  // (see prepare_all()) and warm the connections to the hosts we may
+  // download from.
+  //
+  // After this, preparing an installation root doesn't need the network and
+  // so can be done off the I/O context.
+  //
+  asio::awaitable<void>
+  resolve_all (github_coordinator&,
+               http_coordinator&,
+               download_coordinator&,
+               cache_coordinator&,
+               bool prerelease,
+               release_memo&);
+
+  // Download every item of the plan that requires it into the staging area
+  // without touching the installation itself.
+  //
+  // If the progress coordinator is NULL, then run headless (this is what the
+  // background daemon does). If the rate limit is not 0, then it caps each
+  // download (in bytes per second).
+  //
+  asio::awaitable<std::vector<staged_file>>
+  stage_plan (asio::io_context&,
+              download_coordinator&,
+              progress_coordinator*,
+              const std::vector<reconcile_item>& plan,
+              download_priority = download_priority::normal,
+              std::uint64_t rate_limit = 0);
+
+  // Move the staged files into the installation, extracting archives on the
+  // way, and track the result in the cache.
+  //
+  asio::awaitable<void>
+  apply_plan (cache_coordinator&,
+              const std::vector<staged_file>&,
+              const manifest&,
+              const fs::path& root);
+
+  // Apply a previously prepared update: fetch (or pick up already staged)
+  // files, move them into place, and record the new version.
+  //
+  asio::awaitable<void>
+  apply_update (asio::io_context&,
+                download_coordinator&,
+                progress_coordinator*,
+                cache_coordinator&,
+                const fs::path& root,
+                const staged_update&,
+                download_priority = download_priority::normal,
+                std::uint64_t rate_limit = 0);
+
+  // Apply the boot-critical part of the pending updates at the top download
+  // priority and return the rest, which can be applied once the game is
+  // running (see apply_deferred()).
+  //
+  // Everything except DLC is boot-critical. On top of that, individual DLC
+  // files or directories can be pulled into the set (paths relative to the
+  // installation root).
+  //
+  // Note that a component with a deferred part is not cleaned and stamped
+  // here. That only happens once it has been applied completely so if we
+  // get interrupted the next run will pick up where we left off.
+  //
+  asio::awaitable<std::vector<staged_update>>
+  apply_critical (asio::io_context&,
+                  download_coordinator&,
+                  progress_coordinator*,
+                  cache_coordinator&,
+                  const fs::path& root,
+                  std::vector<staged_update>,
+                  const std::vector<std::string>& boot_critical);
+
+  // Apply the deferred updates headless and at low priority while the game
+  // is running, keeping the aggregate bandwidth under the cap (bytes per
+  // second, 0 for no cap).
+  //
+  // Note that this opens the cache database of the root itself so the
+  // caller must not be holding it.
+  //
+  asio::awaitable<void>
+  apply_deferred (asio::io_context&,
+                  download_coordinator&,
+                  const fs::path& root,
+                  const std::vector<staged_update>&,
+                  std::uint64_t cap,
+                  std::size_t jobs);
+
+  // Prepare the pending updates and download them into the staging area,
+  // headless and at low priority, without touching the installation. This
+  // is a cycle of the background updater.
+  //
+  asio::awaitable<std::vector<staged_update>>
+  stage_updates (asio::io_context&,
+                 github_coordinator&,
+                 http_coordinator&,
+                 download_coordinator&,
+                 cache_coordinator&,
+                 const fs::path& root,
+                 bool prerelease);
+
+  // Apply the updates staged by stage_updates(). At this point this is
+  // mostly renames.
+  //
+  asio::awaitable<void>
+  apply_updates (asio::io_context&,
+                 download_coordinator&,
+                 cache_coordinator&,
+                 const fs::path& root,
+                 const std::vector<staged_update>&);
+
+  // Synchronize several installation roots at once (fleet mode).
+  //
+  // Releases are resolved once, every root is planned in parallel, each
+  // unique object (identified by its content hash or, failing that, by its
+  // URL) is downloaded once into the shared staging area, and then every
+  // root is reconciled in parallel.
+  //
+  // Unless hard links are requested, each root gets its own copy (or reflink)
+  // of every object so that modifying a file in one root doesn't affect the
+  // others.
+  //
+  asio::awaitable<void>
+  sync_fleet (asio::io_context&,
+              github_coordinator&,
+              http_coordinator&,
+              download_coordinator&,
+              progress_coordinator&,
+              const std::vector<fs::path>& roots,
+              bool prerelease,
+              std::size_t workers,
+              bool link);
+}
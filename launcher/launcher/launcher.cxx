@@ -4,16 +4,21 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <exception>
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <system_error>
-#include <unordered_map>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -23,13 +28,17 @@
 #include <boost/process.hpp>
 
 #include <launcher/launcher-cache.hxx>
+#include <launcher/launcher-daemon.hxx>
 #include <launcher/launcher-download.hxx>
 #include <launcher/launcher-github.hxx>
 #include <launcher/launcher-http.hxx>
 #include <launcher/launcher-log.hxx>
 #include <launcher/launcher-manifest.hxx>
 #include <launcher/launcher-options.hxx>
+#include <launcher/launcher-prefetch.hxx>
 #include <launcher/launcher-progress.hxx>
+#include <launcher/launcher-resources.hxx>
+#include <launcher/launcher-sync.hxx>
 #include <launcher/launcher-update.hxx>
 
 #ifdef __linux__
@@ -51,20 +60,19 @@ namespace launcher
 {
   namespace
   {
-    // GitHub repository coordinates and CDN base URL for our distribution
-    // infrastructure.
-    //
-    constexpr const char* github_org          = "iw4x";
-    constexpr const char* client_repo         = "iw4x-client";
-    constexpr const char* rawfiles_repo       = "iw4x-rawfiles";
-    constexpr const char* steam_helper_repo   = "launcher-steam";
-    constexpr const char* cdn_manifest_url    = "https://cdn.iw4x.io/update.json";
-    constexpr const char* cdn_base_url        = "https://cdn.iw4x.io/";
-
     // Steam application ID for the game (Call of Duty: Modern Warfare 2).
     //
     constexpr std::uint32_t steam_app_id = 10190;
 
+    // How long after launching the game we record the files it opens (see
+    // --prefetch). This should cover getting to the main menu.
+    //
+    constexpr chrono::seconds prefetch_window (60);
+
+    // Settings key of the learned prefetch set.
+    //
+    constexpr const char* prefetch_key = "prefetch_files";
+
     constexpr auto
     info ([] (auto&&... args)
     {
@@ -228,39 +236,20 @@ namespace launcher
     }
   }
 
-  string
-  path_digest (const path& p)
-  {
-    std::hash<string> h;
-    string r (std::to_string (h (to_utf8 (p))));
-
-    trace_l3 ("computed path digest for {}: {}", to_utf8 (p), r);
-    return r;
-  }
-
-  path
-  resolve_cache_root ()
-  {
-    path d (current_path () / "cache");
-
-    trace_l2 ("cache root: {}", to_utf8 (d));
-
-    error_code ec;
-
-    create_directories (d, ec);
-
-    if (ec)
-      throw system_error (ec,
-                          "failed to create cache directory: " + to_utf8 (d));
-
-    return d;
-  }
-
+  // Check for a launcher update and, if there is one, install it and restart
+  // into it.
+  //
+  // Unless the update is all we were asked to do (o), we don't hold up the
+  // launch for this: if we are rate-limited or the API is slower than the
+  // deadline (d), then we skip the check until the next run.
+  //
   asio::awaitable<void>
   check_self_update (asio::io_context& io,
                       bool p,
                       bool o,
-                      progress_coordinator& pc)
+                      chrono::milliseconds d,
+                      progress_coordinator& pc,
+                      shared_ptr<github_index> ri)
   {
     info ("checking for launcher updates (prerelease: {}, update_only: {})",
           p,
@@ -269,13 +258,42 @@ namespace launcher
     auto uc (make_update_coordinator (io));
     uc->set_include_prerelease (p);
     uc->set_auto_restart (o);
+    uc->discovery ().set_release_index (move (ri));
+
+    update_status s (update_status::check_failed);
+
+    if (o)
+    {
+      bind_rate_limit_ui (io, *uc, pc);
+      s = co_await uc->check_for_updates ();
+    }
+    else
+    {
+      uc->discovery ().api ().set_wait_on_rate_limit (false);
+
+      if (d != chrono::milliseconds::zero ())
+      {
+        asio::steady_timer t (co_await asio::this_coro::executor);
+        t.expires_after (d);
+
+        auto v (co_await (uc->check_for_updates () ||
+                          t.async_wait (asio::use_awaitable)));
 
-    bind_rate_limit_ui (io, *uc, pc);
+        s = v.index () == 0 ? get<0> (v) : update_status::check_failed;
+      }
+      else
+        s = co_await uc->check_for_updates ();
+    }
 
-    auto s (co_await uc->check_for_updates ());
+    if (s == update_status::check_failed)
+    {
+      if (o)
+        throw runtime_error ("only update requested but check failed");
 
-    if (s == update_status::check_failed && o)
-      throw runtime_error ("only update requested but check failed");
+      warning ("unable to check for launcher updates, skipping until the "
+               "next run");
+      co_return;
+    }
 
     if (s == update_status::up_to_date)
     {
@@ -299,571 +317,381 @@ namespace launcher
     uc->restart ();
   }
 
+  // Write a signed release index for the launcher and every component (see
+  // github_index for the format).
+  //
   asio::awaitable<void>
-  execute_plan (asio::io_context& io,
-                download_coordinator& dc,
-                progress_coordinator& pc,
-                cache_coordinator& cc,
-                const vector<reconcile_item>& pl,
-                const manifest& md,
-                const path& ir)
+  generate_release_index (github_coordinator& gh,
+                          const path& f,
+                          const string& key)
   {
-    struct dl_info
-    {
-      string         url;
-      path           tmp;
-      path           dst;
-      uint64_t       size;
-      component_type comp;
-      string         ver;
-      string         hash;
-      int            retries;
-      bool           done;
-    };
-
-    error_code e;
-    path sd (weakly_canonical (resolve_cache_root () / "staging", e));
-
-    if (e)
-      throw system_error (e,
-                          "failed to canonicalize staging directory: " +
-                            to_utf8 (sd));
-
-    create_directories (sd, e);
-
-    if (e)
-      throw system_error (e,
-                          "failed to create staging directory: " +
-                            to_utf8 (sd));
-
-    // Extract only items that require downloading and build tracking
-    // structures.
-    //
-    // Note that we use hashes of the destination paths in the staging area to
-    // avoid name collisions if two files have the same basename but belong to
-    // different subdirectories.
-    //
-    auto is_dl ([] (const auto& i)
-    {
-      return i.action == reconcile_action::download;
-    });
-
-    auto to_dl ([&sd] (const auto& i)
-    {
-      if (i.url.empty ())
-        throw runtime_error (
-          "reconciliation failed: missing download URL for " + i.path);
-
-      path d (from_utf8 (i.path));
-      path t (sd / (path_digest (d) + "_" + to_utf8 (d.filename ())));
-
-      return dl_info {i.url,
-                      t,
-                      d,
-                      i.expected_size,
-                      i.component,
-                      i.version,
-                      i.expected_hash,
-                      0,
-                      false};
-    });
-
-    vector<dl_info> ds;
-    for (auto&& x : pl | views::filter (is_dl) | views::transform (to_dl))
-      ds.push_back (std::move (x));
-
-    if (ds.empty ())
-      co_return;
-
-    struct active_task
-    {
-      shared_ptr<download_coordinator::task_type> h;
-      shared_ptr<progress_entry> ui;
-      dl_info* ctx;
-
-      active_task (shared_ptr<download_coordinator::task_type> h_,
-                   shared_ptr<progress_entry> ui_,
-                   dl_info* ctx_)
-        : h (std::move (h_)),
-          ui (std::move (ui_)),
-          ctx (ctx_)
-      {
-      }
-    };
+    github_index::entries_type es;
 
-    // Loop as long as there are incomplete downloads that have not exhausted
-    // their retry budget.
-    //
-    // Notice that network drops are common during bulk asset fetching. We are
-    // slightly forgiving here and allow a few retries before failing.
-    //
-    auto is_pd ([] (const auto& d)
-    {
-      return !d.done && d.retries < 3;
-    });
-
-    bool hp (ranges::any_of (ds, is_pd));
-
-    while (hp)
+    for (const char* r : {launcher_repo,
+                          client_repo,
+                          rawfiles_repo,
+                          steam_helper_repo})
     {
-      vector<active_task> ts;
-
-      auto pds (ds | views::filter (is_pd));
-
-      for (auto& d : pds)
-      {
-        download_request r;
-        r.urls.push_back (d.url);
-        r.target = d.tmp;
-        r.name = to_utf8 (d.dst.filename ());
-        r.expected_size = d.size;
-
-        auto en (pc.add_entry (r.name));
-        auto t (dc.queue_download (std::move (r)));
-
-        en->metrics ().total_bytes.store (d.size, memory_order_relaxed);
-
-        t->on_progress = [en, &pc] (const download_progress& dp)
-        {
-          pc.update_progress (en, dp.downloaded_bytes, dp.total_bytes);
-        };
-
-        ts.emplace_back (t, en, &d);
-      }
-
-      if (ts.empty ())
-        break;
+      info ("resolving latest releases of {}/{}", github_org, r);
 
-      info ("executing download batch ({} queued files)", ts.size ());
-      pc.start ();
+      github_index::entry e;
+      e.latest = co_await gh.fetch_latest_release (github_org, r, false);
+      e.latest_prerelease = co_await gh.fetch_latest_release (github_org,
+                                                              r,
+                                                              true);
 
-      auto ml ([&io, &ts, &pc] () -> asio::awaitable<void>
-      {
-        // Periodically scan the active tasks to see if any have finished.
-        //
-        // If they have, we clean up their UI entries and mark them done. If a
-        // task fails, we increment its retry counter so it will be picked up
-        // again in the next outer loop iteration.
-        //
-        asio::steady_timer tm (io);
-        while (!ts.empty ())
-        {
-          erase_if (ts,
-                    [&pc] (const auto& at)
-          {
-            if (at.h->completed () || at.h->failed ())
-            {
-              at.h->on_progress = nullptr;
-              pc.remove_entry (at.ui);
-
-              if (at.h->completed ())
-                at.ctx->done = true;
-              else
-                at.ctx->retries++;
+      es.emplace (string (github_org) + '/' + r, std::move (e));
+    }
 
-              return true;
-            }
+    string d (github_index::generate (es, key));
 
-            return false;
-          });
+    ofstream o (f, ios::binary);
+    o.write (d.data (), static_cast<streamsize> (d.size ()));
+    o.close ();
 
-          if (!ts.empty ())
-          {
-            tm.expires_after (chrono::milliseconds (25));
-            co_await tm.async_wait (asio::use_awaitable);
-          }
-        }
-      });
+    if (!o)
+      throw runtime_error ("unable to write release index " + to_utf8 (f));
 
-      // Run the downloads and the monitoring loop concurrently, yielding back
-      // until everything completes.
-      //
-      // Notice that we use wait_for_all() to avoid orphaned operations running
-      // in the background if an exception is thrown.
-      //
-      auto [order, err_dl, err_ui](
-        co_await asio::experimental::make_parallel_group (
-          asio::co_spawn (io, dc.execute_all (), asio::deferred),
-          asio::co_spawn (io, ml (), asio::deferred))
-          .async_wait (asio::experimental::wait_for_all (),
-                       asio::use_awaitable));
-
-      if (err_dl)
-        std::rethrow_exception (err_dl);
-      if (err_ui)
-        std::rethrow_exception (err_ui);
+    info ("wrote release index {} (public key {})",
+          to_utf8 (f),
+          github_index::public_key (key));
+  }
 
-      co_await pc.stop ();
+  // Return the files recorded during the previous session (relative to the
+  // installation root, in the order the game opened them).
+  //
+  vector<path>
+  load_prefetch_set (const cache_database& db)
+  {
+    vector<path> r;
+    string s (db.setting_value (prefetch_key));
 
-      hp = ranges::any_of (ds, is_pd);
-    }
+    if (s.empty ())
+      return r;
 
-    auto is_f ([] (const auto& d)
+    try
     {
-      return !d.done;
-    });
-
-    ptrdiff_t fc (ranges::count_if (ds, is_f));
-
-    if (fc > 0)
-      throw runtime_error (std::to_string (fc) +
-                           " downloads failed permanently after retries");
+      json::value v (json::parse (s));
 
-    info ("validating and applying staged files...");
-
-    for (const auto& d : ds)
+      for (const json::value& f : v.as_array ())
+        r.push_back (from_utf8 (json::value_to<string> (f)));
+    }
+    catch (const exception& e)
     {
-      // Validate that the file actually ended up on disk and matches our
-      // expected dimensions.
-      //
-      // A missing file or a size mismatch at this stage strongly implies a
-      // truncated download or a local filesystem failure.
-      //
-      if (!exists (d.tmp, e))
-        throw runtime_error ("downloaded file missing from staging area: " +
-                             to_utf8 (d.tmp));
-
-      uintmax_t fs (file_size (d.tmp, e));
-
-      if (e || fs == 0 || (d.size > 0 && fs != d.size))
-      {
-        throw runtime_error ("downloaded file failed size validation: " +
-                             to_utf8 (d.tmp));
-      }
-
-      if (d.dst.has_parent_path ())
-      {
-        path pd (weakly_canonical (d.dst.parent_path (), e));
+      trace_l2 ("ignoring malformed {} record: {}", prefetch_key, e.what ());
+      r.clear ();
+    }
 
-        if (e)
-          throw system_error (e,
-                              "failed to canonicalize parent directory: " +
-                                to_utf8 (pd));
+    return r;
+  }
 
-        create_directories (pd, e);
+  void
+  save_prefetch_set (cache_database& db, const vector<path>& ps)
+  {
+    json::array a;
 
-        if (e)
-          throw system_error (e,
-                              "failed to create parent directory: " +
-                                to_utf8 (pd));
-      }
+    for (const path& f : ps)
+      a.emplace_back (to_utf8 (f.generic_path ()));
 
-      if (exists (d.dst))
-        remove (d.dst, e);
+    db.setting (prefetch_key, json::serialize (a));
+  }
 
-      rename (d.tmp, d.dst, e);
+  // Settings key of the generation time of the newest release index we have
+  // accepted from the specified URL (see github_index::set_floor()).
+  //
+  string
+  index_floor_key (const string& u)
+  {
+    return "release_index_generated " + u;
+  }
 
-      // If a simple rename fails, it is usually because the staging directory
-      // and the destination directory reside on different filesystem mounts. In
-      // this case, the best we can do is attempt a full copy.
-      //
-      if (e)
-      {
-        copy_file (d.tmp, d.dst, copy_options::overwrite_existing, e);
+  uint64_t
+  load_index_floor (const cache_database& db, const string& u)
+  {
+    string s (db.setting_value (index_floor_key (u)));
 
-        if (!e)
-          remove (d.tmp, e);
-        else
-          throw runtime_error ("failed to apply file: " + to_utf8 (d.dst));
-      }
+    try
+    {
+      return s.empty () ? 0 : stoull (s);
     }
-
-    unordered_map<string, const manifest_archive*> am;
-
-    for (const auto& a : md.archives)
-      am[to_utf8 (manifest_coordinator::resolve_path (a, ir))] = &a;
-
-    for (const auto& d : ds)
+    catch (const exception&)
     {
-      // If the item is a zip file and matches a known archive in our manifest,
-      // extract it directly into the root and track its contents.
-      //
-      if (d.dst.extension () == ".zip" || d.dst.extension () == ".ZIP")
-      {
-        auto i (am.find (to_utf8 (d.dst)));
-
-        if (i != am.end ())
-        {
-          info ("extracting downloaded archive: {}", to_utf8 (d.dst));
-          co_await manifest_coordinator::extract_archive (*i->second,
-                                                          d.dst,
-                                                          ir);
-
-          auto resolve_p ([&ir] (const auto& s)
-          {
-            return manifest_coordinator::resolve_path (s, ir);
-          });
-
-          vector<path> efs;
-          for (auto&& x : i->second->files | views::transform (resolve_p))
-            efs.push_back (std::move (x));
+      trace_l2 ("ignoring malformed {} record", index_floor_key (u));
+      return 0;
+    }
+  }
 
-          cc.track (efs, d.comp, d.ver);
-          remove (d.dst, e);
+  // Raise the floor to the index accepted in this run, if any.
+  //
+  void
+  save_index_floor (cache_database& db, const github_index& ri)
+  {
+    uint64_t g (ri.generated ());
 
-          continue;
-        }
-      }
+    if (g > load_index_floor (db, ri.url ()))
+      db.setting (index_floor_key (ri.url ()), std::to_string (g));
+  }
 
-      cc.track (to_utf8 (d.dst), d.comp, d.ver, d.hash);
-    }
+  // Log the hosts that had downloads stall (see --low-speed-limit).
+  //
+  void
+  report_stalls (const download_coordinator& dc)
+  {
+    for (const auto& [h, n] : dc.stalls ())
+      warning ("{} download attempt(s) from {} stalled", n, h);
   }
 
-  // Synchronize the core client.
+  // Append the performance of a phase of the run to the ledger: a record for
+  // the phase as a whole (wall time), one per download host, and, if
+  // requested, one for hashing. Note that the hashing totals are for the
+  // whole process so they should only be recorded once.
   //
-  asio::awaitable<void>
-  sync_client (asio::io_context& io,
-                github_coordinator& gh,
-                download_coordinator& dc,
-                progress_coordinator& pc,
-                cache_coordinator& cc,
-                const path& root,
-                bool pre)
+  void
+  record_performance (cache_database& db,
+                      int64_t run,
+                      const string& phase,
+                      const download_coordinator& dc,
+                      chrono::steady_clock::duration d,
+                      bool ok,
+                      bool hashing)
   {
-    info ("synchronizing client component...");
+    auto ms ([] (auto d)
+    {
+      return static_cast<int64_t> (
+        chrono::duration_cast<chrono::milliseconds> (d).count ());
+    });
 
-    auto rel (co_await gh.fetch_latest_release (github_org, client_repo, pre));
-    bool out (cc.outdated (component_type::client, rel.tag_name));
+    perf_record r;
+    r.run = run;
+    r.time = current_timestamp ();
+    r.release = HELLO_VERSION_ID;
 
-    if (!out)
-    {
-      auto s (cc.audit (component_type::client));
-      bool ok (ranges::all_of (s | views::values, [] (auto st) {
-        return st == file_state::valid; }));
+    vector<perf_record> rs;
 
-      if (ok)
-      {
-        info ("client components are valid and up to date");
-        co_return;
-      }
+    perf_record p (r);
+    p.phase = phase;
+    p.duration = ms (d);
+    p.errors = ok ? 0 : 1;
 
-      warning ("client physical audit failed, forcing reconcile");
+    for (const auto& [h, s] : dc.transfers ())
+    {
+      perf_record e (r);
+      e.phase = "download";
+      e.host = h;
+      e.files = s.files;
+      e.bytes = s.bytes;
+      e.duration = ms (s.time);
+      e.errors = s.errors;
+      e.retries = s.retries;
+      rs.push_back (std::move (e));
+
+      p.files += s.files;
+      p.bytes += s.bytes;
+      p.retries += s.retries;
     }
 
-    auto ms (co_await gh.fetch_manifest (rel));
-    manifest m (ms);
-    auto p (cc.plan (m, component_type::client, rel.tag_name));
+    rs.insert (rs.begin (), std::move (p));
 
-    for (auto& i : p | views::filter ([] (const auto& x) {
-      return x.action == reconcile_action::download && x.url.empty (); }))
+    if (hashing)
     {
-      string fn (to_utf8 (from_utf8 (i.path).filename ()));
-      auto it (ranges::find_if (rel.assets, [&fn] (const auto& a) {
-        return a.name == fn; }));
-
-      if (it != rel.assets.end ())
-        i.url = it->browser_download_url;
+      hash_stats hs (hashing_stats ());
 
-      if (i.url.empty ())
+      if (hs.files != 0)
       {
-        throw runtime_error (
-          "reconciliation failed: unable to resolve URL for " +
-          i.path);
+        perf_record e (r);
+        e.phase = "hash";
+        e.files = hs.files;
+        e.bytes = hs.bytes;
+        e.duration = static_cast<int64_t> (hs.time * 1000);
+        rs.push_back (std::move (e));
       }
     }
 
-    co_await execute_plan (io, dc, pc, cc, p, m, root);
-    cc.clean (m, component_type::client);
-    cc.stamp (component_type::client, rel.tag_name);
+    db.record (rs);
   }
 
-  // Synchronize the rawfiles repository.
+  // Start checking whether we can reach the network, that is, resolve and
+  // connect to any of our servers within the timeout.
   //
-  asio::awaitable<void>
-  sync_rawfiles (asio::io_context& io,
-                  github_coordinator& gh,
-                  download_coordinator& dc,
-                  progress_coordinator& pc,
-                  cache_coordinator& cc,
-                  const path& root,
-                  bool pre)
+  // This runs on its own thread (and I/O context) so that it overlaps with
+  // the rest of startup. Note that we never wait for it to wind down since
+  // an outstanding name lookup can take a lot longer than the timeout.
+  //
+  shared_future<bool>
+  probe_network (chrono::milliseconds t)
   {
-    info ("synchronizing rawfiles component...");
-
-    auto rel (co_await gh.fetch_latest_release (github_org, rawfiles_repo, pre));
-    bool out (cc.outdated (component_type::rawfiles, rel.tag_name));
-
-    if (!out)
-    {
-      auto s (cc.audit (component_type::rawfiles));
-      bool ok (ranges::all_of (s | views::values, [] (auto st) {
-        return st == file_state::valid; }));
-
-      if (ok)
-      {
-        info ("rawfiles components are valid and up to date");
-        co_return;
-      }
-
-      warning ("rawfiles physical audit failed, forcing reconcile");
-    }
-
-    auto ms (co_await gh.fetch_manifest (rel));
-    manifest m (ms);
-
-    for (auto& a : m.archives)
-    {
-      if (a.name == "__launcher_archive.zip")
-        a.name = "release.zip";
-    }
-
-    auto p (cc.plan (m, component_type::rawfiles, rel.tag_name));
+    promise<bool> p;
+    shared_future<bool> r (p.get_future ());
 
-    for (auto& i : p | views::filter ([] (const auto& x) {
-      return x.action == reconcile_action::download && x.url.empty (); }))
+    thread ([t, p = std::move (p)] () mutable
     {
-      string fn (to_utf8 (from_utf8 (i.path).filename ()));
+      using tcp = asio::ip::tcp;
 
-      auto it (ranges::find_if (rel.assets, [&fn] (const auto& a) {
-        return a.name == fn; }));
+      asio::io_context io;
+      tcp::resolver rv (io);
+      vector<unique_ptr<tcp::socket>> ss;
+      bool ok (false);
 
-      if (it == rel.assets.end ())
+      for (const char* h : {"api.github.com", "cdn.iw4x.io"})
       {
-        string asset_name = fn;
-        replace (asset_name.begin (), asset_name.end (), '.', '_');
-        asset_name = "__launcher_" + asset_name + ".bin";
+        rv.async_resolve (
+          h, "443",
+          [&io, &ss, &ok] (const error_code& ec,
+                           const tcp::resolver::results_type& es)
+        {
+          if (ec)
+            return;
 
-        it = ranges::find_if (rel.assets, [&asset_name] (const auto& a) {
-          return a.name == asset_name; });
+          ss.push_back (make_unique<tcp::socket> (io));
+          asio::async_connect (
+            *ss.back (), es,
+            [&io, &ok] (const error_code& ec, const tcp::endpoint&)
+          {
+            if (!ec)
+            {
+              ok = true;
+              io.stop ();
+            }
+          });
+        });
       }
 
-      if (it != rel.assets.end ())
-        i.url = it->browser_download_url;
-
-      if (i.url.empty ())
-      {
-        throw runtime_error (
-          "reconciliation failed: unable to resolve URL for " +
-          i.path);
-      }
-    }
+      io.run_for (t);
+      p.set_value (ok);
+    }).detach ();
 
-    co_await execute_plan (io, dc, pc, cc, p, m, root);
-    cc.clean (m, component_type::rawfiles);
-    cc.stamp (component_type::rawfiles, rel.tag_name);
+    return r;
   }
 
-  // Synchronize dynamic downloadable content (DLC).
+  // Verify the installation against the last synchronized state recorded in
+  // the cache database without going to the network. Return the number of
+  // files that are missing or damaged or nullopt if there is nothing
+  // installed.
   //
-  asio::awaitable<void>
-  sync_dlc (asio::io_context& io,
-            http_coordinator& hc,
-            download_coordinator& dc,
-            progress_coordinator& pc,
-            cache_coordinator& cc,
-            const path& root)
+  optional<size_t>
+  audit_local (cache_coordinator& cc)
   {
-    info ("synchronizing dlc component...");
-
-    auto ms (co_await hc.get (cdn_manifest_url));
-    manifest dlc (ms, manifest_format::dlc);
+    optional<size_t> r;
 
-    manifest m;
-    for (const auto& f : dlc.files)
+    for (auto [c, n] : {pair {component_type::client,   "client"},
+                        pair {component_type::rawfiles, "rawfiles"},
+                        pair {component_type::dlc,      "dlc"},
+                        pair {component_type::helper,   "steam helper"}})
     {
-      manifest_archive x;
-      x.name = f.path;
-      x.url = string (cdn_base_url) + f.path;
-      x.size = f.size;
-      x.hash = f.hash;
+      auto s (cc.audit (c));
 
-      m.archives.push_back (std::move (x));
-    }
-
-    auto p (cc.plan (m, component_type::dlc, "dlc"));
+      if (s.empty ())
+        continue;
 
-    for (auto& i : p | views::filter ([] (const auto& x) {
-      return x.action == reconcile_action::download && x.url.empty (); }))
-    {
-      auto it (ranges::find_if (m.archives,
-                                [&i, &root] (const auto& a)
-      {
-        return to_utf8 (from_utf8 (i.path)) ==
-          to_utf8 (manifest_coordinator::resolve_path (a, root));
-      }));
+      auto b (static_cast<size_t> (
+        ranges::count_if (s | views::values, [] (auto st) {
+          return st != file_state::valid; })));
 
-      if (it != m.archives.end ())
-        i.url = it->url;
+      if (b != 0)
+        trace_l2 ("{} {} file(s) are missing or damaged", b, n);
 
-      if (i.url.empty ())
-      {
-        throw runtime_error (
-          "reconciliation failed: unable to resolve URL for " + i.path);
-      }
+      r = r.value_or (0) + b;
     }
 
-    co_await execute_plan (io, dc, pc, cc, p, m, root);
-    cc.clean (m, component_type::dlc);
-    cc.stamp (component_type::dlc, "dlc");
+    return r;
   }
 
-#ifdef __linux__
+  // Run the background updater.
+  //
+  // Every cycle we discover and plan pending updates and download them into
+  // the staging area at low priority. Then, when the launcher asks us over
+  // the local socket, we apply whatever is pending, which at that point is
+  // mostly renames.
+  //
+  // Note that we only open the cache database for the duration of a cycle or
+  // an apply since the database is opened in exclusive locking mode and the
+  // launcher needs it once we are done.
+  //
   asio::awaitable<void>
-  sync_helper (asio::io_context& io,
-                github_coordinator& gh,
-                download_coordinator& dc,
-                progress_coordinator& pc,
-                cache_coordinator& cc,
-                const path& root,
-                bool pre)
+  run_daemon (asio::io_context& io,
+              daemon_coordinator& dm,
+              github_coordinator& gh,
+              http_coordinator& hc,
+              download_coordinator& dc,
+              const path& root,
+              bool pre,
+              chrono::seconds iv,
+              const github_index* ri)
   {
-    info ("synchronizing linux steam helper component...");
+    vector<staged_update> pd;
 
-    auto rel (co_await gh.fetch_latest_release (github_org, steam_helper_repo, pre));
-    bool out (cc.outdated (component_type::helper, rel.tag_name));
-
-    if (!out)
+    dm.set_cycle_handler ([&] () -> asio::awaitable<void>
     {
-      auto s (cc.audit (component_type::helper));
-      bool ok (ranges::all_of (s | views::values, [] (auto st) {
-        return st == file_state::valid; }));
+      cache_coordinator cc (io, root);
 
-      if (ok)
-      {
-        info ("steam helper components are valid and up to date");
-        co_return;
-      }
+      pd = co_await stage_updates (io, gh, hc, dc, cc, root, pre);
 
-      warning ("steam helper physical audit failed, forcing reconcile");
-    }
+      if (ri != nullptr)
+        save_index_floor (cc.database (), *ri);
+
+      info ("{} pending update(s) staged", pd.size ());
+    });
 
-    manifest m;
-    for (const auto& a : rel.assets)
+    dm.set_apply_handler ([&] () -> asio::awaitable<bool>
     {
-      if (a.name != "steam.exe" && a.name != "steam_api64.dll")
-        continue;
+      if (pd.empty ())
+        co_return false;
 
-      manifest_archive x;
-      x.name = a.name;
-      x.url = a.browser_download_url;
-      x.size = a.size;
+      cache_coordinator cc (io, root);
+      co_await apply_updates (io, dc, cc, root, pd);
 
-      m.archives.push_back (std::move (x));
-    }
+      pd.clear ();
+      co_return true;
+    });
+
+    co_await dm.run (iv);
+  }
 
-    auto p (cc.plan (m, component_type::helper, rel.tag_name));
+  // Ask the background updater (if any) not to touch the installation while
+  // we record what the game opens. Return false if it is in the middle of a
+  // cycle.
+  //
+  bool
+  hold_daemon (asio::io_context& io, chrono::seconds d)
+  {
+    bool r (true);
 
-    for (auto& i : p | views::filter ([] (const auto& x) {
-      return x.action == reconcile_action::download && x.url.empty (); }))
+    asio::co_spawn (
+      io,
+      daemon_coordinator::request_hold (
+        io,
+        daemon_coordinator::default_endpoint (resolve_cache_root ()),
+        d),
+      [&r] (exception_ptr ep, bool h)
     {
-      string fn (to_utf8 (from_utf8 (i.path).filename ()));
-      auto it (ranges::find_if (rel.assets, [&fn] (const auto& a) {
-        return a.name == fn; }));
+      r = !ep && h;
+    });
 
-      if (it != rel.assets.end ())
-        i.url = it->browser_download_url;
+    io.restart ();
+    io.run ();
 
-      if (i.url.empty ())
-        throw runtime_error (
-          "reconciliation failed: unable to resolve URL for " +
-          i.path);
-    }
+    return r;
+  }
 
-    co_await execute_plan (io, dc, pc, cc, p, m, root);
-    cc.clean (m, component_type::helper);
-    cc.stamp (component_type::helper, rel.tag_name);
+  // Pull the files the game reads at startup into the page cache before
+  // launching it.
+  //
+  void
+  warm_up (const prefetch_plan& pp)
+  {
+    if (pp.files.empty ())
+      return;
+
+    auto s (chrono::steady_clock::now ());
+    prefetch_result r (prefetch_files (pp));
+
+    info ("prefetched {} file(s) ({} MiB) in {}ms, skipped {}",
+          r.files,
+          r.bytes / (1024 * 1024),
+          chrono::duration_cast<chrono::milliseconds> (
+            chrono::steady_clock::now () - s).count (),
+          r.skipped);
   }
-#endif
 
 #ifdef __linux__
   asio::awaitable<void>
@@ -871,7 +699,8 @@ namespace launcher
             const path& root,
             const string& exe,
             const vector<string>& args,
-            const bool force_steam_runtime)
+            const bool force_steam_runtime,
+            const prefetch_plan& pp)
   {
     if (exe.empty ())
       throw runtime_error ("game binary unspecified");
@@ -886,6 +715,8 @@ namespace launcher
                           "failed to canonicalize game binary path: " +
                             to_utf8 (bin));
 
+    warm_up (pp);
+
     proton_coordinator proton (io, force_steam_runtime);
 
     if (!exists (root / "steam.exe"))
@@ -939,7 +770,8 @@ namespace launcher
             const path& root,
             const string& exe,
             const vector<string>& args,
-            bool /* force_steam_runtime */)
+            bool /* force_steam_runtime */,
+            const prefetch_plan& pp)
   {
     if (exe.empty ())
       throw runtime_error ("game binary unspecified");
@@ -954,6 +786,8 @@ namespace launcher
                           "failed to canonicalize game binary path: " +
                             to_utf8 (bin));
 
+    warm_up (pp);
+
     info ("launching native game process: {}", to_utf8 (bin));
 
     // On Windows, boost::process heavily relies on standard strings mapping to
@@ -1013,52 +847,230 @@ try
 
   reanchor_cwd ();
 
+  // Handle --cache-status.
+  //
+  // Note that this runs alongside a launcher that may be synchronizing the
+  // same installation so we open the database read-only and don't touch
+  // anything else.
+  //
+  if (opt.cache_status ())
   {
-    error_code ec;
-    create_directories (path ("cache"), ec);
-  }
+    cache_database db (current_path (), cache_database::lock_mode::read_only);
+    cache_status st (db.status ());
 
-  active_logger = new logger;
+    auto& o (cout);
 
-  asio::io_context io;
+    for (const auto& c : st.components)
+      o << "component " << c.type
+        << " version " << (c.version ? *c.version : "none")
+        << " files " << c.files
+        << " bytes " << c.bytes << "\n";
 
-  if ((!opt.no_self_update () || opt.self_update_only ()) && !opt.skip_remote ())
-  {
-    progress_coordinator pc (io);
-    exception_ptr ex;
+    o << "last-sync " << (st.last_sync.empty () ? "none" : st.last_sync)
+      << " time " << st.last_sync_time;
 
-    asio::co_spawn (io,[&io, &opt, &pc] () -> asio::awaitable<void>
-    {
-      exception_ptr ep;
+    if (!st.last_sync_error.empty ())
+      o << " error " << st.last_sync_error;
 
-      try
-      {
-        co_await check_self_update (io,
-                                    opt.prerelease (),
-                                    opt.self_update_only (),
-                                    pc);
-      }
-      catch (...)
-      {
-        ep = current_exception ();
-      }
+    o << "\n";
 
-      co_await pc.stop ();
+    return 0;
+  }
 
-      if (ep)
-        rethrow_exception (ep);
+  // Handle --stats-history.
+  //
+  // Same as above as far as the database is concerned.
+  //
+  if (opt.stats_history ())
+  {
+    cache_database db (current_path (), cache_database::lock_mode::read_only);
 
-    } (), [&io, &ex] (exception_ptr ep) { ex = ep; });
+    auto& o (cout);
 
-    io.restart ();
-    io.run ();
-    io.restart ();
+    for (const perf_record& r : db.history ())
+    {
+      o << "run " << r.run
+        << " time " << r.time
+        << " release " << r.release
+        << " phase " << r.phase
+        << " host " << (r.host.empty () ? "-" : r.host)
+        << " files " << r.files
+        << " bytes " << r.bytes
+        << " duration " << r.duration
+        << " throughput " << static_cast<uint64_t> (r.throughput ())
+        << " errors " << r.errors
+        << " retries " << r.retries << "\n";
+    }
 
-    if (ex)
+    return 0;
+  }
+
+  // Note that this has to be set before we open any cache database since it
+  // also determines how the database itself is synchronized.
+  //
+  {
+    const string& m (opt.durability ());
+    durability_mode d;
+
+    if      (m == "none")  d = durability_mode::none;
+    else if (m == "batch") d = durability_mode::batch;
+    else if (m == "full")  d = durability_mode::full;
+    else
+      throw runtime_error ("invalid --durability value '" + m + "'");
+
+    configure_durability (d);
+  }
+
+  {
+    error_code ec;
+    create_directories (path ("cache"), ec);
+  }
+
+  // Without a network every remote call would have to wait out the connect
+  // timeout before failing so find out whether we are online while we are
+  // starting up. We cannot tell with a proxy so assume we are.
+  //
+  optional<shared_future<bool>> probe;
+
+  if (!opt.skip_remote () && opt.probe_timeout () != 0 && opt.proxy ().empty ())
+    probe = probe_network (chrono::milliseconds (opt.probe_timeout ()));
+
+  active_logger = new logger;
+
+  asio::io_context io;
+
+  // Handle --generate-release-index.
+  //
+  if (!opt.generate_release_index ().empty ())
+  {
+    if (opt.release_index_signing_key ().empty ())
+      throw runtime_error ("--generate-release-index requires "
+                           "--release-index-signing-key");
+
+    string key;
+    {
+      ifstream i (opt.release_index_signing_key (), ios::binary);
+
+      if (!i)
+        throw runtime_error ("unable to read " +
+                             opt.release_index_signing_key ());
+
+      key.assign (istreambuf_iterator<char> (i), istreambuf_iterator<char> ());
+    }
+
+    path f (opt.generate_release_index ());
+    github_coordinator gh (io);
+
+    if (const char* t = getenv ("GITHUB_TOKEN"))
+      gh.set_token (t);
+
+    if (!opt.proxy ().empty ())
+      gh.set_proxy (opt.proxy ());
+
+    exception_ptr ex;
+
+    asio::co_spawn (io,
+                    generate_release_index (gh, f, key),
+                    [&ex] (exception_ptr ep) { ex = ep; });
+
+    io.run ();
+
+    if (ex)
       rethrow_exception (ex);
 
-    if (opt.self_update_only ())
-      return 0;
+    return 0;
+  }
+
+  // Static release index, if any.
+  //
+  shared_ptr<github_index> ri;
+
+  if (!opt.release_index ().empty ())
+  {
+    if (opt.release_index_key ().empty ())
+      throw runtime_error ("--release-index requires --release-index-key");
+
+    ri = make_shared<github_index> (io,
+                                    opt.release_index (),
+                                    opt.release_index_key ());
+
+    if (!opt.proxy ().empty ())
+      ri->set_proxy (opt.proxy ());
+
+    // Don't go back to an older index than the one we accepted last time.
+    //
+    try
+    {
+      cache_database db (current_path (),
+                         cache_database::lock_mode::read_only);
+
+      ri->set_floor (load_index_floor (db, ri->url ()));
+    }
+    catch (const exception& e)
+    {
+      trace_l2 ("no previously accepted release index: {}", e.what ());
+    }
+
+    ri->set_max_age (chrono::seconds (
+      static_cast<int64_t> (opt.release_index_max_age ()) * 24 * 60 * 60));
+  }
+
+  bool offline (probe && !probe->get ());
+
+  if (offline)
+    warning ("unable to reach the update servers, continuing offline");
+
+  if ((!opt.no_self_update () || opt.self_update_only ()) &&
+      !opt.skip_remote () &&
+      !offline)
+  {
+    progress_coordinator pc (io);
+    exception_ptr ex;
+
+    asio::co_spawn (io,[&io, &opt, &pc, &ri] () -> asio::awaitable<void>
+    {
+      exception_ptr ep;
+
+      try
+      {
+        co_await check_self_update (
+          io,
+          opt.prerelease (),
+          opt.self_update_only (),
+          chrono::milliseconds (opt.api_deadline ()),
+          pc,
+          ri);
+      }
+      catch (...)
+      {
+        ep = current_exception ();
+      }
+
+      co_await pc.stop ();
+
+      if (ep)
+        rethrow_exception (ep);
+
+    } (), [&io, &ex] (exception_ptr ep) { ex = ep; });
+
+    io.restart ();
+    io.run ();
+    io.restart ();
+
+    if (ex)
+      rethrow_exception (ex);
+  }
+
+  // Whether or not we managed to check, --self-update-only never goes on to
+  // synchronizing and launching the game.
+  //
+  if (opt.self_update_only ())
+  {
+    if (offline)
+      throw runtime_error ("unable to reach the update servers to check for "
+                           "a launcher update");
+
+    return 0;
   }
 
   // The installation root is the current working directory (which
@@ -1077,6 +1089,57 @@ try
 
   info ("installation root: {}", to_utf8 (root));
 
+  // In the fleet mode we manage the specified installation roots rather than
+  // our own.
+  //
+  vector<path> roots;
+
+  for (const string& r : opt.root ())
+  {
+    error_code ec;
+    path p (from_utf8 (r));
+
+    create_directories (p, ec);
+    p = canonical (p, ec);
+
+    if (ec)
+      throw system_error (ec, "failed to canonicalize installation root: " + r);
+
+    info ("fleet installation root: {}", to_utf8 (p));
+    roots.push_back (std::move (p));
+  }
+
+  if (opt.daemon () && !roots.empty ())
+    throw runtime_error ("--daemon cannot be combined with --root");
+
+  // If a background updater is running for this installation, ask it to
+  // apply whatever it has already staged instead of synchronizing ourselves.
+  // If it is in the middle of a cycle, then we don't wait for it (see
+  // daemon_coordinator for details).
+  //
+  // Note that this has to happen before we open the cache database below
+  // since the daemon may be holding it in the middle of a cycle.
+  //
+  bool applied (false);
+
+  if (!opt.daemon () && !opt.skip_remote () && roots.empty ())
+  {
+    path dp (daemon_coordinator::default_endpoint (resolve_cache_root ()));
+
+    asio::co_spawn (io,
+                    daemon_coordinator::request_apply (io, dp),
+                    [&applied] (exception_ptr ep, bool r)
+    {
+      applied = !ep && r;
+    });
+
+    io.restart ();
+    io.run ();
+
+    if (applied)
+      info ("pending updates applied by the background updater");
+  }
+
   // Check if launcher version changed, if so wipe local cache directory.
   //
   {
@@ -1094,6 +1157,26 @@ try
 
       if (exists (cache_dir, ec))
       {
+        // The performance ledger is only useful across releases so carry it
+        // over. The same goes for the release index floor, which would
+        // otherwise let an old index be replayed after every update.
+        //
+        vector<perf_record> ph;
+        uint64_t fl (0);
+
+        try
+        {
+          cache_database pd (root);
+          ph = pd.history ();
+
+          if (ri != nullptr)
+            fl = load_index_floor (pd, ri->url ());
+        }
+        catch (const exception& e)
+        {
+          trace_l2 ("unable to read records to carry over: {}", e.what ());
+        }
+
         info (
           "launcher version changed ({} -> {}), wiping local cache directory: "
           "{}",
@@ -1110,6 +1193,22 @@ try
         // Recreate it since the database was inside.
         //
         create_directories (cache_dir, ec);
+
+        if (!ph.empty () || fl != 0)
+        {
+          try
+          {
+            cache_database pd (root);
+            pd.record (ph);
+
+            if (fl != 0)
+              pd.setting (index_floor_key (ri->url ()), std::to_string (fl));
+          }
+          catch (const exception& e)
+          {
+            warning ("unable to restore carried over records: {}", e.what ());
+          }
+        }
       }
 
       // Re-open the database after potential wipe and save new version.
@@ -1119,23 +1218,206 @@ try
     }
   }
 
-  if (!opt.skip_remote ())
+  // Size the worker pools from what we are actually allowed to use, which
+  // inside a container may be a lot less than what the machine has.
+  //
+  // Note that we size hashing from what a worker managed on previous runs,
+  // if we have any record of that.
+  //
+  uint64_t hr (0);
+
+  try
   {
-    // Build proxy-aware HTTP traits if --proxy was specified.
-    //
-    http_client_traits ht;
+    cache_database db (root);
+
+    if (optional<perf_prior> p = db.prior ("hash"))
+    {
+      hr = static_cast<uint64_t> (p->throughput);
+      trace_l2 ("hashing prior: {} MiB/s per worker over {} run(s)",
+                hr / (1024 * 1024),
+                p->samples);
+    }
+  }
+  catch (const exception& e)
+  {
+    trace_l2 ("unable to query performance ledger: {}", e.what ());
+  }
+
+  resource_limits rl (detect_resource_limits ());
+  resource_plan rp (plan_resources (rl,
+                                    opt.jobs (),
+                                    opt.jobs_specified (),
+                                    hr));
+
+  info ("resource limits: {}", rl.string ());
+  info ("resource plan: {}", rp.string ());
+
+  try
+  {
+    placement_policy pp (to_placement_policy (opt.placement ()));
+
+    if (pp != placement_policy::none)
+      info ("cpu topology: {}", system_topology ().string ());
+
+    configure_placement (pp);
+  }
+  catch (const invalid_argument&)
+  {
+    throw runtime_error ("invalid --placement value '" + opt.placement () +
+                         "'");
+  }
+
+  {
+    hash_pipeline hp;
+    hp.direct_io = opt.direct_io ();
+    hp.max_in_flight = rp.hash_memory;
+    hp.workers = rp.hash_workers;
+    configure_hashing (hp);
+  }
+
+  {
+    const string& m (opt.verify_mode ());
+    strategy s;
+
+    if      (m == "mtime")       s = strategy::mtime;
+    else if (m == "mixed")       s = strategy::mixed;
+    else if (m == "fingerprint") s = strategy::fingerprint;
+    else if (m == "hash")        s = strategy::hash;
+    else
+      throw runtime_error ("invalid --verify-mode value '" + m + "'");
+
+    reconciler::default_mode (s);
+  }
+
+  {
+    verify_budget b;
+    b.bytes = opt.verify_budget () * 1024 * 1024;
+    b.time = chrono::milliseconds (opt.verify_time ());
+    b.interval = chrono::hours (opt.verify_interval () * 24);
+    reconciler::default_budget (b);
+  }
+
+  // Build proxy-aware HTTP traits if --proxy was specified.
+  //
+  http_client_traits ht;
+  if (!opt.proxy ().empty ())
+    ht.proxy_url = opt.proxy ();
+
+  ht.ktls = opt.ktls ();
+  ht.low_speed_limit = opt.low_speed_limit ();
+  ht.low_speed_time = chrono::seconds (opt.low_speed_time ());
+
+  if (opt.daemon ())
+  {
+    github_coordinator   gh (io);
+    http_coordinator     hc (io, ht);
+    download_coordinator dc (io, rp.connections, ht);
+    daemon_coordinator   dm (io,
+                             daemon_coordinator::default_endpoint (
+                               resolve_cache_root ()));
+
     if (!opt.proxy ().empty ())
-      ht.proxy_url = opt.proxy ();
+      gh.set_proxy (opt.proxy ());
+
+    gh.set_deadline (chrono::milliseconds (opt.api_deadline ()));
+    gh.set_release_index (ri);
+
+    asio::signal_set ss (io, SIGINT, SIGTERM);
+    ss.async_wait ([&dm] (const error_code& ec, int)
+    {
+      if (!ec)
+        dm.stop ();
+    });
+
+    exception_ptr daemon_ex;
+
+    asio::co_spawn (
+      io,
+      run_daemon (io,
+                  dm,
+                  gh,
+                  hc,
+                  dc,
+                  root,
+                  opt.prerelease (),
+                  chrono::seconds (opt.daemon_interval ()),
+                  ri.get ()),
+      [&io, &daemon_ex] (exception_ptr ep)
+    {
+      daemon_ex = ep;
+      io.stop ();
+    });
+
+    io.restart ();
+    io.run ();
+
+    if (daemon_ex)
+      rethrow_exception (daemon_ex);
+
+    info ("background updater stopped");
+    return 0;
+  }
+
+  // Updates that can wait until the game is running (see apply_critical()).
+  //
+  vector<staged_update> deferred;
+
+  // Identifies this run in the performance ledger.
+  //
+  int64_t run (chrono::duration_cast<chrono::milliseconds> (
+                 chrono::system_clock::now ().time_since_epoch ()).count ());
+
+  // Even if the background updater has applied what it had staged, we still
+  // verify what is installed and synchronize ourselves if anything needs
+  // repairing.
+  //
+  if (applied)
+  {
+    cache_coordinator cc (io, root);
+    optional<size_t> b (audit_local (cc));
+
+    if (!b || *b != 0)
+    {
+      if (b)
+        info ("{} file(s) are missing or damaged, synchronizing", *b);
+
+      applied = false;
+    }
+  }
+
+  if (opt.skip_remote ())
+  {
+    info ("skipping remote checks and reconciliation (--skip-remote)");
+  }
+  else if (offline && roots.empty () && !applied)
+  {
+    info ("verifying installation against the last synchronized state");
+
+    cache_coordinator cc (io, root);
+    optional<size_t> b (audit_local (cc));
 
+    if (!b)
+      throw runtime_error ("unable to reach the update servers and nothing "
+                           "is installed yet");
+
+    if (*b != 0)
+      warning ("{} file(s) are missing or damaged and cannot be repaired "
+               "offline", *b);
+  }
+  else if (!applied)
+  {
     github_coordinator   gh (io);
     http_coordinator     hc (io, ht);
-    download_coordinator dc (io, opt.jobs (), ht);
+    download_coordinator dc (io, rp.connections, ht);
     progress_coordinator pc (io);
     cache_coordinator    cc (io, root);
 
     if (!opt.proxy ().empty ())
       gh.set_proxy (opt.proxy ());
 
+    gh.set_deadline (chrono::milliseconds (opt.api_deadline ()));
+    gh.set_release_index (ri);
+
     cc.set_github_coordinator (&gh);
     cc.set_download_coordinator (&dc);
     cc.set_progress_coordinator (&pc);
@@ -1146,18 +1428,35 @@ try
     bind_rate_limit_ui (io, gh, pc);
 
     exception_ptr sync_ex;
+    auto ss (chrono::steady_clock::now ());
 
     asio::co_spawn (
       io,
-      [&io, &gh, &hc, &dc, &pc, &cc, &root, &opt] () -> asio::awaitable<void>
+      [&io, &gh, &hc, &dc, &pc, &cc, &root, &roots, &opt, &rp, &deferred] ()
+        -> asio::awaitable<void>
     {
-      co_await sync_client (io, gh, dc, pc, cc, root, opt.prerelease ());
-      co_await sync_rawfiles (io, gh, dc, pc, cc, root, opt.prerelease ());
-      co_await sync_dlc (io, hc, dc, pc, cc, root);
+      if (!roots.empty ())
+      {
+        co_await sync_fleet (io, gh, hc, dc, pc, roots, opt.prerelease (),
+                             rp.apply_workers, opt.root_hard_links ());
+        co_return;
+      }
 
-#ifdef __linux__
-      co_await sync_helper (io, gh, dc, pc, cc, root, true);
-#endif
+      auto us (co_await prepare_all (gh, hc, cc, root, opt.prerelease (),
+                                     nullptr, &dc));
+
+      // Unless we are not going to launch anything or were asked not to, get
+      // the game bootable first and leave the rest for later.
+      //
+      if (opt.skip_launch () || opt.sync_before_launch ())
+      {
+        for (const auto& u : us)
+          co_await apply_update (io, dc, &pc, cc, root, u);
+      }
+      else
+        deferred = co_await apply_critical (io, dc, &pc, cc, root,
+                                            std::move (us),
+                                            opt.boot_critical ());
     }(),
       [&io, &sync_ex] (exception_ptr ep)
     {
@@ -1168,14 +1467,79 @@ try
     io.restart ();
     io.run ();
 
+    report_stalls (dc);
+
+    // Let status tools know how it went (see --cache-status).
+    //
+    if (roots.empty ())
+    {
+      string e;
+
+      if (sync_ex)
+      {
+        try
+        {
+          rethrow_exception (sync_ex);
+        }
+        catch (const exception& x)
+        {
+          e = x.what ();
+        }
+        catch (...)
+        {
+          e = "unknown error";
+        }
+      }
+
+      try
+      {
+        cc.database ().record_sync (!sync_ex, e);
+
+        if (ri != nullptr)
+          save_index_floor (cc.database (), *ri);
+      }
+      catch (const exception& x)
+      {
+        warning ("unable to record synchronization result: {}", x.what ());
+      }
+
+      try
+      {
+        cache_database& db (cc.database ());
+
+        record_performance (db,
+                            run,
+                            "sync",
+                            dc,
+                            chrono::steady_clock::now () - ss,
+                            !sync_ex,
+                            true);
+
+        db.prune_ledger (
+          opt.stats_retention () != 0
+          ? current_timestamp () -
+            static_cast<int64_t> (opt.stats_retention ()) * 24 * 60 * 60
+          : 0);
+      }
+      catch (const exception& x)
+      {
+        warning ("unable to record performance: {}", x.what ());
+      }
+    }
+
     if (sync_ex)
       rethrow_exception (sync_ex);
 
-    info ("all components synchronized and up to date");
+    if (deferred.empty ())
+      info ("all components synchronized and up to date");
+    else
+      info ("boot-critical components synchronized and up to date");
   }
-  else
+
+  if (!roots.empty ())
   {
-    info ("skipping remote checks and reconciliation (--skip-remote)");
+    info ("fleet synchronization completed, not launching");
+    return 0;
   }
 
   if (opt.skip_launch ())
@@ -1184,18 +1548,79 @@ try
     return 0;
   }
 
+  // Warm the page cache with what the game read at startup last time (plus
+  // anything requested explicitly) and record what it reads this time.
+  //
+  // Note that the page cache is charged to our cgroup so we stay within the
+  // memory limit as well. And we don't want to push out whatever else is
+  // running so use at most half of what is available.
+  //
+  prefetch_plan pp;
+  optional<prefetch_recorder> pr;
+
+  if (opt.prefetch ())
+  {
+    vector<path> ps;
+
+    for (const string& f : opt.prefetch_file ())
+      ps.push_back (from_utf8 (f));
+
+    try
+    {
+      cache_database db (root);
+
+      for (path& f : load_prefetch_set (db))
+      {
+        if (find (ps.begin (), ps.end (), f) == ps.end ())
+          ps.push_back (std::move (f));
+      }
+    }
+    catch (const exception& e)
+    {
+      warning ("unable to load prefetch set: {}", e.what ());
+    }
+
+    for (const path& f : ps)
+      pp.files.push_back (root / f);
+
+    uint64_t m (available_memory ());
+
+    if (rl.memory != 0 && (m == 0 || rl.memory < m))
+      m = rl.memory;
+
+    pp.budget = m / 2;
+    pp.workers = rp.hash_workers;
+
+    // The background updater hashes and extracts below the same root from a
+    // separate process and its opens are indistinguishable from the game's.
+    // So ask it to sit out the recording window and, if it is already in
+    // the middle of a cycle, don't learn anything this time.
+    //
+    if (!hold_daemon (io, prefetch_window))
+      trace_l2 ("background updater is busy, prefetch set is not learned");
+    else
+    {
+      pr.emplace (root);
+
+      if (!pr->active ())
+        trace_l2 (
+          "unable to record opened files, prefetch set is not learned");
+    }
+  }
+
   exception_ptr exec_ex;
 
   asio::co_spawn (
     io,
-    [&io, &root, &opt] () -> asio::awaitable<void>
+    [&io, &root, &opt, &pp] () -> asio::awaitable<void>
   {
     co_await execute (
         io,
         root,
         opt.game_exe (),
         opt.game_args (),
-        opt.force_steam_runtime ());
+        opt.force_steam_runtime (),
+        pp);
 
   } (), [&io, &exec_ex] (exception_ptr ep) { exec_ex = ep; io.stop (); });
 
@@ -1205,7 +1630,122 @@ try
   if (exec_ex)
     rethrow_exception (exec_ex);
 
-  info ("execution payload dispatched, terminating launcher");
+  info ("execution payload dispatched");
+
+  auto launched (chrono::steady_clock::now ());
+
+  // Extend the hold to cover the recording window, which starts now. The
+  // deferred synchronization below can run past it, so stop recording at
+  // the end of the window regardless.
+  //
+  if (pr && pr->active ())
+  {
+    if (!hold_daemon (io, prefetch_window))
+    {
+      trace_l2 ("background updater is busy, prefetch set is not learned");
+      pr->stop ();
+      pr.reset ();
+    }
+    else
+      pr->deadline (launched + prefetch_window);
+  }
+
+  // Now that the game is running, finish synchronizing whatever we have
+  // deferred.
+  //
+  if (!deferred.empty ())
+  {
+    download_coordinator dc (io, rp.connections, ht);
+    exception_ptr bg_ex;
+    auto bs (chrono::steady_clock::now ());
+
+    asio::co_spawn (
+      io,
+      apply_deferred (io,
+                      dc,
+                      root,
+                      deferred,
+                      opt.background_rate () * 1024,
+                      rp.connections),
+      [&io, &bg_ex] (exception_ptr ep) { bg_ex = ep; io.stop (); });
+
+    io.restart ();
+    io.run ();
+
+    report_stalls (dc);
+
+    try
+    {
+      cache_database db (root);
+      record_performance (db,
+                          run,
+                          "background",
+                          dc,
+                          chrono::steady_clock::now () - bs,
+                          !bg_ex,
+                          false);
+    }
+    catch (const exception& x)
+    {
+      warning ("unable to record performance: {}", x.what ());
+    }
+
+    // The game is already running so failing here would only lose the
+    // prefetch set. Whatever is still missing is picked up by the next
+    // run (the deferred components are not stamped until complete).
+    //
+    if (bg_ex)
+    {
+      try
+      {
+        rethrow_exception (bg_ex);
+      }
+      catch (const exception& e)
+      {
+        warning ("unable to synchronize deferred components: {}",
+                 to_utf8_system_message (e.what ()));
+      }
+    }
+    else
+      info ("deferred components synchronized and up to date");
+  }
+
+  // Give the game the rest of the window to start up and save what it read
+  // for next time. Note that if nothing was recorded (say, the game failed
+  // to start), then we keep the old set.
+  //
+  if (pr && pr->active ())
+  {
+    auto d (launched + prefetch_window - chrono::steady_clock::now ());
+
+    if (d > chrono::steady_clock::duration::zero ())
+    {
+      info ("recording files opened by the game for {}s",
+            chrono::duration_cast<chrono::seconds> (d).count ());
+
+      this_thread::sleep_for (d);
+    }
+
+    vector<path> ps (pr->stop ());
+
+    if (!ps.empty ())
+    {
+      try
+      {
+        cache_database db (root);
+        save_prefetch_set (db, ps);
+
+        info ("recorded {} file(s) to prefetch on the next launch",
+              ps.size ());
+      }
+      catch (const exception& e)
+      {
+        warning ("unable to save prefetch set: {}", e.what ());
+      }
+    }
+  }
+
+  info ("terminating launcher");
 
   return 0;
 }
@@ -22,6 +22,7 @@ namespace launcher
     struct progress {};
     struct steam {};
     struct update {};
+    struct daemon {};
   }
 
   namespace log
@@ -91,6 +92,13 @@ namespace launcher
       static constexpr quill::LogLevel  threshold = quill::LogLevel::Info;
     };
 
+    template <>
+    struct policy<categories::daemon>
+    {
+      static constexpr std::string_view name      = "daemon";
+      static constexpr quill::LogLevel  threshold = quill::LogLevel::Info;
+    };
+
     template <typename C>
     concept Category = requires
     {
@@ -107,6 +107,18 @@ namespace odb
       grew = true;
     }
 
+    // fingerprint_
+    //
+    if (t[6UL])
+    {
+      i.fingerprint_value.capacity (i.fingerprint_size);
+      grew = true;
+    }
+
+    // verified_
+    //
+    t[7UL] = false;
+
     return grew;
   }
 
@@ -177,6 +189,24 @@ namespace odb
     b[n].capacity = i.hash_value.capacity ();
     b[n].is_null = &i.hash_null;
     n++;
+
+    // fingerprint_
+    //
+    b[n].type = sqlite::image_traits<
+      ::std::string,
+      sqlite::id_text>::bind_value;
+    b[n].buffer = i.fingerprint_value.data ();
+    b[n].size = &i.fingerprint_size;
+    b[n].capacity = i.fingerprint_value.capacity ();
+    b[n].is_null = &i.fingerprint_null;
+    n++;
+
+    // verified_
+    //
+    b[n].type = sqlite::bind::integer;
+    b[n].buffer = &i.verified_value;
+    b[n].is_null = &i.verified_null;
+    n++;
   }
 
   void access::object_traits_impl< ::launcher::cached_file, id_sqlite >::
@@ -311,6 +341,41 @@ namespace odb
       grew = grew || (cap != i.hash_value.capacity ());
     }
 
+    // fingerprint_
+    //
+    {
+      ::std::string const& v =
+        o.fingerprint_;
+
+      bool is_null (false);
+      std::size_t cap (i.fingerprint_value.capacity ());
+      sqlite::value_traits<
+          ::std::string,
+          sqlite::id_text >::set_image (
+        i.fingerprint_value,
+        i.fingerprint_size,
+        is_null,
+        v);
+      i.fingerprint_null = is_null;
+      grew = grew || (cap != i.fingerprint_value.capacity ());
+    }
+
+    // verified_
+    //
+    {
+      ::int64_t const& v =
+        o.verified_;
+
+      bool is_null (false);
+      sqlite::value_traits<
+          ::int64_t,
+          sqlite::id_integer >::set_image (
+        i.verified_value,
+        is_null,
+        v);
+      i.verified_null = is_null;
+    }
+
     return grew;
   }
 
@@ -409,6 +474,35 @@ namespace odb
         i.hash_size,
         i.hash_null);
     }
+
+    // fingerprint_
+    //
+    {
+      ::std::string& v =
+        o.fingerprint_;
+
+      sqlite::value_traits<
+          ::std::string,
+          sqlite::id_text >::set_value (
+        v,
+        i.fingerprint_value,
+        i.fingerprint_size,
+        i.fingerprint_null);
+    }
+
+    // verified_
+    //
+    {
+      ::int64_t& v =
+        o.verified_;
+
+      sqlite::value_traits<
+          ::int64_t,
+          sqlite::id_integer >::set_value (
+        v,
+        i.verified_value,
+        i.verified_null);
+    }
   }
 
   void access::object_traits_impl< ::launcher::cached_file, id_sqlite >::
@@ -440,9 +534,11 @@ namespace odb
   "\"version\", "
   "\"component\", "
   "\"size\", "
-  "\"hash\") "
+  "\"hash\", "
+  "\"fingerprint\", "
+  "\"verified\") "
   "VALUES "
-  "(?, ?, ?, ?, ?, ?)";
+  "(?, ?, ?, ?, ?, ?, ?, ?)";
 
   const char access::object_traits_impl< ::launcher::cached_file, id_sqlite >::find_statement[] =
   "SELECT "
@@ -451,7 +547,9 @@ namespace odb
   "\"cached_files\".\"version\", "
   "\"cached_files\".\"component\", "
   "\"cached_files\".\"size\", "
-  "\"cached_files\".\"hash\" "
+  "\"cached_files\".\"hash\", "
+  "\"cached_files\".\"fingerprint\", "
+  "\"cached_files\".\"verified\" "
   "FROM \"cached_files\" "
   "WHERE \"cached_files\".\"path\"=?";
 
@@ -462,7 +560,9 @@ namespace odb
   "\"version\"=?, "
   "\"component\"=?, "
   "\"size\"=?, "
-  "\"hash\"=? "
+  "\"hash\"=?, "
+  "\"fingerprint\"=?, "
+  "\"verified\"=? "
   "WHERE \"path\"=?";
 
   const char access::object_traits_impl< ::launcher::cached_file, id_sqlite >::erase_statement[] =
@@ -476,7 +576,9 @@ namespace odb
   "\"cached_files\".\"version\", "
   "\"cached_files\".\"component\", "
   "\"cached_files\".\"size\", "
-  "\"cached_files\".\"hash\" "
+  "\"cached_files\".\"hash\", "
+  "\"cached_files\".\"fingerprint\", "
+  "\"cached_files\".\"verified\" "
   "FROM \"cached_files\"";
 
   const char access::object_traits_impl< ::launcher::cached_file, id_sqlite >::erase_query_statement[] =
@@ -2177,7 +2279,9 @@ namespace odb
                       "  \"version\" TEXT NOT NULL,\n"
                       "  \"component\" INTEGER NOT NULL,\n"
                       "  \"size\" INTEGER NOT NULL,\n"
-                      "  \"hash\" TEXT NOT NULL)");
+                      "  \"hash\" TEXT NOT NULL,\n"
+                      "  \"fingerprint\" TEXT NOT NULL,\n"
+                      "  \"verified\" INTEGER NOT NULL)");
           db.execute ("CREATE INDEX \"cached_files_version_i\"\n"
                       "  ON \"cached_files\" (\"version\")");
           db.execute ("CREATE TABLE \"component_versions\" (\n"
@@ -249,6 +249,30 @@ namespace odb
     hash_type_;
 
     static const hash_type_ hash;
+
+    // fingerprint
+    //
+    typedef
+    sqlite::query_column<
+      sqlite::value_traits<
+        ::std::string,
+        sqlite::id_text >::query_type,
+      sqlite::id_text >
+    fingerprint_type_;
+
+    static const fingerprint_type_ fingerprint;
+
+    // verified
+    //
+    typedef
+    sqlite::query_column<
+      sqlite::value_traits<
+        ::int64_t,
+        sqlite::id_integer >::query_type,
+      sqlite::id_integer >
+    verified_type_;
+
+    static const verified_type_ verified;
   };
 
   template <typename A>
@@ -281,6 +305,16 @@ namespace odb
   query_columns< ::launcher::cached_file, id_sqlite, A >::
   hash (A::table_name, "\"hash\"", 0);
 
+  template <typename A>
+  const typename query_columns< ::launcher::cached_file, id_sqlite, A >::fingerprint_type_
+  query_columns< ::launcher::cached_file, id_sqlite, A >::
+  fingerprint (A::table_name, "\"fingerprint\"", 0);
+
+  template <typename A>
+  const typename query_columns< ::launcher::cached_file, id_sqlite, A >::verified_type_
+  query_columns< ::launcher::cached_file, id_sqlite, A >::
+  verified (A::table_name, "\"verified\"", 0);
+
   template <typename A>
   struct pointer_query_columns< ::launcher::cached_file, id_sqlite, A >:
     query_columns< ::launcher::cached_file, id_sqlite, A >
@@ -336,6 +370,17 @@ namespace odb
       std::size_t hash_size;
       bool hash_null;
 
+      // fingerprint_
+      //
+      details::buffer fingerprint_value;
+      std::size_t fingerprint_size;
+      bool fingerprint_null;
+
+      // verified_
+      //
+      long long verified_value;
+      bool verified_null;
+
       std::size_t version;
     };
 
@@ -375,7 +420,7 @@ namespace odb
 
     typedef sqlite::query_base query_base_type;
 
-    static const std::size_t column_count = 6UL;
+    static const std::size_t column_count = 8UL;
     static const std::size_t id_column_count = 1UL;
     static const std::size_t inverse_column_count = 0UL;
     static const std::size_t readonly_column_count = 0UL;
@@ -763,6 +763,10 @@ namespace launcher
   options ()
   : help_ (),
     version_ (),
+    cache_status_ (),
+    stats_history_ (),
+    stats_retention_ (90),
+    stats_retention_specified_ (false),
     build2_metadata_ (),
     prerelease_ (),
     jobs_ (99),
@@ -775,9 +779,55 @@ namespace launcher
     no_self_update_ (),
     self_update_only_ (),
     skip_launch_ (),
+    sync_before_launch_ (),
+    boot_critical_ (),
+    boot_critical_specified_ (false),
+    background_rate_ (4096),
+    background_rate_specified_ (false),
+    prefetch_ (),
+    prefetch_file_ (),
+    prefetch_file_specified_ (false),
     skip_remote_ (),
+    probe_timeout_ (3000),
+    probe_timeout_specified_ (false),
+    api_deadline_ (5000),
+    api_deadline_specified_ (false),
+    direct_io_ (),
+    placement_ ("none"),
+    placement_specified_ (false),
+    durability_ ("batch"),
+    durability_specified_ (false),
+    verify_mode_ ("mtime"),
+    verify_mode_specified_ (false),
+    verify_budget_ (256),
+    verify_budget_specified_ (false),
+    verify_time_ (2000),
+    verify_time_specified_ (false),
+    verify_interval_ (30),
+    verify_interval_specified_ (false),
     proxy_ (),
-    proxy_specified_ (false)
+    proxy_specified_ (false),
+    release_index_ (),
+    release_index_specified_ (false),
+    release_index_key_ (),
+    release_index_key_specified_ (false),
+    release_index_max_age_ (0),
+    release_index_max_age_specified_ (false),
+    generate_release_index_ (),
+    generate_release_index_specified_ (false),
+    release_index_signing_key_ (),
+    release_index_signing_key_specified_ (false),
+    low_speed_limit_ (1024),
+    low_speed_limit_specified_ (false),
+    low_speed_time_ (30),
+    low_speed_time_specified_ (false),
+    ktls_ (),
+    root_ (),
+    root_specified_ (false),
+    root_hard_links_ (),
+    daemon_ (),
+    daemon_interval_ (3600),
+    daemon_interval_specified_ (false)
   {
   }
 
@@ -789,6 +839,10 @@ namespace launcher
            ::launcher::cli::unknown_mode arg)
   : help_ (),
     version_ (),
+    cache_status_ (),
+    stats_history_ (),
+    stats_retention_ (90),
+    stats_retention_specified_ (false),
     build2_metadata_ (),
     prerelease_ (),
     jobs_ (99),
@@ -801,9 +855,55 @@ namespace launcher
     no_self_update_ (),
     self_update_only_ (),
     skip_launch_ (),
+    sync_before_launch_ (),
+    boot_critical_ (),
+    boot_critical_specified_ (false),
+    background_rate_ (4096),
+    background_rate_specified_ (false),
+    prefetch_ (),
+    prefetch_file_ (),
+    prefetch_file_specified_ (false),
     skip_remote_ (),
+    probe_timeout_ (3000),
+    probe_timeout_specified_ (false),
+    api_deadline_ (5000),
+    api_deadline_specified_ (false),
+    direct_io_ (),
+    placement_ ("none"),
+    placement_specified_ (false),
+    durability_ ("batch"),
+    durability_specified_ (false),
+    verify_mode_ ("mtime"),
+    verify_mode_specified_ (false),
+    verify_budget_ (256),
+    verify_budget_specified_ (false),
+    verify_time_ (2000),
+    verify_time_specified_ (false),
+    verify_interval_ (30),
+    verify_interval_specified_ (false),
     proxy_ (),
-    proxy_specified_ (false)
+    proxy_specified_ (false),
+    release_index_ (),
+    release_index_specified_ (false),
+    release_index_key_ (),
+    release_index_key_specified_ (false),
+    release_index_max_age_ (0),
+    release_index_max_age_specified_ (false),
+    generate_release_index_ (),
+    generate_release_index_specified_ (false),
+    release_index_signing_key_ (),
+    release_index_signing_key_specified_ (false),
+    low_speed_limit_ (1024),
+    low_speed_limit_specified_ (false),
+    low_speed_time_ (30),
+    low_speed_time_specified_ (false),
+    ktls_ (),
+    root_ (),
+    root_specified_ (false),
+    root_hard_links_ (),
+    daemon_ (),
+    daemon_interval_ (3600),
+    daemon_interval_specified_ (false)
   {
     ::launcher::cli::argv_scanner s (argc, argv, erase);
     _parse (s, opt, arg);
@@ -818,6 +918,10 @@ namespace launcher
            ::launcher::cli::unknown_mode arg)
   : help_ (),
     version_ (),
+    cache_status_ (),
+    stats_history_ (),
+    stats_retention_ (90),
+    stats_retention_specified_ (false),
     build2_metadata_ (),
     prerelease_ (),
     jobs_ (99),
@@ -830,9 +934,55 @@ namespace launcher
     no_self_update_ (),
     self_update_only_ (),
     skip_launch_ (),
+    sync_before_launch_ (),
+    boot_critical_ (),
+    boot_critical_specified_ (false),
+    background_rate_ (4096),
+    background_rate_specified_ (false),
+    prefetch_ (),
+    prefetch_file_ (),
+    prefetch_file_specified_ (false),
     skip_remote_ (),
+    probe_timeout_ (3000),
+    probe_timeout_specified_ (false),
+    api_deadline_ (5000),
+    api_deadline_specified_ (false),
+    direct_io_ (),
+    placement_ ("none"),
+    placement_specified_ (false),
+    durability_ ("batch"),
+    durability_specified_ (false),
+    verify_mode_ ("mtime"),
+    verify_mode_specified_ (false),
+    verify_budget_ (256),
+    verify_budget_specified_ (false),
+    verify_time_ (2000),
+    verify_time_specified_ (false),
+    verify_interval_ (30),
+    verify_interval_specified_ (false),
     proxy_ (),
-    proxy_specified_ (false)
+    proxy_specified_ (false),
+    release_index_ (),
+    release_index_specified_ (false),
+    release_index_key_ (),
+    release_index_key_specified_ (false),
+    release_index_max_age_ (0),
+    release_index_max_age_specified_ (false),
+    generate_release_index_ (),
+    generate_release_index_specified_ (false),
+    release_index_signing_key_ (),
+    release_index_signing_key_specified_ (false),
+    low_speed_limit_ (1024),
+    low_speed_limit_specified_ (false),
+    low_speed_time_ (30),
+    low_speed_time_specified_ (false),
+    ktls_ (),
+    root_ (),
+    root_specified_ (false),
+    root_hard_links_ (),
+    daemon_ (),
+    daemon_interval_ (3600),
+    daemon_interval_specified_ (false)
   {
     ::launcher::cli::argv_scanner s (start, argc, argv, erase);
     _parse (s, opt, arg);
@@ -847,6 +997,10 @@ namespace launcher
            ::launcher::cli::unknown_mode arg)
   : help_ (),
     version_ (),
+    cache_status_ (),
+    stats_history_ (),
+    stats_retention_ (90),
+    stats_retention_specified_ (false),
     build2_metadata_ (),
     prerelease_ (),
     jobs_ (99),
@@ -859,9 +1013,55 @@ namespace launcher
     no_self_update_ (),
     self_update_only_ (),
     skip_launch_ (),
+    sync_before_launch_ (),
+    boot_critical_ (),
+    boot_critical_specified_ (false),
+    background_rate_ (4096),
+    background_rate_specified_ (false),
+    prefetch_ (),
+    prefetch_file_ (),
+    prefetch_file_specified_ (false),
     skip_remote_ (),
+    probe_timeout_ (3000),
+    probe_timeout_specified_ (false),
+    api_deadline_ (5000),
+    api_deadline_specified_ (false),
+    direct_io_ (),
+    placement_ ("none"),
+    placement_specified_ (false),
+    durability_ ("batch"),
+    durability_specified_ (false),
+    verify_mode_ ("mtime"),
+    verify_mode_specified_ (false),
+    verify_budget_ (256),
+    verify_budget_specified_ (false),
+    verify_time_ (2000),
+    verify_time_specified_ (false),
+    verify_interval_ (30),
+    verify_interval_specified_ (false),
     proxy_ (),
-    proxy_specified_ (false)
+    proxy_specified_ (false),
+    release_index_ (),
+    release_index_specified_ (false),
+    release_index_key_ (),
+    release_index_key_specified_ (false),
+    release_index_max_age_ (0),
+    release_index_max_age_specified_ (false),
+    generate_release_index_ (),
+    generate_release_index_specified_ (false),
+    release_index_signing_key_ (),
+    release_index_signing_key_specified_ (false),
+    low_speed_limit_ (1024),
+    low_speed_limit_specified_ (false),
+    low_speed_time_ (30),
+    low_speed_time_specified_ (false),
+    ktls_ (),
+    root_ (),
+    root_specified_ (false),
+    root_hard_links_ (),
+    daemon_ (),
+    daemon_interval_ (3600),
+    daemon_interval_specified_ (false)
   {
     ::launcher::cli::argv_scanner s (argc, argv, erase);
     _parse (s, opt, arg);
@@ -878,6 +1078,10 @@ namespace launcher
            ::launcher::cli::unknown_mode arg)
   : help_ (),
     version_ (),
+    cache_status_ (),
+    stats_history_ (),
+    stats_retention_ (90),
+    stats_retention_specified_ (false),
     build2_metadata_ (),
     prerelease_ (),
     jobs_ (99),
@@ -890,9 +1094,55 @@ namespace launcher
     no_self_update_ (),
     self_update_only_ (),
     skip_launch_ (),
+    sync_before_launch_ (),
+    boot_critical_ (),
+    boot_critical_specified_ (false),
+    background_rate_ (4096),
+    background_rate_specified_ (false),
+    prefetch_ (),
+    prefetch_file_ (),
+    prefetch_file_specified_ (false),
     skip_remote_ (),
+    probe_timeout_ (3000),
+    probe_timeout_specified_ (false),
+    api_deadline_ (5000),
+    api_deadline_specified_ (false),
+    direct_io_ (),
+    placement_ ("none"),
+    placement_specified_ (false),
+    durability_ ("batch"),
+    durability_specified_ (false),
+    verify_mode_ ("mtime"),
+    verify_mode_specified_ (false),
+    verify_budget_ (256),
+    verify_budget_specified_ (false),
+    verify_time_ (2000),
+    verify_time_specified_ (false),
+    verify_interval_ (30),
+    verify_interval_specified_ (false),
     proxy_ (),
-    proxy_specified_ (false)
+    proxy_specified_ (false),
+    release_index_ (),
+    release_index_specified_ (false),
+    release_index_key_ (),
+    release_index_key_specified_ (false),
+    release_index_max_age_ (0),
+    release_index_max_age_specified_ (false),
+    generate_release_index_ (),
+    generate_release_index_specified_ (false),
+    release_index_signing_key_ (),
+    release_index_signing_key_specified_ (false),
+    low_speed_limit_ (1024),
+    low_speed_limit_specified_ (false),
+    low_speed_time_ (30),
+    low_speed_time_specified_ (false),
+    ktls_ (),
+    root_ (),
+    root_specified_ (false),
+    root_hard_links_ (),
+    daemon_ (),
+    daemon_interval_ (3600),
+    daemon_interval_specified_ (false)
   {
     ::launcher::cli::argv_scanner s (start, argc, argv, erase);
     _parse (s, opt, arg);
@@ -905,6 +1155,10 @@ namespace launcher
            ::launcher::cli::unknown_mode arg)
   : help_ (),
     version_ (),
+    cache_status_ (),
+    stats_history_ (),
+    stats_retention_ (90),
+    stats_retention_specified_ (false),
     build2_metadata_ (),
     prerelease_ (),
     jobs_ (99),
@@ -917,9 +1171,55 @@ namespace launcher
     no_self_update_ (),
     self_update_only_ (),
     skip_launch_ (),
+    sync_before_launch_ (),
+    boot_critical_ (),
+    boot_critical_specified_ (false),
+    background_rate_ (4096),
+    background_rate_specified_ (false),
+    prefetch_ (),
+    prefetch_file_ (),
+    prefetch_file_specified_ (false),
     skip_remote_ (),
+    probe_timeout_ (3000),
+    probe_timeout_specified_ (false),
+    api_deadline_ (5000),
+    api_deadline_specified_ (false),
+    direct_io_ (),
+    placement_ ("none"),
+    placement_specified_ (false),
+    durability_ ("batch"),
+    durability_specified_ (false),
+    verify_mode_ ("mtime"),
+    verify_mode_specified_ (false),
+    verify_budget_ (256),
+    verify_budget_specified_ (false),
+    verify_time_ (2000),
+    verify_time_specified_ (false),
+    verify_interval_ (30),
+    verify_interval_specified_ (false),
     proxy_ (),
-    proxy_specified_ (false)
+    proxy_specified_ (false),
+    release_index_ (),
+    release_index_specified_ (false),
+    release_index_key_ (),
+    release_index_key_specified_ (false),
+    release_index_max_age_ (0),
+    release_index_max_age_specified_ (false),
+    generate_release_index_ (),
+    generate_release_index_specified_ (false),
+    release_index_signing_key_ (),
+    release_index_signing_key_specified_ (false),
+    low_speed_limit_ (1024),
+    low_speed_limit_specified_ (false),
+    low_speed_time_ (30),
+    low_speed_time_specified_ (false),
+    ktls_ (),
+    root_ (),
+    root_specified_ (false),
+    root_hard_links_ (),
+    daemon_ (),
+    daemon_interval_ (3600),
+    daemon_interval_specified_ (false)
   {
     _parse (s, opt, arg);
   }
@@ -932,32 +1232,143 @@ namespace launcher
     if (p == ::launcher::cli::usage_para::text)
       os << ::std::endl;
 
-    os << "--help                Show this help message and exit." << ::std::endl;
+    os << "--help                             Show this help message and exit." << ::std::endl;
 
-    os << "--version             Show version information and exit." << ::std::endl;
+    os << "--version                          Show version information and exit." << ::std::endl;
 
-    os << "--build2-metadata     Print the build2 metadata and exit." << ::std::endl;
+    os << "--cache-status                     Print a summary of the installation's cache" << ::std::endl
+       << "                                   (installed component versions, tracked file" << ::std::endl
+       << "                                   counts and sizes, and the outcome of the" << ::std::endl
+       << "                                   last synchronization) and exit." << ::std::endl;
 
-    os << "--prerelease          Opt-in to pre-release (beta) updates." << ::std::endl;
+    os << "--stats-history                    Print the performance ledger, that is, the" << ::std::endl
+       << "                                   bytes, files, duration, throughput (in bytes" << ::std::endl
+       << "                                   per second), errors, and retries of each" << ::std::endl
+       << "                                   phase (and download host) of past runs, and" << ::std::endl
+       << "                                   exit." << ::std::endl;
 
-    os << "--jobs|-j <num>       The number of parallel download jobs to run." << ::std::endl;
+    os << "--stats-retention <days>           How long to keep performance ledger records." << ::std::endl;
 
-    os << "--game-exe <file>     The game executable to launch." << ::std::endl;
+    os << "--build2-metadata                  Print the build2 metadata and exit." << ::std::endl;
 
-    os << "--game-args <arg>     Additional arguments to pass to the game executable." << ::std::endl;
+    os << "--prerelease                       Opt-in to pre-release (beta) updates." << ::std::endl;
 
-    os << "--force-steam-runtime Use the Steam Linux Runtime container instead of the" << ::std::endl
-       << "                      standalone Proton." << ::std::endl;
+    os << "--jobs|-j <num>                    The number of parallel download jobs to run." << ::std::endl;
 
-    os << "--no-self-update      Skip the automatic launcher self-update check." << ::std::endl;
+    os << "--game-exe <file>                  The game executable to launch." << ::std::endl;
 
-    os << "--self-update-only    Only check for and apply launcher updates, then exit." << ::std::endl;
+    os << "--game-args <arg>                  Additional arguments to pass to the game" << ::std::endl
+       << "                                   executable." << ::std::endl;
 
-    os << "--skip-launch         Skip launching the game after updating/installing." << ::std::endl;
+    os << "--force-steam-runtime              Use the Steam Linux Runtime container" << ::std::endl
+       << "                                   instead of the standalone Proton." << ::std::endl;
 
-    os << "--skip-remote         Skip all remote checks and file reconciliation." << ::std::endl;
+    os << "--no-self-update                   Skip the automatic launcher self-update" << ::std::endl
+       << "                                   check." << ::std::endl;
 
-    os << "--proxy <url>         Route all HTTP/HTTPS traffic through the specified proxy." << ::std::endl;
+    os << "--self-update-only                 Only check for and apply launcher updates," << ::std::endl
+       << "                                   then exit." << ::std::endl;
+
+    os << "--skip-launch                      Skip launching the game after" << ::std::endl
+       << "                                   updating/installing." << ::std::endl;
+
+    os << "--sync-before-launch               Synchronize every component, including DLC," << ::std::endl
+       << "                                   before launching the game." << ::std::endl;
+
+    os << "--boot-critical <path>             Treat DLC files under the specified path" << ::std::endl
+       << "                                   (relative to the installation root, for" << ::std::endl
+       << "                                   example, zone/dlc/mp_rust.ff) as" << ::std::endl
+       << "                                   boot-critical, that is, download them before" << ::std::endl
+       << "                                   launching the game." << ::std::endl;
+
+    os << "--background-rate <KiB/s>          The bandwidth cap for downloads that" << ::std::endl
+       << "                                   continue in the background after the game is" << ::std::endl
+       << "                                   launched." << ::std::endl;
+
+    os << "--prefetch                         Read the files the game needs at startup" << ::std::endl
+       << "                                   into memory before launching it." << ::std::endl;
+
+    os << "--prefetch-file <path>             Prefetch the specified file (relative to the" << ::std::endl
+       << "                                   installation root, for example," << ::std::endl
+       << "                                   zone/english/common_mp.ff) with --prefetch," << ::std::endl
+       << "                                   before the learned ones." << ::std::endl;
+
+    os << "--skip-remote                      Skip all remote checks and file" << ::std::endl
+       << "                                   reconciliation." << ::std::endl;
+
+    os << "--probe-timeout <ms>               How long to wait for the network check at" << ::std::endl
+       << "                                   startup." << ::std::endl;
+
+    os << "--api-deadline <ms>                How long to wait for GitHub when checking" << ::std::endl
+       << "                                   for updates." << ::std::endl;
+
+    os << "--direct-io                        Bypass the operating system's file cache" << ::std::endl
+       << "                                   when verifying installed files." << ::std::endl;
+
+    os << "--placement <policy>               How to place the hashing worker threads on" << ::std::endl
+       << "                                   CPUs." << ::std::endl;
+
+    os << "--durability <mode>                How hard to try to keep the installation" << ::std::endl
+       << "                                   consistent across power loss and crashes." << ::std::endl;
+
+    os << "--verify-mode <mode>               How to decide whether an installed file is" << ::std::endl
+       << "                                   still intact." << ::std::endl;
+
+    os << "--verify-budget <MiB>              The amount of installed file content to" << ::std::endl
+       << "                                   re-hash on each launch in order to detect" << ::std::endl
+       << "                                   silent corruption." << ::std::endl;
+
+    os << "--verify-time <ms>                 The time limit for re-hashing installed" << ::std::endl
+       << "                                   files on each launch (see --verify-budget)." << ::std::endl;
+
+    os << "--verify-interval <days>           How often each installed file should be" << ::std::endl
+       << "                                   re-hashed (see --verify-budget)." << ::std::endl;
+
+    os << "--proxy <url>                      Route all HTTP/HTTPS traffic through the" << ::std::endl
+       << "                                   specified proxy." << ::std::endl;
+
+    os << "--release-index <url>              Discover releases through the signed static" << ::std::endl
+       << "                                   release index at <url> before querying the" << ::std::endl
+       << "                                   GitHub API." << ::std::endl;
+
+    os << "--release-index-key <hex>          The hex-encoded Ed25519 public key the" << ::std::endl
+       << "                                   release index must be signed with." << ::std::endl;
+
+    os << "--release-index-max-age <days>     Reject a release index generated more than" << ::std::endl
+       << "                                   <days> days ago." << ::std::endl;
+
+    os << "--generate-release-index <file>    Query the GitHub API for the latest releases" << ::std::endl
+       << "                                   of the launcher and all the game components," << ::std::endl
+       << "                                   write a signed release index to <file>, and" << ::std::endl
+       << "                                   exit." << ::std::endl;
+
+    os << "--release-index-signing-key <file> The PEM-encoded Ed25519 private key to sign" << ::std::endl
+       << "                                   the release index with (as generated by, for" << ::std::endl
+       << "                                   example, openssl genpkey -algorithm" << ::std::endl
+       << "                                   ed25519)." << ::std::endl;
+
+    os << "--low-speed-limit <bytes>          Abort a download attempt if it receives less" << ::std::endl
+       << "                                   than this many bytes per second over" << ::std::endl
+       << "                                   --low-speed-time seconds." << ::std::endl;
+
+    os << "--low-speed-time <sec>             The period over which the download speed is" << ::std::endl
+       << "                                   checked against --low-speed-limit." << ::std::endl;
+
+    os << "--ktls                             Offload TLS to the kernel (kTLS) for" << ::std::endl
+       << "                                   downloads on Linux." << ::std::endl;
+
+    os << "--root <dir>                       Manage the specified installation root" << ::std::endl
+       << "                                   instead of the launcher's own directory." << ::std::endl;
+
+    os << "--root-hard-links                  In the fleet mode, hard link identical files" << ::std::endl
+       << "                                   between the installation roots instead of" << ::std::endl
+       << "                                   copying them (or reflinking, where the" << ::std::endl
+       << "                                   filesystem supports it)." << ::std::endl;
+
+    os << "--daemon                           Run as a background updater." << ::std::endl;
+
+    os << "--daemon-interval <sec>            The interval between update checks in the" << ::std::endl
+       << "                                   --daemon mode." << ::std::endl;
 
     p = ::launcher::cli::usage_para::option;
 
@@ -978,6 +1389,13 @@ namespace launcher
       &::launcher::cli::thunk< options, &options::help_ >;
       _cli_options_map_["--version"] =
       &::launcher::cli::thunk< options, &options::version_ >;
+      _cli_options_map_["--cache-status"] =
+      &::launcher::cli::thunk< options, &options::cache_status_ >;
+      _cli_options_map_["--stats-history"] =
+      &::launcher::cli::thunk< options, &options::stats_history_ >;
+      _cli_options_map_["--stats-retention"] =
+      &::launcher::cli::thunk< options, std::size_t, &options::stats_retention_,
+        &options::stats_retention_specified_ >;
       _cli_options_map_["--build2-metadata"] =
       &::launcher::cli::thunk< options, &options::build2_metadata_ >;
       _cli_options_map_["--prerelease"] =
@@ -1002,11 +1420,83 @@ namespace launcher
       &::launcher::cli::thunk< options, &options::self_update_only_ >;
       _cli_options_map_["--skip-launch"] =
       &::launcher::cli::thunk< options, &options::skip_launch_ >;
+      _cli_options_map_["--sync-before-launch"] =
+      &::launcher::cli::thunk< options, &options::sync_before_launch_ >;
+      _cli_options_map_["--boot-critical"] =
+      &::launcher::cli::thunk< options, std::vector<std::string>, &options::boot_critical_,
+        &options::boot_critical_specified_ >;
+      _cli_options_map_["--background-rate"] =
+      &::launcher::cli::thunk< options, std::uint64_t, &options::background_rate_,
+        &options::background_rate_specified_ >;
+      _cli_options_map_["--prefetch"] =
+      &::launcher::cli::thunk< options, &options::prefetch_ >;
+      _cli_options_map_["--prefetch-file"] =
+      &::launcher::cli::thunk< options, std::vector<std::string>, &options::prefetch_file_,
+        &options::prefetch_file_specified_ >;
       _cli_options_map_["--skip-remote"] =
       &::launcher::cli::thunk< options, &options::skip_remote_ >;
+      _cli_options_map_["--probe-timeout"] =
+      &::launcher::cli::thunk< options, std::size_t, &options::probe_timeout_,
+        &options::probe_timeout_specified_ >;
+      _cli_options_map_["--api-deadline"] =
+      &::launcher::cli::thunk< options, std::size_t, &options::api_deadline_,
+        &options::api_deadline_specified_ >;
+      _cli_options_map_["--direct-io"] =
+      &::launcher::cli::thunk< options, &options::direct_io_ >;
+      _cli_options_map_["--placement"] =
+      &::launcher::cli::thunk< options, std::string, &options::placement_,
+        &options::placement_specified_ >;
+      _cli_options_map_["--durability"] =
+      &::launcher::cli::thunk< options, std::string, &options::durability_,
+        &options::durability_specified_ >;
+      _cli_options_map_["--verify-mode"] =
+      &::launcher::cli::thunk< options, std::string, &options::verify_mode_,
+        &options::verify_mode_specified_ >;
+      _cli_options_map_["--verify-budget"] =
+      &::launcher::cli::thunk< options, std::uint64_t, &options::verify_budget_,
+        &options::verify_budget_specified_ >;
+      _cli_options_map_["--verify-time"] =
+      &::launcher::cli::thunk< options, std::uint64_t, &options::verify_time_,
+        &options::verify_time_specified_ >;
+      _cli_options_map_["--verify-interval"] =
+      &::launcher::cli::thunk< options, std::uint64_t, &options::verify_interval_,
+        &options::verify_interval_specified_ >;
       _cli_options_map_["--proxy"] =
       &::launcher::cli::thunk< options, std::string, &options::proxy_,
         &options::proxy_specified_ >;
+      _cli_options_map_["--release-index"] =
+      &::launcher::cli::thunk< options, std::string, &options::release_index_,
+        &options::release_index_specified_ >;
+      _cli_options_map_["--release-index-key"] =
+      &::launcher::cli::thunk< options, std::string, &options::release_index_key_,
+        &options::release_index_key_specified_ >;
+      _cli_options_map_["--release-index-max-age"] =
+      &::launcher::cli::thunk< options, std::size_t, &options::release_index_max_age_,
+        &options::release_index_max_age_specified_ >;
+      _cli_options_map_["--generate-release-index"] =
+      &::launcher::cli::thunk< options, std::string, &options::generate_release_index_,
+        &options::generate_release_index_specified_ >;
+      _cli_options_map_["--release-index-signing-key"] =
+      &::launcher::cli::thunk< options, std::string, &options::release_index_signing_key_,
+        &options::release_index_signing_key_specified_ >;
+      _cli_options_map_["--low-speed-limit"] =
+      &::launcher::cli::thunk< options, std::uint64_t, &options::low_speed_limit_,
+        &options::low_speed_limit_specified_ >;
+      _cli_options_map_["--low-speed-time"] =
+      &::launcher::cli::thunk< options, std::size_t, &options::low_speed_time_,
+        &options::low_speed_time_specified_ >;
+      _cli_options_map_["--ktls"] =
+      &::launcher::cli::thunk< options, &options::ktls_ >;
+      _cli_options_map_["--root"] =
+      &::launcher::cli::thunk< options, std::vector<std::string>, &options::root_,
+        &options::root_specified_ >;
+      _cli_options_map_["--root-hard-links"] =
+      &::launcher::cli::thunk< options, &options::root_hard_links_ >;
+      _cli_options_map_["--daemon"] =
+      &::launcher::cli::thunk< options, &options::daemon_ >;
+      _cli_options_map_["--daemon-interval"] =
+      &::launcher::cli::thunk< options, std::size_t, &options::daemon_interval_,
+        &options::daemon_interval_specified_ >;
     }
   };
 
@@ -480,6 +480,18 @@ namespace launcher
     const bool&
     version () const;
 
+    const bool&
+    cache_status () const;
+
+    const bool&
+    stats_history () const;
+
+    const std::size_t&
+    stats_retention () const;
+
+    bool
+    stats_retention_specified () const;
+
     const bool&
     build2_metadata () const;
 
@@ -516,15 +528,153 @@ namespace launcher
     const bool&
     skip_launch () const;
 
+    const bool&
+    sync_before_launch () const;
+
+    const std::vector<std::string>&
+    boot_critical () const;
+
+    bool
+    boot_critical_specified () const;
+
+    const std::uint64_t&
+    background_rate () const;
+
+    bool
+    background_rate_specified () const;
+
+    const bool&
+    prefetch () const;
+
+    const std::vector<std::string>&
+    prefetch_file () const;
+
+    bool
+    prefetch_file_specified () const;
+
     const bool&
     skip_remote () const;
 
+    const std::size_t&
+    probe_timeout () const;
+
+    bool
+    probe_timeout_specified () const;
+
+    const std::size_t&
+    api_deadline () const;
+
+    bool
+    api_deadline_specified () const;
+
+    const bool&
+    direct_io () const;
+
+    const std::string&
+    placement () const;
+
+    bool
+    placement_specified () const;
+
+    const std::string&
+    durability () const;
+
+    bool
+    durability_specified () const;
+
+    const std::string&
+    verify_mode () const;
+
+    bool
+    verify_mode_specified () const;
+
+    const std::uint64_t&
+    verify_budget () const;
+
+    bool
+    verify_budget_specified () const;
+
+    const std::uint64_t&
+    verify_time () const;
+
+    bool
+    verify_time_specified () const;
+
+    const std::uint64_t&
+    verify_interval () const;
+
+    bool
+    verify_interval_specified () const;
+
     const std::string&
     proxy () const;
 
     bool
     proxy_specified () const;
 
+    const std::string&
+    release_index () const;
+
+    bool
+    release_index_specified () const;
+
+    const std::string&
+    release_index_key () const;
+
+    bool
+    release_index_key_specified () const;
+
+    const std::size_t&
+    release_index_max_age () const;
+
+    bool
+    release_index_max_age_specified () const;
+
+    const std::string&
+    generate_release_index () const;
+
+    bool
+    generate_release_index_specified () const;
+
+    const std::string&
+    release_index_signing_key () const;
+
+    bool
+    release_index_signing_key_specified () const;
+
+    const std::uint64_t&
+    low_speed_limit () const;
+
+    bool
+    low_speed_limit_specified () const;
+
+    const std::size_t&
+    low_speed_time () const;
+
+    bool
+    low_speed_time_specified () const;
+
+    const bool&
+    ktls () const;
+
+    const std::vector<std::string>&
+    root () const;
+
+    bool
+    root_specified () const;
+
+    const bool&
+    root_hard_links () const;
+
+    const bool&
+    daemon () const;
+
+    const std::size_t&
+    daemon_interval () const;
+
+    bool
+    daemon_interval_specified () const;
+
     // Print usage information.
     //
     static ::launcher::cli::usage_para
@@ -546,6 +696,10 @@ namespace launcher
     public:
     bool help_;
     bool version_;
+    bool cache_status_;
+    bool stats_history_;
+    std::size_t stats_retention_;
+    bool stats_retention_specified_;
     bool build2_metadata_;
     bool prerelease_;
     std::size_t jobs_;
@@ -558,9 +712,55 @@ namespace launcher
     bool no_self_update_;
     bool self_update_only_;
     bool skip_launch_;
+    bool sync_before_launch_;
+    std::vector<std::string> boot_critical_;
+    bool boot_critical_specified_;
+    std::uint64_t background_rate_;
+    bool background_rate_specified_;
+    bool prefetch_;
+    std::vector<std::string> prefetch_file_;
+    bool prefetch_file_specified_;
     bool skip_remote_;
+    std::size_t probe_timeout_;
+    bool probe_timeout_specified_;
+    std::size_t api_deadline_;
+    bool api_deadline_specified_;
+    bool direct_io_;
+    std::string placement_;
+    bool placement_specified_;
+    std::string durability_;
+    bool durability_specified_;
+    std::string verify_mode_;
+    bool verify_mode_specified_;
+    std::uint64_t verify_budget_;
+    bool verify_budget_specified_;
+    std::uint64_t verify_time_;
+    bool verify_time_specified_;
+    std::uint64_t verify_interval_;
+    bool verify_interval_specified_;
     std::string proxy_;
     bool proxy_specified_;
+    std::string release_index_;
+    bool release_index_specified_;
+    std::string release_index_key_;
+    bool release_index_key_specified_;
+    std::size_t release_index_max_age_;
+    bool release_index_max_age_specified_;
+    std::string generate_release_index_;
+    bool generate_release_index_specified_;
+    std::string release_index_signing_key_;
+    bool release_index_signing_key_specified_;
+    std::uint64_t low_speed_limit_;
+    bool low_speed_limit_specified_;
+    std::size_t low_speed_time_;
+    bool low_speed_time_specified_;
+    bool ktls_;
+    std::vector<std::string> root_;
+    bool root_specified_;
+    bool root_hard_links_;
+    bool daemon_;
+    std::size_t daemon_interval_;
+    bool daemon_interval_specified_;
   };
 }
 
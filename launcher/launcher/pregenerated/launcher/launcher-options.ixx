@@ -293,6 +293,30 @@ namespace launcher
     return this->version_;
   }
 
+  inline const bool& options::
+  cache_status () const
+  {
+    return this->cache_status_;
+  }
+
+  inline const bool& options::
+  stats_history () const
+  {
+    return this->stats_history_;
+  }
+
+  inline const std::size_t& options::
+  stats_retention () const
+  {
+    return this->stats_retention_;
+  }
+
+  inline bool options::
+  stats_retention_specified () const
+  {
+    return this->stats_retention_specified_;
+  }
+
   inline const bool& options::
   build2_metadata () const
   {
@@ -365,12 +389,162 @@ namespace launcher
     return this->skip_launch_;
   }
 
+  inline const bool& options::
+  sync_before_launch () const
+  {
+    return this->sync_before_launch_;
+  }
+
+  inline const std::vector<std::string>& options::
+  boot_critical () const
+  {
+    return this->boot_critical_;
+  }
+
+  inline bool options::
+  boot_critical_specified () const
+  {
+    return this->boot_critical_specified_;
+  }
+
+  inline const std::uint64_t& options::
+  background_rate () const
+  {
+    return this->background_rate_;
+  }
+
+  inline bool options::
+  background_rate_specified () const
+  {
+    return this->background_rate_specified_;
+  }
+
+  inline const bool& options::
+  prefetch () const
+  {
+    return this->prefetch_;
+  }
+
+  inline const std::vector<std::string>& options::
+  prefetch_file () const
+  {
+    return this->prefetch_file_;
+  }
+
+  inline bool options::
+  prefetch_file_specified () const
+  {
+    return this->prefetch_file_specified_;
+  }
+
   inline const bool& options::
   skip_remote () const
   {
     return this->skip_remote_;
   }
 
+  inline const std::size_t& options::
+  probe_timeout () const
+  {
+    return this->probe_timeout_;
+  }
+
+  inline bool options::
+  probe_timeout_specified () const
+  {
+    return this->probe_timeout_specified_;
+  }
+
+  inline const std::size_t& options::
+  api_deadline () const
+  {
+    return this->api_deadline_;
+  }
+
+  inline bool options::
+  api_deadline_specified () const
+  {
+    return this->api_deadline_specified_;
+  }
+
+  inline const bool& options::
+  direct_io () const
+  {
+    return this->direct_io_;
+  }
+
+  inline const std::string& options::
+  placement () const
+  {
+    return this->placement_;
+  }
+
+  inline bool options::
+  placement_specified () const
+  {
+    return this->placement_specified_;
+  }
+
+  inline const std::string& options::
+  durability () const
+  {
+    return this->durability_;
+  }
+
+  inline bool options::
+  durability_specified () const
+  {
+    return this->durability_specified_;
+  }
+
+  inline const std::string& options::
+  verify_mode () const
+  {
+    return this->verify_mode_;
+  }
+
+  inline bool options::
+  verify_mode_specified () const
+  {
+    return this->verify_mode_specified_;
+  }
+
+  inline const std::uint64_t& options::
+  verify_budget () const
+  {
+    return this->verify_budget_;
+  }
+
+  inline bool options::
+  verify_budget_specified () const
+  {
+    return this->verify_budget_specified_;
+  }
+
+  inline const std::uint64_t& options::
+  verify_time () const
+  {
+    return this->verify_time_;
+  }
+
+  inline bool options::
+  verify_time_specified () const
+  {
+    return this->verify_time_specified_;
+  }
+
+  inline const std::uint64_t& options::
+  verify_interval () const
+  {
+    return this->verify_interval_;
+  }
+
+  inline bool options::
+  verify_interval_specified () const
+  {
+    return this->verify_interval_specified_;
+  }
+
   inline const std::string& options::
   proxy () const
   {
@@ -382,6 +556,132 @@ namespace launcher
   {
     return this->proxy_specified_;
   }
+
+  inline const std::string& options::
+  release_index () const
+  {
+    return this->release_index_;
+  }
+
+  inline bool options::
+  release_index_specified () const
+  {
+    return this->release_index_specified_;
+  }
+
+  inline const std::string& options::
+  release_index_key () const
+  {
+    return this->release_index_key_;
+  }
+
+  inline bool options::
+  release_index_key_specified () const
+  {
+    return this->release_index_key_specified_;
+  }
+
+  inline const std::size_t& options::
+  release_index_max_age () const
+  {
+    return this->release_index_max_age_;
+  }
+
+  inline bool options::
+  release_index_max_age_specified () const
+  {
+    return this->release_index_max_age_specified_;
+  }
+
+  inline const std::string& options::
+  generate_release_index () const
+  {
+    return this->generate_release_index_;
+  }
+
+  inline bool options::
+  generate_release_index_specified () const
+  {
+    return this->generate_release_index_specified_;
+  }
+
+  inline const std::string& options::
+  release_index_signing_key () const
+  {
+    return this->release_index_signing_key_;
+  }
+
+  inline bool options::
+  release_index_signing_key_specified () const
+  {
+    return this->release_index_signing_key_specified_;
+  }
+
+  inline const std::uint64_t& options::
+  low_speed_limit () const
+  {
+    return this->low_speed_limit_;
+  }
+
+  inline bool options::
+  low_speed_limit_specified () const
+  {
+    return this->low_speed_limit_specified_;
+  }
+
+  inline const std::size_t& options::
+  low_speed_time () const
+  {
+    return this->low_speed_time_;
+  }
+
+  inline bool options::
+  low_speed_time_specified () const
+  {
+    return this->low_speed_time_specified_;
+  }
+
+  inline const bool& options::
+  ktls () const
+  {
+    return this->ktls_;
+  }
+
+  inline const std::vector<std::string>& options::
+  root () const
+  {
+    return this->root_;
+  }
+
+  inline bool options::
+  root_specified () const
+  {
+    return this->root_specified_;
+  }
+
+  inline const bool& options::
+  root_hard_links () const
+  {
+    return this->root_hard_links_;
+  }
+
+  inline const bool& options::
+  daemon () const
+  {
+    return this->daemon_;
+  }
+
+  inline const std::size_t& options::
+  daemon_interval () const
+  {
+    return this->daemon_interval_;
+  }
+
+  inline bool options::
+  daemon_interval_specified () const
+  {
+    return this->daemon_interval_specified_;
+  }
 }
 
 // Begin epilogue.
@@ -54,7 +54,17 @@ namespace launcher
   std::shared_ptr<progress_entry> progress_manager::
   add_entry (std::string l)
   {
-    auto e (std::make_shared<progress_entry> (std::move (l)));
+    return add_entry (std::move (l), nullptr, nullptr);
+  }
+
+  std::shared_ptr<progress_entry> progress_manager::
+  add_entry (std::string l,
+             progress_entry::counter c,
+             progress_entry::counter t)
+  {
+    auto e (std::make_shared<progress_entry> (std::move (l),
+                                              std::move (c),
+                                              std::move (t)));
 
     asio::post (strand_,
                 [this, e]
@@ -94,6 +104,11 @@ namespace launcher
 
         entries_buffer_.store (w, std::memory_order_release);
 
+        // Catch up with the followed counters which may have moved since
+        // the last update.
+        //
+        e->pull ();
+
         if (e->metrics ().state.load (std::memory_order_relaxed) ==
             progress_state::completed)
         {
@@ -158,6 +173,8 @@ namespace launcher
 
       for (const auto& e : entries)
       {
+        e->pull ();
+
         auto& m (e->metrics ());
         auto& t (e->tracker ());
 
@@ -22,12 +22,28 @@ namespace launcher
   class progress_entry
   {
   public:
+    // A counter owned by someone else (for example, a download task) that
+    // the entry keeps alive.
+    //
+    using counter = std::shared_ptr<const std::atomic<std::uint64_t>>;
+
     explicit
     progress_entry (std::string label)
       : label_ (std::move (label))
     {
     }
 
+    // Follow the specified current and total byte counters: rather than
+    // having the progress pushed (see progress_coordinator), the metrics
+    // are refreshed from the counters on every update (see pull()).
+    //
+    progress_entry (std::string label, counter current, counter total)
+      : label_ (std::move (label)),
+        current_src_ (std::move (current)),
+        total_src_ (std::move (total))
+    {
+    }
+
     const std::string&
     label () const noexcept
     {
@@ -64,10 +80,43 @@ namespace launcher
       return progress_snapshot (metrics_);
     }
 
+    // Refresh the metrics from the followed counters, if any.
+    //
+    // Note that a zero total means it's not (yet) known, in which case we
+    // keep whatever the entry was created with.
+    //
+    void
+    pull () noexcept
+    {
+      if (current_src_ == nullptr)
+        return;
+
+      std::uint64_t c (current_src_->load (std::memory_order_relaxed));
+      std::uint64_t t (total_src_ != nullptr
+                       ? total_src_->load (std::memory_order_relaxed)
+                       : 0);
+
+      if (t != 0)
+        metrics_.total_bytes.store (t, std::memory_order_relaxed);
+      else
+        t = metrics_.total_bytes.load (std::memory_order_relaxed);
+
+      metrics_.current_bytes.store (c, std::memory_order_relaxed);
+
+      if (c != 0)
+        metrics_.state.store ((t > 0 && c >= t)
+                              ? progress_state::completed
+                              : progress_state::active,
+                              std::memory_order_relaxed);
+    }
+
   private:
     std::string label_;
     progress_metrics metrics_;
     progress_tracker tracker_;
+
+    counter current_src_;
+    counter total_src_;
   };
 
   class progress_manager
@@ -93,6 +142,11 @@ namespace launcher
     std::shared_ptr<progress_entry>
     add_entry (std::string label);
 
+    std::shared_ptr<progress_entry>
+    add_entry (std::string label,
+               progress_entry::counter current,
+               progress_entry::counter total);
+
     void
     remove_entry (std::shared_ptr<progress_entry> entry);
 
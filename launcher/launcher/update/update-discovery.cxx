@@ -53,6 +53,13 @@ namespace launcher
     return include_prerelease_;
   }
 
+  void update_discovery::
+  set_release_index (shared_ptr<github_index> i)
+  {
+    launcher::log::trace_l3 (categories::update{}, "setting release index: {}", i != nullptr ? i->url () : string ());
+    index_ = move (i);
+  }
+
   asio::awaitable<update_info> update_discovery::
   check_for_update (const string& o,
                     const string& r,
@@ -88,6 +95,32 @@ namespace launcher
   {
     launcher::log::trace_l2 (categories::update{}, "fetching latest release metadata from {}/{} (include_prerelease: {})", o, r, include_prerelease_);
 
+    // If the release index lists us, that's all we need. Note that the index
+    // only carries releases that are not drafts. If it is unusable, we fall
+    // back to the API from now on rather than fetching it again on every
+    // check.
+    //
+    if (index_ != nullptr)
+    {
+      optional<release_type> ir;
+
+      try
+      {
+        ir = co_await index_->find_latest_release (o, r, include_prerelease_);
+      }
+      catch (const exception& e)
+      {
+        launcher::log::warning (categories::update{}, "unable to use release index {}: {}", index_->url (), e.what ());
+        index_.reset ();
+      }
+
+      if (ir)
+      {
+        launcher::log::debug (categories::update{}, "selected release '{}' from release index", ir->tag_name);
+        co_return release_to_update_info (*ir);
+      }
+    }
+
     // Grab a batch of releases. We ask for 20 hoping that if we are ignoring
     // prereleases, we will find at least one stable release in this set.
     //
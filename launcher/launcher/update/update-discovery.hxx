@@ -3,12 +3,14 @@
 #include <boost/asio.hpp>
 
 #include <functional>
+#include <memory>
 #include <optional>
 #include <string>
 
 #include <launcher/update/update-types.hxx>
 
 #include <launcher/github/github-api.hxx>
+#include <launcher/github/github-index.hxx>
 
 namespace launcher
 {
@@ -54,6 +56,11 @@ namespace launcher
     bool
     include_prerelease () const noexcept;
 
+    // Consult a static release index before the API.
+    //
+    void
+    set_release_index (std::shared_ptr<github_index> index);
+
     // Discovery.
     //
 
@@ -113,5 +120,6 @@ namespace launcher
     asio::io_context& ioc_;
     api_type api_;
     bool include_prerelease_ = false;
+    std::shared_ptr<github_index> index_;
   };
 }